@@ -0,0 +1,73 @@
+#include "MetricAccumulator.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define METRICS_HAS_SSE2 1
+#endif
+
+namespace MetricsSystem {
+
+    namespace {
+
+        // Leaves of the pairwise tree are summed linearly across 4 lanes
+        const size_t kPairwiseBlock = 128;
+
+        template<typename V>
+        double blockSum(const V* values, size_t count) {
+#ifdef METRICS_HAS_SSE2
+            __m128d lanes_a = _mm_setzero_pd();
+            __m128d lanes_b = _mm_setzero_pd();
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                if constexpr (std::is_same_v<V, double>) {
+                    lanes_a = _mm_add_pd(lanes_a, _mm_loadu_pd(values + i));
+                    lanes_b = _mm_add_pd(lanes_b, _mm_loadu_pd(values + i + 2));
+                } else {
+                    __m128 quad = _mm_loadu_ps(values + i);
+                    lanes_a = _mm_add_pd(lanes_a, _mm_cvtps_pd(quad));
+                    lanes_b = _mm_add_pd(lanes_b, _mm_cvtps_pd(_mm_movehl_ps(quad, quad)));
+                }
+            }
+
+            double lanes[4];
+            _mm_storeu_pd(lanes, lanes_a);
+            _mm_storeu_pd(lanes + 2, lanes_b);
+#else
+            double lanes[4] = { 0.0, 0.0, 0.0, 0.0 };
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                lanes[0] += values[i];
+                lanes[1] += values[i + 1];
+                lanes[2] += values[i + 2];
+                lanes[3] += values[i + 3];
+            }
+#endif
+            double tail = 0.0;
+            for (; i < count; ++i) {
+                tail += values[i];
+            }
+            return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + tail;
+        }
+
+        template<typename V>
+        double pairwise(const V* values, size_t count) {
+            if (count <= kPairwiseBlock) {
+                return blockSum(values, count);
+            }
+
+            // Split on a block boundary so leaves stay full
+            size_t half = (count / 2 + kPairwiseBlock - 1) / kPairwiseBlock * kPairwiseBlock;
+            return pairwise(values, half) + pairwise(values + half, count - half);
+        }
+
+    } // namespace
+
+    double PairwiseSum::sum(const double* values, size_t count) {
+        return pairwise(values, count);
+    }
+
+    double PairwiseSum::sum(const float* values, size_t count) {
+        return pairwise(values, count);
+    }
+
+} // namespace MetricsSystem
\ No newline at end of file
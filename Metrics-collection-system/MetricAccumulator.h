@@ -0,0 +1,177 @@
+#pragma once
+
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <type_traits>
+
+namespace MetricsSystem {
+
+    // Value types a TypedMetric can hold: arithmetic types other than bool,
+    // or trivially copyable (checkpointable) structs that add up, divide by
+    // a sample count and print
+    template<typename T>
+    concept Accumulable =
+        !std::same_as<T, bool> &&
+        (std::is_arithmetic_v<T> ||
+         (std::is_trivially_copyable_v<T> && std::default_initializable<T> && std::equality_comparable<T> &&
+          requires(T& a, const T& b, uint64_t samples, std::ostream& os) {
+              a += b;
+              { b / samples } -> std::convertible_to<T>;
+              os << b;
+          }));
+
+    // What an integer accumulator does when a sum leaves its range
+    enum class CounterOverflow {
+        Saturate,   // Stop at the largest (or smallest) representable value
+        Wrap        // Modulo 2^64 like a hardware counter; rates stay correct across the wrap
+    };
+
+    // Integers are accumulated in 64 bits of their own signedness, so an
+    // interval of int samples cannot overflow; floating-point values are
+    // accumulated in their own type (with compensation), structs as they are
+    template<typename T>
+    struct AccumulatorTraits {
+        using type = T;
+    };
+
+    template<std::integral T>
+    struct AccumulatorTraits<T> {
+        using type = std::conditional_t<std::is_signed_v<T>, int64_t, uint64_t>;
+    };
+
+    template<typename T>
+    using AccumulatorType = typename AccumulatorTraits<T>::type;
+
+    // a + b for 64-bit accumulators without undefined behavior
+    template<std::integral A>
+    A addCounter(A a, A b, CounterOverflow overflow) {
+        using Unsigned = std::make_unsigned_t<A>;
+        A wrapped = static_cast<A>(static_cast<Unsigned>(a) + static_cast<Unsigned>(b));
+        if (overflow == CounterOverflow::Wrap) {
+            return wrapped;
+        }
+
+        if constexpr (std::is_signed_v<A>) {
+            // Overflowed iff both operands have the same sign and the result does not
+            if ((a < 0) == (b < 0) && (wrapped < 0) != (a < 0)) {
+                return a < 0 ? std::numeric_limits<A>::min() : std::numeric_limits<A>::max();
+            }
+        } else if (wrapped < a) {
+            return std::numeric_limits<A>::max();
+        }
+        return wrapped;
+    }
+
+    // Interval sum and sample count of one TypedMetric shard. Integers add
+    // exactly in their 64-bit accumulator type; floating-point values use
+    // Neumaier compensation, so millions of small samples next to a few
+    // large ones do not lose their contribution.
+    template<typename T, bool = std::is_floating_point_v<T>>
+    struct CompensatedSum {
+        AccumulatorType<T> sum{};
+        uint64_t count = 0;
+
+        void add(AccumulatorType<T> value, uint64_t samples = 1, CounterOverflow overflow = CounterOverflow::Saturate) {
+            if constexpr (std::is_integral_v<T>) {
+                sum = addCounter(sum, value, overflow);
+            } else {
+                sum += value;
+            }
+            count += samples;
+        }
+
+        void merge(const CompensatedSum& other, CounterOverflow overflow = CounterOverflow::Saturate) {
+            add(other.sum, other.count, overflow);
+        }
+
+        AccumulatorType<T> value() const { return sum; }
+        AccumulatorType<T> compensation() const { return AccumulatorType<T>{}; }
+        void reset() { sum = AccumulatorType<T>{}; count = 0; }
+    };
+
+    template<typename T>
+    struct CompensatedSum<T, true> {
+        T sum{};
+        uint64_t count = 0; // Between sum and correction: their updates stay separate stores
+        T correction{};     // Low-order bits lost from sum so far
+
+        void add(T value, uint64_t samples = 1, CounterOverflow = CounterOverflow::Saturate) {
+            T total = sum + value;
+            correction += std::fabs(sum) >= std::fabs(value) ? (sum - total) + value : (value - total) + sum;
+            sum = total;
+            count += samples;
+        }
+
+        void merge(const CompensatedSum& other, CounterOverflow = CounterOverflow::Saturate) {
+            add(other.sum, other.count);
+            correction += other.correction;
+        }
+
+        T value() const { return sum + correction; }
+        T compensation() const { return correction; }
+        void reset() { sum = T{}; count = 0; correction = T{}; }
+    };
+
+    // Sums of whole arrays (recordValues batches). Pairwise reduction
+    // over SIMD lanes: error grows with log(n) instead of n at the cost of
+    // a plain vectorized loop. Floats are accumulated in double.
+    class PairwiseSum {
+    public:
+        static double sum(const double* values, size_t count);
+        static double sum(const float* values, size_t count);
+
+        // Integers are summed modulo 2^64 in their accumulator type; plain
+        // loop the compiler vectorizes. Exact unless the batch itself
+        // overflows 64 bits.
+        template<std::integral T>
+        static AccumulatorType<T> sum(const T* values, size_t count) {
+            uint64_t total = 0;
+            for (size_t i = 0; i < count; ++i) {
+                total += static_cast<uint64_t>(static_cast<AccumulatorType<T>>(values[i]));
+            }
+            return static_cast<AccumulatorType<T>>(total);
+        }
+
+        // User-defined accumulable types: running sum in order
+        template<typename T>
+            requires (!std::is_arithmetic_v<T>)
+        static T sum(const T* values, size_t count) {
+            T total{};
+            for (size_t i = 0; i < count; ++i) {
+                total += values[i];
+            }
+            return total;
+        }
+    };
+
+    // Sum of an array in the accumulator type of T. With Saturate, 64-bit
+    // integers are checked per value because the batch itself can overflow.
+    // long double has no SIMD path and summing it in double would drop its
+    // extra precision, so it gets a scalar Neumaier loop.
+    template<Accumulable T>
+    AccumulatorType<T> batchSum(const T* values, size_t count, CounterOverflow overflow) {
+        if constexpr (std::is_integral_v<T>) {
+            if (overflow == CounterOverflow::Saturate && sizeof(T) == sizeof(AccumulatorType<T>)) {
+                AccumulatorType<T> total = 0;
+                for (size_t i = 0; i < count; ++i) {
+                    total = addCounter<AccumulatorType<T>>(total, values[i], overflow);
+                }
+                return total;
+            }
+            return PairwiseSum::sum(values, count);
+        } else if constexpr (std::is_same_v<T, long double>) {
+            CompensatedSum<T> total;
+            for (size_t i = 0; i < count; ++i) {
+                total.add(values[i]);
+            }
+            return total.value();
+        } else {
+            return static_cast<T>(PairwiseSum::sum(values, count));
+        }
+    }
+
+} // namespace MetricsSystem
\ No newline at end of file
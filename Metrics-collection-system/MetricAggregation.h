@@ -0,0 +1,353 @@
+#pragma once
+
+#include "MetricAccumulator.h"
+#include "MetricCheckpoint.h"
+#include "MetricValue.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+namespace MetricsSystem {
+
+    // Aggregation policies for TypedMetric<T, Policy>. A policy names the
+    // per-shard Accumulator<T>, which keeps only the state the policy needs:
+    //
+    //   add(value, overflow)               record one sample
+    //   addBatch(values, count, overflow)  record an array (count > 0)
+    //   merge(other, overflow)             fold a local accumulator in (locked accumulators)
+    //   drainInto(total, reset, overflow)  add this shard to `total`, optionally starting over
+    //   result()                           interval value for output
+    //   save(out) / load(in, overflow)     checkpoint state
+    //
+    // kLockFree accumulators update with atomics and are never locked; the
+    // others are guarded by their shard mutex. kShardable = false keeps a
+    // metric on one accumulator.
+
+    // Interval total. Integers add with one atomic operation; floating-point
+    // and user-defined values keep a compensated sum under the shard lock.
+    template<Accumulable T, bool = std::is_integral_v<T>>
+    class SumAccumulator {
+    private:
+        CompensatedSum<T> sum_;
+
+    public:
+        static constexpr bool kLockFree = false;
+        static constexpr bool kShardable = true;
+
+        void add(T value, CounterOverflow overflow) { sum_.add(value, 1, overflow); }
+        void addBatch(const T* values, size_t count, CounterOverflow overflow) {
+            sum_.add(batchSum(values, count, overflow), count, overflow);
+        }
+        void merge(const SumAccumulator& other, CounterOverflow overflow) { sum_.merge(other.sum_, overflow); }
+        void drainInto(SumAccumulator& total, bool reset, CounterOverflow overflow) {
+            total.merge(*this, overflow);
+            if (reset) {
+                sum_.reset();
+            }
+        }
+        void reset() { sum_.reset(); }
+
+        std::unique_ptr<MetricValue> result() const {
+            if (sum_.count == 0) {
+                return std::make_unique<TypedMetricValue<T>>();
+            }
+            return std::make_unique<TypedMetricValue<T>>(sum_.value());
+        }
+
+        void save(CheckpointWriter& out) const {
+            out.put(sum_.value());
+            out.put(sum_.count);
+        }
+        void load(CheckpointReader& in, CounterOverflow overflow) {
+            auto sum = in.get<AccumulatorType<T>>();
+            auto count = in.get<uint64_t>();
+            sum_.add(sum, count, overflow);
+        }
+    };
+
+    template<Accumulable T>
+    class SumAccumulator<T, true> {
+    private:
+        using Accumulated = AccumulatorType<T>;
+        std::atomic<Accumulated> sum_{ 0 };
+
+        // Atomic integer arithmetic wraps. Saturation pins the limit after
+        // the fact, which only costs a second store when the sum crosses it
+        // (a concurrent update in between is lost - at the limit anyway).
+        void addAccumulated(Accumulated value, CounterOverflow overflow) {
+            Accumulated previous = sum_.fetch_add(value, std::memory_order_relaxed);
+            if (overflow == CounterOverflow::Saturate) {
+                Accumulated saturated = addCounter(previous, value, overflow);
+                if (saturated != addCounter(previous, value, CounterOverflow::Wrap)) {
+                    sum_.store(saturated, std::memory_order_relaxed);
+                }
+            }
+        }
+
+    public:
+        static constexpr bool kLockFree = true;
+        static constexpr bool kShardable = true;
+
+        void add(T value, CounterOverflow overflow) { addAccumulated(value, overflow); }
+        void addBatch(const T* values, size_t count, CounterOverflow overflow) {
+            addAccumulated(batchSum(values, count, overflow), overflow);
+        }
+        void drainInto(SumAccumulator& total, bool reset, CounterOverflow overflow) {
+            Accumulated value = reset ? sum_.exchange(0, std::memory_order_relaxed) : sum_.load(std::memory_order_relaxed);
+            total.addAccumulated(value, overflow);
+        }
+        void reset() { sum_.store(0, std::memory_order_relaxed); }
+
+        std::unique_ptr<MetricValue> result() const {
+            return std::make_unique<TypedMetricValue<T>>(sum_.load(std::memory_order_relaxed));
+        }
+
+        void save(CheckpointWriter& out) const { out.put(sum_.load(std::memory_order_relaxed)); }
+        void load(CheckpointReader& in, CounterOverflow overflow) { addAccumulated(in.get<Accumulated>(), overflow); }
+    };
+
+    // Interval average (sum and sample count under the shard lock)
+    template<Accumulable T>
+    class MeanAccumulator {
+    private:
+        CompensatedSum<T> sum_;
+
+    public:
+        static constexpr bool kLockFree = false;
+        static constexpr bool kShardable = true;
+
+        void add(T value, CounterOverflow overflow) { sum_.add(value, 1, overflow); }
+        void addBatch(const T* values, size_t count, CounterOverflow overflow) {
+            sum_.add(batchSum(values, count, overflow), count, overflow);
+        }
+        void merge(const MeanAccumulator& other, CounterOverflow overflow) { sum_.merge(other.sum_, overflow); }
+        void drainInto(MeanAccumulator& total, bool reset, CounterOverflow overflow) {
+            total.merge(*this, overflow);
+            if (reset) {
+                sum_.reset();
+            }
+        }
+        void reset() { sum_.reset(); }
+
+        // Sum and sample count, so coalesced ticks weight their means
+        std::unique_ptr<MetricValue> result() const {
+            if (sum_.count == 0) {
+                return std::make_unique<TypedMetricValue<T>>();
+            }
+            return std::make_unique<TypedMetricValue<T>>(sum_.value(), TickMerge::Mean, sum_.count);
+        }
+
+        void save(CheckpointWriter& out) const {
+            out.put(sum_.value());
+            out.put(sum_.count);
+        }
+        void load(CheckpointReader& in, CounterOverflow overflow) {
+            auto sum = in.get<AccumulatorType<T>>();
+            auto count = in.get<uint64_t>();
+            sum_.add(sum, count, overflow);
+        }
+    };
+
+    // Interval maximum: one atomic compare-exchange, and only when a sample
+    // raises the maximum. An empty interval holds the lowest value.
+    template<Accumulable T>
+        requires std::is_arithmetic_v<T>
+    class MaxAccumulator {
+    private:
+        static constexpr T kEmpty = std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity()
+                                                                          : std::numeric_limits<T>::lowest();
+        std::atomic<T> max_{ kEmpty };
+
+    public:
+        static constexpr bool kLockFree = true;
+        static constexpr bool kShardable = true;
+
+        void add(T value, CounterOverflow) {
+            T current = max_.load(std::memory_order_relaxed);
+            while (value > current && !max_.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+            }
+        }
+        void addBatch(const T* values, size_t count, CounterOverflow overflow) {
+            add(*std::max_element(values, values + count), overflow);
+        }
+        void drainInto(MaxAccumulator& total, bool reset, CounterOverflow overflow) {
+            T value = reset ? max_.exchange(kEmpty, std::memory_order_relaxed) : max_.load(std::memory_order_relaxed);
+            total.add(value, overflow);
+        }
+        void reset() { max_.store(kEmpty, std::memory_order_relaxed); }
+
+        std::unique_ptr<MetricValue> result() const {
+            T value = max_.load(std::memory_order_relaxed);
+            return value == kEmpty ? std::make_unique<TypedMetricValue<T>>()
+                                   : std::make_unique<TypedMetricValue<T>>(value, TickMerge::Max);
+        }
+
+        void save(CheckpointWriter& out) const { out.put(max_.load(std::memory_order_relaxed)); }
+        void load(CheckpointReader& in, CounterOverflow overflow) { add(in.get<T>(), overflow); }
+    };
+
+    // Most recent sample of the interval: two relaxed stores. Samples from
+    // different threads have no order beyond the one the atomic gives, so
+    // the metric is never split into shards.
+    template<Accumulable T>
+    class LastAccumulator {
+    private:
+        std::atomic<T> value_{ T{} };
+        std::atomic<bool> updated_{ false };
+
+    public:
+        static constexpr bool kLockFree = true;
+        static constexpr bool kShardable = false;
+
+        void add(T value, CounterOverflow) {
+            value_.store(value, std::memory_order_relaxed);
+            updated_.store(true, std::memory_order_release);
+        }
+        void addBatch(const T* values, size_t count, CounterOverflow overflow) { add(values[count - 1], overflow); }
+        void drainInto(LastAccumulator& total, bool reset, CounterOverflow overflow) {
+            bool updated = reset ? updated_.exchange(false, std::memory_order_acq_rel) : updated_.load(std::memory_order_acquire);
+            if (updated) {
+                total.add(value_.load(std::memory_order_relaxed), overflow);
+            }
+        }
+        void reset() { updated_.store(false, std::memory_order_relaxed); }
+
+        std::unique_ptr<MetricValue> result() const {
+            if (!updated_.load(std::memory_order_acquire)) {
+                return std::make_unique<TypedMetricValue<T>>();
+            }
+            return std::make_unique<TypedMetricValue<T>>(value_.load(std::memory_order_relaxed), TickMerge::Last);
+        }
+
+        void save(CheckpointWriter& out) const {
+            out.put(updated_.load(std::memory_order_acquire));
+            out.put(value_.load(std::memory_order_relaxed));
+        }
+        void load(CheckpointReader& in, CounterOverflow overflow) {
+            bool updated = in.get<bool>();
+            T value = in.get<T>();
+            if (updated) {
+                add(value, overflow);
+            }
+        }
+    };
+
+    // Interval minimum, maximum and mean under the shard lock
+    template<Accumulable T>
+        requires std::is_arithmetic_v<T>
+    class MinMaxMeanAccumulator {
+    private:
+        T min_{};
+        T max_{};
+        CompensatedSum<T> sum_;
+
+        void extend(T min, T max) {
+            if (sum_.count == 0) {
+                min_ = min;
+                max_ = max;
+            } else {
+                min_ = std::min(min_, min);
+                max_ = std::max(max_, max);
+            }
+        }
+
+    public:
+        static constexpr bool kLockFree = false;
+        static constexpr bool kShardable = true;
+
+        void add(T value, CounterOverflow overflow) {
+            extend(value, value);
+            sum_.add(value, 1, overflow);
+        }
+        void addBatch(const T* values, size_t count, CounterOverflow overflow) {
+            auto [min, max] = std::minmax_element(values, values + count);
+            extend(*min, *max);
+            sum_.add(batchSum(values, count, overflow), count, overflow);
+        }
+        void merge(const MinMaxMeanAccumulator& other, CounterOverflow overflow) {
+            if (other.sum_.count == 0) {
+                return;
+            }
+            extend(other.min_, other.max_);
+            sum_.merge(other.sum_, overflow);
+        }
+        void drainInto(MinMaxMeanAccumulator& total, bool reset, CounterOverflow overflow) {
+            total.merge(*this, overflow);
+            if (reset) {
+                this->reset();
+            }
+        }
+        void reset() {
+            min_ = T{};
+            max_ = T{};
+            sum_.reset();
+        }
+
+        std::unique_ptr<MetricValue> result() const {
+            return std::make_unique<MinMaxMeanValue<T>>(min_, max_, sum_.value(), sum_.count);
+        }
+
+        void save(CheckpointWriter& out) const {
+            out.put(min_);
+            out.put(max_);
+            out.put(sum_.value());
+            out.put(sum_.count);
+        }
+        void load(CheckpointReader& in, CounterOverflow overflow) {
+            MinMaxMeanAccumulator restored;
+            restored.min_ = in.get<T>();
+            restored.max_ = in.get<T>();
+            auto sum = in.get<AccumulatorType<T>>();
+            auto count = in.get<uint64_t>();
+            restored.sum_.add(sum, count, overflow);
+            merge(restored, overflow);
+        }
+    };
+
+    // Policies (the checkpoint code keeps state from being restored into a
+    // metric that aggregates differently)
+    struct Sum {
+        template<Accumulable T>
+        using Accumulator = SumAccumulator<T>;
+        static constexpr uint8_t kCheckpointCode = 1;
+    };
+
+    struct Mean {
+        template<Accumulable T>
+        using Accumulator = MeanAccumulator<T>;
+        static constexpr uint8_t kCheckpointCode = 2;
+    };
+
+    struct Max {
+        template<Accumulable T>
+            requires std::is_arithmetic_v<T>
+        using Accumulator = MaxAccumulator<T>;
+        static constexpr uint8_t kCheckpointCode = 3;
+    };
+
+    struct Last {
+        template<Accumulable T>
+        using Accumulator = LastAccumulator<T>;
+        static constexpr uint8_t kCheckpointCode = 4;
+    };
+
+    struct MinMaxMean {
+        template<Accumulable T>
+            requires std::is_arithmetic_v<T>
+        using Accumulator = MinMaxMeanAccumulator<T>;
+        static constexpr uint8_t kCheckpointCode = 5;
+    };
+
+    template<typename P, typename T>
+    concept AggregationPolicy = Accumulable<T> && requires {
+        typename P::template Accumulator<T>;
+        { P::kCheckpointCode } -> std::convertible_to<uint8_t>;
+    };
+
+    // Floating-point metrics report averages, everything else totals
+    template<Accumulable T>
+    using DefaultAggregation = std::conditional_t<std::is_floating_point_v<T>, Mean, Sum>;
+
+} // namespace MetricsSystem
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include "MetricCheckpoint.h"
+#include "MetricUtilities.h"
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+namespace MetricsSystem {
+
+    namespace {
+
+        const char kCheckpointMagic[4] = { 'M', 'C', 'K', 'P' };
+        // Version 2: integer metric state is stored in 64-bit accumulators
+        // Version 3: TypedMetric state is tagged with its aggregation policy
+        const uint32_t kCheckpointVersion = 3;
+
+        // FNV-1a over the payload, detects truncated or damaged files
+        uint32_t checksum(const char* data, size_t size) {
+            uint32_t hash = 2166136261u;
+            for (size_t i = 0; i < size; ++i) {
+                hash ^= static_cast<unsigned char>(data[i]);
+                hash *= 16777619u;
+            }
+            return hash;
+        }
+
+    } // namespace
+
+    void MetricCheckpoint::save(const std::string& path, const std::vector<Record>& records) {
+        std::string payload;
+        CheckpointWriter writer(payload);
+
+        payload.append(kCheckpointMagic, sizeof(kCheckpointMagic));
+        writer.put(kCheckpointVersion);
+        writer.put(static_cast<uint32_t>(records.size()));
+        for (const auto& record : records) {
+            writer.putString(record.name);
+            writer.putString(record.state);
+        }
+        writer.put(checksum(payload.data(), payload.size()));
+
+        const std::string tmp_path = path + ".tmp";
+        std::FILE* file = std::fopen(tmp_path.c_str(), "wb");
+        if (!file) {
+            throw std::runtime_error("Failed to open checkpoint file: " + tmp_path);
+        }
+
+        bool ok = std::fwrite(payload.data(), 1, payload.size(), file) == payload.size();
+        ok = (std::fclose(file) == 0) && ok;
+        if (!ok) {
+            std::remove(tmp_path.c_str());
+            throw std::runtime_error("Failed to write checkpoint file: " + tmp_path);
+        }
+
+        try {
+            DurableFile::replace(tmp_path, path);
+        } catch (...) {
+            std::remove(tmp_path.c_str());
+            throw;
+        }
+    }
+
+    std::vector<MetricCheckpoint::Record> MetricCheckpoint::load(const std::string& path) {
+        std::vector<Record> records;
+
+        std::ifstream file(path, std::ios::in | std::ios::binary);
+        if (!file.is_open()) {
+            return records; // No checkpoint yet - cold start
+        }
+
+        std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        if (data.size() < sizeof(kCheckpointMagic) + sizeof(uint32_t) ||
+            data.compare(0, sizeof(kCheckpointMagic), kCheckpointMagic, sizeof(kCheckpointMagic)) != 0) {
+            throw std::runtime_error("Not a metric checkpoint file: " + path);
+        }
+
+        const size_t payload_size = data.size() - sizeof(uint32_t);
+        CheckpointReader trailer(data.data() + payload_size, sizeof(uint32_t));
+        if (trailer.get<uint32_t>() != checksum(data.data(), payload_size)) {
+            throw std::runtime_error("Checkpoint checksum mismatch: " + path);
+        }
+
+        CheckpointReader reader(data.data() + sizeof(kCheckpointMagic), payload_size - sizeof(kCheckpointMagic));
+        uint32_t version = reader.get<uint32_t>();
+        if (version != kCheckpointVersion) {
+            throw std::runtime_error("Unsupported checkpoint version " + std::to_string(version) + ": " + path);
+        }
+
+        uint32_t count = reader.get<uint32_t>();
+        records.reserve(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            Record record;
+            record.name = reader.getString();
+            record.state = reader.getString();
+            records.push_back(std::move(record));
+        }
+
+        return records;
+    }
+
+} // namespace MetricsSystem
\ No newline at end of file
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace MetricsSystem {
+
+    // Compact binary encoding of accumulator state (host byte order).
+    // Metrics append their state with a CheckpointWriter and read it back
+    // with a CheckpointReader; see Metric::saveState/loadState.
+    class CheckpointWriter {
+    private:
+        std::string& buffer_;
+        bool intervals_;
+
+    public:
+        // intervals: false saves the state of the current interval as empty
+        // (cumulative state only), for checkpoints taken while collected
+        // ticks are still waiting to be written
+        explicit CheckpointWriter(std::string& buffer, bool intervals = true)
+            : buffer_(buffer), intervals_(intervals) {}
+
+        bool intervals() const { return intervals_; }
+
+        template<typename T>
+        void put(const T& value) {
+            static_assert(std::is_trivially_copyable_v<T>, "Checkpoint values must be trivially copyable");
+            buffer_.append(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+        void putString(const std::string& value) {
+            put(static_cast<uint32_t>(value.size()));
+            buffer_.append(value);
+        }
+    };
+
+    class CheckpointReader {
+    private:
+        const char* pos_;
+        const char* end_;
+
+    public:
+        CheckpointReader(const char* data, size_t size) : pos_(data), end_(data + size) {}
+        explicit CheckpointReader(const std::string& data) : CheckpointReader(data.data(), data.size()) {}
+
+        template<typename T>
+        T get() {
+            static_assert(std::is_trivially_copyable_v<T>, "Checkpoint values must be trivially copyable");
+            if (remaining() < sizeof(T)) {
+                throw std::runtime_error("Truncated checkpoint data");
+            }
+            T value;
+            std::memcpy(&value, pos_, sizeof(T));
+            pos_ += sizeof(T);
+            return value;
+        }
+
+        std::string getString() {
+            uint32_t size = get<uint32_t>();
+            if (remaining() < size) {
+                throw std::runtime_error("Truncated checkpoint data");
+            }
+            std::string value(pos_, size);
+            pos_ += size;
+            return value;
+        }
+
+        size_t remaining() const { return static_cast<size_t>(end_ - pos_); }
+    };
+
+    // Type tag stored in front of TypedMetric state so a checkpoint is never
+    // restored into a metric of a different value type
+    template<typename T>
+    constexpr uint8_t checkpointTypeCode() {
+        return static_cast<uint8_t>((std::is_floating_point_v<T> ? 0x40 : 0) |
+                                    (std::is_signed_v<T> ? 0x20 : 0) |
+                                    (sizeof(T) & 0x1F));
+    }
+
+    // Checkpoint file: registry names plus opaque per-metric state.
+    // Saved to "<path>.tmp" and moved over <path> with DurableFile::replace,
+    // so readers see either the previous or the new checkpoint, never a
+    // torn one, and the new one survives a power failure.
+    class MetricCheckpoint {
+    public:
+        struct Record {
+            std::string name;
+            std::string state;
+        };
+
+        // Write records atomically (throws std::runtime_error on I/O failure)
+        static void save(const std::string& path, const std::vector<Record>& records);
+
+        // Read records (empty if the file does not exist; throws on corruption)
+        static std::vector<Record> load(const std::string& path);
+    };
+
+} // namespace MetricsSystem
\ No newline at end of file
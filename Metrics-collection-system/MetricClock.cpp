@@ -0,0 +1,294 @@
+#include "MetricClock.h"
+#include <algorithm>
+#include <atomic>
+#include <ctime>
+#include <stdexcept>
+#include <thread>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define METRICS_HAS_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define METRICS_HAS_TSC 1
+#endif
+
+namespace MetricsSystem {
+
+    // Clock Implementation
+    bool Clock::waitUntil(std::unique_lock<std::mutex>& lock, std::condition_variable& cv,
+                          SteadyTimePoint deadline, const std::function<bool()>& pred) {
+        return cv.wait_until(lock, deadline, pred);
+    }
+
+    void Clock::sleepFor(std::chrono::nanoseconds duration) {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::unique_lock<std::mutex> lock(mutex);
+        waitUntil(lock, cv, steadyNow() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration),
+                  []() { return false; });
+    }
+
+    std::shared_ptr<Clock> Clock::create(TimeSource source) {
+        switch (source) {
+        case TimeSource::Precise:
+            return std::make_shared<RealClock>();
+        case TimeSource::Coarse:
+            return std::make_shared<CoarseClock>();
+        case TimeSource::Tsc:
+            return std::make_shared<TscClock>();
+        case TimeSource::Cached:
+            return std::make_shared<CachedClock>();
+        }
+        throw std::invalid_argument("Unknown time source");
+    }
+
+    namespace {
+
+        std::atomic<Clock*>& defaultClockSlot() {
+            static RealClock real_clock;
+            static std::atomic<Clock*> slot(&real_clock);
+            return slot;
+        }
+
+    } // namespace
+
+    Clock& Clock::getDefault() {
+        return *defaultClockSlot().load(std::memory_order_acquire);
+    }
+
+    void Clock::setDefault(std::shared_ptr<Clock> clock) {
+        if (!clock) {
+            throw std::invalid_argument("Default clock cannot be null");
+        }
+
+        // Readers may still hold a reference to the previous clock
+        static std::mutex retained_mutex;
+        static std::vector<std::shared_ptr<Clock>> retained;
+
+        std::lock_guard<std::mutex> lock(retained_mutex);
+        retained.push_back(clock);
+        defaultClockSlot().store(clock.get(), std::memory_order_release);
+    }
+
+    // RealClock Implementation
+    TimePoint RealClock::now() const {
+        return std::chrono::system_clock::now();
+    }
+
+    SteadyTimePoint RealClock::steadyNow() const {
+        return std::chrono::steady_clock::now();
+    }
+
+    // CoarseClock Implementation
+#if defined(__linux__) && defined(CLOCK_REALTIME_COARSE)
+    TimePoint CoarseClock::now() const {
+        timespec ts;
+        clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+        return TimePoint(std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec)));
+    }
+
+    SteadyTimePoint CoarseClock::steadyNow() const {
+        // Same epoch as steady_clock (CLOCK_MONOTONIC), so deadlines mix
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+        return SteadyTimePoint(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec)));
+    }
+#else
+    TimePoint CoarseClock::now() const {
+        return std::chrono::system_clock::now();
+    }
+
+    SteadyTimePoint CoarseClock::steadyNow() const {
+        return std::chrono::steady_clock::now();
+    }
+#endif
+
+    // TscClock Implementation
+    uint64_t TscClock::readTicks() {
+#ifdef METRICS_HAS_TSC
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+
+    TscClock::TscClock(std::chrono::milliseconds calibration) : ns_per_tick_(1.0) {
+        base_steady_ = std::chrono::steady_clock::now();
+        base_wall_ = std::chrono::system_clock::now();
+        base_ticks_ = readTicks();
+
+#ifdef METRICS_HAS_TSC
+        std::this_thread::sleep_for(calibration);
+        uint64_t ticks = readTicks();
+        auto steady = std::chrono::steady_clock::now();
+
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(steady - base_steady_).count();
+        if (ticks > base_ticks_ && ns > 0) {
+            ns_per_tick_ = static_cast<double>(ns) / static_cast<double>(ticks - base_ticks_);
+        }
+#else
+        (void)calibration;
+#endif
+    }
+
+    std::chrono::nanoseconds TscClock::elapsed() const {
+        uint64_t ticks = readTicks() - base_ticks_;
+        return std::chrono::nanoseconds(static_cast<int64_t>(static_cast<double>(ticks) * ns_per_tick_));
+    }
+
+    TimePoint TscClock::now() const {
+        return base_wall_ + std::chrono::duration_cast<std::chrono::system_clock::duration>(elapsed());
+    }
+
+    SteadyTimePoint TscClock::steadyNow() const {
+        return base_steady_ + std::chrono::duration_cast<std::chrono::steady_clock::duration>(elapsed());
+    }
+
+    // CachedClock Implementation
+    CachedClock::CachedClock(std::shared_ptr<Clock> source, std::chrono::milliseconds resolution)
+        : source_(std::move(source)), resolution_(resolution), wall_ns_(0), steady_ns_(0) {
+        if (!source_) {
+            throw std::invalid_argument("Cached clock needs a source clock");
+        }
+        if (resolution_ <= std::chrono::milliseconds(0)) {
+            throw std::invalid_argument("Cached clock resolution must be positive");
+        }
+        refresh();
+    }
+
+    TimePoint CachedClock::now() const {
+        return TimePoint(std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::nanoseconds(wall_ns_.load(std::memory_order_relaxed))));
+    }
+
+    SteadyTimePoint CachedClock::steadyNow() const {
+        return SteadyTimePoint(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::nanoseconds(steady_ns_.load(std::memory_order_relaxed))));
+    }
+
+    bool CachedClock::waitUntil(std::unique_lock<std::mutex>& lock, std::condition_variable& cv,
+                                SteadyTimePoint deadline, const std::function<bool()>& pred) {
+        return source_->waitUntil(lock, cv, deadline, pred);
+    }
+
+    void CachedClock::refresh() {
+        wall_ns_.store(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            source_->now().time_since_epoch()).count(), std::memory_order_relaxed);
+        steady_ns_.store(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            source_->steadyNow().time_since_epoch()).count(), std::memory_order_relaxed);
+    }
+
+    // VirtualClock Implementation
+    VirtualClock::VirtualClock(TimePoint start, std::chrono::milliseconds settle_timeout)
+        : wall_(start), steady_(std::chrono::steady_clock::now()), settle_timeout_(settle_timeout) {}
+
+    TimePoint VirtualClock::now() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return wall_;
+    }
+
+    SteadyTimePoint VirtualClock::steadyNow() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return steady_;
+    }
+
+    bool VirtualClock::waitUntil(std::unique_lock<std::mutex>& lock, std::condition_variable& cv,
+                                 SteadyTimePoint deadline, const std::function<bool()>& pred) {
+        Waiter waiter{ lock.mutex(), &cv, deadline };
+        {
+            std::lock_guard<std::mutex> clock_lock(mutex_);
+            waiters_.push_back(&waiter);
+        }
+        settled_cv_.notify_all();
+
+        // The caller's lock is held while the time is checked, and advance()
+        // takes it before notifying, so a wakeup cannot be lost
+        while (!pred()) {
+            {
+                std::lock_guard<std::mutex> clock_lock(mutex_);
+                if (steady_ >= deadline) {
+                    break;
+                }
+            }
+            cv.wait(lock);
+        }
+
+        {
+            std::lock_guard<std::mutex> clock_lock(mutex_);
+            waiters_.erase(std::find(waiters_.begin(), waiters_.end(), &waiter));
+        }
+        settled_cv_.notify_all();
+        return pred();
+    }
+
+    bool VirtualClock::settledLocked(size_t expected_waiters) const {
+        // Every thread woken by the last step is waiting again with a later deadline
+        if (waiters_.size() < expected_waiters) {
+            return false;
+        }
+        return std::none_of(waiters_.begin(), waiters_.end(),
+                            [this](const Waiter* w) { return w->deadline <= steady_; });
+    }
+
+    void VirtualClock::advance(std::chrono::nanoseconds duration) {
+        if (duration.count() < 0) {
+            throw std::invalid_argument("Virtual clock cannot go backwards");
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        const SteadyTimePoint target = steady_ + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration);
+
+        while (true) {
+            // Step to the earliest deadline on the way, or to the target
+            SteadyTimePoint next = target;
+            for (const Waiter* w : waiters_) {
+                if (w->deadline > steady_ && w->deadline < next) {
+                    next = w->deadline;
+                }
+            }
+
+            const size_t expected_waiters = waiters_.size();
+            wall_ += std::chrono::duration_cast<std::chrono::system_clock::duration>(next - steady_);
+            steady_ = next;
+
+            std::vector<Waiter> due;
+            for (const Waiter* w : waiters_) {
+                if (w->deadline <= steady_) {
+                    due.push_back(*w);
+                }
+            }
+
+            if (!due.empty()) {
+                lock.unlock();
+                for (const Waiter& w : due) {
+                    std::lock_guard<std::mutex> waiter_lock(*w.mutex);
+                    w.cv->notify_all();
+                }
+                lock.lock();
+
+                settled_cv_.wait_for(lock, settle_timeout_, [this, expected_waiters]() {
+                    return settledLocked(expected_waiters);
+                });
+            }
+
+            if (steady_ >= target) {
+                break;
+            }
+        }
+    }
+
+    bool VirtualClock::waitForWaiters(size_t count, std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return settled_cv_.wait_for(lock, timeout, [this, count]() { return waiters_.size() >= count; });
+    }
+
+    size_t VirtualClock::getWaiterCount() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return waiters_.size();
+    }
+
+} // namespace MetricsSystem
\ No newline at end of file
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace MetricsSystem {
+
+    using TimePoint = std::chrono::system_clock::time_point;
+    using SteadyTimePoint = std::chrono::steady_clock::time_point;
+
+    // Timestamp sources, cheapest last
+    enum class TimeSource {
+        Precise,    // system_clock / steady_clock
+        Coarse,     // CLOCK_REALTIME_COARSE / CLOCK_MONOTONIC_COARSE (1-4 ms)
+        Tsc,        // CPU timestamp counter, calibrated against steady_clock
+        Cached      // Value published by the collector thread every millisecond
+    };
+
+    // Source of time for timestamps, intervals and timed waits.
+    // now() stamps output, steadyNow() drives scheduling. Components take a
+    // clock instead of calling std::chrono directly so simulations can run
+    // hours of ticks in milliseconds with a VirtualClock.
+    class Clock {
+    public:
+        virtual ~Clock() = default;
+
+        virtual TimePoint now() const = 0;
+        virtual SteadyTimePoint steadyNow() const = 0;
+
+        // Wait on cv (lock held by the caller) until pred() holds or the
+        // clock reaches deadline. Returns pred(). Notifying cv interrupts
+        // the wait as with std::condition_variable::wait_until.
+        virtual bool waitUntil(std::unique_lock<std::mutex>& lock, std::condition_variable& cv,
+                               SteadyTimePoint deadline, const std::function<bool()>& pred);
+
+        // Uninterruptible sleep in this clock's time
+        void sleepFor(std::chrono::nanoseconds duration);
+
+        // New clock reading from the given source
+        static std::shared_ptr<Clock> create(TimeSource source);
+
+        // Process-wide clock used where none is injected (TimestampUtils,
+        // specific metrics, collectors without setClock). Clocks passed to
+        // setDefault() stay alive until exit, so getDefault() is lock-free.
+        static Clock& getDefault();
+        static void setDefault(std::shared_ptr<Clock> clock);
+    };
+
+    // std::chrono::system_clock / steady_clock
+    class RealClock : public Clock {
+    public:
+        TimePoint now() const override;
+        SteadyTimePoint steadyNow() const override;
+    };
+
+    // Cheaper, lower resolution reads (CLOCK_*_COARSE on Linux, a few ms).
+    // Falls back to RealClock behaviour where no coarse source exists.
+    class CoarseClock : public Clock {
+    public:
+        TimePoint now() const override;
+        SteadyTimePoint steadyNow() const override;
+    };
+
+    // Timestamp counter scaled to nanoseconds. The rate is calibrated
+    // against steady_clock at construction; wall time is the system_clock
+    // reading taken at the same moment plus the elapsed ticks. Assumes an
+    // invariant TSC (every x86-64 CPU of the last decade); other
+    // architectures fall back to steady_clock.
+    class TscClock : public Clock {
+    private:
+        uint64_t base_ticks_;
+        SteadyTimePoint base_steady_;
+        TimePoint base_wall_;
+        double ns_per_tick_;
+
+        static uint64_t readTicks();
+        std::chrono::nanoseconds elapsed() const;
+
+    public:
+        explicit TscClock(std::chrono::milliseconds calibration = std::chrono::milliseconds(10));
+
+        TimePoint now() const override;
+        SteadyTimePoint steadyNow() const override;
+        double getNanosecondsPerTick() const { return ns_per_tick_; }
+    };
+
+    // Last published time of a source clock: a reader pays one atomic load.
+    // Accuracy is the refresh period - the collector thread refreshes
+    // cached clocks it uses (its own and the default clock) every
+    // getResolution() while it runs; anyone else may call refresh().
+    class CachedClock : public Clock {
+    private:
+        std::shared_ptr<Clock> source_;
+        std::chrono::milliseconds resolution_;
+        std::atomic<int64_t> wall_ns_;
+        std::atomic<int64_t> steady_ns_;
+
+    public:
+        explicit CachedClock(std::shared_ptr<Clock> source = std::make_shared<RealClock>(),
+                             std::chrono::milliseconds resolution = std::chrono::milliseconds(1));
+
+        TimePoint now() const override;
+        SteadyTimePoint steadyNow() const override;
+
+        // Deadlines are checked against the source, not the cached value
+        bool waitUntil(std::unique_lock<std::mutex>& lock, std::condition_variable& cv,
+                       SteadyTimePoint deadline, const std::function<bool()>& pred) override;
+
+        void refresh();
+        std::chrono::milliseconds getResolution() const { return resolution_; }
+    };
+
+    // Manually advanced clock for deterministic simulation and tests.
+    // Time only moves in advance(); threads waiting in waitUntil() wake as
+    // their deadlines are passed, and advance() lets them settle before it
+    // moves on, so every interval crossed produces its tick.
+    class VirtualClock : public Clock {
+    private:
+        struct Waiter {
+            std::mutex* mutex;
+            std::condition_variable* cv;
+            SteadyTimePoint deadline;
+        };
+
+        mutable std::mutex mutex_;
+        std::condition_variable settled_cv_;
+        TimePoint wall_;
+        SteadyTimePoint steady_;
+        std::vector<Waiter*> waiters_;
+        std::chrono::milliseconds settle_timeout_;
+
+        bool settledLocked(size_t expected_waiters) const;
+
+    public:
+        // settle_timeout: real time advance() waits for woken threads to go
+        // back to sleep (covers threads that exit instead)
+        explicit VirtualClock(TimePoint start = std::chrono::system_clock::now(),
+                              std::chrono::milliseconds settle_timeout = std::chrono::milliseconds(1000));
+
+        TimePoint now() const override;
+        SteadyTimePoint steadyNow() const override;
+        bool waitUntil(std::unique_lock<std::mutex>& lock, std::condition_variable& cv,
+                       SteadyTimePoint deadline, const std::function<bool()>& pred) override;
+
+        // Move time forward, stopping at every waiter deadline on the way.
+        // Must not be called while holding a mutex that a waiter uses.
+        void advance(std::chrono::nanoseconds duration);
+
+        // Block (in real time) until at least `count` threads are waiting on
+        // this clock, e.g. until a freshly started collector is idle
+        bool waitForWaiters(size_t count, std::chrono::milliseconds timeout = std::chrono::milliseconds(1000));
+        size_t getWaiterCount() const;
+    };
+
+} // namespace MetricsSystem
\ No newline at end of file
@@ -1,93 +1,108 @@
 #include "MetricSystem.h"
 #include "MetricUtilities.h"
 #include "SpecificMetrics.h"
+#include "MetricWorkerPool.h"
+#include "MetricRuntime.h"
+#include "MetricCheckpoint.h"
+#include "MetricOutputBuffer.h"
+#include "MetricSpool.h"
 #include <algorithm>
+#include <bit>
 #include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <iostream>
+#include <iterator>
 
 namespace MetricsSystem {
 
     // MetricCollector Implementation
-    MetricCollector::MetricCollector(std::unique_ptr<MetricWriter> writer)
-        : writer_(std::move(writer)), running_(false) {
+    MetricCollector::MetricCollector(std::unique_ptr<MetricWriter> writer, size_t snapshot_threads)
+        : running_(false), writer_(std::move(writer)),
+          output_buffer_(std::make_unique<MetricOutputBuffer>(kDefaultOutputBufferTicks, OverflowPolicy::Block)),
+          drain_scheduled_(false), sink_failed_(false), initial_retry_delay_(kDefaultRetryDelay),
+          max_retry_delay_(kDefaultMaxRetryDelay), retry_delay_(kDefaultRetryDelay), snapshot_threads_(snapshot_threads),
+          tick_in_progress_(false), tick_generation_(0), checkpoint_every_ticks_(0), ticks_since_checkpoint_(0),
+          checkpoint_has_intervals_(false), gauges_(std::make_unique<GaugeSampler>()), emission_tick_(0) {
         if (!writer_) {
             throw std::invalid_argument("MetricWriter cannot be null");
         }
+
+        if (snapshot_threads_ == 0) {
+            snapshot_threads_ = WorkerPool::defaultThreadCount();
+        }
+    }
+
+    MetricCollector::MetricCollector(std::unique_ptr<MetricWriter> writer, std::shared_ptr<MetricRuntime> runtime)
+        : running_(false), writer_(std::move(writer)),
+          output_buffer_(std::make_unique<MetricOutputBuffer>(kDefaultOutputBufferTicks, OverflowPolicy::Block)),
+          drain_scheduled_(false), sink_failed_(false), initial_retry_delay_(kDefaultRetryDelay),
+          max_retry_delay_(kDefaultMaxRetryDelay), retry_delay_(kDefaultRetryDelay), snapshot_threads_(0),
+          runtime_(std::move(runtime)), tick_in_progress_(false), tick_generation_(0),
+          checkpoint_every_ticks_(0), ticks_since_checkpoint_(0), checkpoint_has_intervals_(false), gauges_(std::make_unique<GaugeSampler>()),
+          emission_tick_(0) {
+        if (!writer_) {
+            throw std::invalid_argument("MetricWriter cannot be null");
+        }
+
+        if (!runtime_) {
+            throw std::invalid_argument("MetricRuntime cannot be null");
+        }
+
+        snapshot_threads_ = runtime_->pool().size() + 1;
     }
 
     MetricCollector::~MetricCollector() {
         stop();
     }
 
-    template<typename T>
-    void MetricCollector::registerMetric(const std::string& name) {
-        std::lock_guard<std::mutex> lock(metrics_mutex_);
-        
-        // Check if metric already exists
-        auto it = std::find_if(metrics_.begin(), metrics_.end(),
-            [&name](const std::unique_ptr<Metric>& metric) {
-                return metric->getName() == name;
-            });
-        
-        if (it != metrics_.end()) {
+    void MetricCollector::registerMetric(std::unique_ptr<Metric> metric) {
+        if (!metric) {
+            throw std::invalid_argument("Metric cannot be null");
+        }
+
+        std::unique_lock<std::shared_mutex> lock(metrics_mutex_);
+        const std::string name = metric->getName();
+
+        if (metric_index_.find(name) != metric_index_.end()) {
             throw std::invalid_argument("Metric already registered: " + name);
         }
-        
-        // Create and add new metric
-        auto metric = std::make_unique<TypedMetric<T>>(name);
-        metrics_.push_back(std::move(metric));
+
+        addMetric(std::move(metric));
     }
 
-    template<typename T>
-    void MetricCollector::recordMetric(const std::string& name, T value) {
-        if (!running_) {
-            return; // Silently ignore if not running
+    void MetricCollector::addMetric(std::unique_ptr<Metric> metric) {
+        const std::string name = metric->getName();
+        const size_t index = metrics_.size();
+        metric->attachDirtySlot(dirty_.add());
+        if (!metric->tracksDirty()) {
+            untracked_metrics_.push_back(index);
         }
 
-        // Find the metric (read lock)
-        Metric* target_metric = nullptr;
+        // Continue from the checkpointed state, if any
         {
-            std::lock_guard<std::mutex> lock(metrics_mutex_);
-            auto it = std::find_if(metrics_.begin(), metrics_.end(),
-                [&name](const std::unique_ptr<Metric>& metric) {
-                    return metric->getName() == name;
-                });
-            
-            if (it != metrics_.end()) {
-                target_metric = it->get();
-            }
-        }
-
-        if (!target_metric) {
-            // Auto-register metric if it doesn't exist
-            try {
-                registerMetric<T>(name);
-                // Try again after registration
-                std::lock_guard<std::mutex> lock(metrics_mutex_);
-                auto it = std::find_if(metrics_.begin(), metrics_.end(),
-                    [&name](const std::unique_ptr<Metric>& metric) {
-                        return metric->getName() == name;
-                    });
-                if (it != metrics_.end()) {
-                    target_metric = it->get();
+            std::lock_guard<std::mutex> lock(checkpoint_mutex_);
+            auto restore = pending_restore_.find(name);
+            if (restore != pending_restore_.end()) {
+                try {
+                    CheckpointReader reader(restore->second);
+                    metric->loadState(reader);
+                } catch (const std::exception& e) {
+                    std::cerr << "Failed to restore metric '" << name << "' from checkpoint: " << e.what() << std::endl;
                 }
-            } catch (const std::exception& e) {
-                std::cerr << "Failed to auto-register metric '" << name << "': " << e.what() << std::endl;
-                return;
+                pending_restore_.erase(restore);
             }
         }
 
-        if (target_metric) {
-            // Record the value (this is the hot path - must be fast)
-            try {
-                auto typed_metric = dynamic_cast<TypedMetric<T>*>(target_metric);
-                if (typed_metric) {
-                    typed_metric->recordValue(value);
-                }
-            } catch (const std::exception& e) {
-                std::cerr << "Failed to record metric '" << name << "': " << e.what() << std::endl;
-            }
-        }
+        metric_index_.emplace(name, metric.get());
+        metrics_.push_back(std::move(metric));
+        emission_state_.emplace_back();
+    }
+
+    Metric* MetricCollector::findMetric(const std::string& name) {
+        std::shared_lock<std::shared_mutex> lock(metrics_mutex_);
+        auto it = metric_index_.find(name);
+        return (it != metric_index_.end()) ? it->second : nullptr;
     }
 
     void MetricCollector::start() {
@@ -95,8 +110,33 @@ namespace MetricsSystem {
             return; // Already running
         }
 
-        // Start background worker thread
-        worker_thread_ = std::thread(&MetricCollector::processMetrics, this);
+        output_buffer_->reopen();
+        writer_->setClock(clock_);
+        if (event_time_) {
+            event_time_->advance(clock().now());
+        }
+
+        // Cached clocks read by this collector or the metrics are refreshed
+        // by the collector thread (or on each runtime tick)
+        cached_clocks_.clear();
+        for (Clock* used : { static_cast<Clock*>(clock_.get()), &Clock::getDefault() }) {
+            auto cached = dynamic_cast<CachedClock*>(used);
+            if (cached && std::find(cached_clocks_.begin(), cached_clocks_.end(), cached) == cached_clocks_.end()) {
+                cached_clocks_.push_back(cached);
+                cached_refresh_period_ = cached_clocks_.size() == 1
+                                             ? cached->getResolution()
+                                             : std::min(cached_refresh_period_, cached->getResolution());
+            }
+        }
+
+        if (runtime_) {
+            // Ticks are driven by the shared runtime scheduler
+            runtime_->attach(this);
+        } else {
+            // Start background worker and writer threads
+            worker_thread_ = std::thread(&MetricCollector::processMetrics, this);
+            writer_thread_ = std::thread(&MetricCollector::writerLoop, this);
+        }
         std::cout << "MetricCollector started" << std::endl;
     }
 
@@ -105,95 +145,853 @@ namespace MetricsSystem {
             return; // Already stopped
         }
 
-        // Signal worker thread to stop and wait for it
-        if (worker_thread_.joinable()) {
-            worker_thread_.join();
+        // Signal worker threads to stop and wait for them
+        if (runtime_) {
+            runtime_->detach(this);
+        } else {
+            // Closing releases a collector blocked on a full buffer; the
+            // writer thread drains what is queued and exits
+            {
+                std::lock_guard<std::mutex> lock(worker_mutex_);
+                worker_cv_.notify_all();
+            }
+            output_buffer_->close();
+            if (worker_thread_.joinable()) {
+                worker_thread_.join();
+            }
+            if (writer_thread_.joinable()) {
+                writer_thread_.join();
+            }
+        }
+
+        // Affinity batches still queued must not read gauges of a stopped
+        // (possibly destroyed) collector
+        gauges_->stop();
+
+        // Final collection before stopping; open event-time intervals and
+        // held ticks go out with it
+        if (event_time_) {
+            event_time_->closeAll();
         }
+        collectCurrentMetrics(true);
 
-        // Final flush before stopping
-        collectCurrentMetrics();
+        if (runtime_) {
+            // Wait for a drain queued on the I/O thread
+            std::unique_lock<std::mutex> lock(tick_mutex_);
+            tick_cv_.wait(lock, [this]() { return !drain_scheduled_; });
+        }
+
+        {
+            // One last attempt on a failed sink regardless of the backoff
+            std::lock_guard<std::mutex> lock(drain_mutex_);
+            next_retry_ = SteadyTimePoint();
+        }
+        if (!drainOutput()) {
+            auto stats = output_buffer_->getStats();
+            if (stats.queued_ticks > 0) {
+                std::cerr << "Output sink unavailable at shutdown: " << stats.queued_ticks
+                          << " ticks were not written" << std::endl;
+            }
+        }
+
+        if (!checkpoint_path_.empty()) {
+            saveCheckpoint();
+        }
         std::cout << "MetricCollector stopped" << std::endl;
     }
 
+    void MetricCollector::configureOutputBuffer(size_t max_ticks, OverflowPolicy policy, size_t max_bytes) {
+        if (running_) {
+            throw std::logic_error("Output buffer must be configured before start()");
+        }
+
+        output_buffer_ = std::make_unique<MetricOutputBuffer>(max_ticks, policy, max_bytes);
+    }
+
+    OutputBufferStats MetricCollector::getOutputStats() const {
+        return output_buffer_->getStats();
+    }
+
+    void MetricCollector::configureSpool(const std::string& path, size_t max_bytes) {
+        if (running_) {
+            throw std::logic_error("Spool must be configured before start()");
+        }
+
+        std::lock_guard<std::mutex> lock(drain_mutex_);
+        spool_ = std::make_unique<MetricSpool>(path, max_bytes);
+    }
+
+    void MetricCollector::configureSegments(const SegmentOptions& options) {
+        if (running_) {
+            throw std::logic_error("Segments must be configured before start()");
+        }
+
+        writer_->setSegmentOptions(options);
+    }
+
+    void MetricCollector::setClock(std::shared_ptr<Clock> clock) {
+        if (running_) {
+            throw std::logic_error("Clock must be set before start()");
+        }
+
+        clock_ = std::move(clock);
+    }
+
+    void MetricCollector::setTimeSource(TimeSource source) {
+        setClock(Clock::create(source));
+    }
+
+    void MetricCollector::refreshCachedClocks() {
+        for (CachedClock* cached : cached_clocks_) {
+            cached->refresh();
+        }
+    }
+
+    void MetricCollector::setRetryBackoff(std::chrono::milliseconds initial_delay, std::chrono::milliseconds max_delay) {
+        if (initial_delay <= std::chrono::milliseconds(0) || max_delay < initial_delay) {
+            throw std::invalid_argument("Invalid retry backoff");
+        }
+
+        std::lock_guard<std::mutex> lock(drain_mutex_);
+        initial_retry_delay_ = initial_delay;
+        max_retry_delay_ = max_delay;
+        retry_delay_ = initial_delay;
+    }
+
+    void MetricCollector::setGaugeBudget(std::chrono::microseconds budget) {
+        gauges_->setBudget(budget);
+    }
+
+    GaugeStats MetricCollector::getGaugeStats() const {
+        return gauges_->stats();
+    }
+
+    void MetricCollector::configureEventTime(const EventTimeOptions& options) {
+        if (running_) {
+            throw std::logic_error("Event-time recording must be configured before start()");
+        }
+
+        event_time_ = std::make_unique<EventTimeWindows>(options);
+    }
+
+    EventTimeStats MetricCollector::getEventTimeStats() const {
+        return event_time_ ? event_time_->getStats() : EventTimeStats{};
+    }
+
+    void MetricCollector::setEmissionPolicy(const EmissionPolicy& policy) {
+        if (!(policy.deadband >= 0.0)) {
+            throw std::invalid_argument("Emission deadband cannot be negative");
+        }
+
+        std::unique_lock<std::shared_mutex> lock(metrics_mutex_);
+        emission_ = policy;
+    }
+
+    void MetricCollector::setDeadband(const std::string& name, double deadband) {
+        if (!(deadband >= 0.0)) {
+            throw std::invalid_argument("Emission deadband cannot be negative");
+        }
+
+        std::unique_lock<std::shared_mutex> lock(metrics_mutex_);
+        auto it = metric_index_.find(name);
+        if (it == metric_index_.end()) {
+            throw std::invalid_argument("Metric not registered: " + name);
+        }
+
+        for (size_t i = 0; i < metrics_.size(); ++i) {
+            if (metrics_[i].get() == it->second) {
+                emission_state_[i].deadband = deadband;
+                emission_state_[i].has_deadband = true;
+                break;
+            }
+        }
+    }
+
+    void MetricCollector::enableCheckpoint(const std::string& path, size_t every_ticks) {
+        if (path.empty()) {
+            throw std::invalid_argument("Checkpoint path cannot be empty");
+        }
+
+        // An unreadable checkpoint (corrupt, truncated, other version) costs
+        // the warm start, not the collector: start cold and let the next
+        // save replace it
+        std::vector<MetricCheckpoint::Record> records;
+        try {
+            records = MetricCheckpoint::load(path);
+        } catch (const std::exception& e) {
+            std::cerr << "Ignoring checkpoint " << path << ", starting cold: " << e.what() << std::endl;
+        }
+
+        {
+            std::lock_guard<std::mutex> drain_lock(drain_mutex_);
+            ticks_since_checkpoint_ = 0;
+            checkpoint_has_intervals_ = false;
+        }
+
+        std::unique_lock<std::shared_mutex> lock(metrics_mutex_);
+        std::lock_guard<std::mutex> checkpoint_lock(checkpoint_mutex_);
+        checkpoint_path_ = path;
+        checkpoint_every_ticks_ = every_ticks;
+
+        size_t restored = 0;
+        for (auto& record : records) {
+            auto it = metric_index_.find(record.name);
+            if (it == metric_index_.end()) {
+                // Applied when the metric is registered (explicitly or on first record)
+                pending_restore_[record.name] = std::move(record.state);
+                continue;
+            }
+
+            try {
+                CheckpointReader reader(record.state);
+                it->second->loadState(reader);
+                ++restored;
+            } catch (const std::exception& e) {
+                std::cerr << "Failed to restore metric '" << record.name << "' from checkpoint: " << e.what() << std::endl;
+            }
+        }
+
+        if (!records.empty()) {
+            std::cout << "Checkpoint loaded from " << path << ": " << restored << " metrics restored, "
+                      << pending_restore_.size() << " pending registration" << std::endl;
+        }
+    }
+
+    bool MetricCollector::saveCheckpoint() {
+        std::lock_guard<std::mutex> lock(drain_mutex_);
+        return saveCheckpointLocked(true);
+    }
+
+    bool MetricCollector::saveCheckpointLocked(bool intervals) {
+        // The partial interval is only saved while every collected tick has
+        // been written (no tick in progress or buffered, none collected
+        // during the capture): it then holds exactly what no output has.
+        // Holding drain_mutex_ keeps it unwritten until drainOutput() takes
+        // it out of the checkpoint again.
+        const uint64_t generation = intervals ? tickGeneration() : 0;
+        intervals = intervals && generation % 2 == 0 && output_buffer_->getStats().queued_ticks == 0 && !ticksHeld();
+
+        std::vector<MetricCheckpoint::Record> records;
+        std::string path;
+        for (;;) {
+            std::shared_lock<std::shared_mutex> lock(metrics_mutex_);
+            std::lock_guard<std::mutex> checkpoint_lock(checkpoint_mutex_);
+            if (checkpoint_path_.empty()) {
+                return false;
+            }
+            path = checkpoint_path_;
+
+            records.clear();
+            records.reserve(metrics_.size() + pending_restore_.size());
+            for (const auto& metric : metrics_) {
+                MetricCheckpoint::Record record;
+                CheckpointWriter writer(record.state, intervals);
+                metric->saveState(writer);
+                if (!record.state.empty()) {
+                    record.name = metric->getName();
+                    records.push_back(std::move(record));
+                }
+            }
+
+            // Keep state of metrics not registered in this run for the next one
+            for (const auto& pending : pending_restore_) {
+                records.push_back({ pending.first, pending.second });
+            }
+
+            if (!intervals || tickGeneration() == generation) {
+                break;
+            }
+            intervals = false;  // A tick ran meanwhile: cumulative state only
+        }
+
+        try {
+            MetricCheckpoint::save(path, records);
+            checkpoint_has_intervals_ = intervals;
+            ticks_since_checkpoint_ = 0;
+            return true;
+        } catch (const std::exception& e) {
+            std::cerr << "Error saving checkpoint: " << e.what() << std::endl;
+            return false;
+        }
+    }
+
+    void MetricCollector::maybeCheckpoint(size_t written_ticks) {
+        {
+            std::lock_guard<std::mutex> lock(checkpoint_mutex_);
+            if (checkpoint_path_.empty() || checkpoint_every_ticks_ == 0) {
+                return;
+            }
+            ticks_since_checkpoint_ += written_ticks;
+            if (ticks_since_checkpoint_ < checkpoint_every_ticks_) {
+                return;
+            }
+        }
+
+        saveCheckpointLocked(true);
+    }
+
     void MetricCollector::flush() {
         if (!running_) {
             return;
         }
 
+        // Collect, then write everything buffered on the calling thread
         collectCurrentMetrics();
+        drainOutput();
     }
 
     void MetricCollector::processMetrics() {
         const auto flush_interval = std::chrono::seconds(1); // Flush every second
         
         while (running_) {
-            auto start_time = std::chrono::steady_clock::now();
+            refreshCachedClocks();
+            auto start_time = clock().steadyNow();
             
-            // Collect and write current metrics
+            // Collect current metrics and hand them to the writer thread
             collectCurrentMetrics();
             
-            // Calculate sleep time to maintain consistent intervals
-            auto elapsed = std::chrono::steady_clock::now() - start_time;
-            auto sleep_time = flush_interval - elapsed;
-            
-            if (sleep_time > std::chrono::milliseconds(0)) {
-                std::this_thread::sleep_for(sleep_time);
+            // Wait out the rest of the interval; stop() interrupts the wait.
+            // Cached clocks in use are kept fresh meanwhile.
+            const auto deadline = start_time + flush_interval;
+            std::unique_lock<std::mutex> lock(worker_mutex_);
+            if (cached_clocks_.empty()) {
+                clock().waitUntil(lock, worker_cv_, deadline, [this]() { return !running_; });
+                continue;
+            }
+
+            while (running_ && clock().steadyNow() < deadline) {
+                clock().waitUntil(lock, worker_cv_, std::min(deadline, clock().steadyNow() + cached_refresh_period_),
+                                  [this]() { return !running_; });
+                refreshCachedClocks();
             }
         }
     }
 
-    void MetricCollector::collectCurrentMetrics() {
-        std::vector<MetricEntry> entries;
-        auto timestamp = TimestampUtils::getCurrentTime();
+    void MetricCollector::writerLoop() {
+        while (output_buffer_->waitForTicks()) {
+            if (!drainOutput()) {
+                if (!running_) {
+                    break; // Stopping with a failed sink: give up on the rest
+                }
 
-        // Collect all metric values
+                // Sink failed - ticks stay buffered under the overflow policy
+                std::unique_lock<std::mutex> lock(worker_mutex_);
+                clock().waitUntil(lock, worker_cv_, clock().steadyNow() + std::chrono::milliseconds(100),
+                                  [this]() { return !running_; });
+            }
+        }
+    }
+
+    void MetricCollector::acquireTick() {
+        std::unique_lock<std::mutex> lock(tick_mutex_);
+        tick_cv_.wait(lock, [this]() { return !tick_in_progress_; });
+        tick_in_progress_ = true;
+        ++tick_generation_;
+    }
+
+    bool MetricCollector::tryAcquireTick() {
+        std::lock_guard<std::mutex> lock(tick_mutex_);
+        if (tick_in_progress_) {
+            return false;
+        }
+        tick_in_progress_ = true;
+        ++tick_generation_;
+        return true;
+    }
+
+    void MetricCollector::releaseTick() {
+        // Notify under the lock: once a waiting stop() sees the flag cleared,
+        // the collector may be destroyed right away
+        std::lock_guard<std::mutex> lock(tick_mutex_);
+        tick_in_progress_ = false;
+        ++tick_generation_;
+        tick_cv_.notify_all();
+    }
+
+    uint64_t MetricCollector::tickGeneration() {
+        std::lock_guard<std::mutex> lock(tick_mutex_);
+        return tick_generation_;
+    }
+
+    bool MetricCollector::ticksHeld() {
+        // Only the thread holding the tick changes held_ticks_
+        std::lock_guard<std::mutex> lock(tick_mutex_);
+        return tick_in_progress_ || !held_ticks_.empty();
+    }
+
+    WorkerPool* MetricCollector::snapshotPool() {
+        if (runtime_) {
+            return &runtime_->pool();
+        }
+
+        if (snapshot_threads_ <= 1) {
+            return nullptr;
+        }
+
+        // The collector thread works on one partition itself
+        std::call_once(snapshot_pool_once_, [this]() {
+            snapshot_pool_ = std::make_unique<WorkerPool>(snapshot_threads_ - 1);
+        });
+        return snapshot_pool_.get();
+    }
+
+    size_t MetricCollector::partitionCount(size_t metric_count, WorkerPool* pool) const {
+        if (metric_count < 2 * kMinPartitionSize || !pool) {
+            return 1;
+        }
+
+        // A few partitions per thread keeps the sweep balanced when some
+        // metrics are slower to read than others
+        size_t partitions = metric_count / kMinPartitionSize;
+        return std::min(partitions, (pool->size() + 1) * 4);
+    }
+
+    void MetricCollector::collectCurrentMetrics(bool closing) {
+        acquireTick();
+
+        try {
+            // With the Block policy this waits for the writer to make room
+            pushTick(prepareTick(), true, closing);
+        } catch (const std::exception& e) {
+            std::cerr << "Error collecting metrics: " << e.what() << std::endl;
+        }
+
+        releaseTick();
+    }
+
+    void MetricCollector::runScheduledTick() {
+        refreshCachedClocks();
+
+        // The scheduler never waits: when a Block-policy buffer is full the
+        // tick is skipped and values keep accumulating in the metrics
+        if (output_buffer_->deferIfFull()) {
+            scheduleDrain();
+            return;
+        }
+
+        if (!tryAcquireTick()) {
+            return;
+        }
+
+        try {
+            pushTick(prepareTick(), false, false);
+        } catch (const std::exception& e) {
+            std::cerr << "Error collecting metrics: " << e.what() << std::endl;
+        }
+
+        releaseTick();
+        scheduleDrain();
+    }
+
+    void MetricCollector::scheduleDrain() {
         {
-            std::lock_guard<std::mutex> lock(metrics_mutex_);
-            entries.reserve(metrics_.size());
+            std::lock_guard<std::mutex> lock(tick_mutex_);
+            if (drain_scheduled_) {
+                return;
+            }
+            drain_scheduled_ = true;
+        }
 
-            for (auto& metric : metrics_) {
-                try {
-                    auto accumulated_value = metric->getAccumulatedValue();
-                    
-                    // Only write if there's actual data
-                    if (accumulated_value) {
-                        entries.emplace_back(timestamp, metric->getName(), std::move(accumulated_value));
+        runtime_->postIO([this]() {
+            drainOutput();
+
+            // Notify under the lock: stop() may destroy the collector as
+            // soon as it sees the flag cleared
+            std::lock_guard<std::mutex> lock(tick_mutex_);
+            drain_scheduled_ = false;
+            tick_cv_.notify_all();
+        });
+    }
+
+    void MetricCollector::takeDirtyMetrics(uint64_t tick, std::vector<uint64_t>& words) {
+        dirty_.drain(words);
+
+        auto set = [&words](size_t i) {
+            words[i / DirtySet::kBitsPerWord] |= uint64_t{ 1 } << (i % DirtySet::kBitsPerWord);
+        };
+        for (size_t i : untracked_metrics_) {
+            set(i);
+        }
+
+        // Heartbeats are spread over the ticks by metric index, so every
+        // n-th metric is due on each tick instead of all of them at once
+        const size_t heartbeat = emission_.heartbeat_ticks;
+        if (emission_.skip_idle && heartbeat > 0) {
+            for (size_t i = (heartbeat - tick % heartbeat) % heartbeat; i < metrics_.size(); i += heartbeat) {
+                set(i);
+            }
+        }
+    }
+
+    bool MetricCollector::shouldEmit(size_t index, const MetricValue& value, uint64_t tick) {
+        EmissionState& state = emission_state_[index];
+        const double deadband = state.has_deadband ? state.deadband : emission_.deadband;
+        if (deadband <= 0.0) {
+            return true;
+        }
+
+        std::optional<double> current = value.asDouble();
+        if (!current) {
+            return true;
+        }
+
+        const size_t heartbeat = emission_.heartbeat_ticks;
+        const bool heartbeat_due = heartbeat > 0 && (tick + index) % heartbeat == 0;
+        if (state.written && !heartbeat_due && std::abs(*current - state.last_written) <= deadband) {
+            return false;
+        }
+
+        // Suppressed values do not move the reference, so slow drifts are
+        // written once they add up to more than the deadband
+        state.last_written = *current;
+        state.written = true;
+        return true;
+    }
+
+    MetricTick MetricCollector::prepareTick() {
+        // Each partition covers a contiguous range of the metrics read this
+        // tick and is swept and formatted independently. Chunks are kept in
+        // partition order, so the output order matches registration order
+        // regardless of thread timing.
+        struct SnapshotPartition {
+            size_t begin = 0;
+            size_t end = 0;
+            std::vector<MetricEntry> entries;
+            std::string formatted;
+        };
+
+        // Gauge callbacks run before the registry lock is taken, so they may
+        // record into other metrics or register new ones
+        gauges_->sampleDue();
+
+        MetricTick tick;
+        tick.timestamp = clock().now();
+        std::vector<SnapshotPartition> partitions;
+        const uint64_t tick_number = emission_tick_++;
+
+        {
+            std::shared_lock<std::shared_mutex> lock(metrics_mutex_);
+
+            // Only metrics recorded since the last tick are read. With
+            // skip_idle the others are left out; otherwise they are written
+            // with their idle value, without locking or resetting them.
+            std::vector<uint64_t> dirty;
+            takeDirtyMetrics(tick_number, dirty);
+
+            std::vector<size_t> active;
+            if (emission_.skip_idle) {
+                for (size_t w = 0; w < dirty.size(); ++w) {
+                    for (uint64_t bits = dirty[w]; bits != 0; bits &= bits - 1) {
+                        active.push_back(w * DirtySet::kBitsPerWord + static_cast<size_t>(std::countr_zero(bits)));
                     }
-                } catch (const std::exception& e) {
-                    std::cerr << "Error collecting metric '" << metric->getName() << "': " << e.what() << std::endl;
                 }
             }
-        }
+            const size_t* indices = emission_.skip_idle ? active.data() : nullptr;
+            const size_t read_count = emission_.skip_idle ? active.size() : metrics_.size();
 
-        // Write to file (outside of lock)
-        if (!entries.empty()) {
-            try {
-                writer_->writeMetrics(entries);
-                
-                // Reset metrics after successful write
-                std::lock_guard<std::mutex> lock(metrics_mutex_);
-                for (auto& metric : metrics_) {
+            WorkerPool* pool = read_count >= 2 * kMinPartitionSize ? snapshotPool() : nullptr;
+            const size_t partition_count = partitionCount(read_count, pool);
+
+            partitions.resize(partition_count);
+            for (size_t p = 0; p < partition_count; ++p) {
+                partitions[p].begin = read_count * p / partition_count;
+                partitions[p].end = read_count * (p + 1) / partition_count;
+            }
+
+            const TimePoint timestamp = tick.timestamp;
+            auto sweep = [this, &partitions, &dirty, indices, timestamp, tick_number](size_t p) {
+                SnapshotPartition& partition = partitions[p];
+                partition.entries.reserve(partition.end - partition.begin);
+
+                for (size_t n = partition.begin; n < partition.end; ++n) {
+                    const size_t i = indices ? indices[n] : n;
+                    Metric* metric = metrics_[i].get();
                     try {
-                        metric->reset();
+                        const bool is_dirty = (dirty[i / DirtySet::kBitsPerWord] >> (i % DirtySet::kBitsPerWord)) & 1;
+                        std::unique_ptr<MetricValue> accumulated_value = is_dirty ? nullptr : metric->idleValue();
+                        if (!accumulated_value) {
+                            // Read and reset in one step: the interval is closed here
+                            accumulated_value = metric->collectAndReset();
+                        }
+
+                        // Only write if there's actual data
+                        if (accumulated_value && shouldEmit(i, *accumulated_value, tick_number)) {
+                            partition.entries.emplace_back(timestamp, metric->getName(), std::move(accumulated_value));
+                        }
                     } catch (const std::exception& e) {
-                        std::cerr << "Error resetting metric '" << metric->getName() << "': " << e.what() << std::endl;
+                        std::cerr << "Error collecting metric '" << metric->getName() << "': " << e.what() << std::endl;
                     }
                 }
+
+                writer_->formatEntries(partition.entries.data(),
+                                       partition.entries.data() + partition.entries.size(),
+                                       partition.formatted);
+            };
+
+            if (partition_count == 1) {
+                sweep(0);
+            } else {
+                pool->parallelFor(partition_count, sweep);
+            }
+        }
+
+        size_t entry_count = 0;
+        for (const auto& partition : partitions) {
+            entry_count += partition.entries.size();
+        }
+
+        tick.entries.reserve(entry_count);
+        tick.chunks.reserve(partitions.size());
+        for (auto& partition : partitions) {
+            std::move(partition.entries.begin(), partition.entries.end(), std::back_inserter(tick.entries));
+            tick.chunks.push_back(std::move(partition.formatted));
+        }
+        writer_->finishTick(tick.timestamp, tick.entries, tick.chunks);
+        tick.formatted = true;
+
+        return tick;
+    }
+
+    void MetricCollector::pushTick(MetricTick tick, bool may_wait, bool closing) {
+        if (!event_time_) {
+            output_buffer_->push(std::move(tick));
+            return;
+        }
+
+        // Held ticks and closed intervals before the watermark are final and
+        // go out merged in timestamp order. Closing (on stop) everything
+        // does. A tick further behind the clock than the open intervals
+        // reach goes out regardless, so a stalled event-time watermark
+        // cannot hold output back indefinitely.
+        held_ticks_.push_back(std::move(tick));
+        const TimePoint now = clock().now();
+        const TimePoint watermark = closing ? TimePoint::max() : event_time_->advance(now);
+        const TimePoint overdue = now - std::chrono::seconds(event_time_->options().max_open_intervals);
+
+        // A Block-policy buffer full on a scheduled tick leaves the rest held
+        bool pushed = false;
+        TimePoint interval_start;
+        EventTimeInterval interval;
+        for (;;) {
+            const bool has_interval = event_time_->oldestClosed(interval_start);
+            const TimePoint tick_second = held_ticks_.empty()
+                                              ? TimePoint::max()
+                                              : std::chrono::floor<std::chrono::seconds>(held_ticks_.front().timestamp);
+            if (!has_interval && held_ticks_.empty()) {
+                break;
+            }
+
+            const bool interval_first = has_interval && interval_start < tick_second;
+            const TimePoint next = interval_first ? interval_start : tick_second;
+            if (next >= watermark && (interval_first || tick_second >= overdue)) {
+                break;
+            }
+            if (pushed && !may_wait && output_buffer_->deferIfFull()) {
+                break;
+            }
+
+            if (interval_first) {
+                // No live tick of its second is left: a tick of its own
+                event_time_->popClosed(interval);
+                MetricTick own;
+                own.timestamp = interval.start;
+                foldInterval(own, interval);
+                if (own.entries.empty()) {
+                    continue;
+                }
+                if (interval.start <= released_until_) {
+                    event_time_->countLateInterval();
+                } else {
+                    released_until_ = interval.start;
+                }
+                output_buffer_->push(std::move(own));
+            } else {
+                MetricTick live = std::move(held_ticks_.front());
+                held_ticks_.pop_front();
+                if (has_interval && interval_start == tick_second) {
+                    event_time_->popClosed(interval);
+                    foldInterval(live, interval);
+                }
+                released_until_ = std::max(released_until_, tick_second);
+                output_buffer_->push(std::move(live));
+            }
+            pushed = true;
+        }
+    }
+
+    void MetricCollector::foldInterval(MetricTick& tick, EventTimeInterval& interval) {
+        std::unordered_map<std::string, size_t> index;
+        index.reserve(tick.entries.size());
+        for (size_t i = 0; i < tick.entries.size(); ++i) {
+            index.emplace(tick.entries[i].name, i);
+        }
+
+        bool changed = false;
+        for (const auto& metric : interval.metrics) {
+            std::unique_ptr<MetricValue> value = metric->collectAndReset();
+            if (!value) {
+                continue;
+            }
+
+            auto it = index.find(metric->getName());
+            if (it == index.end()) {
+                tick.entries.emplace_back(tick.timestamp, metric->getName(), std::move(value));
+                changed = true;
+                continue;
+            }
+
+            // The live value counts as the newer one, e.g. for Last
+            MetricEntry& entry = tick.entries[it->second];
+            try {
+                value->coalesce(*entry.value);
+                entry.value = std::move(value);
+                changed = true;
             } catch (const std::exception& e) {
-                std::cerr << "Error writing metrics: " << e.what() << std::endl;
+                std::cerr << "Cannot fold event-time values of metric '" << entry.name << "': " << e.what()
+                          << std::endl;
+            }
+        }
+
+        // Formatted again when written (see formatBatch)
+        if (changed) {
+            tick.chunks.clear();
+            tick.formatted = false;
+        }
+    }
+
+    std::string MetricCollector::formatBatch(std::vector<MetricTick>& ticks) {
+        std::string batch;
+        for (auto& tick : ticks) {
+            if (!tick.formatted) {
+                // Coalesced ticks lost their formatted form
+                tick.chunks.assign(1, std::string());
+                writer_->formatEntries(tick.entries.data(), tick.entries.data() + tick.entries.size(),
+                                       tick.chunks.front());
+                writer_->finishTick(tick.timestamp, tick.entries, tick.chunks);
+                tick.formatted = true;
+            }
+
+            for (const auto& chunk : tick.chunks) {
+                batch.append(chunk);
             }
         }
+        return batch;
+    }
+
+    bool MetricCollector::drainOutput() {
+        std::lock_guard<std::mutex> lock(drain_mutex_);
+
+        if (sink_failed_ && !retrySink()) {
+            spillOutput();
+            return false;
+        }
+
+        std::vector<MetricTick> ticks;
+        try {
+            ticks = output_buffer_->takeAll();
+            if (checkpoint_has_intervals_ && (!ticks.empty() || (spool_ && !spool_->empty()))) {
+                // These ticks carry the interval the checkpoint holds: take it
+                // out first, so a restart cannot count it twice
+                if (!saveCheckpointLocked(false)) {
+                    std::remove(checkpoint_path_.c_str());
+                    checkpoint_has_intervals_ = false;
+                    std::cerr << "Removed checkpoint " << checkpoint_path_
+                              << ": it holds an interval that is about to be written" << std::endl;
+                }
+            }
+
+            // Catch up on spooled (older) output before anything newer
+            if (spool_ && !spool_->empty()) {
+                size_t spooled = spool_->size();
+                spool_->replayInto(*writer_);
+                std::cout << "Replayed " << spooled << " spooled bytes to the output sink" << std::endl;
+            }
+
+            // Everything buffered goes out as one batch
+            if (!ticks.empty()) {
+                std::vector<std::string> batch(1, formatBatch(ticks));
+                if (!batch.front().empty()) {
+                    writer_->writeFormatted(batch);
+                }
+                output_buffer_->markWritten(ticks.size());
+                maybeCheckpoint(ticks.size());
+            }
+        } catch (const MetricWriteError& e) {
+            output_buffer_->requeueFront(std::move(ticks));
+            handleSinkFailure(e.what(), e.getErrorCode());
+            spillOutput();
+            return false;
+        } catch (const std::exception& e) {
+            output_buffer_->requeueFront(std::move(ticks));
+            handleSinkFailure(e.what(), 0);
+            spillOutput();
+            return false;
+        }
+
+        if (sink_failed_) {
+            sink_failed_ = false;
+            retry_delay_ = initial_retry_delay_;
+            output_buffer_->setDegraded(false);
+            std::cout << "Output sink recovered" << std::endl;
+        }
+        return true;
+    }
+
+    bool MetricCollector::retrySink() {
+        auto now = clock().steadyNow();
+        if (now < next_retry_) {
+            return false;
+        }
+
+        if (writer_->recover()) {
+            return true;
+        }
+
+        next_retry_ = now + retry_delay_;
+        retry_delay_ = std::min(retry_delay_ * 2, max_retry_delay_);
+        return false;
     }
 
-    // Explicit template instantiations for common types
-    template void MetricCollector::registerMetric<int>(const std::string& name);
-    template void MetricCollector::registerMetric<double>(const std::string& name);
-    template void MetricCollector::registerMetric<float>(const std::string& name);
-    template void MetricCollector::registerMetric<long>(const std::string& name);
+    void MetricCollector::handleSinkFailure(const std::string& message, int error_code) {
+        output_buffer_->recordWriteFailure(error_code);
 
-    template void MetricCollector::recordMetric<int>(const std::string& name, int value);
-    template void MetricCollector::recordMetric<double>(const std::string& name, double value);
-    template void MetricCollector::recordMetric<float>(const std::string& name, float value);
-    template void MetricCollector::recordMetric<long>(const std::string& name, long value);
+        // Log once per outage, not on every retry
+        if (!sink_failed_) {
+            const bool disk_full = MetricWriteError(message, error_code).isDiskFull();
+            std::cerr << "Error writing metrics (" << (disk_full ? "disk full" : "I/O error") << "): " << message
+                      << " - buffering" << (spool_ ? " and spooling to " + spool_->getPath() : std::string())
+                      << " until the sink recovers" << std::endl;
+            sink_failed_ = true;
+            output_buffer_->setDegraded(true);
+        }
+
+        next_retry_ = clock().steadyNow() + retry_delay_;
+        retry_delay_ = std::min(retry_delay_ * 2, max_retry_delay_);
+    }
+
+    void MetricCollector::spillOutput() {
+        if (!spool_) {
+            return; // Ticks stay in memory under the overflow policy
+        }
+
+        std::vector<MetricTick> ticks = output_buffer_->takeAll();
+        size_t spilled = 0;
+        for (; spilled < ticks.size(); ++spilled) {
+            std::vector<MetricTick> one(1);
+            one.front() = std::move(ticks[spilled]);
+            if (!spool_->append(formatBatch(one))) {
+                ticks[spilled] = std::move(one.front());
+                break; // Spool full or failing too - keep the rest in memory
+            }
+        }
+
+        if (spilled < ticks.size()) {
+            output_buffer_->requeueFront(std::vector<MetricTick>(std::make_move_iterator(ticks.begin() + spilled),
+                                                                 std::make_move_iterator(ticks.end())));
+        }
+        if (spilled > 0) {
+            output_buffer_->markSpilled(spilled);
+        }
+    }
 
 } // namespace MetricsSystem 
\ No newline at end of file
@@ -0,0 +1,399 @@
+#include "MetricColumnar.h"
+#include "MetricCheckpoint.h"
+#include "MetricSnappy.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace MetricsSystem {
+
+    namespace {
+
+        const char kArchiveMagic[4] = { 'M', 'C', 'O', 'L' };
+        const size_t kMaxDecimalDigits = 18;   // Always fits in int64_t
+
+        // Plain decimal whose text comes back unchanged from mantissa and
+        // scale: no '+', no leading zeros, no "-0"
+        bool parseDecimal(std::string_view text, int64_t& mantissa, uint8_t& scale) {
+            size_t pos = 0;
+            const bool negative = !text.empty() && text[0] == '-';
+            if (negative) {
+                ++pos;
+            }
+
+            const size_t int_begin = pos;
+            while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9') {
+                ++pos;
+            }
+            const size_t int_digits = pos - int_begin;
+            if (int_digits == 0 || (int_digits > 1 && text[int_begin] == '0')) {
+                return false;
+            }
+
+            size_t frac_digits = 0;
+            if (pos < text.size() && text[pos] == '.') {
+                const size_t frac_begin = ++pos;
+                while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9') {
+                    ++pos;
+                }
+                frac_digits = pos - frac_begin;
+                if (frac_digits == 0) {
+                    return false;
+                }
+            }
+            if (pos != text.size() || int_digits + frac_digits > kMaxDecimalDigits) {
+                return false;
+            }
+
+            uint64_t value = 0;
+            for (size_t i = int_begin; i < text.size(); ++i) {
+                if (text[i] != '.') {
+                    value = value * 10 + static_cast<uint64_t>(text[i] - '0');
+                }
+            }
+            if (negative && value == 0) {
+                return false;
+            }
+
+            mantissa = negative ? -static_cast<int64_t>(value) : static_cast<int64_t>(value);
+            scale = static_cast<uint8_t>(frac_digits);
+            return true;
+        }
+
+        uint64_t zigzag(int64_t value) {
+            return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+        }
+
+        int64_t unzigzag(uint64_t value) {
+            return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+        }
+
+        void appendVarint(std::string& out, uint64_t value) {
+            while (value >= 0x80) {
+                out.push_back(static_cast<char>(value | 0x80));
+                value >>= 7;
+            }
+            out.push_back(static_cast<char>(value));
+        }
+
+        bool readVarint(const char*& pos, const char* end, uint64_t& value) {
+            value = 0;
+            for (int shift = 0; shift < 64 && pos < end; shift += 7) {
+                const uint8_t byte = static_cast<uint8_t>(*pos++);
+                value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                if (!(byte & 0x80)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        struct DirectoryEntry {
+            std::string name;
+            ColumnKind kind = ColumnKind::Decimal;
+            uint8_t scale = 0;
+            uint64_t count = 0;
+            uint64_t min_key = 0;
+            uint64_t max_key = 0;
+            uint64_t offset = 0;
+            uint32_t time_bytes = 0;
+            uint32_t value_bytes = 0;
+        };
+
+        [[noreturn]] void corrupt(const std::string& what) {
+            throw std::runtime_error("Corrupt columnar archive: " + what);
+        }
+
+        // Version check; returns the series count
+        uint32_t readHeader(CheckpointReader& reader) {
+            if (reader.get<uint32_t>() != ColumnarArchive::kVersion) {
+                corrupt("unsupported version");
+            }
+            return reader.get<uint32_t>();
+        }
+
+        DirectoryEntry readEntry(CheckpointReader& reader) {
+            DirectoryEntry entry;
+            entry.name = reader.getString();
+            entry.kind = static_cast<ColumnKind>(reader.get<uint8_t>());
+            entry.scale = reader.get<uint8_t>();
+            entry.count = reader.get<uint64_t>();
+            entry.min_key = reader.get<uint64_t>();
+            entry.max_key = reader.get<uint64_t>();
+            entry.offset = reader.get<uint64_t>();
+            entry.time_bytes = reader.get<uint32_t>();
+            entry.value_bytes = reader.get<uint32_t>();
+            return entry;
+        }
+
+    } // namespace
+
+    // ColumnarSeries Implementation
+    void ColumnarSeries::add(uint64_t key, std::string_view value) {
+        keys.push_back(key);
+
+        if (kind == ColumnKind::Decimal) {
+            int64_t mantissa = 0;
+            uint8_t value_scale = 0;
+            if (parseDecimal(value, mantissa, value_scale) && (mantissas.empty() || value_scale == scale)) {
+                scale = value_scale;
+                mantissas.push_back(mantissa);
+                return;
+            }
+
+            // Earlier values go over as the text they were parsed from
+            texts.reserve(keys.size());
+            for (size_t i = 0; i < mantissas.size(); ++i) {
+                texts.emplace_back();
+                appendValue(i, texts.back());
+            }
+            mantissas.clear();
+            mantissas.shrink_to_fit();
+            kind = ColumnKind::Text;
+            scale = 0;
+        }
+
+        texts.emplace_back(value);
+    }
+
+    void ColumnarSeries::append(const ColumnarSeries& other) {
+        if (kind == ColumnKind::Decimal && other.kind == ColumnKind::Decimal &&
+            (mantissas.empty() || other.mantissas.empty() || scale == other.scale)) {
+            if (mantissas.empty()) {
+                scale = other.scale;
+            }
+            keys.insert(keys.end(), other.keys.begin(), other.keys.end());
+            mantissas.insert(mantissas.end(), other.mantissas.begin(), other.mantissas.end());
+            return;
+        }
+
+        std::string text;
+        for (size_t i = 0; i < other.size(); ++i) {
+            text.clear();
+            other.appendValue(i, text);
+            add(other.keys[i], text);
+        }
+    }
+
+    void ColumnarSeries::appendValue(size_t i, std::string& out) const {
+        if (kind == ColumnKind::Text) {
+            out.append(texts[i]);
+            return;
+        }
+
+        const int64_t mantissa = mantissas[i];
+        const uint64_t magnitude = mantissa < 0 ? 0 - static_cast<uint64_t>(mantissa) : static_cast<uint64_t>(mantissa);
+        if (mantissa < 0) {
+            out.push_back('-');
+        }
+
+        char digits[24];
+        const size_t count = static_cast<size_t>(std::to_chars(digits, digits + sizeof(digits), magnitude).ptr - digits);
+        if (scale == 0) {
+            out.append(digits, count);
+        } else if (count <= scale) {
+            out.append("0.");
+            out.append(scale - count, '0');
+            out.append(digits, count);
+        } else {
+            out.append(digits, count - scale);
+            out.push_back('.');
+            out.append(digits + count - scale, scale);
+        }
+    }
+
+    // ColumnarArchive Implementation
+    bool ColumnarArchive::timeRange(std::string_view data, uint64_t& min_key, uint64_t& max_key) {
+        if (!isArchive(data)) {
+            corrupt("bad magic");
+        }
+
+        CheckpointReader reader(data.data() + sizeof(kArchiveMagic), data.size() - sizeof(kArchiveMagic));
+        const uint32_t count = readHeader(reader);
+
+        bool any = false;
+        for (uint32_t s = 0; s < count; ++s) {
+            const DirectoryEntry entry = readEntry(reader);
+            if (entry.count == 0) {
+                continue;
+            }
+            min_key = any ? std::min(min_key, entry.min_key) : entry.min_key;
+            max_key = any ? std::max(max_key, entry.max_key) : entry.max_key;
+            any = true;
+        }
+        return any;
+    }
+
+    bool ColumnarArchive::isArchive(std::string_view data) {
+        return data.size() >= sizeof(kArchiveMagic) && std::memcmp(data.data(), kArchiveMagic, sizeof(kArchiveMagic)) == 0;
+    }
+
+    void ColumnarArchive::encode(const std::vector<ColumnarSeries>& series, std::string& out) {
+        // Columns first, so the directory can give their offsets
+        std::vector<DirectoryEntry> directory(series.size());
+        std::vector<std::string> columns(series.size() * 2);
+        std::string raw;
+        size_t directory_bytes = sizeof(kArchiveMagic) + 2 * sizeof(uint32_t);
+
+        for (size_t s = 0; s < series.size(); ++s) {
+            const ColumnarSeries& input = series[s];
+            DirectoryEntry& entry = directory[s];
+            entry.name = input.name;
+            entry.kind = input.kind;
+            entry.scale = input.scale;
+            entry.count = input.size();
+            if (!input.keys.empty()) {
+                auto [min, max] = std::minmax_element(input.keys.begin(), input.keys.end());
+                entry.min_key = *min;
+                entry.max_key = *max;
+            }
+
+            raw.clear();
+            uint64_t previous_key = 0;
+            for (uint64_t key : input.keys) {
+                appendVarint(raw, zigzag(static_cast<int64_t>(key - previous_key)));
+                previous_key = key;
+            }
+            SnappyCodec::compress(raw, columns[2 * s]);
+
+            raw.clear();
+            if (input.kind == ColumnKind::Decimal) {
+                int64_t previous = 0;
+                for (int64_t mantissa : input.mantissas) {
+                    appendVarint(raw, zigzag(static_cast<int64_t>(static_cast<uint64_t>(mantissa) -
+                                                                  static_cast<uint64_t>(previous))));
+                    previous = mantissa;
+                }
+            } else {
+                for (const auto& text : input.texts) {
+                    appendVarint(raw, text.size());
+                    raw.append(text);
+                }
+            }
+            SnappyCodec::compress(raw, columns[2 * s + 1]);
+
+            if (columns[2 * s].size() > std::numeric_limits<uint32_t>::max() ||
+                columns[2 * s + 1].size() > std::numeric_limits<uint32_t>::max()) {
+                throw std::runtime_error("Series too large for a columnar archive: " + input.name);
+            }
+            entry.time_bytes = static_cast<uint32_t>(columns[2 * s].size());
+            entry.value_bytes = static_cast<uint32_t>(columns[2 * s + 1].size());
+            directory_bytes += sizeof(uint32_t) + entry.name.size() + 2 * sizeof(uint8_t) + 4 * sizeof(uint64_t) +
+                               2 * sizeof(uint32_t);
+        }
+
+        out.clear();
+        CheckpointWriter writer(out);
+        out.append(kArchiveMagic, sizeof(kArchiveMagic));
+        writer.put(kVersion);
+        writer.put(static_cast<uint32_t>(series.size()));
+
+        uint64_t offset = directory_bytes;
+        for (auto& entry : directory) {
+            writer.putString(entry.name);
+            writer.put(static_cast<uint8_t>(entry.kind));
+            writer.put(entry.scale);
+            writer.put(entry.count);
+            writer.put(entry.min_key);
+            writer.put(entry.max_key);
+            writer.put(offset);
+            writer.put(entry.time_bytes);
+            writer.put(entry.value_bytes);
+            offset += static_cast<uint64_t>(entry.time_bytes) + entry.value_bytes;
+        }
+
+        for (const auto& column : columns) {
+            out.append(column);
+        }
+    }
+
+    std::vector<ColumnarSeries> ColumnarArchive::decode(std::string_view data, std::string_view only) {
+        if (!isArchive(data)) {
+            corrupt("bad magic");
+        }
+
+        CheckpointReader reader(data.data() + sizeof(kArchiveMagic), data.size() - sizeof(kArchiveMagic));
+        const uint32_t count = readHeader(reader);
+
+        std::vector<ColumnarSeries> result;
+        std::string raw;
+        for (uint32_t s = 0; s < count; ++s) {
+            const DirectoryEntry entry = readEntry(reader);
+
+            if (!only.empty() && entry.name != only) {
+                continue;
+            }
+            if (entry.kind != ColumnKind::Decimal && entry.kind != ColumnKind::Text) {
+                corrupt("unknown column kind for " + entry.name);
+            }
+            if (entry.offset > data.size() ||
+                data.size() - entry.offset < static_cast<uint64_t>(entry.time_bytes) + entry.value_bytes) {
+                corrupt("column of " + entry.name + " out of range");
+            }
+
+            ColumnarSeries series;
+            series.name = entry.name;
+            series.kind = entry.kind;
+            series.scale = entry.scale;
+
+            // Every key and value takes at least one byte, which bounds
+            // `count` before anything is reserved
+            if (!SnappyCodec::uncompress(data.substr(entry.offset, entry.time_bytes), raw) || raw.size() < entry.count) {
+                corrupt("time column of " + entry.name);
+            }
+            series.keys.reserve(entry.count);
+            const char* pos = raw.data();
+            const char* end = raw.data() + raw.size();
+            uint64_t key = 0;
+            for (uint64_t i = 0; i < entry.count; ++i) {
+                uint64_t delta = 0;
+                if (!readVarint(pos, end, delta)) {
+                    corrupt("time column of " + entry.name);
+                }
+                key += static_cast<uint64_t>(unzigzag(delta));
+                series.keys.push_back(key);
+            }
+            if (pos != end) {
+                corrupt("time column of " + entry.name);
+            }
+
+            if (!SnappyCodec::uncompress(data.substr(entry.offset + entry.time_bytes, entry.value_bytes), raw) ||
+                raw.size() < entry.count) {
+                corrupt("value column of " + entry.name);
+            }
+            pos = raw.data();
+            end = raw.data() + raw.size();
+            if (series.kind == ColumnKind::Decimal) {
+                series.mantissas.reserve(entry.count);
+                uint64_t mantissa = 0;
+                for (uint64_t i = 0; i < entry.count; ++i) {
+                    uint64_t delta = 0;
+                    if (!readVarint(pos, end, delta)) {
+                        corrupt("value column of " + entry.name);
+                    }
+                    mantissa += static_cast<uint64_t>(unzigzag(delta));
+                    series.mantissas.push_back(static_cast<int64_t>(mantissa));
+                }
+            } else {
+                series.texts.reserve(entry.count);
+                for (uint64_t i = 0; i < entry.count; ++i) {
+                    uint64_t length = 0;
+                    if (!readVarint(pos, end, length) || static_cast<uint64_t>(end - pos) < length) {
+                        corrupt("value column of " + entry.name);
+                    }
+                    series.texts.emplace_back(pos, static_cast<size_t>(length));
+                    pos += length;
+                }
+            }
+            if (pos != end) {
+                corrupt("value column of " + entry.name);
+            }
+
+            result.push_back(std::move(series));
+        }
+        return result;
+    }
+
+} // namespace MetricsSystem
\ No newline at end of file
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace MetricsSystem {
+
+    enum class ColumnKind : uint8_t {
+        Decimal = 0,    // Values like 42, -7 or 0.97, stored as integers with a fixed scale
+        Text = 1        // Anything else, stored as written
+    };
+
+    // The samples of one metric, in file order. Values are kept so that
+    // their text comes back exactly as written: a series stays Decimal
+    // while all values are plain decimals with the same number of digits
+    // after the point (the writer's fixed formats), and turns into Text on
+    // the first value that is not.
+    struct ColumnarSeries {
+        std::string name;
+        ColumnKind kind = ColumnKind::Decimal;
+        uint8_t scale = 0;                  // Decimal: digits after the point
+        std::vector<uint64_t> keys;         // Packed time keys (see MetricTimeKey)
+        std::vector<int64_t> mantissas;     // Decimal: value * 10^scale
+        std::vector<std::string> texts;     // Text
+
+        void add(uint64_t key, std::string_view value);
+
+        // Append the samples of another part of the same series
+        void append(const ColumnarSeries& other);
+
+        size_t size() const { return keys.size(); }
+        bool operator==(const ColumnarSeries& other) const = default;
+
+        // Append the text of value i
+        void appendValue(size_t i, std::string& out) const;
+    };
+
+    // Columnar archive of a metrics file. Each series is stored as two
+    // Snappy-compressed columns: time keys as zigzag varint deltas, and
+    // values as zigzag varint deltas of the mantissas (Decimal) or as
+    // length-prefixed text. A directory in front gives each series' time
+    // range and column offsets, so one series is read without decoding
+    // the others. Layout (host byte order, like the merge tool's binary
+    // output):
+    //   "MCOL" u32 version u32 series_count
+    //   per series: u32 name_length name u8 kind u8 scale u64 count
+    //               u64 min_key u64 max_key u64 offset u32 time_bytes u32 value_bytes
+    //   column blocks (offsets are from the start of the file)
+    class ColumnarArchive {
+    public:
+        static constexpr uint32_t kVersion = 1;
+
+        static void encode(const std::vector<ColumnarSeries>& series, std::string& out);
+
+        // Decode all series, or only the one named `only`. Throws
+        // std::runtime_error for a corrupt archive.
+        static std::vector<ColumnarSeries> decode(std::string_view data, std::string_view only = {});
+
+        // Time range of all series from the directory alone; false if the
+        // archive holds no samples. Throws like decode.
+        static bool timeRange(std::string_view data, uint64_t& min_key, uint64_t& max_key);
+
+        static bool isArchive(std::string_view data);
+    };
+
+} // namespace MetricsSystem
\ No newline at end of file
@@ -0,0 +1,143 @@
+#include "MetricCompactWriter.h"
+#include "MetricUtilities.h"
+#include <charconv>
+#include <iostream>
+
+namespace MetricsSystem {
+
+    namespace {
+
+        const std::string_view kDefinition = "#def ";
+
+        void appendId(std::string& out, uint32_t id) {
+            char digits[12];
+            auto result = std::to_chars(digits, digits + sizeof(digits), id);
+            out.append(digits, result.ptr);
+        }
+
+        // Value as written by the text format, quoted if it would not stay
+        // one token
+        void appendValue(std::string& out, const MetricValue& value) {
+            const size_t start = out.size();
+            value.appendText(out);
+            if (out.find_first_of(" \"\r\n\\", start) == std::string::npos) {
+                return;
+            }
+
+            std::string text = out.substr(start);
+            out.resize(start);
+            out.push_back('"');
+            for (char c : text) {
+                switch (c) {
+                    case '"': out.append("\\\""); break;
+                    case '\\': out.append("\\\\"); break;
+                    case '\n': out.append("\\n"); break;
+                    case '\r': out.append("\\r"); break;
+                    default: out.push_back(c); break;
+                }
+            }
+            out.push_back('"');
+        }
+
+    } // namespace
+
+    void CompactTextWriter::formatEntries(const MetricEntry* /*first*/, const MetricEntry* /*last*/,
+                                          std::string& /*out*/) const {
+        // Numbers are assigned in tick order, which only finishTick() sees
+    }
+
+    void CompactTextWriter::finishTick(TimePoint timestamp, const std::vector<MetricEntry>& entries,
+                                       std::vector<std::string>& chunks) const {
+        if (entries.empty()) {
+            return;
+        }
+        if (chunks.empty()) {
+            chunks.emplace_back();
+        }
+        std::string& out = chunks.back();
+
+        std::lock_guard<std::mutex> lock(dictionary_mutex_);
+
+        line_ = TimestampUtils::formatTimestamp(timestamp);
+        for (const auto& entry : entries) {
+            const size_t start = line_.size();
+            try {
+                auto it = ids_.find(entry.name);
+                if (it == ids_.end()) {
+                    it = ids_.emplace(entry.name, static_cast<uint32_t>(names_.size())).first;
+                    names_.push_back(entry.name);
+                    written_.push_back(false);
+                }
+                const uint32_t id = it->second;
+
+                if (!written_[id]) {
+                    out.append(kDefinition);
+                    appendId(out, id);
+                    out.push_back(' ');
+                    out.append(MetricNameValidator::formatNameForOutput(entry.name));
+                    out.push_back('\n');
+                }
+
+                line_.push_back(' ');
+                appendId(line_, id);
+                line_.push_back('=');
+                appendValue(line_, *entry.value);
+
+            } catch (const std::exception& e) {
+                line_.resize(start);
+                std::cerr << "Error formatting metric entry '" << entry.name << "': " << e.what() << std::endl;
+            }
+        }
+
+        line_.push_back('\n');
+        out.append(line_);
+    }
+
+    void CompactTextWriter::confirmDefinitions(std::string_view chunk) {
+        // #def <id> "<name>" at the start of a line; the name is checked so
+        // replayed output of an earlier writer does not count
+        for (size_t pos = chunk.find(kDefinition); pos != std::string_view::npos; pos = chunk.find(kDefinition, pos + 1)) {
+            if (pos > 0 && chunk[pos - 1] != '\n') {
+                continue;
+            }
+
+            const char* first = chunk.data() + pos + kDefinition.size();
+            const char* last = chunk.data() + chunk.size();
+            uint32_t id = 0;
+            auto result = std::from_chars(first, last, id);
+            if (result.ec != std::errc() || id >= names_.size() || last - result.ptr < 3 || result.ptr[0] != ' ' ||
+                result.ptr[1] != '"') {
+                continue;
+            }
+
+            std::string_view name(result.ptr + 2, static_cast<size_t>(last - result.ptr - 2));
+            const std::string& expected = names_[id];
+            if (name.size() > expected.size() && name.compare(0, expected.size(), expected) == 0 &&
+                name[expected.size()] == '"') {
+                written_[id] = true;
+            }
+        }
+    }
+
+    void CompactTextWriter::startSegment(std::string& preamble) {
+        std::lock_guard<std::mutex> lock(dictionary_mutex_);
+        for (uint32_t id = 0; id < names_.size(); ++id) {
+            preamble.append(kDefinition);
+            appendId(preamble, id);
+            preamble.push_back(' ');
+            preamble.append(MetricNameValidator::formatNameForOutput(names_[id]));
+            preamble.push_back('\n');
+            written_[id] = true;
+        }
+    }
+
+    void CompactTextWriter::writeFormatted(const std::vector<std::string>& chunks) {
+        MetricWriter::writeFormatted(chunks);
+
+        std::lock_guard<std::mutex> lock(dictionary_mutex_);
+        for (const auto& chunk : chunks) {
+            confirmDefinitions(chunk);
+        }
+    }
+
+} // namespace MetricsSystem 
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "MetricSystem.h"
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace MetricsSystem {
+
+    // Compact text output: metric names are written once, in a dictionary
+    // line, and ticks refer to them by number,
+    //   #def 7 "HTTP requests RPS"
+    //   #def 3 "CPU"
+    //   2025-06-01 15:00:01.653 7=42 3=0.97
+    // Values are written as in the text format; a value containing spaces,
+    // quotes or line breaks is quoted, with \ escapes. The file stays
+    // greppable (grep '#def.*"CPU"' gives the number to look for) and is
+    // read by MetricFileCursor like the text format.
+    //
+    // A number's definition is repeated in every tick that uses it until a
+    // write carrying it has succeeded, so ticks that are dropped, coalesced
+    // or spooled by the output buffer never leave a number undefined in the
+    // file. A new writer (e.g. after a restart, appending to the same file)
+    // starts a new dictionary; readers use the latest definition. A rotated
+    // file starts with the whole dictionary, so every segment reads alone.
+    class CompactTextWriter : public MetricWriter {
+    private:
+        mutable std::mutex dictionary_mutex_;
+        mutable std::unordered_map<std::string, uint32_t> ids_;
+        mutable std::vector<std::string> names_;    // By number
+        mutable std::vector<bool> written_;         // By number: definition is in the file
+        mutable std::string line_;                  // Tick line being built
+
+        void confirmDefinitions(std::string_view chunk);
+
+    protected:
+        void startSegment(std::string& preamble) override;
+        SegmentFormat segmentFormat() const override { return SegmentFormat::Compact; }
+
+    public:
+        explicit CompactTextWriter(const std::string& filename) : MetricWriter(filename) {}
+
+        // Rows need the dictionary, so the tick is written by finishTick()
+        void formatEntries(const MetricEntry* first, const MetricEntry* last, std::string& out) const override;
+        void finishTick(TimePoint timestamp, const std::vector<MetricEntry>& entries,
+                        std::vector<std::string>& chunks) const override;
+
+        void writeFormatted(const std::vector<std::string>& chunks) override;
+    };
+
+} // namespace MetricsSystem
\ No newline at end of file
@@ -0,0 +1,86 @@
+#include "MetricCsvWriter.h"
+#include "MetricUtilities.h"
+#include <algorithm>
+
+namespace MetricsSystem {
+
+    void CsvWriter::appendField(std::string& out, std::string_view text) {
+        if (text.find_first_of(",\"\r\n") == std::string_view::npos) {
+            out.append(text);
+            return;
+        }
+
+        out.push_back('"');
+        for (char c : text) {
+            if (c == '"') {
+                out.push_back('"');
+            }
+            out.push_back(c);
+        }
+        out.push_back('"');
+    }
+
+    void CsvWriter::formatEntries(const MetricEntry* /*first*/, const MetricEntry* /*last*/, std::string& /*out*/) const {
+        // Rows need the column layout, which only finishTick() may change
+    }
+
+    void CsvWriter::appendHeader(std::string& out) const {
+        out.append("timestamp");
+        for (const auto& name : header_) {
+            out.push_back(',');
+            out.append(name);
+        }
+        out.push_back('\n');
+    }
+
+    void CsvWriter::startSegment(std::string& preamble) {
+        std::lock_guard<std::mutex> lock(layout_mutex_);
+        if (!header_.empty()) {
+            appendHeader(preamble);
+        }
+    }
+
+    void CsvWriter::finishTick(TimePoint timestamp, const std::vector<MetricEntry>& entries,
+                               std::vector<std::string>& chunks) const {
+        if (entries.empty()) {
+            return;
+        }
+        if (chunks.empty()) {
+            chunks.emplace_back();
+        }
+        std::string& out = chunks.back();
+
+        std::lock_guard<std::mutex> lock(layout_mutex_);
+
+        size_t width = 0;
+        for (const auto& entry : entries) {
+            auto it = columns_.find(entry.name);
+            if (it == columns_.end()) {
+                it = columns_.emplace(entry.name, header_.size()).first;
+                header_.emplace_back();
+                appendField(header_.back(), entry.name);
+
+                // The next write opens a new file under the wider header
+                startNewSegment();
+            }
+            width = std::max(width, it->second + 1);
+        }
+
+        // Cells up to the last column with a value; trailing empty cells are
+        // left out
+        row_.assign(width, nullptr);
+        for (const auto& entry : entries) {
+            row_[columns_.find(entry.name)->second] = entry.value.get();
+        }
+
+        out.append(TimestampUtils::formatTimestamp(timestamp));
+        for (const MetricValue* value : row_) {
+            out.push_back(',');
+            if (value && !value->appendNumber(out)) {
+                appendField(out, value->toString());
+            }
+        }
+        out.push_back('\n');
+    }
+
+} // namespace MetricsSystem 
\ No newline at end of file
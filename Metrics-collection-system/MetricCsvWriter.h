@@ -0,0 +1,55 @@
+#pragma once
+
+#include "MetricSystem.h"
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace MetricsSystem {
+
+    // Wide CSV output: a header row naming the metric columns, then one row
+    // per tick,
+    //   timestamp,CPU,HTTP requests RPS
+    //   2025-06-01 15:00:01.653,0.97,42
+    // Metrics without a value in a tick leave their cell empty. A metric seen
+    // for the first time appends a column and starts a new file: the current
+    // one is rotated like a finished segment (see SegmentOptions), so every
+    // file has exactly one header row, at its top. Earlier columns keep their
+    // position and rows leave out trailing empty cells, so every row is a
+    // prefix of the header of the file it is in. The header is the segment
+    // preamble: it is written again until a write carrying it succeeds.
+    //
+    // Rows are built in finishTick() from the tick's entries: the values are
+    // written in place (std::to_chars for numbers), with no per-cell
+    // allocation. formatEntries() writes nothing.
+    class CsvWriter : public MetricWriter {
+    private:
+        // Column layout, shared by the threads that finish ticks
+        mutable std::mutex layout_mutex_;
+        mutable std::unordered_map<std::string, size_t> columns_;   // Name -> column (0-based, after timestamp)
+        mutable std::vector<std::string> header_;                   // Quoted names in column order
+        mutable std::vector<const MetricValue*> row_;               // Cells of the row being written
+
+        void appendHeader(std::string& out) const;
+
+    protected:
+        // A rotated file starts with the full header; CSV has no comment
+        // lines for a footer
+        void startSegment(std::string& preamble) override;
+        bool hasSegmentFooters() const override { return false; }
+
+    public:
+        explicit CsvWriter(const std::string& filename) : MetricWriter(filename) {}
+
+        void formatEntries(const MetricEntry* first, const MetricEntry* last, std::string& out) const override;
+        void finishTick(TimePoint timestamp, const std::vector<MetricEntry>& entries,
+                        std::vector<std::string>& chunks) const override;
+
+        // Append `text` as a CSV field, quoted only if it contains a
+        // separator, quote or line break
+        static void appendField(std::string& out, std::string_view text);
+    };
+
+} // namespace MetricsSystem
\ No newline at end of file
@@ -0,0 +1,47 @@
+#include "MetricDirtySet.h"
+#include <bit>
+
+namespace MetricsSystem {
+
+    DirtySlot DirtySet::add() {
+        const size_t index = size_;
+        const size_t word = index / kBitsPerWord;
+        if (word / kWordsPerBlock == blocks_.size()) {
+            auto block = std::make_unique<Block>();
+            block->summary.store(0, std::memory_order_relaxed);
+            for (auto& bits : block->words) {
+                bits.store(0, std::memory_order_relaxed);
+            }
+            blocks_.push_back(std::move(block));
+        }
+
+        ++size_;
+        Block& block = *blocks_[word / kWordsPerBlock];
+        DirtySlot slot;
+        slot.word = &block.words[word % kWordsPerBlock];
+        slot.summary = &block.summary;
+        slot.mask = uint64_t{ 1 } << (index % kBitsPerWord);
+        slot.summary_mask = uint64_t{ 1 } << (word % kWordsPerBlock);
+        return slot;
+    }
+
+    void DirtySet::drain(std::vector<uint64_t>& words) {
+        words.assign(wordCount(), 0);
+
+        for (size_t b = 0; b < blocks_.size(); ++b) {
+            Block& block = *blocks_[b];
+            if (block.summary.load(std::memory_order_relaxed) == 0) {
+                continue;
+            }
+
+            // Summary first: a word marked after this exchange sets its
+            // summary bit again and is taken by the next drain
+            uint64_t summary = block.summary.exchange(0, std::memory_order_acquire);
+            for (; summary != 0; summary &= summary - 1) {
+                const size_t w = static_cast<size_t>(std::countr_zero(summary));
+                words[b * kWordsPerBlock + w] = block.words[w].exchange(0, std::memory_order_acquire);
+            }
+        }
+    }
+
+} // namespace MetricsSystem 
\ No newline at end of file
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace MetricsSystem {
+
+    // A metric's bit in a DirtySet. mark() is called after every record: the
+    // first record of an interval sets the bit, later ones only read it.
+    struct DirtySlot {
+        std::atomic<uint64_t>* word = nullptr;
+        std::atomic<uint64_t>* summary = nullptr;
+        uint64_t mask = 0;
+        uint64_t summary_mask = 0;
+
+        void mark() const {
+            // Release after the record, so a collector that sees the bit also
+            // sees the value. A record that finds the bit already set is read
+            // by the same collection as the record that set it.
+            if (word && (word->load(std::memory_order_relaxed) & mask) == 0) {
+                // Only the record that makes the word non-zero touches the
+                // summary, so the summary line is written once per word and
+                // interval
+                if (word->fetch_or(mask, std::memory_order_release) == 0) {
+                    summary->fetch_or(summary_mask, std::memory_order_release);
+                }
+            }
+        }
+    };
+
+    // One bit per registered metric, set when the metric is recorded and
+    // cleared when the collector takes the set. Bits live in fixed blocks,
+    // so slots stay valid while metrics are added.
+    //
+    // Each block has a summary word with one bit per non-zero word, on its
+    // own cache line. drain() follows the summary bits, so it reads only the
+    // words that were marked: the cost tracks active metrics rather than
+    // registered ones.
+    class DirtySet {
+    private:
+        static constexpr size_t kWordsPerBlock = 64;    // 4096 metrics per block
+
+        struct alignas(64) Block {
+            std::atomic<uint64_t> summary;
+            alignas(64) std::atomic<uint64_t> words[kWordsPerBlock];
+        };
+
+        std::vector<std::unique_ptr<Block>> blocks_;
+        size_t size_;
+
+    public:
+        static constexpr size_t kBitsPerWord = 64;
+
+        DirtySet() : size_(0) {}
+
+        // Slot for the next metric index. Requires exclusive access to the
+        // set (the collector's registry lock).
+        DirtySlot add();
+
+        size_t size() const { return size_; }
+        size_t wordCount() const { return (size_ + kBitsPerWord - 1) / kBitsPerWord; }
+
+        // Move all bits to `words` (one entry per word) and clear them
+        void drain(std::vector<uint64_t>& words);
+    };
+
+} // namespace MetricsSystem
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include "MetricEventTime.h"
+#include <stdexcept>
+#include <string>
+
+namespace MetricsSystem {
+
+    namespace {
+
+        int64_t secondOf(std::chrono::system_clock::time_point time) {
+            return std::chrono::floor<std::chrono::seconds>(time).time_since_epoch().count();
+        }
+
+    } // namespace
+
+    // EventTimeWindows Implementation
+    EventTimeWindows::EventTimeWindows(const EventTimeOptions& options)
+        : options_(options), closed_before_(0), accepted_(0), late_dropped_(0), early_dropped_(0),
+          emitted_intervals_(0), late_intervals_(0) {
+        if (options_.allowed_lateness.count() < 0) {
+            throw std::invalid_argument("Allowed lateness cannot be negative");
+        }
+
+        // Room for the intervals still within the lateness, the current one
+        // and the next
+        const auto lateness = std::chrono::ceil<std::chrono::seconds>(options_.allowed_lateness).count();
+        if (options_.max_open_intervals < static_cast<size_t>(lateness) + 2) {
+            throw std::invalid_argument("Open event-time intervals must cover the allowed lateness plus two");
+        }
+
+        slots_.reset(new Slot[options_.max_open_intervals]);
+    }
+
+    EventTimeWindows::Slot& EventTimeWindows::slotOf(int64_t second) const {
+        const int64_t count = static_cast<int64_t>(options_.max_open_intervals);
+        return slots_[static_cast<size_t>((second % count + count) % count)];
+    }
+
+    void EventTimeWindows::advanceTo(int64_t closed_before) {
+        int64_t current = closed_before_.load();
+        while (current < closed_before && !closed_before_.compare_exchange_weak(current, closed_before)) {
+        }
+    }
+
+    void EventTimeWindows::closeSlot(Slot& slot) {
+        {
+            std::lock_guard<std::mutex> lock(closed_mutex_);
+            auto [it, inserted] = closed_.try_emplace(slot.second);
+            EventTimeInterval& interval = it->second;
+            if (inserted) {
+                interval.start = std::chrono::system_clock::time_point(std::chrono::seconds(slot.second));
+                interval.metrics = std::move(slot.metrics);
+            } else {
+                // Closed again before the collector took it (reopened after
+                // closeAll() on a restart): fold into the waiting interval
+                std::unordered_map<std::string, Metric*> waiting;
+                for (const auto& metric : interval.metrics) {
+                    waiting.emplace(metric->getName(), metric.get());
+                }
+                for (auto& metric : slot.metrics) {
+                    auto found = waiting.find(metric->getName());
+                    if (found != waiting.end()) {
+                        found->second->mergeInterval(*metric);
+                    } else {
+                        interval.metrics.push_back(std::move(metric));
+                    }
+                }
+            }
+        }
+        slot.metrics.clear();
+        slot.index.clear();
+        slot.second = kFree;
+    }
+
+    Metric* EventTimeWindows::acquire(const Metric& metric, std::chrono::system_clock::time_point event_time,
+                                      std::unique_lock<std::mutex>& lock) {
+        const int64_t second = secondOf(event_time);
+        if (options_.watermark == WatermarkSource::EventTime) {
+            advanceTo(secondOf(event_time - options_.allowed_lateness));
+        }
+
+        Slot& slot = slotOf(second);
+        std::unique_lock<std::mutex> slot_lock(slot.mutex);
+
+        // Read under the slot lock: a sweep that closes this slot takes the
+        // lock after moving the watermark, so no record slips in behind it
+        const int64_t closed_before = closed_before_.load();
+        if (second < closed_before) {
+            late_dropped_.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        if (second - closed_before >= static_cast<int64_t>(options_.max_open_intervals)) {
+            early_dropped_.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        if (slot.second != second) {
+            // Anything else in the slot is an interval the watermark has
+            // passed and no sweep has taken yet
+            if (slot.second != kFree) {
+                closeSlot(slot);
+            }
+            slot.second = second;
+        }
+
+        auto [it, inserted] = slot.index.try_emplace(&metric, slot.metrics.size());
+        if (inserted) {
+            std::unique_ptr<Metric> copy = metric.createInterval();
+            if (!copy) {
+                slot.index.erase(it);
+                throw std::invalid_argument("Metric '" + metric.getName() + "' does not support event-time recording");
+            }
+            slot.metrics.push_back(std::move(copy));
+        }
+
+        accepted_.fetch_add(1, std::memory_order_relaxed);
+        lock = std::move(slot_lock);
+        return slot.metrics[it->second].get();
+    }
+
+    std::chrono::system_clock::time_point EventTimeWindows::advance(std::chrono::system_clock::time_point now) {
+        if (options_.watermark == WatermarkSource::Clock) {
+            advanceTo(secondOf(now - options_.allowed_lateness));
+        }
+
+        const int64_t closed_before = closed_before_.load();
+        for (size_t i = 0; i < options_.max_open_intervals; ++i) {
+            std::lock_guard<std::mutex> lock(slots_[i].mutex);
+            if (slots_[i].second != kFree && slots_[i].second < closed_before) {
+                closeSlot(slots_[i]);
+            }
+        }
+
+        // Records take the watermark under their slot's lock, so none of them
+        // lands in an interval before it once the sweep has passed its slot
+        return std::chrono::system_clock::time_point(std::chrono::seconds(closed_before));
+    }
+
+    void EventTimeWindows::closeAll() {
+        for (size_t i = 0; i < options_.max_open_intervals; ++i) {
+            std::lock_guard<std::mutex> lock(slots_[i].mutex);
+            if (slots_[i].second != kFree) {
+                closeSlot(slots_[i]);
+            }
+        }
+    }
+
+    bool EventTimeWindows::oldestClosed(std::chrono::system_clock::time_point& start) {
+        std::lock_guard<std::mutex> lock(closed_mutex_);
+        if (closed_.empty()) {
+            return false;
+        }
+
+        start = closed_.begin()->second.start;
+        return true;
+    }
+
+    bool EventTimeWindows::popClosed(EventTimeInterval& interval) {
+        std::lock_guard<std::mutex> lock(closed_mutex_);
+        if (closed_.empty()) {
+            return false;
+        }
+
+        interval = std::move(closed_.begin()->second);
+        closed_.erase(closed_.begin());
+        emitted_intervals_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void EventTimeWindows::countLateInterval() {
+        late_intervals_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    EventTimeStats EventTimeWindows::getStats() const {
+        EventTimeStats stats;
+        stats.accepted = accepted_.load(std::memory_order_relaxed);
+        stats.late_dropped = late_dropped_.load(std::memory_order_relaxed);
+        stats.early_dropped = early_dropped_.load(std::memory_order_relaxed);
+        stats.emitted_intervals = emitted_intervals_.load(std::memory_order_relaxed);
+        stats.late_intervals = late_intervals_.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+} // namespace MetricsSystem
\ No newline at end of file
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "MetricValue.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace MetricsSystem {
+
+    // What moves the event-time watermark (see EventTimeWindows)
+    enum class WatermarkSource {
+        Clock,      // The collector's clock: intervals close a fixed time after they end
+        EventTime   // The latest event time recorded, for sources that replay old data
+    };
+
+    struct EventTimeOptions {
+        std::chrono::milliseconds allowed_lateness{ 5000 };    // How long after its end an interval takes records
+        WatermarkSource watermark = WatermarkSource::Clock;
+        size_t max_open_intervals = 64;     // Ring size; events further ahead of the watermark are dropped
+    };
+
+    struct EventTimeStats {
+        uint64_t accepted = 0;
+        uint64_t late_dropped = 0;          // Interval already closed by the watermark
+        uint64_t early_dropped = 0;         // Interval beyond the open ones
+        uint64_t emitted_intervals = 0;
+        uint64_t late_intervals = 0;        // Written after newer ticks (see MetricCollector::record)
+    };
+
+    // One closed interval, metrics in the order of their first record
+    struct EventTimeInterval {
+        std::chrono::system_clock::time_point start;
+        std::vector<std::unique_ptr<Metric>> metrics;   // Interval copies (see Metric::createInterval)
+    };
+
+    // Open 1 s intervals for values recorded with their event time
+    // (MetricCollector::record(handle, value, event_time)). Interval i lives
+    // in slot i % max_open_intervals of a ring and holds an interval copy of
+    // each metric recorded into it. The watermark is the clock (or the
+    // latest event time) minus the allowed lateness; intervals that end
+    // before it are closed and handed to the collector, which holds its
+    // live ticks back until the watermark has passed them and folds each
+    // closed interval into the tick of its second (see
+    // MetricCollector::record). Records for a closed interval are counted
+    // and dropped. The record path of live values does not come here.
+    class EventTimeWindows {
+    private:
+        static constexpr int64_t kFree = INT64_MIN;
+
+        struct alignas(64) Slot {
+            std::mutex mutex;
+            int64_t second = kFree;     // Interval held (seconds since the epoch)
+            std::unordered_map<const Metric*, size_t> index;
+            std::vector<std::unique_ptr<Metric>> metrics;
+        };
+
+        EventTimeOptions options_;
+        std::unique_ptr<Slot[]> slots_;
+        std::atomic<int64_t> closed_before_;    // Intervals starting before this second are closed
+
+        std::mutex closed_mutex_;
+        std::map<int64_t, EventTimeInterval> closed_;   // Waiting for the collector, by start
+
+        std::atomic<uint64_t> accepted_;
+        std::atomic<uint64_t> late_dropped_;
+        std::atomic<uint64_t> early_dropped_;
+        std::atomic<uint64_t> emitted_intervals_;
+        std::atomic<uint64_t> late_intervals_;
+
+        Slot& slotOf(int64_t second) const;
+        void advanceTo(int64_t closed_before);
+        void closeSlot(Slot& slot);     // Requires slot.mutex
+
+    public:
+        explicit EventTimeWindows(const EventTimeOptions& options = EventTimeOptions());
+
+        EventTimeWindows(const EventTimeWindows&) = delete;
+        EventTimeWindows& operator=(const EventTimeWindows&) = delete;
+
+        // Interval copy of `metric` for the interval holding event_time,
+        // created on first use. The caller records into it while `lock` is
+        // held. Null (and counted) when the interval is closed or beyond the
+        // open ones. Throws std::invalid_argument for metrics without
+        // interval copies.
+        Metric* acquire(const Metric& metric, std::chrono::system_clock::time_point event_time,
+                        std::unique_lock<std::mutex>& lock);
+
+        // Move the clock watermark (ignored with WatermarkSource::EventTime)
+        // and close the intervals it has passed. Returns the watermark the
+        // intervals were closed up to: every interval starting before it is
+        // closed, and no record for one is taken any more.
+        std::chrono::system_clock::time_point advance(std::chrono::system_clock::time_point now);
+
+        // Close every open interval (on stop)
+        void closeAll();
+
+        // Start of the oldest closed interval, if any
+        bool oldestClosed(std::chrono::system_clock::time_point& start);
+        bool popClosed(EventTimeInterval& interval);
+
+        // An interval was written after a newer tick
+        void countLateInterval();
+
+        const EventTimeOptions& options() const { return options_; }
+        EventTimeStats getStats() const;
+    };
+
+} // namespace MetricsSystem
\ No newline at end of file
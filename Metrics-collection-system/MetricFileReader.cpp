@@ -0,0 +1,401 @@
+#include "MetricFileReader.h"
+#include <algorithm>
+#include <charconv>
+#include <ctime>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace MetricsSystem {
+
+    // MappedFile Implementation
+#ifdef _WIN32
+    MappedFile::MappedFile(const std::string& path)
+        : path_(path), data_(nullptr), size_(0), file_handle_(INVALID_HANDLE_VALUE), mapping_handle_(nullptr) {
+        file_handle_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                                   OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file_handle_ == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("Failed to open metrics file: " + path);
+        }
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file_handle_, &size)) {
+            CloseHandle(file_handle_);
+            throw std::runtime_error("Failed to stat metrics file: " + path);
+        }
+        size_ = static_cast<size_t>(size.QuadPart);
+
+        if (size_ > 0) {
+            mapping_handle_ = CreateFileMappingA(file_handle_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping_handle_) {
+                data_ = static_cast<const char*>(MapViewOfFile(mapping_handle_, FILE_MAP_READ, 0, 0, 0));
+            }
+            if (!data_) {
+                if (mapping_handle_) {
+                    CloseHandle(mapping_handle_);
+                }
+                CloseHandle(file_handle_);
+                throw std::runtime_error("Failed to map metrics file: " + path);
+            }
+        }
+    }
+
+    MappedFile::~MappedFile() {
+        if (data_) {
+            UnmapViewOfFile(data_);
+        }
+        if (mapping_handle_) {
+            CloseHandle(mapping_handle_);
+        }
+        if (file_handle_ != INVALID_HANDLE_VALUE) {
+            CloseHandle(file_handle_);
+        }
+    }
+
+    void MappedFile::releaseBefore(size_t offset) const {
+        // Unmodified file-backed pages are trimmed by the working set manager
+        (void)offset;
+    }
+#else
+    MappedFile::MappedFile(const std::string& path) : path_(path), data_(nullptr), size_(0) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open metrics file: " + path);
+        }
+
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Failed to stat metrics file: " + path);
+        }
+        size_ = static_cast<size_t>(st.st_size);
+
+        if (size_ > 0) {
+            void* mapping = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("Failed to map metrics file: " + path);
+            }
+            ::madvise(mapping, size_, MADV_SEQUENTIAL);
+            data_ = static_cast<const char*>(mapping);
+        }
+
+        ::close(fd); // The mapping keeps the file referenced
+    }
+
+    MappedFile::~MappedFile() {
+        if (data_) {
+            ::munmap(const_cast<char*>(data_), size_);
+        }
+    }
+
+    void MappedFile::releaseBefore(size_t offset) const {
+        const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        offset -= offset % page;
+        if (data_ && offset > 0) {
+            ::madvise(const_cast<char*>(data_), offset, MADV_DONTNEED);
+        }
+    }
+#endif
+
+    namespace {
+
+        // Digits at these offsets, separators everywhere else
+        const char kTimestampLayout[] = "dddd-dd-dd dd:dd:dd.ddd";
+
+    } // namespace
+
+    // MetricFileCursor Implementation
+    MetricFileCursor::MetricFileCursor(const MappedFile& file, size_t end) : MetricFileCursor(file, 0, end) {}
+
+    MetricFileCursor::MetricFileCursor(const MappedFile& file, size_t begin, size_t end)
+        : file_(&file), data_(file.data()), end_(std::min(end, file.size())), pos_(std::min(begin, end_)), line_pos_(0),
+          line_end_(0), released_(pos_), malformed_lines_(0) {}
+
+    MetricFileCursor::MetricFileCursor(std::string_view data, std::vector<std::string_view> dictionary)
+        : file_(nullptr), data_(data.data()), end_(data.size()), pos_(0), line_pos_(0), line_end_(0), released_(0),
+          malformed_lines_(0), dictionary_(std::move(dictionary)) {}
+
+    bool MetricFileCursor::next() {
+        if (line_pos_ < line_end_ && nextPair()) {
+            return true;
+        }
+
+        while (nextLine()) {
+            if (nextPair()) {
+                return true;
+            }
+            ++malformed_lines_; // Timestamp without a valid pair
+        }
+        return false;
+    }
+
+    bool MetricFileCursor::nextLine() {
+        const char* data = data_;
+        const size_t size = end_;
+
+        while (pos_ < size) {
+            size_t begin = pos_;
+            size_t end = begin;
+            while (end < size && data[end] != '\n') {
+                ++end;
+            }
+            pos_ = end < size ? end + 1 : end;
+
+            if (end > begin && data[end - 1] == '\r') {
+                --end;
+            }
+            if (end == begin) {
+                continue; // Blank line
+            }
+
+            std::string_view line(data + begin, end - begin);
+            if (line[0] == '#') {
+                defineName(line);
+                continue;
+            }
+
+            uint64_t key = line.size() > MetricTimeKey::kTimestampLength
+                               ? MetricTimeKey::parse(line.substr(0, MetricTimeKey::kTimestampLength))
+                               : 0;
+            if (key == 0 || line[MetricTimeKey::kTimestampLength] != ' ') {
+                ++malformed_lines_;
+                continue;
+            }
+
+            current_.time_key = key;
+            current_.timestamp = line.substr(0, MetricTimeKey::kTimestampLength);
+            line_pos_ = begin + MetricTimeKey::kTimestampLength + 1;
+            line_end_ = end;
+            return true;
+        }
+
+        return false;
+    }
+
+    void MetricFileCursor::defineName(std::string_view line) {
+        // #def 7 "HTTP requests RPS"; other # lines are comments
+        const std::string_view prefix = "#def ";
+        if (line.compare(0, prefix.size(), prefix) != 0) {
+            return;
+        }
+
+        uint32_t id = 0;
+        auto result = std::from_chars(line.data() + prefix.size(), line.data() + line.size(), id);
+        size_t name_begin = static_cast<size_t>(result.ptr - line.data()) + 2;
+        if (result.ec != std::errc() || name_begin >= line.size() || result.ptr[0] != ' ' || result.ptr[1] != '"' ||
+            line.back() != '"' || id > kMaxDictionaryId) {
+            ++malformed_lines_;
+            return;
+        }
+
+        if (id >= dictionary_.size()) {
+            dictionary_.resize(id + 1);
+        }
+        dictionary_[id] = line.substr(name_begin, line.size() - 1 - name_begin);
+    }
+
+    bool MetricFileCursor::nextPair() {
+        // "name" value ["name" value ...], or id=value [id=value ...]
+        // after #def lines
+        const char* data = data_;
+        size_t pos = line_pos_;
+
+        while (true) {
+            while (pos < line_end_ && data[pos] == ' ') {
+                ++pos;
+            }
+            if (pos >= line_end_) {
+                line_pos_ = line_end_;
+                return false;
+            }
+
+            size_t value_begin;
+            if (data[pos] == '"') {
+                size_t name_begin = pos + 1;
+                size_t name_end = name_begin;
+                while (name_end < line_end_ && data[name_end] != '"') {
+                    ++name_end;
+                }
+                if (name_end + 1 >= line_end_ || data[name_end + 1] != ' ') {
+                    line_pos_ = line_end_;
+                    return false;
+                }
+                current_.name = std::string_view(data + name_begin, name_end - name_begin);
+                value_begin = name_end + 2;
+            } else {
+                uint32_t id = 0;
+                auto result = std::from_chars(data + pos, data + line_end_, id);
+                if (result.ec != std::errc() || result.ptr == data + line_end_ || *result.ptr != '=') {
+                    line_pos_ = line_end_;
+                    return false;
+                }
+                value_begin = static_cast<size_t>(result.ptr - data) + 1;
+                current_.name = id < dictionary_.size() ? dictionary_[id] : std::string_view();
+            }
+
+            // Quoted values (compact format) run to the closing quote
+            size_t value_end = value_begin;
+            if (value_end < line_end_ && data[value_end] == '"') {
+                for (++value_end; value_end < line_end_ && data[value_end] != '"'; ++value_end) {
+                    if (data[value_end] == '\\') {
+                        ++value_end;
+                    }
+                }
+                value_end = std::min(value_end + 1, line_end_);
+            } else {
+                while (value_end < line_end_ && data[value_end] != ' ') {
+                    ++value_end;
+                }
+            }
+            if (value_end == value_begin) {
+                line_pos_ = line_end_;
+                return false;
+            }
+            pos = value_end;
+
+            if (current_.name.empty()) {
+                continue; // Number without a definition (e.g. the file was cut)
+            }
+            current_.value = std::string_view(data + value_begin, value_end - value_begin);
+            line_pos_ = value_end;
+            return true;
+        }
+    }
+
+    void MetricFileCursor::releaseConsumed(size_t window) {
+        if (file_ && pos_ - released_ >= window) {
+            released_ = pos_;
+            file_->releaseBefore(released_);
+        }
+    }
+
+    // MetricTimeKey Implementation
+    uint64_t MetricTimeKey::parse(std::string_view timestamp) {
+        if (timestamp.size() != kTimestampLength) {
+            return 0;
+        }
+
+        uint64_t key = 0;
+        for (size_t i = 0; i < kTimestampLength; ++i) {
+            char c = timestamp[i];
+            if (kTimestampLayout[i] == 'd') {
+                if (c < '0' || c > '9') {
+                    return 0;
+                }
+                key = key * 10 + static_cast<uint64_t>(c - '0');
+            } else if (c != kTimestampLayout[i]) {
+                return 0;
+            }
+        }
+        return key;
+    }
+
+    void MetricTimeKey::format(uint64_t key, std::string& out) {
+        char text[kTimestampLength];
+        for (size_t i = kTimestampLength; i-- > 0;) {
+            if (kTimestampLayout[i] == 'd') {
+                text[i] = static_cast<char>('0' + key % 10);
+                key /= 10;
+            } else {
+                text[i] = kTimestampLayout[i];
+            }
+        }
+        out.append(text, kTimestampLength);
+    }
+
+    TimePoint MetricTimeKey::toTimePoint(uint64_t key) {
+        thread_local uint64_t cached_second = 0;
+        thread_local TimePoint cached_time;
+
+        const uint64_t second = key / 1000;
+        if (second != cached_second) {
+            std::tm tm = {};
+            uint64_t rest = second;
+            tm.tm_sec = static_cast<int>(rest % 100); rest /= 100;
+            tm.tm_min = static_cast<int>(rest % 100); rest /= 100;
+            tm.tm_hour = static_cast<int>(rest % 100); rest /= 100;
+            tm.tm_mday = static_cast<int>(rest % 100); rest /= 100;
+            tm.tm_mon = static_cast<int>(rest % 100) - 1; rest /= 100;
+            tm.tm_year = static_cast<int>(rest) - 1900;
+            tm.tm_isdst = -1; // Timestamps are written in local time
+
+            cached_time = std::chrono::system_clock::from_time_t(std::mktime(&tm));
+            cached_second = second;
+        }
+
+        return cached_time + std::chrono::milliseconds(key % 1000);
+    }
+
+    uint64_t MetricTimeKey::fromTimePoint(TimePoint time) {
+        const std::time_t seconds = std::chrono::system_clock::to_time_t(std::chrono::floor<std::chrono::seconds>(time));
+        std::tm tm = {};
+#ifdef _WIN32
+        localtime_s(&tm, &seconds);
+#else
+        localtime_r(&seconds, &tm);
+#endif
+        uint64_t key = static_cast<uint64_t>(tm.tm_year + 1900);
+        for (int part : { tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec }) {
+            key = key * 100 + static_cast<uint64_t>(part);
+        }
+        const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count() % 1000;
+        return key * 1000 + static_cast<uint64_t>(ms < 0 ? ms + 1000 : ms);
+    }
+
+    // MetricSampleReorder Implementation
+    MetricSampleReorder::MetricSampleReorder(std::chrono::milliseconds window)
+        : window_(window), newest_key_(0), release_key_(0), released_key_(0), late_samples_(0), finished_(false) {
+        if (window_.count() < 0) {
+            throw std::invalid_argument("Reorder window cannot be negative");
+        }
+    }
+
+    void MetricSampleReorder::push(const MetricSample& sample) {
+        if (sample.time_key < released_key_) {
+            // Newer samples are already out: pass it on where it is
+            late_samples_++;
+            buffer_.push_front(sample);
+            return;
+        }
+
+        if (buffer_.empty() || buffer_.back().time_key <= sample.time_key) {
+            buffer_.push_back(sample);
+        } else {
+            auto it = std::upper_bound(buffer_.begin(), buffer_.end(), sample.time_key,
+                                       [](uint64_t key, const MetricSample& held) { return key < held.time_key; });
+            buffer_.insert(it, sample);
+        }
+
+        if (sample.time_key > newest_key_) {
+            // The release point moves once per second of input
+            if (sample.time_key / 1000 != newest_key_ / 1000 || window_.count() == 0) {
+                release_key_ = window_.count() == 0
+                                   ? sample.time_key
+                                   : MetricTimeKey::fromTimePoint(MetricTimeKey::toTimePoint(sample.time_key / 1000 * 1000) - window_);
+            }
+            newest_key_ = sample.time_key;
+        }
+    }
+
+    bool MetricSampleReorder::pop(MetricSample& sample) {
+        if (buffer_.empty() || (!finished_ && buffer_.front().time_key > release_key_)) {
+            return false;
+        }
+
+        sample = buffer_.front();
+        buffer_.pop_front();
+        released_key_ = std::max(released_key_, sample.time_key);
+        return true;
+    }
+
+} // namespace MetricsSystem
\ No newline at end of file
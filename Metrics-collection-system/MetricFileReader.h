@@ -0,0 +1,150 @@
+#pragma once
+
+#include "MetricSystem.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace MetricsSystem {
+
+    // Read-only memory mapping of a metrics file (mmap / MapViewOfFile).
+    // Pages are only touched as the reader advances, so files larger than
+    // RAM can be processed in constant memory.
+    class MappedFile {
+    private:
+        std::string path_;
+        const char* data_;
+        size_t size_;
+#ifdef _WIN32
+        void* file_handle_;
+        void* mapping_handle_;
+#endif
+
+    public:
+        explicit MappedFile(const std::string& path);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const char* data() const { return data_; }
+        size_t size() const { return size_; }
+        const std::string& getPath() const { return path_; }
+
+        // Tell the OS that [0, offset) will not be read again, so resident
+        // pages do not pile up during a long sequential scan
+        void releaseBefore(size_t offset) const;
+    };
+
+    // One parsed sample. Views point into the mapped file.
+    struct MetricSample {
+        uint64_t time_key = 0;          // Packed YYYYMMDDhhmmssmmm, orders like the text
+        std::string_view timestamp;     // "2025-06-01 15:00:01.653"
+        std::string_view name;          // Without quotes
+        std::string_view value;         // As written
+    };
+
+    // Sequential parser for the writer's text formats. Accepts one
+    // `"name" value` pair per line as written by MetricWriter, several pairs
+    // sharing one timestamp, and the compact format's `#def` lines and
+    // `id=value` pairs (see CompactTextWriter). Malformed lines are skipped
+    // and counted.
+    class MetricFileCursor {
+    private:
+        static constexpr uint32_t kMaxDictionaryId = 1u << 24;
+
+        const MappedFile* file_;        // Null when reading a buffer
+        const char* data_;
+        size_t end_;                    // Bytes to read (the data part of a segment)
+        size_t pos_;                    // Start of the next unread line
+        size_t line_pos_;               // Next pair within the current line
+        size_t line_end_;
+        MetricSample current_;
+        size_t released_;
+        uint64_t malformed_lines_;
+        std::vector<std::string_view> dictionary_;     // Compact format names by number
+
+        bool nextLine();
+        bool nextPair();
+        void defineName(std::string_view line);
+
+    public:
+        // Reads [0, end) of the file, e.g. up to a segment footer
+        explicit MetricFileCursor(const MappedFile& file, size_t end = SIZE_MAX);
+
+        // Reads [begin, end); begin must be the start of a line. Compact
+        // files need the #def lines before `begin`, so they are read whole.
+        MetricFileCursor(const MappedFile& file, size_t begin, size_t end);
+
+        // Reads a buffer, e.g. a batch as it is written. `dictionary` holds
+        // compact-format names defined before it; the views must stay valid.
+        explicit MetricFileCursor(std::string_view data, std::vector<std::string_view> dictionary = {});
+
+        // Advance to the next sample; false at end of file
+        bool next();
+
+        const MetricSample& current() const { return current_; }
+        uint64_t getMalformedLines() const { return malformed_lines_; }
+
+        // Compact-format names by number, as defined so far
+        const std::vector<std::string_view>& getDictionary() const { return dictionary_; }
+
+        // Return pages behind the cursor to the OS every `window` bytes
+        void releaseConsumed(size_t window = 8 * 1024 * 1024);
+    };
+
+    // Timestamp text helpers shared by the file tools
+    class MetricTimeKey {
+    public:
+        static constexpr size_t kTimestampLength = 23;  // "YYYY-MM-DD hh:mm:ss.mmm"
+
+        // Packed key of a timestamp (0 if malformed)
+        static uint64_t parse(std::string_view timestamp);
+
+        // Append the timestamp text of a key
+        static void format(uint64_t key, std::string& out);
+
+        // Local-time key to time point (mktime is cached per second)
+        static TimePoint toTimePoint(uint64_t key);
+
+        // Time point to local-time key
+        static uint64_t fromTimePoint(TimePoint time);
+    };
+
+    // Restores timestamp order to a stream of samples in which some arrive
+    // late, e.g. event-time intervals a collector wrote after newer ticks
+    // (see EventTimeStats::late_intervals).
+    // A sample is held until the newest one pushed is `window` newer; late
+    // samples within the window are slotted in before it, later ones are
+    // passed on at once, out of order, and counted. Samples equal in time
+    // keep their order. The samples are views: the files they point into
+    // must stay mapped while they are buffered.
+    class MetricSampleReorder {
+    private:
+        std::chrono::milliseconds window_;
+        std::deque<MetricSample> buffer_;   // In time order
+        uint64_t newest_key_;
+        uint64_t release_key_;              // Samples up to this key are out of the window
+        uint64_t released_key_;             // Newest sample handed out
+        uint64_t late_samples_;
+        bool finished_;
+
+    public:
+        explicit MetricSampleReorder(std::chrono::milliseconds window);
+
+        void push(const MetricSample& sample);
+
+        // Hand out everything still held (end of input)
+        void finish() { finished_ = true; }
+
+        // Next sample that can no longer be preceded by a late one
+        bool pop(MetricSample& sample);
+
+        uint64_t getLateSamples() const { return late_samples_; }
+    };
+
+} // namespace MetricsSystem
\ No newline at end of file
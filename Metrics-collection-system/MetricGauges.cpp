@@ -0,0 +1,227 @@
+#include "MetricGauges.h"
+#include <iostream>
+#include <stdexcept>
+
+namespace MetricsSystem {
+
+    namespace {
+
+        class FunctionAffinity : public GaugeAffinity {
+        private:
+            std::function<void(std::function<void()>)> post_;
+
+        public:
+            explicit FunctionAffinity(std::function<void(std::function<void()>)> post) : post_(std::move(post)) {}
+
+            void post(std::function<void()> batch) override {
+                post_(std::move(batch));
+            }
+        };
+
+        // Failing and slow callbacks are reported on the first occurrence and
+        // then every n-th time, so a broken gauge does not flood the log
+        const uint64_t kReportInterval = 100;
+
+    } // namespace
+
+    std::shared_ptr<GaugeAffinity> makeGaugeAffinity(std::function<void(std::function<void()>)> post) {
+        if (!post) {
+            throw std::invalid_argument("Gauge affinity post function cannot be empty");
+        }
+        return std::make_shared<FunctionAffinity>(std::move(post));
+    }
+
+    // GaugeBase Implementation
+    GaugeBase::GaugeBase(const std::string& name, GaugeOptions options)
+        : name_(name), options_(std::move(options)), ticks_until_due_(0), slow_count_(0), failure_count_(0) {
+        if (options_.every_ticks == 0) {
+            throw std::invalid_argument("Gauge interval must be at least one tick: " + name);
+        }
+    }
+
+    // GaugeSampler Implementation
+    GaugeSampler::GaugeSampler()
+        : budget_(kDefaultBudget), next_inline_(0), samples_(0), failures_(0), slow_callbacks_(0),
+          skipped_(0), late_batches_(0), last_tick_us_(0) {
+    }
+
+    GaugeSampler::~GaugeSampler() {
+        stop();
+    }
+
+    void GaugeSampler::add(GaugeBase* gauge) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        gauges_.push_back(gauge);
+    }
+
+    void GaugeSampler::setBudget(std::chrono::microseconds budget) {
+        if (budget.count() <= 0) {
+            throw std::invalid_argument("Gauge tick budget must be positive");
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        budget_ = budget;
+    }
+
+    GaugeStats GaugeSampler::stats() const {
+        GaugeStats stats;
+        stats.samples = samples_.load(std::memory_order_relaxed);
+        stats.failures = failures_.load(std::memory_order_relaxed);
+        stats.slow_callbacks = slow_callbacks_.load(std::memory_order_relaxed);
+        stats.skipped = skipped_.load(std::memory_order_relaxed);
+        stats.late_batches = late_batches_.load(std::memory_order_relaxed);
+        stats.last_tick_time = std::chrono::microseconds(last_tick_us_.load(std::memory_order_relaxed));
+        return stats;
+    }
+
+    void GaugeSampler::run(GaugeBase& gauge) {
+        const auto start = std::chrono::steady_clock::now();
+
+        try {
+            gauge.sample();
+            samples_.fetch_add(1, std::memory_order_relaxed);
+        } catch (const std::exception& e) {
+            failures_.fetch_add(1, std::memory_order_relaxed);
+            if (gauge.failure_count_++ % kReportInterval == 0) {
+                std::cerr << "Gauge callback '" << gauge.getName() << "' failed: " << e.what()
+                          << " (" << gauge.failure_count_ << " failures)" << std::endl;
+            }
+        }
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        if (elapsed > gauge.options_.slow_threshold) {
+            slow_callbacks_.fetch_add(1, std::memory_order_relaxed);
+            if (gauge.slow_count_++ % kReportInterval == 0) {
+                std::cerr << "Slow gauge callback '" << gauge.getName() << "': " << elapsed.count()
+                          << " us (" << gauge.slow_count_ << " slow reads)" << std::endl;
+            }
+        }
+    }
+
+    void GaugeSampler::sampleDue() {
+        // Ticks are serialized by the collector, so only the gauge list and
+        // the budget need the lock. Callbacks run without it and may
+        // register further gauges.
+        std::vector<GaugeBase*> gauges;
+        std::chrono::microseconds budget;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (gauges_.empty()) {
+                return;
+            }
+            gauges = gauges_;
+            budget = budget_;
+        }
+
+        // Gauge callbacks are timed against real time, even when the
+        // collector runs on a virtual clock
+        const auto start = std::chrono::steady_clock::now();
+        const auto deadline = start + budget;
+
+        std::vector<GaugeBase*> inline_due;
+        std::unordered_map<GaugeAffinity*, std::vector<GaugeBase*>> affinity_due;
+        for (GaugeBase* gauge : gauges) {
+            if (gauge->ticks_until_due_ > 0) {
+                --gauge->ticks_until_due_;
+                continue;
+            }
+
+            if (gauge->options_.affinity) {
+                affinity_due[gauge->options_.affinity.get()].push_back(gauge);
+            } else {
+                inline_due.push_back(gauge);
+            }
+        }
+
+        // Post first, so affinity threads read while the collector reads the
+        // inline gauges
+        std::vector<std::shared_ptr<Batch>> posted;
+        for (auto& [affinity, due] : affinity_due) {
+            std::shared_ptr<Batch>& in_flight = in_flight_[affinity];
+            if (in_flight) {
+                std::lock_guard<std::mutex> batch_lock(in_flight->mutex);
+                if (!in_flight->done) {
+                    // Still busy with an earlier tick - those gauges stay due
+                    skipped_.fetch_add(due.size(), std::memory_order_relaxed);
+                    continue;
+                }
+            }
+
+            auto batch = std::make_shared<Batch>();
+            try {
+                affinity->post([this, batch, due]() {
+                    {
+                        // Cancelled: the sampler and the gauges may be gone
+                        std::lock_guard<std::mutex> batch_lock(batch->mutex);
+                        if (batch->cancelled) {
+                            return;
+                        }
+                        batch->running = true;
+                    }
+
+                    for (GaugeBase* gauge : due) {
+                        run(*gauge);
+                    }
+
+                    std::lock_guard<std::mutex> batch_lock(batch->mutex);
+                    batch->running = false;
+                    batch->done = true;
+                    batch->cv.notify_all();
+                });
+            } catch (const std::exception& e) {
+                failures_.fetch_add(1, std::memory_order_relaxed);
+                std::cerr << "Failed to post gauge batch: " << e.what() << std::endl;
+                in_flight.reset();
+                continue;
+            }
+
+            for (GaugeBase* gauge : due) {
+                gauge->ticks_until_due_ = gauge->options_.every_ticks - 1;
+            }
+            in_flight = batch;
+            posted.push_back(std::move(batch));
+        }
+
+        // Inline reads start where the previous tick ran out of budget, so a
+        // slow gauge cannot starve the ones registered after it
+        const size_t inline_count = inline_due.size();
+        const size_t first = inline_count > 0 ? next_inline_ % inline_count : 0;
+        next_inline_ = 0;
+        for (size_t n = 0; n < inline_count; ++n) {
+            const size_t i = (first + n) % inline_count;
+            if (n > 0 && std::chrono::steady_clock::now() >= deadline) {
+                skipped_.fetch_add(inline_count - n, std::memory_order_relaxed);
+                next_inline_ = i;
+                break;
+            }
+
+            GaugeBase* gauge = inline_due[i];
+            gauge->ticks_until_due_ = gauge->options_.every_ticks - 1;
+            run(*gauge);
+        }
+
+        for (const auto& batch : posted) {
+            std::unique_lock<std::mutex> batch_lock(batch->mutex);
+            if (!batch->cv.wait_until(batch_lock, deadline, [&batch]() { return batch->done; })) {
+                // Its values are collected by the next tick
+                late_batches_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        last_tick_us_.store(elapsed.count(), std::memory_order_relaxed);
+    }
+
+    void GaugeSampler::stop() {
+        // No tick runs any more, so in_flight_ is ours
+        std::unordered_map<GaugeAffinity*, std::shared_ptr<Batch>> in_flight;
+        in_flight.swap(in_flight_);
+
+        for (auto& [affinity, batch] : in_flight) {
+            std::unique_lock<std::mutex> batch_lock(batch->mutex);
+            batch->cancelled = true;
+            batch->cv.wait(batch_lock, [&batch]() { return !batch->running; });
+        }
+    }
+
+} // namespace MetricsSystem 
\ No newline at end of file
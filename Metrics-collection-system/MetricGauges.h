@@ -0,0 +1,209 @@
+#pragma once
+
+#include "MetricValue.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace MetricsSystem {
+
+    // Runs gauge callbacks on a thread of the application's choosing, e.g.
+    // a UI or event loop thread that owns the state a gauge reads. The
+    // collector posts all due gauges of one affinity as a single batch per
+    // tick. A batch run after its collector stopped does nothing, so the
+    // affinity may hold on to batches past the collector's lifetime.
+    class GaugeAffinity {
+    public:
+        virtual ~GaugeAffinity() = default;
+        virtual void post(std::function<void()> batch) = 0;
+    };
+
+    // Affinity backed by a posting function, e.g. an event loop's post()
+    std::shared_ptr<GaugeAffinity> makeGaugeAffinity(std::function<void(std::function<void()>)> post);
+
+    struct GaugeOptions {
+        size_t every_ticks = 1;                                 // Read on every n-th tick
+        std::chrono::microseconds slow_threshold{ 1000 };       // Reads above this are reported
+        std::shared_ptr<GaugeAffinity> affinity;                // Null: read on the collector thread
+    };
+
+    struct GaugeStats {
+        uint64_t samples = 0;           // Callbacks that returned a value
+        uint64_t failures = 0;          // Callbacks that threw
+        uint64_t slow_callbacks = 0;    // Callbacks above their slow_threshold
+        uint64_t skipped = 0;           // Due reads dropped by the tick budget or a busy affinity
+        uint64_t late_batches = 0;      // Affinity batches that missed their tick
+        std::chrono::microseconds last_tick_time{ 0 };  // Time spent sampling in the last tick
+    };
+
+    // A metric whose value is pulled from a callback once per tick instead
+    // of being recorded. Each tick emits the value read for it; a gauge that
+    // was not read (not due, skipped or late) emits nothing.
+    class GaugeBase : public Metric {
+    private:
+        std::string name_;
+        GaugeOptions options_;
+        size_t ticks_until_due_;        // Collector thread only
+        uint64_t slow_count_;           // Updated by whichever thread reads the gauge
+        uint64_t failure_count_;
+
+        friend class GaugeSampler;
+
+    protected:
+        GaugeBase(const std::string& name, GaugeOptions options);
+
+        // Invoke the callback and store its value for the next collection
+        virtual void sample() = 0;
+
+    public:
+        std::string getName() const override { return name_; }
+        bool tracksDirty() const override { return true; }
+        const GaugeOptions& options() const { return options_; }
+    };
+
+    template<Accumulable T>
+    class PullGauge : public GaugeBase {
+    private:
+        std::function<T()> read_;
+        mutable std::mutex mutex_;
+        T value_{};
+        bool fresh_ = false;    // A read is waiting for collection
+        bool valid_ = false;    // The gauge has been read at least once
+
+    protected:
+        void sample() override;
+
+    public:
+        PullGauge(const std::string& name, std::function<T()> read, GaugeOptions options = {});
+
+        // Set the value by hand, e.g. from a checkpoint or test
+        void recordValue(std::unique_ptr<MetricValue> value) override;
+        std::unique_ptr<MetricValue> getAccumulatedValue() const override;
+        std::unique_ptr<MetricValue> collectAndReset() override;
+        void reset() override;
+    };
+
+    // Reads the registered gauges of one collector at the start of each
+    // tick. Inline gauges are read on the collector thread until the tick
+    // budget is spent; gauges with an affinity are posted as one batch per
+    // affinity and waited for until the same deadline. A batch that misses
+    // it is counted as late and its values are emitted on the next tick.
+    class GaugeSampler {
+    private:
+        struct Batch {
+            std::mutex mutex;
+            std::condition_variable cv;
+            bool done = false;
+            bool running = false;       // Reading gauges on the affinity thread
+            bool cancelled = false;     // The sampler stopped; the batch must not start
+        };
+
+        std::mutex mutex_;
+        std::vector<GaugeBase*> gauges_;    // Owned by the collector registry
+        std::chrono::microseconds budget_;
+        size_t next_inline_;                // Where the next tick starts reading
+        std::unordered_map<GaugeAffinity*, std::shared_ptr<Batch>> in_flight_;
+
+        std::atomic<uint64_t> samples_;
+        std::atomic<uint64_t> failures_;
+        std::atomic<uint64_t> slow_callbacks_;
+        std::atomic<uint64_t> skipped_;
+        std::atomic<uint64_t> late_batches_;
+        std::atomic<int64_t> last_tick_us_;
+
+        void run(GaugeBase& gauge);
+
+    public:
+        static constexpr std::chrono::microseconds kDefaultBudget{ 10000 };
+
+        GaugeSampler();
+        ~GaugeSampler();
+
+        void add(GaugeBase* gauge);
+        void setBudget(std::chrono::microseconds budget);
+        GaugeStats stats() const;
+
+        // Read all gauges due this tick. Called by the collector before it
+        // takes the registry lock, so callbacks may use the metric system:
+        // record, register metrics, attach or stop other collectors of the
+        // same runtime. Stopping their own collector would wait for the
+        // tick they run in.
+        void sampleDue();
+
+        // Cancel batches still queued on an affinity and wait for those
+        // already reading, so neither the sampler nor its gauges are used
+        // afterwards. Called by the collector once its ticks have stopped.
+        void stop();
+    };
+
+    // PullGauge template implementations
+    template<Accumulable T>
+    PullGauge<T>::PullGauge(const std::string& name, std::function<T()> read, GaugeOptions options)
+        : GaugeBase(name, std::move(options)), read_(std::move(read)) {
+        if (!read_) {
+            throw std::invalid_argument("Gauge callback cannot be empty: " + name);
+        }
+    }
+
+    template<Accumulable T>
+    void PullGauge<T>::sample() {
+        T value = read_();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            value_ = value;
+            fresh_ = true;
+            valid_ = true;
+        }
+        markDirty();
+    }
+
+    template<Accumulable T>
+    void PullGauge<T>::recordValue(std::unique_ptr<MetricValue> value) {
+        auto* typed_value = dynamic_cast<TypedMetricValue<T>*>(value.get());
+        if (!typed_value) {
+            throw std::invalid_argument("Invalid metric value type for metric: " + getName());
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            value_ = static_cast<T>(typed_value->getValue());
+            fresh_ = true;
+            valid_ = true;
+        }
+        markDirty();
+    }
+
+    template<Accumulable T>
+    std::unique_ptr<MetricValue> PullGauge<T>::getAccumulatedValue() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!valid_) {
+            return nullptr;
+        }
+        return std::make_unique<TypedMetricValue<T>>(value_, TickMerge::Last);
+    }
+
+    template<Accumulable T>
+    std::unique_ptr<MetricValue> PullGauge<T>::collectAndReset() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!fresh_) {
+            return nullptr;
+        }
+        fresh_ = false;
+        return std::make_unique<TypedMetricValue<T>>(value_, TickMerge::Last);
+    }
+
+    template<Accumulable T>
+    void PullGauge<T>::reset() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fresh_ = false;
+    }
+
+} // namespace MetricsSystem
\ No newline at end of file
@@ -0,0 +1,408 @@
+#include "MetricHttp.h"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "Ws2_32.lib")
+#endif
+#else
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace MetricsSystem {
+
+    namespace {
+
+#ifdef _WIN32
+        using NativeSocket = SOCKET;
+
+        int lastError() { return WSAGetLastError(); }
+        bool interrupted(int) { return false; }
+        bool inProgress(int error) { return error == WSAEWOULDBLOCK; }
+        void closeNative(NativeSocket s) { closesocket(s); }
+
+        std::string errorText(int error) {
+            char text[256] = {};
+            FormatMessageA(FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS, nullptr,
+                           static_cast<DWORD>(error), 0, text, sizeof(text), nullptr);
+            return text[0] ? text : "error " + std::to_string(error);
+        }
+
+        void ensureStarted() {
+            static std::once_flag once;
+            std::call_once(once, []() {
+                WSADATA data;
+                if (WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+                    throw std::runtime_error("Failed to start Winsock");
+                }
+            });
+        }
+
+        void setBlocking(NativeSocket s, bool blocking) {
+            u_long mode = blocking ? 0 : 1;
+            ioctlsocket(s, FIONBIO, &mode);
+        }
+
+        void setTimeouts(NativeSocket s, std::chrono::milliseconds timeout) {
+            DWORD ms = static_cast<DWORD>(timeout.count());
+            setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&ms), sizeof(ms));
+            setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&ms), sizeof(ms));
+        }
+
+        bool waitWritable(NativeSocket s, std::chrono::milliseconds timeout) {
+            fd_set writable;
+            FD_ZERO(&writable);
+            FD_SET(s, &writable);
+            timeval tv{ static_cast<long>(timeout.count() / 1000), static_cast<long>(timeout.count() % 1000 * 1000) };
+            return select(0, nullptr, &writable, nullptr, &tv) > 0;
+        }
+#else
+        using NativeSocket = int;
+
+        int lastError() { return errno; }
+        bool interrupted(int error) { return error == EINTR; }
+        bool inProgress(int error) { return error == EINPROGRESS; }
+        void closeNative(NativeSocket s) { ::close(s); }
+        std::string errorText(int error) { return std::strerror(error); }
+        void ensureStarted() {}
+
+        void setBlocking(NativeSocket s, bool blocking) {
+            int flags = fcntl(s, F_GETFL, 0);
+            fcntl(s, F_SETFL, blocking ? flags & ~O_NONBLOCK : flags | O_NONBLOCK);
+        }
+
+        void setTimeouts(NativeSocket s, std::chrono::milliseconds timeout) {
+            timeval tv{ static_cast<time_t>(timeout.count() / 1000), static_cast<suseconds_t>(timeout.count() % 1000 * 1000) };
+            setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+            setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        }
+
+        bool waitWritable(NativeSocket s, std::chrono::milliseconds timeout) {
+            pollfd pfd{ s, POLLOUT, 0 };
+            int rc;
+            do {
+                rc = poll(&pfd, 1, static_cast<int>(timeout.count()));
+            } while (rc < 0 && errno == EINTR);
+            return rc > 0;
+        }
+#endif
+
+        NativeSocket native(std::intptr_t handle) {
+            return static_cast<NativeSocket>(handle);
+        }
+
+        bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+            if (a.size() != b.size()) {
+                return false;
+            }
+            for (size_t i = 0; i < a.size(); ++i) {
+                char x = a[i] >= 'A' && a[i] <= 'Z' ? static_cast<char>(a[i] - 'A' + 'a') : a[i];
+                char y = b[i] >= 'A' && b[i] <= 'Z' ? static_cast<char>(b[i] - 'A' + 'a') : b[i];
+                if (x != y) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        std::string_view trim(std::string_view text) {
+            while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+                text.remove_prefix(1);
+            }
+            while (!text.empty() && (text.back() == ' ' || text.back() == '\t' || text.back() == '\r')) {
+                text.remove_suffix(1);
+            }
+            return text;
+        }
+
+        // Read more bytes into `buffer`; false once the peer has closed
+        bool fill(TcpSocket& socket, std::string& buffer) {
+            char chunk[16384];
+            size_t received = socket.receive(chunk, sizeof(chunk));
+            buffer.append(chunk, received);
+            return received > 0;
+        }
+
+        // Take the next CRLF-terminated line from `buffer` (reading as needed)
+        std::string takeLine(TcpSocket& socket, std::string& buffer) {
+            size_t end;
+            while ((end = buffer.find("\r\n")) == std::string::npos) {
+                if (buffer.size() > 64 * 1024) {
+                    throw std::runtime_error("HTTP line too long");
+                }
+                if (!fill(socket, buffer)) {
+                    throw std::runtime_error("Connection closed inside an HTTP message");
+                }
+            }
+            std::string line = buffer.substr(0, end);
+            buffer.erase(0, end + 2);
+            return line;
+        }
+
+        void takeBytes(TcpSocket& socket, std::string& buffer, size_t count, std::string& out) {
+            while (buffer.size() < count) {
+                if (!fill(socket, buffer)) {
+                    throw std::runtime_error("Connection closed inside an HTTP body");
+                }
+            }
+            out.append(buffer, 0, count);
+            buffer.erase(0, count);
+        }
+
+    } // namespace
+
+    // TcpSocket Implementation
+    TcpSocket::~TcpSocket() {
+        close();
+    }
+
+    TcpSocket::TcpSocket(TcpSocket&& other) noexcept : handle_(other.handle_) {
+        other.handle_ = -1;
+    }
+
+    TcpSocket& TcpSocket::operator=(TcpSocket&& other) noexcept {
+        if (this != &other) {
+            close();
+            handle_ = other.handle_;
+            other.handle_ = -1;
+        }
+        return *this;
+    }
+
+    void TcpSocket::close() {
+        if (handle_ != -1) {
+            closeNative(native(handle_));
+            handle_ = -1;
+        }
+    }
+
+    TcpSocket TcpSocket::connect(const std::string& host, uint16_t port, std::chrono::milliseconds timeout) {
+        ensureStarted();
+
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* addresses = nullptr;
+        std::string service = std::to_string(port);
+        int rc = getaddrinfo(host.c_str(), service.c_str(), &hints, &addresses);
+        if (rc != 0) {
+            throw std::runtime_error("Failed to resolve " + host + ": " + gai_strerror(rc));
+        }
+
+        // Try each address in turn, each within the full timeout
+        std::string error = "no address";
+        for (addrinfo* address = addresses; address; address = address->ai_next) {
+            NativeSocket s = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+            if (s == static_cast<NativeSocket>(-1)) {
+                error = errorText(lastError());
+                continue;
+            }
+
+            setBlocking(s, false);
+            bool connected = ::connect(s, address->ai_addr, static_cast<int>(address->ai_addrlen)) == 0;
+            if (!connected && inProgress(lastError()) && waitWritable(s, timeout)) {
+                int so_error = 0;
+                socklen_t length = sizeof(so_error);
+                getsockopt(s, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&so_error), &length);
+                connected = so_error == 0;
+                error = connected ? error : errorText(so_error);
+            } else if (!connected) {
+                int last = lastError();
+                error = inProgress(last) ? "connection timed out" : errorText(last);
+            }
+
+            if (!connected) {
+                closeNative(s);
+                continue;
+            }
+
+            setBlocking(s, true);
+            setTimeouts(s, timeout);
+            int one = 1;
+            setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&one), sizeof(one));
+            freeaddrinfo(addresses);
+            return TcpSocket(static_cast<std::intptr_t>(s));
+        }
+
+        freeaddrinfo(addresses);
+        throw std::runtime_error("Failed to connect to " + host + ":" + service + ": " + error);
+    }
+
+    TcpSocket TcpSocket::listen(uint16_t port, bool loopback_only) {
+        ensureStarted();
+
+        NativeSocket s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (s == static_cast<NativeSocket>(-1)) {
+            throw std::runtime_error("Failed to create socket: " + errorText(lastError()));
+        }
+        TcpSocket listener(static_cast<std::intptr_t>(s));
+
+        int one = 1;
+        setsockopt(s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&one), sizeof(one));
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(loopback_only ? INADDR_LOOPBACK : INADDR_ANY);
+        if (bind(s, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || ::listen(s, 16) != 0) {
+            throw std::runtime_error("Failed to listen on port " + std::to_string(port) + ": " + errorText(lastError()));
+        }
+        return listener;
+    }
+
+    TcpSocket TcpSocket::accept() {
+        while (true) {
+            NativeSocket s = ::accept(native(handle_), nullptr, nullptr);
+            if (s != static_cast<NativeSocket>(-1)) {
+                return TcpSocket(static_cast<std::intptr_t>(s));
+            }
+            int error = lastError();
+            if (!interrupted(error)) {
+                throw std::runtime_error("Failed to accept connection: " + errorText(error));
+            }
+        }
+    }
+
+    uint16_t TcpSocket::localPort() const {
+        sockaddr_in address{};
+        socklen_t length = sizeof(address);
+        if (getsockname(native(handle_), reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+            return 0;
+        }
+        return ntohs(address.sin_port);
+    }
+
+    void TcpSocket::sendAll(std::string_view data) {
+#ifdef MSG_NOSIGNAL
+        const int flags = MSG_NOSIGNAL;    // A closed peer is an error, not SIGPIPE
+#else
+        const int flags = 0;
+#endif
+        while (!data.empty()) {
+            int chunk = static_cast<int>(std::min<size_t>(data.size(), 1 << 30));
+            auto sent = send(native(handle_), data.data(), chunk, flags);
+            if (sent < 0) {
+                int error = lastError();
+                if (interrupted(error)) {
+                    continue;
+                }
+                throw std::runtime_error("Failed to send: " + errorText(error));
+            }
+            data.remove_prefix(static_cast<size_t>(sent));
+        }
+    }
+
+    size_t TcpSocket::receive(char* buffer, size_t size) {
+        while (true) {
+            int chunk = static_cast<int>(std::min<size_t>(size, 1 << 30));
+            auto received = recv(native(handle_), buffer, chunk, 0);
+            if (received >= 0) {
+                return static_cast<size_t>(received);
+            }
+            int error = lastError();
+            if (!interrupted(error)) {
+                throw std::runtime_error("Failed to receive: " + errorText(error));
+            }
+        }
+    }
+
+    // HttpMessage Implementation
+    std::string_view HttpMessage::header(std::string_view name) const {
+        for (const auto& [key, value] : headers) {
+            if (equalsIgnoreCase(key, name)) {
+                return value;
+            }
+        }
+        return {};
+    }
+
+    int HttpMessage::status() const {
+        // HTTP/1.1 204 No Content
+        if (start_line.compare(0, 5, "HTTP/") != 0) {
+            return 0;
+        }
+        size_t space = start_line.find(' ');
+        int code = 0;
+        if (space == std::string::npos ||
+            std::from_chars(start_line.data() + space + 1, start_line.data() + start_line.size(), code).ec != std::errc()) {
+            return 0;
+        }
+        return code;
+    }
+
+    bool readHttpMessage(TcpSocket& socket, std::string& buffer, HttpMessage& message, size_t max_body) {
+        message.start_line.clear();
+        message.headers.clear();
+        message.body.clear();
+
+        if (buffer.empty() && !fill(socket, buffer)) {
+            return false;
+        }
+
+        message.start_line = takeLine(socket, buffer);
+        for (std::string line = takeLine(socket, buffer); !line.empty(); line = takeLine(socket, buffer)) {
+            size_t colon = line.find(':');
+            if (colon == std::string::npos) {
+                throw std::runtime_error("Malformed HTTP header: " + line);
+            }
+            message.headers.emplace_back(std::string(trim(std::string_view(line).substr(0, colon))),
+                                         std::string(trim(std::string_view(line).substr(colon + 1))));
+        }
+
+        std::string_view length_header = message.header("Content-Length");
+        if (equalsIgnoreCase(message.header("Transfer-Encoding"), "chunked")) {
+            while (true) {
+                std::string size_line = takeLine(socket, buffer);
+                size_t size = 0;
+                auto result = std::from_chars(size_line.data(), size_line.data() + size_line.size(), size, 16);
+                if (result.ec != std::errc() || message.body.size() + size > max_body) {
+                    throw std::runtime_error("Bad HTTP chunk size: " + size_line);
+                }
+                if (size == 0) {
+                    // Trailers end with an empty line
+                    while (!takeLine(socket, buffer).empty()) {
+                    }
+                    break;
+                }
+                takeBytes(socket, buffer, size, message.body);
+                takeLine(socket, buffer);
+            }
+        } else if (!length_header.empty()) {
+            size_t length = 0;
+            auto result = std::from_chars(length_header.data(), length_header.data() + length_header.size(), length);
+            if (result.ec != std::errc() || length > max_body) {
+                throw std::runtime_error("Bad HTTP Content-Length: " + std::string(length_header));
+            }
+            takeBytes(socket, buffer, length, message.body);
+        } else {
+            // Requests without a length have no body, and neither do these responses
+            int status = message.status();
+            if (status != 0 && status >= 200 && status != 204 && status != 304) {
+                while (fill(socket, buffer)) {
+                    if (buffer.size() > max_body) {
+                        throw std::runtime_error("HTTP body too large");
+                    }
+                }
+                message.body.swap(buffer);
+                buffer.clear();
+            }
+        }
+        return true;
+    }
+
+} // namespace MetricsSystem 
\ No newline at end of file
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace MetricsSystem {
+
+    // Blocking TCP socket (BSD sockets / Winsock) for the network sinks and
+    // their stand-in tools. Errors are thrown as std::runtime_error.
+    class TcpSocket {
+    private:
+        std::intptr_t handle_;      // -1 when closed
+
+        explicit TcpSocket(std::intptr_t handle) : handle_(handle) {}
+
+    public:
+        TcpSocket() : handle_(-1) {}
+        ~TcpSocket();
+
+        TcpSocket(TcpSocket&& other) noexcept;
+        TcpSocket& operator=(TcpSocket&& other) noexcept;
+        TcpSocket(const TcpSocket&) = delete;
+        TcpSocket& operator=(const TcpSocket&) = delete;
+
+        // Connect within `timeout`; sends and receives then time out after
+        // the same interval
+        static TcpSocket connect(const std::string& host, uint16_t port, std::chrono::milliseconds timeout);
+
+        // Listening socket; port 0 picks a free port (see localPort())
+        static TcpSocket listen(uint16_t port, bool loopback_only = true);
+        TcpSocket accept();
+        uint16_t localPort() const;
+
+        void sendAll(std::string_view data);
+
+        // Read what is available, at most `size` bytes. Returns 0 once the
+        // peer has closed the connection.
+        size_t receive(char* buffer, size_t size);
+
+        bool isOpen() const { return handle_ != -1; }
+        void close();
+    };
+
+    // An HTTP/1.1 request or response, as far as the sinks need it
+    struct HttpMessage {
+        std::string start_line;     // "POST /path HTTP/1.1" or "HTTP/1.1 204 No Content"
+        std::vector<std::pair<std::string, std::string>> headers;
+        std::string body;
+
+        // Value of the first header called `name` (any case), empty if none
+        std::string_view header(std::string_view name) const;
+
+        // Status code of a response, 0 if the start line is not one
+        int status() const;
+    };
+
+    // Read one HTTP/1.1 message from `socket`. `buffer` carries bytes read
+    // past the end of the previous message on a keep-alive connection.
+    // Bodies are read by Content-Length or chunked encoding; a response
+    // with neither is read until the peer closes. Returns false if the peer
+    // closed the connection before the message started.
+    bool readHttpMessage(TcpSocket& socket, std::string& buffer, HttpMessage& message,
+                         size_t max_body = 64 * 1024 * 1024);
+
+} // namespace MetricsSystem
\ No newline at end of file
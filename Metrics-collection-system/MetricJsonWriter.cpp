@@ -0,0 +1,128 @@
+#include "MetricJsonWriter.h"
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <iostream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define METRICS_HAS_SSE2 1
+#endif
+
+namespace MetricsSystem {
+
+    namespace {
+
+        bool needsEscape(unsigned char c) {
+            return c < 0x20 || c == '"' || c == '\\';
+        }
+
+        // Offset of the first character of `text` that needs escaping
+        // (text.size() if none)
+        size_t findEscape(std::string_view text) {
+            const char* data = text.data();
+            const size_t size = text.size();
+            size_t i = 0;
+
+#ifdef METRICS_HAS_SSE2
+            const __m128i quote = _mm_set1_epi8('"');
+            const __m128i backslash = _mm_set1_epi8('\\');
+            const __m128i control = _mm_set1_epi8(0x1F);
+            for (; i + 16 <= size; i += 16) {
+                __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+                // min(c, 0x1F) == c exactly for the control characters
+                __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chars, quote), _mm_cmpeq_epi8(chars, backslash)),
+                                               _mm_cmpeq_epi8(_mm_min_epu8(chars, control), chars));
+                unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(special));
+                if (mask != 0) {
+                    return i + static_cast<size_t>(std::countr_zero(mask));
+                }
+            }
+#endif
+
+            for (; i < size; ++i) {
+                if (needsEscape(static_cast<unsigned char>(data[i]))) {
+                    return i;
+                }
+            }
+            return size;
+        }
+
+        void appendEscaped(std::string& out, unsigned char c) {
+            switch (c) {
+                case '"':  out.append("\\\""); break;
+                case '\\': out.append("\\\\"); break;
+                case '\n': out.append("\\n"); break;
+                case '\r': out.append("\\r"); break;
+                case '\t': out.append("\\t"); break;
+                case '\b': out.append("\\b"); break;
+                case '\f': out.append("\\f"); break;
+                default: {
+                    static const char kHex[] = "0123456789abcdef";
+                    const char escaped[] = { '\\', 'u', '0', '0', kHex[c >> 4], kHex[c & 0xF] };
+                    out.append(escaped, sizeof(escaped));
+                    break;
+                }
+            }
+        }
+
+    } // namespace
+
+    void JsonLinesWriter::appendString(std::string& out, std::string_view text) {
+        out.push_back('"');
+        while (!text.empty()) {
+            size_t clean = findEscape(text);
+            out.append(text.data(), clean);
+            if (clean == text.size()) {
+                break;
+            }
+            appendEscaped(out, static_cast<unsigned char>(text[clean]));
+            text.remove_prefix(clean + 1);
+        }
+        out.push_back('"');
+    }
+
+    void JsonLinesWriter::formatEntries(const MetricEntry* first, const MetricEntry* last, std::string& out) const {
+        for (const MetricEntry* entry = first; entry != last; ++entry) {
+            const size_t start = out.size();
+            try {
+                out.push_back(',');
+                appendString(out, entry->name);
+                out.push_back(':');
+
+                if (!entry->value->appendNumber(out)) {
+                    if (entry->value->asDouble()) {
+                        out.append("null"); // NaN or infinity
+                    } else {
+                        appendString(out, entry->value->toString());
+                    }
+                }
+
+            } catch (const std::exception& e) {
+                // Drop the partial member so the object stays valid
+                out.resize(start);
+                std::cerr << "Error formatting metric entry '" << entry->name << "': " << e.what() << std::endl;
+            }
+        }
+    }
+
+    void JsonLinesWriter::finishTick(TimePoint timestamp, const std::vector<MetricEntry>& /*entries*/,
+                                     std::vector<std::string>& chunks) const {
+        auto first = std::find_if(chunks.begin(), chunks.end(), [](const std::string& chunk) { return !chunk.empty(); });
+        if (first == chunks.end()) {
+            return;
+        }
+        first->erase(0, 1);
+
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(timestamp.time_since_epoch()).count();
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof(digits), ms);
+
+        std::string head = "{\"ts\":";
+        head.append(digits, result.ptr);
+        head.append(",\"metrics\":{");
+        chunks.insert(chunks.begin(), std::move(head));
+        chunks.back().append("}}\n");
+    }
+
+} // namespace MetricsSystem 
\ No newline at end of file
@@ -0,0 +1,448 @@
+#include "MetricMerge.h"
+#include "MetricFileReader.h"
+#include "MetricCheckpoint.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+
+namespace MetricsSystem {
+
+    namespace {
+
+        const char kMergeMagic[4] = { 'M', 'M', 'R', 'G' };
+        const uint32_t kMergeVersion = 1;
+        const size_t kOutputBufferBytes = 1 << 20;
+
+        // A sample value in the type fixed for its name
+        struct MergeValue {
+            bool floating = false;
+            int64_t integer = 0;
+            double real = 0.0;
+        };
+
+        // The whole value text must parse, so "1.50" is not read as 1
+        template<typename V>
+        bool parseWhole(std::string_view text, V& value) {
+            const char* last = text.data() + text.size();
+            auto result = std::from_chars(text.data(), last, value);
+            return result.ec == std::errc() && result.ptr == last;
+        }
+
+        bool parseValue(std::string_view text, bool floating, MergeValue& value) {
+            value.floating = floating;
+            return floating ? parseWhole(text, value.real) : parseWhole(text, value.integer);
+        }
+
+        // Merge kind and value type per name, fixed by the first sample of
+        // the name: integer if its value is a whole integer, floating point
+        // otherwise. Means are always floating point.
+        class NameKinds {
+        public:
+            struct Entry {
+                MergeKind kind = MergeKind::Sum;
+                bool floating = false;
+            };
+
+        private:
+            const MergeOptions& options_;
+            std::unordered_map<std::string, Entry> entries_;
+
+        public:
+            explicit NameKinds(const MergeOptions& options) : options_(options) {}
+
+            const Entry& lookup(const MetricSample& sample) {
+                std::string name(sample.name);
+                auto it = entries_.find(name);
+                if (it != entries_.end()) {
+                    return it->second;
+                }
+
+                Entry entry;
+                auto listed = options_.kinds.find(name);
+                entry.kind = listed != options_.kinds.end() ? listed->second : options_.default_kind;
+                int64_t integer = 0;
+                entry.floating = entry.kind == MergeKind::Mean || !parseWhole(sample.value, integer);
+                return entries_.emplace(std::move(name), entry).first->second;
+            }
+        };
+
+        // Loser tree over the input cursors. Internal node n holds the loser
+        // of the match below it, node 0 the overall winner; replacing the
+        // winner costs log2(k) comparisons.
+        class LoserTree {
+        private:
+            std::vector<MetricFileCursor*> cursors_;
+            std::vector<bool> exhausted_;
+            std::vector<size_t> tree_;
+
+            bool less(size_t a, size_t b) const {
+                if (exhausted_[a] != exhausted_[b]) {
+                    return exhausted_[b];
+                }
+                if (exhausted_[a]) {
+                    return a < b;
+                }
+                uint64_t key_a = cursors_[a]->current().time_key;
+                uint64_t key_b = cursors_[b]->current().time_key;
+                return key_a < key_b || (key_a == key_b && a < b);
+            }
+
+            size_t build(size_t node) {
+                const size_t k = cursors_.size();
+                if (node >= k) {
+                    return node - k; // Leaf
+                }
+                size_t left = build(2 * node);
+                size_t right = build(2 * node + 1);
+                if (less(left, right)) {
+                    tree_[node] = right;
+                    return left;
+                }
+                tree_[node] = left;
+                return right;
+            }
+
+        public:
+            explicit LoserTree(std::vector<MetricFileCursor*> cursors)
+                : cursors_(std::move(cursors)), exhausted_(cursors_.size()), tree_(cursors_.size()) {
+                for (size_t i = 0; i < cursors_.size(); ++i) {
+                    exhausted_[i] = !cursors_[i]->next();
+                }
+                tree_[0] = build(1);
+            }
+
+            // Null once every input is exhausted
+            MetricFileCursor* top() const {
+                return exhausted_[tree_[0]] ? nullptr : cursors_[tree_[0]];
+            }
+
+            void advance() {
+                size_t winner = tree_[0];
+                exhausted_[winner] = !cursors_[winner]->next();
+                cursors_[winner]->releaseConsumed();
+
+                for (size_t node = (winner + cursors_.size()) / 2; node > 0; node /= 2) {
+                    if (less(tree_[node], winner)) {
+                        std::swap(tree_[node], winner);
+                    }
+                }
+                tree_[0] = winner;
+            }
+        };
+
+        // Buffered text or binary output
+        class MergeOutput {
+        private:
+            std::ofstream file_;
+            std::string path_;
+            std::string buffer_;
+            MergeOutputFormat format_;
+            std::unordered_map<std::string, uint32_t> name_ids_;
+
+            void flushIfFull() {
+                if (buffer_.size() >= kOutputBufferBytes) {
+                    flush();
+                }
+            }
+
+            uint32_t nameId(std::string_view name) {
+                auto it = name_ids_.find(std::string(name));
+                if (it != name_ids_.end()) {
+                    return it->second;
+                }
+
+                uint32_t id = static_cast<uint32_t>(name_ids_.size());
+                name_ids_.emplace(std::string(name), id);
+
+                CheckpointWriter out(buffer_);
+                out.put('N');
+                out.put(id);
+                out.put(static_cast<uint16_t>(name.size()));
+                buffer_.append(name.data(), name.size());
+                return id;
+            }
+
+        public:
+            MergeOutput(const std::string& path, MergeOutputFormat format) : path_(path), format_(format) {
+                file_.open(path, std::ios::out | std::ios::trunc | std::ios::binary);
+                if (!file_.is_open()) {
+                    throw std::runtime_error("Failed to open merge output: " + path);
+                }
+
+                buffer_.reserve(kOutputBufferBytes + 4096);
+                if (format_ == MergeOutputFormat::Binary) {
+                    buffer_.append(kMergeMagic, sizeof(kMergeMagic));
+                    CheckpointWriter(buffer_).put(kMergeVersion);
+                }
+            }
+
+            bool binary() const { return format_ == MergeOutputFormat::Binary; }
+
+            // Sample passed through with its original value text
+            void write(const MetricSample& sample) {
+                buffer_.append(sample.timestamp.data(), sample.timestamp.size());
+                buffer_.append(" \"");
+                buffer_.append(sample.name.data(), sample.name.size());
+                buffer_.append("\" ");
+                buffer_.append(sample.value.data(), sample.value.size());
+                buffer_.push_back('\n');
+                flushIfFull();
+            }
+
+            // Sample passed through with its parsed value
+            void write(const MetricSample& sample, const MergeValue& value) {
+                if (format_ == MergeOutputFormat::Text) {
+                    write(sample);
+                } else if (value.floating) {
+                    write(sample.time_key, sample.timestamp, sample.name, value.real);
+                } else {
+                    write(sample.time_key, sample.timestamp, sample.name, value.integer);
+                }
+            }
+
+            // Aggregated sample
+            template<typename V>
+            void write(uint64_t time_key, std::string_view timestamp, std::string_view name, V value) {
+                if (format_ == MergeOutputFormat::Text) {
+                    char value_text[64];
+                    if constexpr (std::is_floating_point_v<V>) {
+                        std::snprintf(value_text, sizeof(value_text), "%.2f", value);
+                    } else {
+                        std::snprintf(value_text, sizeof(value_text), "%lld", static_cast<long long>(value));
+                    }
+
+                    buffer_.append(timestamp.data(), timestamp.size());
+                    buffer_.append(" \"");
+                    buffer_.append(name.data(), name.size());
+                    buffer_.append("\" ");
+                    buffer_.append(value_text);
+                    buffer_.push_back('\n');
+                } else {
+                    writeBinary(time_key, name, value);
+                }
+                flushIfFull();
+            }
+
+            template<typename V>
+            void writeBinary(uint64_t time_key, std::string_view name, V value) {
+                uint32_t id = nameId(name);
+                int64_t epoch_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    MetricTimeKey::toTimePoint(time_key).time_since_epoch()).count();
+
+                CheckpointWriter out(buffer_);
+                out.put('S');
+                out.put(epoch_ms);
+                out.put(id);
+                out.put(static_cast<uint8_t>(std::is_floating_point_v<V> ? 1 : 0));
+                out.put(value);
+            }
+
+            void flush() {
+                file_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+                buffer_.clear();
+                if (file_.fail()) {
+                    throw std::runtime_error("Failed to write merge output: " + path_);
+                }
+            }
+
+            void close() {
+                flush();
+                file_.close();
+                if (file_.fail()) {
+                    throw std::runtime_error("Failed to close merge output: " + path_);
+                }
+            }
+        };
+
+        // Same-name samples of the current bucket, in first-seen order.
+        // Bounded by the number of distinct metrics per bucket.
+        class TickAggregator {
+        private:
+            struct Slot {
+                std::string name;
+                MergeKind kind = MergeKind::Sum;
+                MergeValue value;
+                uint64_t count = 0;
+            };
+
+            std::chrono::milliseconds width_;
+            uint64_t start_key_ = 0;
+            uint64_t end_key_ = 0;      // First key of the next bucket
+            std::string timestamp_;
+            std::vector<Slot> slots_;
+            std::unordered_map<std::string, size_t> index_;
+
+            static void combine(Slot& slot, const MergeValue& value) {
+                if (slot.count == 0 || slot.kind == MergeKind::Last) {
+                    slot.value = value;
+                    return;
+                }
+
+                switch (slot.kind) {
+                    case MergeKind::Sum:
+                    case MergeKind::Mean:
+                        slot.value.integer += value.integer;
+                        slot.value.real += value.real;
+                        break;
+                    case MergeKind::Max:
+                        slot.value.integer = std::max(slot.value.integer, value.integer);
+                        slot.value.real = std::max(slot.value.real, value.real);
+                        break;
+                    case MergeKind::Last:
+                        break;
+                }
+            }
+
+        public:
+            explicit TickAggregator(std::chrono::milliseconds width) : width_(width) {}
+
+            bool empty() const { return slots_.empty(); }
+
+            // Keys of a bucket are contiguous, as keys order like time
+            bool contains(uint64_t time_key) const { return time_key >= start_key_ && time_key < end_key_; }
+
+            void add(const MetricSample& sample, MergeKind kind, const MergeValue& value) {
+                if (slots_.empty()) {
+                    // Stamped with the start of the bucket
+                    if (width_.count() == 0) {
+                        start_key_ = sample.time_key;
+                        end_key_ = sample.time_key + 1;
+                    } else {
+                        const auto since_epoch = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            MetricTimeKey::toTimePoint(sample.time_key).time_since_epoch());
+                        const TimePoint start(since_epoch / width_ * width_);
+                        start_key_ = MetricTimeKey::fromTimePoint(start);
+                        end_key_ = MetricTimeKey::fromTimePoint(start + width_);
+                    }
+                    timestamp_.clear();
+                    MetricTimeKey::format(start_key_, timestamp_);
+                }
+
+                std::string name(sample.name);
+                auto it = index_.find(name);
+                if (it == index_.end()) {
+                    it = index_.emplace(name, slots_.size()).first;
+                    slots_.emplace_back();
+                    slots_.back().name = std::move(name);
+                    slots_.back().kind = kind;
+                }
+
+                Slot& slot = slots_[it->second];
+                combine(slot, value);
+                slot.count++;
+            }
+
+            size_t flushTo(MergeOutput& output) {
+                size_t written = slots_.size();
+                for (const Slot& slot : slots_) {
+                    if (slot.kind == MergeKind::Mean) {
+                        output.write(start_key_, timestamp_, slot.name, slot.value.real / static_cast<double>(slot.count));
+                    } else if (slot.value.floating) {
+                        output.write(start_key_, timestamp_, slot.name, slot.value.real);
+                    } else {
+                        output.write(start_key_, timestamp_, slot.name, slot.value.integer);
+                    }
+                }
+                slots_.clear();
+                index_.clear();
+                return written;
+            }
+        };
+
+    } // namespace
+
+    // MetricMerger Implementation
+    MetricMerger::MetricMerger(MergeOptions options) : options_(std::move(options)) {
+        if (options_.bucket.count() < 0) {
+            throw std::invalid_argument("Merge bucket width cannot be negative");
+        }
+    }
+
+    void MetricMerger::addInput(const std::string& path) {
+        if (path.empty()) {
+            throw std::invalid_argument("Input path cannot be empty");
+        }
+        inputs_.push_back(path);
+    }
+
+    MergeStats MetricMerger::merge(const std::string& output_path) {
+        if (inputs_.empty()) {
+            throw std::logic_error("No merge inputs");
+        }
+
+        std::vector<std::unique_ptr<MappedFile>> files;
+        std::vector<std::unique_ptr<MetricFileCursor>> cursors;
+        std::vector<MetricFileCursor*> cursor_ptrs;
+        for (const auto& input : inputs_) {
+            files.push_back(std::make_unique<MappedFile>(input));
+            cursors.push_back(std::make_unique<MetricFileCursor>(*files.back()));
+            cursor_ptrs.push_back(cursors.back().get());
+        }
+
+        MergeStats stats;
+        stats.inputs = inputs_.size();
+
+        MergeOutput output(output_path, options_.format);
+        LoserTree tree(cursor_ptrs);
+        MetricSampleReorder reorder(options_.reorder_window);
+        TickAggregator aggregator(options_.bucket);
+        NameKinds kinds(options_);
+
+        auto emit = [&](const MetricSample& sample) {
+            if (!options_.aggregate && !output.binary()) {
+                output.write(sample);
+                stats.output_samples++;
+                return;
+            }
+
+            const NameKinds::Entry& kind = kinds.lookup(sample);
+            MergeValue value;
+            if (!parseValue(sample.value, kind.floating, value)) {
+                stats.mismatched_values++;
+                return;
+            }
+
+            if (options_.aggregate) {
+                if (!aggregator.empty() && !aggregator.contains(sample.time_key)) {
+                    stats.output_samples += aggregator.flushTo(output);
+                }
+                aggregator.add(sample, kind.kind, value);
+            } else {
+                output.write(sample, value);
+                stats.output_samples++;
+            }
+        };
+
+        // Buffered samples stay valid: the files are mapped until the end
+        MetricSample sample;
+        while (MetricFileCursor* cursor = tree.top()) {
+            reorder.push(cursor->current());
+            stats.input_samples++;
+            tree.advance();
+
+            while (reorder.pop(sample)) {
+                emit(sample);
+            }
+        }
+        reorder.finish();
+        while (reorder.pop(sample)) {
+            emit(sample);
+        }
+
+        stats.output_samples += aggregator.flushTo(output);
+        output.close();
+
+        stats.late_samples = reorder.getLateSamples();
+        for (const auto& c : cursors) {
+            stats.malformed_lines += c->getMalformedLines();
+        }
+        return stats;
+    }
+
+} // namespace MetricsSystem
\ No newline at end of file
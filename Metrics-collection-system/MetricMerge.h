@@ -0,0 +1,80 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace MetricsSystem {
+
+    enum class MergeOutputFormat {
+        Text,       // Same line format as MetricWriter
+        Binary      // Compact records, see below
+    };
+
+    // How same-name samples of one bucket are combined
+    enum class MergeKind {
+        Sum,        // Counters, e.g. requests per tick
+        Mean,       // Gauges, e.g. CPU usage; written as floating point
+        Max,
+        Last        // Value of the input read last
+    };
+
+    // Binary merge output (host byte order):
+    //   "MMRG" u32 version
+    //   'N' u32 id  u16 length  name bytes        - defines a name id
+    //   'S' i64 epoch_ms  u32 id  u8 kind  8 bytes - sample; kind 0 = int64, 1 = double
+    struct MergeOptions {
+        // Combine samples of the same metric within the same bucket, written
+        // with the timestamp of the bucket's start. Each name is combined as
+        // listed in `kinds`, otherwise as `default_kind`.
+        bool aggregate = false;
+        MergeKind default_kind = MergeKind::Sum;
+        std::unordered_map<std::string, MergeKind> kinds;
+
+        // Bucket width. One second matches the collector tick, which hosts
+        // stamp at different milliseconds; zero combines only samples with
+        // the exact same timestamp.
+        std::chrono::milliseconds bucket{ 1000 };
+
+        MergeOutputFormat format = MergeOutputFormat::Text;
+
+        // How far a sample may be behind the newest one read and still be
+        // put in order, e.g. event-time intervals a collector wrote after
+        // newer ticks; see MetricSampleReorder.
+        std::chrono::milliseconds reorder_window{ 10000 };
+    };
+
+    struct MergeStats {
+        size_t inputs = 0;
+        uint64_t input_samples = 0;
+        uint64_t output_samples = 0;
+        uint64_t malformed_lines = 0;
+        uint64_t late_samples = 0;      // Beyond the reorder window, written out of order
+        uint64_t mismatched_values = 0; // Not of the value type fixed for their name, skipped
+    };
+
+    // Streaming k-way merge of metric files (e.g. one per host or process)
+    // into one time-ordered stream. Inputs are memory-mapped and are
+    // expected in timestamp order, as MetricWriter produces them, except
+    // for ticks up to reorder_window late. A loser tree picks the next
+    // sample, so memory depends on the reorder window, not on input size.
+    // Samples with equal timestamps keep input order. The value type of a
+    // name (integer or floating point) is fixed by its first sample for the
+    // whole stream.
+    class MetricMerger {
+    private:
+        std::vector<std::string> inputs_;
+        MergeOptions options_;
+
+    public:
+        explicit MetricMerger(MergeOptions options = MergeOptions());
+
+        void addInput(const std::string& path);
+
+        // Merge all inputs into output_path (throws std::runtime_error on I/O errors)
+        MergeStats merge(const std::string& output_path);
+    };
+
+} // namespace MetricsSystem
\ No newline at end of file
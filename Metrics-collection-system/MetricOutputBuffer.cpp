@@ -0,0 +1,225 @@
+#include "MetricOutputBuffer.h"
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace MetricsSystem {
+
+    size_t MetricTick::sizeBytes() const {
+        size_t bytes = sizeof(MetricTick) + entries.capacity() * sizeof(MetricEntry);
+        for (const auto& entry : entries) {
+            bytes += entry.name.capacity() + 32; // Name storage + boxed value
+        }
+        for (const auto& chunk : chunks) {
+            bytes += chunk.capacity();
+        }
+        return bytes;
+    }
+
+    // MetricOutputBuffer Implementation
+    MetricOutputBuffer::MetricOutputBuffer(size_t max_ticks, OverflowPolicy policy, size_t max_bytes)
+        : max_ticks_(max_ticks), max_bytes_(max_bytes), policy_(policy), closed_(false), degraded_(false) {
+        if (max_ticks_ == 0) {
+            throw std::invalid_argument("Output buffer must hold at least one tick");
+        }
+    }
+
+    bool MetricOutputBuffer::isFullLocked() const {
+        return queue_.size() >= max_ticks_ ||
+               (max_bytes_ > 0 && !queue_.empty() && stats_.queued_bytes >= max_bytes_);
+    }
+
+    void MetricOutputBuffer::dropOldestLocked() {
+        MetricTick& oldest = queue_.front();
+        stats_.dropped_ticks++;
+        stats_.dropped_entries += oldest.entries.size();
+        stats_.queued_bytes -= std::min(stats_.queued_bytes, oldest.sizeBytes());
+        queue_.pop_front();
+    }
+
+    void MetricOutputBuffer::coalesceOldestLocked() {
+        // Fold the oldest tick into the next one, stamped with the later
+        // timestamp. Values combine by their aggregation
+        // (MetricValue::coalesce): totals add, means are weighted by their
+        // sample counts, maxima keep the larger and last values the newer.
+        MetricTick older = std::move(queue_[0]);
+        queue_.pop_front();
+        MetricTick& newer = queue_.front();
+
+        stats_.queued_bytes -= std::min(stats_.queued_bytes, older.sizeBytes() + newer.sizeBytes());
+
+        std::unordered_map<std::string, size_t> newer_index;
+        newer_index.reserve(newer.entries.size());
+        for (size_t i = 0; i < newer.entries.size(); ++i) {
+            newer_index.emplace(newer.entries[i].name, i);
+        }
+
+        // Keep registration order: older entries first (merged with their
+        // newer counterpart), then metrics that only appear in the newer tick
+        std::vector<MetricEntry> merged;
+        std::vector<bool> consumed(newer.entries.size(), false);
+        merged.reserve(std::max(older.entries.size(), newer.entries.size()));
+
+        for (auto& entry : older.entries) {
+            auto it = newer_index.find(entry.name);
+            if (it == newer_index.end()) {
+                entry.timestamp = newer.timestamp;
+                merged.push_back(std::move(entry));
+                continue;
+            }
+
+            MetricEntry& counterpart = newer.entries[it->second];
+            try {
+                entry.value->coalesce(*counterpart.value);
+                entry.timestamp = newer.timestamp;
+                merged.push_back(std::move(entry));
+            } catch (const std::exception& e) {
+                // Type changed between ticks: keep the newer value only
+                std::cerr << "Cannot coalesce metric '" << entry.name << "': " << e.what() << std::endl;
+                merged.push_back(std::move(counterpart));
+            }
+            consumed[it->second] = true;
+        }
+
+        for (size_t i = 0; i < newer.entries.size(); ++i) {
+            if (!consumed[i]) {
+                merged.push_back(std::move(newer.entries[i]));
+            }
+        }
+
+        newer.entries = std::move(merged);
+        newer.chunks.clear();
+        newer.formatted = false;
+
+        stats_.queued_bytes += newer.sizeBytes();
+        stats_.coalesced_ticks++;
+    }
+
+    void MetricOutputBuffer::push(MetricTick tick) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        stats_.enqueued_ticks++;
+
+        if (isFullLocked()) {
+            OverflowPolicy policy = (degraded_ && policy_ == OverflowPolicy::Block) ? OverflowPolicy::Coalesce : policy_;
+            switch (policy) {
+            case OverflowPolicy::Block:
+                stats_.blocked_ticks++;
+                not_full_.wait(lock, [this]() { return closed_ || degraded_ || !isFullLocked(); });
+                while (degraded_ && queue_.size() >= 2 && isFullLocked()) {
+                    coalesceOldestLocked();
+                }
+                break;
+
+            case OverflowPolicy::DropOldest:
+                while (!queue_.empty() && isFullLocked()) {
+                    dropOldestLocked();
+                }
+                break;
+
+            case OverflowPolicy::DropNewest:
+                stats_.dropped_ticks++;
+                stats_.dropped_entries += tick.entries.size();
+                return;
+
+            case OverflowPolicy::Coalesce:
+                while (queue_.size() >= 2 && isFullLocked()) {
+                    coalesceOldestLocked();
+                }
+                if (isFullLocked() && !queue_.empty()) {
+                    dropOldestLocked();
+                }
+                break;
+            }
+        }
+
+        stats_.queued_bytes += tick.sizeBytes();
+        queue_.push_back(std::move(tick));
+        stats_.peak_queued_ticks = std::max(stats_.peak_queued_ticks, queue_.size());
+        not_empty_.notify_one();
+    }
+
+    bool MetricOutputBuffer::deferIfFull() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (policy_ == OverflowPolicy::Block && !closed_ && !degraded_ && isFullLocked()) {
+            stats_.blocked_ticks++;
+            return true;
+        }
+        return false;
+    }
+
+    std::vector<MetricTick> MetricOutputBuffer::takeAll() {
+        std::vector<MetricTick> ticks;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ticks.reserve(queue_.size());
+            std::move(queue_.begin(), queue_.end(), std::back_inserter(ticks));
+            queue_.clear();
+            stats_.queued_bytes = 0;
+        }
+        not_full_.notify_all();
+        return ticks;
+    }
+
+    void MetricOutputBuffer::requeueFront(std::vector<MetricTick> ticks) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto it = ticks.rbegin(); it != ticks.rend(); ++it) {
+            stats_.queued_bytes += it->sizeBytes();
+            queue_.push_front(std::move(*it));
+        }
+        stats_.peak_queued_ticks = std::max(stats_.peak_queued_ticks, queue_.size());
+    }
+
+    bool MetricOutputBuffer::waitForTicks() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [this]() { return closed_ || !queue_.empty(); });
+        return !queue_.empty();
+    }
+
+    void MetricOutputBuffer::markWritten(size_t ticks) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.written_ticks += ticks;
+    }
+
+    void MetricOutputBuffer::setDegraded(bool degraded) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            degraded_ = degraded;
+        }
+        not_full_.notify_all(); // Release a producer blocked before the failure
+    }
+
+    void MetricOutputBuffer::recordWriteFailure(int error_code) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.write_failures++;
+        stats_.last_error_code = error_code;
+    }
+
+    void MetricOutputBuffer::markSpilled(size_t ticks) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.spilled_ticks += ticks;
+    }
+
+    void MetricOutputBuffer::close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+
+    void MetricOutputBuffer::reopen() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = false;
+    }
+
+    OutputBufferStats MetricOutputBuffer::getStats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        OutputBufferStats stats = stats_;
+        stats.queued_ticks = queue_.size();
+        return stats;
+    }
+
+} // namespace MetricsSystem
\ No newline at end of file
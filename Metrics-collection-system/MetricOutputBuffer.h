@@ -0,0 +1,70 @@
+#pragma once
+
+#include "MetricSystem.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace MetricsSystem {
+
+    // Bounded FIFO of collected ticks between the collector and the writer.
+    // Keeps the process memory ceiling when the sink falls behind: once the
+    // tick or byte limit is reached, the overflow policy decides what gives.
+    class MetricOutputBuffer {
+    private:
+        std::deque<MetricTick> queue_;
+        size_t max_ticks_;
+        size_t max_bytes_;
+        OverflowPolicy policy_;
+        bool closed_;
+        bool degraded_;     // Sink down: Block behaves like Coalesce
+
+        mutable std::mutex mutex_;
+        std::condition_variable not_empty_;
+        std::condition_variable not_full_;
+        OutputBufferStats stats_;
+
+        bool isFullLocked() const;
+        void dropOldestLocked();
+        void coalesceOldestLocked();
+
+    public:
+        MetricOutputBuffer(size_t max_ticks, OverflowPolicy policy, size_t max_bytes = 0);
+
+        // Add a tick, applying the overflow policy when full. With Block the
+        // call waits for room (or for close()).
+        void push(MetricTick tick);
+
+        // For threads that must never wait (the runtime scheduler): returns
+        // true, and counts a blocked tick, if a Block-policy push would wait
+        // right now. The caller then skips collecting this tick.
+        bool deferIfFull();
+
+        // Take every buffered tick (oldest first) without waiting
+        std::vector<MetricTick> takeAll();
+
+        // Put ticks that could not be written back at the front, oldest first
+        void requeueFront(std::vector<MetricTick> ticks);
+
+        // Wait until ticks are available; false once closed and empty
+        bool waitForTicks();
+
+        // Record ticks that reached the sink
+        void markWritten(size_t ticks);
+
+        // Sink failure bookkeeping. While degraded, a Block-policy buffer
+        // coalesces instead of waiting, so collection never stalls on a
+        // broken disk.
+        void setDegraded(bool degraded);
+        void recordWriteFailure(int error_code);
+        void markSpilled(size_t ticks);
+
+        // Wake all waiters; pushes after close() are still accepted
+        void close();
+        void reopen();
+
+        OutputBufferStats getStats() const;
+        OverflowPolicy getPolicy() const { return policy_; }
+    };
+
+} // namespace MetricsSystem
\ No newline at end of file
@@ -0,0 +1,554 @@
+#include "MetricRemoteWrite.h"
+#include "MetricSampleLines.h"
+#include "MetricSnappy.h"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+namespace MetricsSystem {
+
+    namespace {
+
+        // prometheus/prompb field tags (field number << 3 | wire type)
+        const char kTagLengthField1 = 0x0a;     // WriteRequest.timeseries, TimeSeries.labels, Label.name
+        const char kTagLengthField2 = 0x12;     // TimeSeries.samples, Label.value
+        const char kTagSampleValue = 0x09;      // Sample.value, fixed64 double
+        const char kTagSampleTimestamp = 0x10;  // Sample.timestamp, varint
+
+        size_t varintSize(uint64_t value) {
+            size_t size = 1;
+            while (value >= 0x80) {
+                value >>= 7;
+                ++size;
+            }
+            return size;
+        }
+
+        void appendVarint(std::string& out, uint64_t value) {
+            while (value >= 0x80) {
+                out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+                value >>= 7;
+            }
+            out.push_back(static_cast<char>(value));
+        }
+
+        void appendBytesField(std::string& out, char tag, std::string_view bytes) {
+            out.push_back(tag);
+            appendVarint(out, bytes.size());
+            out.append(bytes);
+        }
+
+        size_t sampleSize(int64_t timestamp) {
+            return 1 + 8 + 1 + varintSize(static_cast<uint64_t>(timestamp));
+        }
+
+        void appendSample(std::string& out, int64_t timestamp, double value) {
+            out.push_back(kTagLengthField2);
+            appendVarint(out, sampleSize(timestamp));
+
+            uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            out.push_back(kTagSampleValue);
+            for (int i = 0; i < 8; ++i) {
+                out.push_back(static_cast<char>(bits >> (8 * i)));
+            }
+            out.push_back(kTagSampleTimestamp);
+            appendVarint(out, static_cast<uint64_t>(timestamp));
+        }
+
+        bool isValidLabelName(std::string_view name) {
+            if (name.empty() || (name[0] >= '0' && name[0] <= '9')) {
+                return false;
+            }
+            return std::all_of(name.begin(), name.end(), [](char c) {
+                return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+            });
+        }
+
+        // Minimal protobuf reader: varint, fixed64 and length-delimited
+        // fields; other wire types are skipped
+        class ProtoReader {
+        private:
+            std::string_view data_;
+            size_t pos_ = 0;
+
+        public:
+            explicit ProtoReader(std::string_view data) : data_(data) {}
+
+            bool done() const { return pos_ >= data_.size(); }
+
+            bool varint(uint64_t& value) {
+                value = 0;
+                for (int shift = 0; shift < 64; shift += 7) {
+                    if (pos_ >= data_.size()) {
+                        return false;
+                    }
+                    uint8_t byte = static_cast<uint8_t>(data_[pos_++]);
+                    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+                    if (!(byte & 0x80)) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            bool fixed64(uint64_t& value) {
+                if (data_.size() - pos_ < 8) {
+                    return false;
+                }
+                value = 0;
+                for (int i = 0; i < 8; ++i) {
+                    value |= static_cast<uint64_t>(static_cast<uint8_t>(data_[pos_ + i])) << (8 * i);
+                }
+                pos_ += 8;
+                return true;
+            }
+
+            bool bytes(std::string_view& value) {
+                uint64_t length;
+                if (!varint(length) || length > data_.size() - pos_) {
+                    return false;
+                }
+                value = data_.substr(pos_, static_cast<size_t>(length));
+                pos_ += static_cast<size_t>(length);
+                return true;
+            }
+
+            // Read the key of the next field
+            bool field(uint32_t& number, uint32_t& wire_type) {
+                uint64_t key;
+                if (!varint(key)) {
+                    return false;
+                }
+                number = static_cast<uint32_t>(key >> 3);
+                wire_type = static_cast<uint32_t>(key & 7);
+                return true;
+            }
+
+            bool skip(uint32_t wire_type) {
+                uint64_t ignored;
+                std::string_view ignored_bytes;
+                switch (wire_type) {
+                    case 0: return varint(ignored);
+                    case 1: return fixed64(ignored);
+                    case 2: return bytes(ignored_bytes);
+                    case 5:
+                        if (data_.size() - pos_ < 4) {
+                            return false;
+                        }
+                        pos_ += 4;
+                        return true;
+                    default: return false;
+                }
+            }
+        };
+
+        bool decodeLabel(std::string_view data, std::pair<std::string, std::string>& label) {
+            ProtoReader reader(data);
+            while (!reader.done()) {
+                uint32_t number, wire_type;
+                std::string_view text;
+                if (!reader.field(number, wire_type)) {
+                    return false;
+                }
+                if ((number == 1 || number == 2) && wire_type == 2) {
+                    if (!reader.bytes(text)) {
+                        return false;
+                    }
+                    (number == 1 ? label.first : label.second).assign(text);
+                } else if (!reader.skip(wire_type)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool decodeSample(std::string_view data, std::pair<int64_t, double>& sample) {
+            ProtoReader reader(data);
+            while (!reader.done()) {
+                uint32_t number, wire_type;
+                uint64_t raw;
+                if (!reader.field(number, wire_type)) {
+                    return false;
+                }
+                if (number == 1 && wire_type == 1) {
+                    if (!reader.fixed64(raw)) {
+                        return false;
+                    }
+                    std::memcpy(&sample.second, &raw, sizeof(raw));
+                } else if (number == 2 && wire_type == 0) {
+                    if (!reader.varint(raw)) {
+                        return false;
+                    }
+                    sample.first = static_cast<int64_t>(raw);
+                } else if (!reader.skip(wire_type)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+    } // namespace
+
+    RemoteWriteWriter::RemoteWriteWriter(const std::string& url, RemoteWriteOptions options)
+        : MetricWriter(url, NoFile{}), options_(std::move(options)), port_(80), reused_(false),
+          pending_samples_(0), skipped_text_(0), late_samples_(0), failed_(false), closed_(false) {
+        if (options_.batches_per_request == 0 || options_.max_samples_per_request == 0) {
+            throw std::invalid_argument("Remote write requests must hold at least one batch and sample");
+        }
+
+        // http://host[:port][/path], host possibly a [v6] literal
+        const std::string scheme = "http://";
+        if (url.compare(0, scheme.size(), scheme) != 0) {
+            throw std::invalid_argument("Remote write supports http:// URLs only: " + url);
+        }
+        std::string_view rest = std::string_view(url).substr(scheme.size());
+        size_t slash = rest.find('/');
+        path_ = slash == std::string_view::npos ? "/api/v1/write" : std::string(rest.substr(slash));
+        std::string_view authority = rest.substr(0, slash);
+
+        size_t colon = authority.rfind(':');
+        if (colon != std::string_view::npos && authority.find(']', colon) == std::string_view::npos) {
+            std::string_view port = authority.substr(colon + 1);
+            unsigned value = 0;
+            auto result = std::from_chars(port.data(), port.data() + port.size(), value);
+            if (result.ec != std::errc() || result.ptr != port.data() + port.size() || value == 0 || value > 65535) {
+                throw std::invalid_argument("Invalid port in remote write URL: " + url);
+            }
+            port_ = static_cast<uint16_t>(value);
+            authority = authority.substr(0, colon);
+        }
+        if (authority.size() >= 2 && authority.front() == '[' && authority.back() == ']') {
+            authority = authority.substr(1, authority.size() - 2);
+        }
+        if (authority.empty()) {
+            throw std::invalid_argument("Missing host in remote write URL: " + url);
+        }
+        host_ = authority;
+
+        for (const auto& [name, value] : options_.labels) {
+            if (!isValidLabelName(name) || name.compare(0, 2, "__") == 0) {
+                throw std::invalid_argument("Invalid remote write label name: " + name);
+            }
+        }
+        std::sort(options_.labels.begin(), options_.labels.end());
+
+        std::cout << "RemoteWriteWriter initialized with endpoint: " << url << std::endl;
+    }
+
+    RemoteWriteWriter::~RemoteWriteWriter() {
+        close();
+    }
+
+    std::string RemoteWriteWriter::sanitizeName(std::string_view name) {
+        std::string result;
+        result.reserve(name.size() + 1);
+        if (name.empty() || (name[0] >= '0' && name[0] <= '9')) {
+            result.push_back('_');
+        }
+        for (char c : name) {
+            bool valid = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == ':';
+            result.push_back(valid ? c : '_');
+        }
+        return result;
+    }
+
+    void RemoteWriteWriter::formatEntries(const MetricEntry* first, const MetricEntry* last, std::string& out) const {
+        SampleLines::format(first, last, out);
+    }
+
+    void RemoteWriteWriter::encodeRequest() {
+        for (auto& series : series_) {
+            series.samples.clear();
+        }
+
+        SampleLine line;
+        size_t malformed = 0;
+        for (const auto& batch : pending_) {
+            std::string_view lines = batch;
+            while (!lines.empty()) {
+                if (!SampleLines::next(lines, line)) {
+                    ++malformed;
+                    continue;
+                }
+
+                double value;
+                switch (line.kind) {
+                    case SampleLine::Kind::Integer: value = static_cast<double>(line.integer); break;
+                    case SampleLine::Kind::Real: value = line.real; break;
+                    case SampleLine::Kind::Null: value = std::numeric_limits<double>::quiet_NaN(); break;
+                    default:
+                        if (skipped_text_++ == 0) {
+                            std::cerr << "Remote write skips metrics without a numeric value, e.g. '" << line.name
+                                      << "'" << std::endl;
+                        }
+                        continue;
+                }
+
+                auto it = series_index_.find(line.name);
+                if (it == series_index_.end()) {
+                    // Labels sorted by name; "__name__" sorts before lowercase names
+                    std::vector<std::pair<std::string, std::string>> labels = options_.labels;
+                    labels.emplace_back("__name__", sanitizeName(line.name));
+                    std::sort(labels.begin(), labels.end());
+
+                    Series series;
+                    std::string label;
+                    for (const auto& [name, text] : labels) {
+                        label.clear();
+                        appendBytesField(label, kTagLengthField1, name);
+                        appendBytesField(label, kTagLengthField2, text);
+                        appendBytesField(series.labels, kTagLengthField1, label);
+                    }
+                    it = series_index_.emplace(line.name, series_.size()).first;
+                    series_.push_back(std::move(series));
+                }
+                Series& series = series_[it->second];
+                if (line.timestamp_ms <= series.sent_until ||
+                    (!series.samples.empty() && line.timestamp_ms < series.samples.back().first)) {
+                    if (late_samples_.fetch_add(1, std::memory_order_relaxed) == 0) {
+                        std::cerr << "Remote write drops samples older than their series' last one, e.g. '"
+                                  << line.name << "'" << std::endl;
+                    }
+                    continue;
+                }
+                if (!series.samples.empty() && line.timestamp_ms == series.samples.back().first) {
+                    series.samples.back().second = value;
+                } else {
+                    series.samples.emplace_back(line.timestamp_ms, value);
+                }
+            }
+        }
+
+        if (malformed > 0) {
+            std::cerr << "Skipped " << malformed << " malformed lines for " << getOutputFile() << std::endl;
+        }
+
+        proto_.clear();
+        for (const auto& series : series_) {
+            if (series.samples.empty()) {
+                continue;
+            }
+
+            size_t size = series.labels.size();
+            for (const auto& [timestamp, value] : series.samples) {
+                size_t sample = sampleSize(timestamp);
+                size += 1 + varintSize(sample) + sample;
+            }
+
+            proto_.push_back(kTagLengthField1);
+            appendVarint(proto_, size);
+            proto_.append(series.labels);
+            for (const auto& [timestamp, value] : series.samples) {
+                appendSample(proto_, timestamp, value);
+            }
+        }
+    }
+
+    void RemoteWriteWriter::post() {
+        request_.clear();
+        request_.append("POST ").append(path_).append(" HTTP/1.1\r\n");
+        request_.append("Host: ").append(host_).append(":").append(std::to_string(port_)).append("\r\n");
+        request_.append("Content-Encoding: snappy\r\n"
+                        "Content-Type: application/x-protobuf\r\n"
+                        "User-Agent: Metrics-collection-system\r\n"
+                        "X-Prometheus-Remote-Write-Version: 0.1.0\r\n");
+        request_.append("Content-Length: ").append(std::to_string(compressed_.size())).append("\r\n\r\n");
+        request_.append(compressed_);
+
+        // An idle keep-alive connection may have been closed by the server;
+        // that shows on first use, so a reused connection gets one retry
+        for (int attempt = 0;; ++attempt) {
+            try {
+                if (!socket_.isOpen()) {
+                    socket_ = TcpSocket::connect(host_, port_, options_.timeout);
+                    receive_buffer_.clear();
+                    reused_ = false;
+                }
+
+                socket_.sendAll(request_);
+                if (!readHttpMessage(socket_, receive_buffer_, response_)) {
+                    throw std::runtime_error("Connection closed before the response");
+                }
+                break;
+            } catch (const std::exception& e) {
+                socket_.close();
+                if (attempt == 0 && reused_) {
+                    continue;
+                }
+                throw MetricWriteError("Remote write to " + getOutputFile() + " failed: " + e.what(), EIO);
+            }
+        }
+
+        reused_ = true;
+        std::string_view connection = response_.header("Connection");
+        if (connection == "close" || connection == "Close") {
+            socket_.close();
+        }
+    }
+
+    void RemoteWriteWriter::markSent() {
+        for (auto& series : series_) {
+            if (!series.samples.empty()) {
+                series.sent_until = series.samples.back().first;
+            }
+        }
+    }
+
+    void RemoteWriteWriter::sendPending() {
+        encodeRequest();
+        if (proto_.empty()) {
+            return;
+        }
+        SnappyCodec::compress(proto_, compressed_);
+        post();
+
+        int status = response_.status();
+        if (status >= 200 && status < 300) {
+            markSent();
+            return;
+        }
+
+        std::string message = "Remote write to " + getOutputFile() + " failed: " + response_.start_line;
+        if (!response_.body.empty()) {
+            message += " - " + response_.body.substr(0, 200);
+        }
+        if (status >= 400 && status < 500 && status != 429) {
+            // Retrying cannot succeed (bad data, rejected samples)
+            std::cerr << message << " - dropping " << pending_samples_ << " samples" << std::endl;
+            markSent();
+            return;
+        }
+        throw MetricWriteError(message, EIO);
+    }
+
+    void RemoteWriteWriter::writeFormatted(const std::vector<std::string>& chunks) {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (closed_) {
+            throw MetricWriteError("Remote write output is closed: " + getOutputFile(), EBADF);
+        }
+
+        std::string batch;
+        for (const auto& chunk : chunks) {
+            batch.append(chunk);
+        }
+        const size_t samples = static_cast<size_t>(std::count(batch.begin(), batch.end(), '\n'));
+
+        pending_.push_back(std::move(batch));
+        pending_samples_ += samples;
+        if (pending_.size() < options_.batches_per_request && pending_samples_ < options_.max_samples_per_request) {
+            return;
+        }
+
+        try {
+            sendPending();
+        } catch (const MetricWriteError&) {
+            // This batch goes back to the collector; the earlier ones stay queued
+            pending_.pop_back();
+            pending_samples_ -= samples;
+            failed_ = true;
+            throw;
+        }
+        pending_.clear();
+        pending_samples_ = 0;
+    }
+
+    bool RemoteWriteWriter::recover() {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (closed_) {
+            return false;
+        }
+
+        if (!socket_.isOpen()) {
+            try {
+                socket_ = TcpSocket::connect(host_, port_, options_.timeout);
+                receive_buffer_.clear();
+                reused_ = false;
+            } catch (const std::exception&) {
+                return false;
+            }
+        }
+
+        failed_ = false;
+        return true;
+    }
+
+    bool RemoteWriteWriter::hasFailed() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return failed_;
+    }
+
+    void RemoteWriteWriter::close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (closed_) {
+            return;
+        }
+
+        if (!pending_.empty()) {
+            try {
+                sendPending();
+            } catch (const MetricWriteError& e) {
+                std::cerr << e.what() << " - dropping " << pending_samples_ << " samples" << std::endl;
+            }
+            pending_.clear();
+            pending_samples_ = 0;
+        }
+
+        socket_.close();
+        closed_ = true;
+        failed_ = false;
+        std::cout << "RemoteWriteWriter closed" << std::endl;
+    }
+
+    bool RemoteWriteWriter::decodeWriteRequest(std::string_view data, std::vector<RemoteSeries>& series) {
+        series.clear();
+
+        ProtoReader request(data);
+        while (!request.done()) {
+            uint32_t number, wire_type;
+            std::string_view series_data;
+            if (!request.field(number, wire_type)) {
+                return false;
+            }
+            if (number != 1 || wire_type != 2) {
+                if (!request.skip(wire_type)) {
+                    return false;
+                }
+                continue;
+            }
+            if (!request.bytes(series_data)) {
+                return false;
+            }
+
+            RemoteSeries& decoded = series.emplace_back();
+            ProtoReader reader(series_data);
+            while (!reader.done()) {
+                std::string_view field_data;
+                if (!reader.field(number, wire_type)) {
+                    return false;
+                }
+                if ((number == 1 || number == 2) && wire_type == 2) {
+                    if (!reader.bytes(field_data)) {
+                        return false;
+                    }
+                    bool ok = number == 1 ? decodeLabel(field_data, decoded.labels.emplace_back())
+                                          : decodeSample(field_data, decoded.samples.emplace_back());
+                    if (!ok) {
+                        return false;
+                    }
+                } else if (!reader.skip(wire_type)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+} // namespace MetricsSystem 
\ No newline at end of file
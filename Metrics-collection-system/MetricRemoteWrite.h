@@ -0,0 +1,115 @@
+#pragma once
+
+#include "MetricSystem.h"
+#include "MetricHttp.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace MetricsSystem {
+
+    struct RemoteWriteOptions {
+        size_t batches_per_request = 5;             // Output batches (one per drain) sent per request
+        size_t max_samples_per_request = 10000;     // Send earlier once this many samples wait
+        std::chrono::milliseconds timeout{ 10000 }; // Connect, send and response timeout
+        std::vector<std::pair<std::string, std::string>> labels;   // Added to every series, e.g. {"job", "app"}
+    };
+
+    // A series of a decoded WriteRequest
+    struct RemoteSeries {
+        std::vector<std::pair<std::string, std::string>> labels;
+        std::vector<std::pair<int64_t, double>> samples;    // (ms since the Unix epoch, value)
+    };
+
+    // Prometheus remote-write output: snapshots are posted as
+    // snappy-compressed protobuf WriteRequests to an http:// endpoint, e.g.
+    //   http://metrics-store:9201/api/v1/write
+    // Each metric becomes a series named after it (characters Prometheus
+    // does not allow replaced by '_'), with the configured labels added.
+    // Values without a numeric form (e.g. min/max/mean summaries) are not
+    // sent; non-finite numbers are sent as NaN. Series timestamps must
+    // increase, so of two ticks within one millisecond the later value is
+    // sent, and a sample older than one already taken for its series (e.g.
+    // an event-time interval written late, see MetricCollector::record) is
+    // dropped and counted in getLateSamples().
+    //
+    // The protobuf wire format is written by hand and compressed with
+    // SnappyCodec, into buffers that are kept across requests. Ticks are
+    // formatted as SampleLines, so the collector's batching and spooling work
+    // unchanged. A request holds batches_per_request output batches, or
+    // fewer once max_samples_per_request is reached, and goes out over one
+    // keep-alive connection. Waiting batches form a bounded queue: they stay
+    // queued when a request fails and are sent with the next batch after
+    // recover(). A failed request throws MetricWriteError, so the collector
+    // buffers (and spools) the rest; a request the endpoint rejects with a
+    // 4xx status other than 429 is dropped, as retrying cannot succeed.
+    class RemoteWriteWriter : public MetricWriter {
+    private:
+        struct Series {
+            std::string labels;                                 // Encoded TimeSeries.labels fields
+            std::vector<std::pair<int64_t, double>> samples;    // Of the request being built
+            int64_t sent_until = std::numeric_limits<int64_t>::min();   // Last timestamp delivered
+        };
+
+        RemoteWriteOptions options_;
+        std::string host_;
+        uint16_t port_;
+        std::string path_;
+
+        std::mutex mutex_;
+        TcpSocket socket_;
+        bool reused_;                   // socket_ has served a request before
+        std::string receive_buffer_;
+        HttpMessage response_;
+
+        std::vector<std::string> pending_;      // Batches waiting for the next request
+        size_t pending_samples_;
+
+        std::unordered_map<std::string, size_t> series_index_;
+        std::vector<Series> series_;
+        std::string proto_;
+        std::string compressed_;
+        std::string request_;
+
+        uint64_t skipped_text_;
+        std::atomic<uint64_t> late_samples_;
+        bool failed_;
+        bool closed_;
+
+        void encodeRequest();
+        void markSent();
+        void sendPending();
+        void post();
+
+    public:
+        // `url` is http://host[:port][/path]; the path defaults to /api/v1/write
+        explicit RemoteWriteWriter(const std::string& url, RemoteWriteOptions options = {});
+        ~RemoteWriteWriter() override;
+
+        void formatEntries(const MetricEntry* first, const MetricEntry* last, std::string& out) const override;
+        void writeFormatted(const std::vector<std::string>& chunks) override;
+        bool recover() override;
+        bool hasFailed() override;
+
+        // Samples dropped for being older than their series' last one
+        uint64_t getLateSamples() const { return late_samples_.load(std::memory_order_relaxed); }
+
+        // Sends what is still queued and closes the connection
+        void close() override;
+
+        // Metric name as a Prometheus metric name ([a-zA-Z_:][a-zA-Z0-9_:]*)
+        static std::string sanitizeName(std::string_view name);
+
+        // Decode a (decompressed) WriteRequest, e.g. in a stand-in receiver.
+        // Returns false for malformed protobuf.
+        static bool decodeWriteRequest(std::string_view data, std::vector<RemoteSeries>& series);
+    };
+
+} // namespace MetricsSystem
\ No newline at end of file
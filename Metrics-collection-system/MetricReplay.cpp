@@ -0,0 +1,276 @@
+#include "MetricReplay.h"
+#include "MetricFileReader.h"
+#include "MetricSystemManager.h"
+#include <charconv>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+namespace MetricsSystem {
+
+    namespace {
+
+        // Samples of one tick for one producer. Views point into the mapped
+        // input files, which stay mapped until every producer has finished.
+        using ReplayBatch = std::vector<std::pair<std::string_view, std::string_view>>;
+
+        const size_t kMaxBatchSamples = 4096;
+        const size_t kMaxQueuedBatches = 16;
+
+        // Bounded hand-off from the reader to one producer thread
+        class ProducerQueue {
+        private:
+            std::deque<ReplayBatch> batches_;
+            std::mutex mutex_;
+            std::condition_variable not_empty_;
+            std::condition_variable not_full_;
+            std::condition_variable idle_;
+            size_t busy_ = 0;           // Batches popped and not yet recorded
+            bool closed_ = false;
+
+        public:
+            void push(ReplayBatch batch) {
+                std::unique_lock<std::mutex> lock(mutex_);
+                not_full_.wait(lock, [this]() { return batches_.size() < kMaxQueuedBatches; });
+                batches_.push_back(std::move(batch));
+                not_empty_.notify_one();
+            }
+
+            bool pop(ReplayBatch& batch) {
+                std::unique_lock<std::mutex> lock(mutex_);
+                not_empty_.wait(lock, [this]() { return closed_ || !batches_.empty(); });
+                if (batches_.empty()) {
+                    return false;
+                }
+                batch = std::move(batches_.front());
+                batches_.pop_front();
+                ++busy_;
+                not_full_.notify_one();
+                return true;
+            }
+
+            // The batch from the last pop() is recorded
+            void done() {
+                std::lock_guard<std::mutex> lock(mutex_);
+                --busy_;
+                idle_.notify_all();
+            }
+
+            // Wait until every pushed batch is recorded
+            void waitIdle() {
+                std::unique_lock<std::mutex> lock(mutex_);
+                idle_.wait(lock, [this]() { return batches_.empty() && busy_ == 0; });
+            }
+
+            void close() {
+                std::lock_guard<std::mutex> lock(mutex_);
+                closed_ = true;
+                not_empty_.notify_all();
+            }
+        };
+
+        bool isFloatingValue(std::string_view value) {
+            return value.find_first_of(".eEnN") != std::string_view::npos;
+        }
+
+        void produce(MetricSystemManager& target, ProducerQueue& queue) {
+            // Value type per metric, fixed on first sight (this thread owns
+            // every metric hashed to it)
+            std::unordered_map<std::string, bool> floating;
+            std::string name;
+            ReplayBatch batch;
+
+            while (queue.pop(batch)) {
+                for (const auto& sample : batch) {
+                    name.assign(sample.first.data(), sample.first.size());
+                    auto it = floating.find(name);
+                    if (it == floating.end()) {
+                        it = floating.emplace(name, isFloatingValue(sample.second)).first;
+                    }
+
+                    if (it->second) {
+                        std::string value(sample.second);
+                        target.recordMetric<double>(name, std::strtod(value.c_str(), nullptr));
+                    } else {
+                        long value = 0;
+                        std::from_chars(sample.second.data(), sample.second.data() + sample.second.size(), value);
+                        target.recordMetric<long>(name, value);
+                    }
+                }
+                queue.done();
+            }
+        }
+
+    } // namespace
+
+    // MetricReplayer Implementation
+    MetricReplayer::MetricReplayer(MetricSystemManager& target, ReplayOptions options)
+        : target_(target), options_(options) {
+        if (options_.speed < 0) {
+            throw std::invalid_argument("Replay speed cannot be negative");
+        }
+        if (options_.producer_threads == 0) {
+            options_.producer_threads = 1;
+        }
+    }
+
+    void MetricReplayer::addInput(const std::string& path) {
+        if (path.empty()) {
+            throw std::invalid_argument("Input path cannot be empty");
+        }
+        inputs_.push_back(path);
+    }
+
+    ReplayStats MetricReplayer::run() {
+        if (!target_.isRunning()) {
+            throw std::logic_error("Replay target must be running");
+        }
+
+        const size_t producer_count = options_.producer_threads;
+        std::vector<ProducerQueue> queues(producer_count);
+        std::vector<std::thread> producers;
+        for (size_t i = 0; i < producer_count; ++i) {
+            producers.emplace_back(produce, std::ref(target_), std::ref(queues[i]));
+        }
+
+        ReplayStats stats;
+        std::vector<std::unique_ptr<MappedFile>> files;
+        const auto start = std::chrono::steady_clock::now();
+
+        try {
+            std::vector<ReplayBatch> pending(producer_count);
+            auto dispatch = [&](size_t producer) {
+                if (!pending[producer].empty()) {
+                    queues[producer].push(std::move(pending[producer]));
+                    pending[producer] = ReplayBatch();
+                }
+            };
+
+            // Collect the source tick at `tick_time` on the target's clock
+            // once everything recorded so far has reached the metrics
+            auto collectAt = [&](TimePoint tick_time) {
+                for (size_t p = 0; p < producer_count; ++p) {
+                    dispatch(p);
+                }
+                for (auto& queue : queues) {
+                    queue.waitIdle();
+                }
+                const auto behind = tick_time - options_.clock->now();
+                if (behind.count() > 0) {
+                    options_.clock->advance(behind);
+                }
+            };
+
+            for (const auto& input : inputs_) {
+                files.push_back(std::make_unique<MappedFile>(input));
+                MetricFileCursor cursor(*files.back());
+
+                // Pacing restarts with each file: its first tick plays now
+                uint64_t current_key = 0;
+                TimePoint source_start;
+                TimePoint source_time;
+                TimePoint source_end;
+                auto wall_start = std::chrono::steady_clock::now();
+
+                auto play = [&](const MetricSample& sample) {
+                    if (sample.time_key != current_key) {
+                        if (options_.clock && current_key != 0) {
+                            collectAt(source_time);
+                        }
+                        for (size_t p = 0; p < producer_count; ++p) {
+                            dispatch(p);
+                        }
+
+                        source_time = MetricTimeKey::toTimePoint(sample.time_key);
+                        if (options_.clock) {
+                            // Empty ticks of a gap in the source go out before
+                            // this tick's samples are recorded
+                            collectAt(source_time - std::chrono::seconds(1));
+                        }
+                        if (current_key == 0) {
+                            source_start = source_time;
+                            source_end = source_time;
+                        }
+                        current_key = sample.time_key;
+                        stats.ticks++;
+
+                        // A tick beyond the reorder window plays at once
+                        if (options_.speed > 0 && source_time >= source_end) {
+                            auto offset = std::chrono::duration<double>(source_time - source_start) / options_.speed;
+                            auto due = wall_start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(offset);
+                            auto now = std::chrono::steady_clock::now();
+                            if (now < due) {
+                                std::this_thread::sleep_until(due);
+                            } else {
+                                stats.max_lag_seconds = std::max(stats.max_lag_seconds,
+                                                                 std::chrono::duration<double>(now - due).count());
+                            }
+                        }
+                        source_end = std::max(source_end, source_time);
+                    }
+
+                    size_t producer = std::hash<std::string_view>()(sample.name) % producer_count;
+                    pending[producer].emplace_back(sample.name, sample.value);
+                    if (pending[producer].size() >= kMaxBatchSamples) {
+                        dispatch(producer);
+                    }
+                    stats.samples++;
+                };
+
+                // Buffered samples point into the file, which stays mapped
+                MetricSampleReorder reorder(options_.reorder_window);
+                MetricSample sample;
+                while (cursor.next()) {
+                    reorder.push(cursor.current());
+                    while (reorder.pop(sample)) {
+                        play(sample);
+                    }
+                }
+                reorder.finish();
+                while (reorder.pop(sample)) {
+                    play(sample);
+                }
+
+                for (size_t p = 0; p < producer_count; ++p) {
+                    dispatch(p);
+                }
+                if (options_.clock && current_key != 0) {
+                    collectAt(source_end);
+                }
+                if (current_key != 0) {
+                    stats.source_seconds += std::chrono::duration<double>(source_end - source_start).count();
+                }
+                stats.late_samples += reorder.getLateSamples();
+                stats.malformed_lines += cursor.getMalformedLines();
+            }
+        } catch (...) {
+            for (auto& queue : queues) {
+                queue.close();
+            }
+            for (auto& producer : producers) {
+                producer.join();
+            }
+            throw;
+        }
+
+        for (auto& queue : queues) {
+            queue.close();
+        }
+        for (auto& producer : producers) {
+            producer.join();
+        }
+
+        // End to end: everything recorded has reached the sink
+        target_.flush();
+        stats.elapsed_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return stats;
+    }
+
+} // namespace MetricsSystem
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "MetricClock.h"
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace MetricsSystem {
+
+    class MetricSystemManager;
+
+    struct ReplayOptions {
+        // Source time runs this many times faster than wall time
+        // (1 = real time, 100 = accelerated, 0 = as fast as possible)
+        double speed = 1.0;
+
+        // Threads calling recordMetric. Metrics are partitioned by name, so
+        // samples of one metric are recorded in file order.
+        size_t producer_threads = 4;
+
+        // The target's clock (set before it was started), moved to source
+        // time: after the samples of a source tick are recorded, the clock
+        // is advanced to that tick, so the target collects each source
+        // second as one interval at any speed. Start it one second before
+        // the first source tick. Without it the target ticks on its own
+        // clock and, at speeds other than 1, each output tick covers
+        // `speed` source seconds.
+        std::shared_ptr<VirtualClock> clock;
+
+        // Ticks up to this far behind the newest one read (e.g. late
+        // event-time intervals) are played in time order; see
+        // MetricSampleReorder
+        std::chrono::milliseconds reorder_window{ 10000 };
+    };
+
+    struct ReplayStats {
+        uint64_t samples = 0;
+        uint64_t ticks = 0;                 // Distinct source timestamps
+        uint64_t malformed_lines = 0;
+        uint64_t late_samples = 0;          // Beyond the reorder window, played when read
+        double elapsed_seconds = 0.0;       // Wall time including the final flush
+        double source_seconds = 0.0;        // Time span covered by the inputs
+        double max_lag_seconds = 0.0;       // Worst delay behind the paced schedule (wall time)
+
+        double samplesPerSecond() const { return elapsed_seconds > 0 ? samples / elapsed_seconds : 0.0; }
+        double achievedSpeed() const { return elapsed_seconds > 0 ? source_seconds / elapsed_seconds : 0.0; }
+    };
+
+    // Feeds recorded metric files back through a running MetricSystemManager
+    // at the original pace, accelerated or flat out, to benchmark
+    // aggregations and sinks with production-shaped traffic.
+    //
+    // Value types are inferred from the first value seen per metric:
+    // integers are recorded as long, anything with a decimal point as double.
+    // Inputs are replayed one after another; merge them first (MetricMerger)
+    // to interleave several hosts.
+    class MetricReplayer {
+    private:
+        MetricSystemManager& target_;
+        ReplayOptions options_;
+        std::vector<std::string> inputs_;
+
+    public:
+        MetricReplayer(MetricSystemManager& target, ReplayOptions options = ReplayOptions());
+
+        void addInput(const std::string& path);
+
+        // Replay every input and flush the target; the target must be running
+        ReplayStats run();
+    };
+
+} // namespace MetricsSystem
\ No newline at end of file
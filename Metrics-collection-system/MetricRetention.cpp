@@ -0,0 +1,595 @@
+#include "MetricRetention.h"
+#include "MetricColumnar.h"
+#include "MetricSegment.h"
+#include "MetricUtilities.h"
+#include "MetricWorkerPool.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+
+namespace MetricsSystem {
+
+    namespace {
+
+        const uint64_t kSecondsPerDay = 24 * 60 * 60;
+        const uint64_t kKeysPerDay = 1000000000;            // hhmmssmmm part of a time key
+        const uint64_t kKeysPerMonth = 100 * kKeysPerDay;   // DDhhmmssmmm part
+
+        // Samples read between checks for a stop while rolling up a segment
+        const size_t kStopCheckSamples = 65536;
+
+        // Metric names cannot contain quotes, so this never meets a metric
+        const std::string kSourcesSeries = "\"sources\"";
+
+        struct RollupCell {
+            uint64_t count = 0;
+            double sum = 0.0;
+            double min = 0.0;
+            double max = 0.0;
+
+            void merge(const RollupCell& other) {
+                min = count > 0 ? std::min(min, other.min) : other.min;
+                max = count > 0 ? std::max(max, other.max) : other.max;
+                sum += other.sum;
+                count += other.count;
+            }
+        };
+
+        struct Rollup {
+            std::map<std::string, std::map<uint64_t, RollupCell>> metrics;  // Name -> bucket key -> cell
+            std::map<std::string, uint64_t> sources;                        // Merged file -> its last key
+        };
+
+        bool parseDouble(std::string_view text, double& value) {
+            auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+            return result.ec == std::errc() && result.ptr == text.data() + text.size() && !text.empty() &&
+                   std::isfinite(value);
+        }
+
+        void appendDouble(double value, std::string& out) {
+            // Shortest text that reads back as the same double
+            char buffer[32];
+            auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+            out.append(buffer, result.ptr);
+        }
+
+        uint64_t keyOf(std::chrono::system_clock::time_point time) {
+            return MetricTimeKey::parse(TimestampUtils::formatTimestamp(time));
+        }
+
+        // Start of the bucket of `seconds` (a divisor of a day) holding key
+        uint64_t bucketKey(uint64_t key, uint64_t seconds) {
+            const uint64_t time = key % kKeysPerDay;
+            uint64_t second_of_day = time / 10000000 * 3600 + time / 100000 % 100 * 60 + time / 1000 % 100;
+            second_of_day -= second_of_day % seconds;
+            return key - time + second_of_day / 3600 * 10000000 + second_of_day / 60 % 60 * 100000 +
+                   second_of_day % 60 * 1000;
+        }
+
+        std::string resolutionLabel(std::chrono::seconds resolution) {
+            const uint64_t seconds = static_cast<uint64_t>(resolution.count());
+            if (seconds % kSecondsPerDay == 0) {
+                return std::to_string(seconds / kSecondsPerDay) + "d";
+            }
+            if (seconds % 3600 == 0) {
+                return std::to_string(seconds / 3600) + "h";
+            }
+            if (seconds % 60 == 0) {
+                return std::to_string(seconds / 60) + "m";
+            }
+            return std::to_string(seconds) + "s";
+        }
+
+        bool endsWith(std::string_view text, std::string_view suffix) {
+            return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+        }
+
+        // A segment and its archive are the same source
+        std::string sourceName(const std::string& path, bool raw) {
+            std::string name = std::filesystem::path(path).filename().string();
+            if (raw && endsWith(name, SegmentNames::kArchiveExtension)) {
+                name.resize(name.size() - SegmentNames::kArchiveExtension.size());
+            }
+            return name;
+        }
+
+        std::string readFile(const std::string& path) {
+            MappedFile file(path);
+            return std::string(file.data(), file.size());
+        }
+
+        void decodeRollup(std::string_view data, Rollup& rollup) {
+            std::string value;
+            for (const auto& series : ColumnarArchive::decode(data)) {
+                if (series.name == kSourcesSeries) {
+                    for (size_t i = 0; i < series.size(); ++i) {
+                        value.clear();
+                        series.appendValue(i, value);
+                        rollup.sources[value] = series.keys[i];
+                    }
+                    continue;
+                }
+
+                const size_t colon = series.name.rfind(':');
+                if (colon == std::string::npos) {
+                    throw std::runtime_error("unexpected series '" + series.name + "' in rollup");
+                }
+                const std::string aggregate = series.name.substr(colon + 1);
+                auto& cells = rollup.metrics[series.name.substr(0, colon)];
+
+                for (size_t i = 0; i < series.size(); ++i) {
+                    value.clear();
+                    series.appendValue(i, value);
+                    double number = 0.0;
+                    if (!parseDouble(value, number)) {
+                        throw std::runtime_error("bad value in rollup series '" + series.name + "'");
+                    }
+
+                    RollupCell& cell = cells[series.keys[i]];
+                    if (aggregate == "count") {
+                        cell.count = static_cast<uint64_t>(number);
+                    } else if (aggregate == "sum") {
+                        cell.sum = number;
+                    } else if (aggregate == "min") {
+                        cell.min = number;
+                    } else if (aggregate == "max") {
+                        cell.max = number;
+                    } else {
+                        throw std::runtime_error("unexpected series '" + series.name + "' in rollup");
+                    }
+                }
+            }
+
+            for (const auto& [name, cells] : rollup.metrics) {
+                for (const auto& [key, cell] : cells) {
+                    if (cell.count == 0) {
+                        throw std::runtime_error("incomplete rollup of '" + name + "'");
+                    }
+                }
+            }
+        }
+
+        void encodeRollup(const Rollup& rollup, std::string& out) {
+            std::vector<ColumnarSeries> series;
+            std::string value;
+            for (const auto& [name, cells] : rollup.metrics) {
+                ColumnarSeries count, sum, min, max;
+                count.name = name + ":count";
+                sum.name = name + ":sum";
+                min.name = name + ":min";
+                max.name = name + ":max";
+                for (const auto& [key, cell] : cells) {
+                    count.add(key, std::to_string(cell.count));
+                    value.clear();
+                    appendDouble(cell.sum, value);
+                    sum.add(key, value);
+                    value.clear();
+                    appendDouble(cell.min, value);
+                    min.add(key, value);
+                    value.clear();
+                    appendDouble(cell.max, value);
+                    max.add(key, value);
+                }
+                series.push_back(std::move(count));
+                series.push_back(std::move(sum));
+                series.push_back(std::move(min));
+                series.push_back(std::move(max));
+            }
+
+            ColumnarSeries sources;
+            sources.name = kSourcesSeries;
+            for (const auto& [name, key] : rollup.sources) {
+                sources.add(key, name);
+            }
+            series.push_back(std::move(sources));
+
+            ColumnarArchive::encode(series, out);
+        }
+
+        // Write through <path>.tmp, so readers and later cycles see the old
+        // rollup or the new one, never a partial file; synced before the
+        // rename, and the rename before the caller removes the source
+        void writeRollup(const std::string& path, const std::string& data) {
+            const std::string temp = path + ".tmp";
+            {
+                std::ofstream out(temp, std::ios::out | std::ios::trunc | std::ios::binary);
+                if (!out.is_open()) {
+                    throw std::runtime_error("failed to create " + temp);
+                }
+                out.write(data.data(), static_cast<std::streamsize>(data.size()));
+                out.close();
+                if (out.fail()) {
+                    std::error_code ec;
+                    std::filesystem::remove(temp, ec);
+                    throw std::runtime_error("failed to write " + temp);
+                }
+            }
+            try {
+                DurableFile::replace(temp, path);
+            } catch (...) {
+                std::error_code ec;
+                std::filesystem::remove(temp, ec);
+                throw;
+            }
+        }
+
+        // Time range of a raw or rollup file. A segment without a footer
+        // (footers off) is read through; false if nothing in it parses
+        // (another format), in which case it is left alone.
+        bool fileRange(const std::string& path, uint64_t& first_key, uint64_t& last_key, bool& empty) {
+            MappedFile file(path);
+            const std::string_view data(file.data(), file.size());
+            if (ColumnarArchive::isArchive(data)) {
+                empty = !ColumnarArchive::timeRange(data, first_key, last_key);
+                return true;
+            }
+
+            SegmentFooter footer;
+            if (!SegmentFooter::read(file, footer, false)) {
+                MetricFileCursor cursor(file);
+                empty = true;
+                while (cursor.next()) {
+                    const uint64_t key = cursor.current().time_key;
+                    first_key = empty ? key : std::min(first_key, key);
+                    last_key = empty ? key : std::max(last_key, key);
+                    empty = false;
+                }
+                return !empty || cursor.getMalformedLines() == 0;
+            }
+            first_key = footer.getFirstKey();
+            last_key = footer.getLastKey();
+            empty = footer.getSamples() == 0;
+            return true;
+        }
+
+    } // namespace
+
+    // RetentionManager Implementation
+    RetentionManager::RetentionManager(const std::string& output_file, RetentionOptions options)
+        : output_file_(output_file), options_(std::move(options)), stopping_(false), cycles_(0),
+          downsampled_files_(0), deleted_files_(0), failures_(0), input_bytes_(0), output_bytes_(0) {
+        if (output_file.empty()) {
+            throw std::invalid_argument("Output filename cannot be empty");
+        }
+        if (options_.cycle_interval.count() <= 0) {
+            throw std::invalid_argument("Retention cycle interval must be positive");
+        }
+        if (options_.raw_keep.count() <= 0) {
+            throw std::invalid_argument("Raw retention must be positive");
+        }
+        if (options_.retry_delay.count() <= 0 || options_.max_retry_delay < options_.retry_delay) {
+            throw std::invalid_argument("Retention retry delays must be positive and increasing");
+        }
+
+        std::chrono::seconds previous_resolution(1);
+        std::chrono::seconds previous_keep = options_.raw_keep;
+        for (const auto& tier : options_.rollups) {
+            if (tier.resolution.count() <= 0 || kSecondsPerDay % static_cast<uint64_t>(tier.resolution.count()) != 0) {
+                throw std::invalid_argument("Rollup resolution must divide a day");
+            }
+            if (tier.resolution.count() % previous_resolution.count() != 0 ||
+                (!labels_.empty() && tier.resolution == previous_resolution)) {
+                throw std::invalid_argument("Rollup resolution must be a multiple of the previous tier's");
+            }
+            if (tier.keep <= previous_keep) {
+                throw std::invalid_argument("Rollup tiers must be kept longer than the tier before");
+            }
+            previous_resolution = tier.resolution;
+            previous_keep = tier.keep;
+            labels_.push_back(resolutionLabel(tier.resolution));
+        }
+    }
+
+    RetentionManager::~RetentionManager() {
+        stop();
+    }
+
+    void RetentionManager::start() {
+        if (thread_.joinable()) {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = false;
+        }
+        thread_ = std::thread(&RetentionManager::run, this);
+    }
+
+    void RetentionManager::stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    RetentionStats RetentionManager::getStats() const {
+        RetentionStats stats;
+        stats.cycles = cycles_.load(std::memory_order_relaxed);
+        stats.downsampled_files = downsampled_files_.load(std::memory_order_relaxed);
+        stats.deleted_files = deleted_files_.load(std::memory_order_relaxed);
+        stats.failures = failures_.load(std::memory_order_relaxed);
+        stats.input_bytes = input_bytes_.load(std::memory_order_relaxed);
+        stats.output_bytes = output_bytes_.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    void RetentionManager::run() {
+        WorkerPool::lowerThreadPriority();
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stopping_) {
+            lock.unlock();
+            try {
+                runCycle();
+            } catch (const std::exception& e) {
+                std::cerr << "Retention cycle failed: " << e.what() << std::endl;
+            }
+            lock.lock();
+
+            cv_.wait_for(lock, options_.cycle_interval, [this]() { return stopping_; });
+        }
+    }
+
+    bool RetentionManager::isStopping() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stopping_;
+    }
+
+    size_t RetentionManager::levelOf(const std::string& path) const {
+        if (SegmentNames::isSegment(output_file_, path)) {
+            return 0;
+        }
+
+        const std::string_view extension = SegmentNames::kArchiveExtension;
+        if (!endsWith(path, extension)) {
+            return SIZE_MAX;
+        }
+        if (SegmentNames::isSegment(output_file_, path.substr(0, path.size() - extension.size()))) {
+            return 0;
+        }
+
+        // <stem>.<label>.<digits>.mca
+        const std::string prefix = std::filesystem::path(output_file_).stem().string() + ".";
+        const std::string name = std::filesystem::path(path).filename().string();
+        for (size_t tier = 0; tier < labels_.size(); ++tier) {
+            const std::string tier_prefix = prefix + labels_[tier] + ".";
+            if (name.size() <= tier_prefix.size() + extension.size() ||
+                name.compare(0, tier_prefix.size(), tier_prefix) != 0) {
+                continue;
+            }
+            const std::string_view window(name.data() + tier_prefix.size(),
+                                          name.size() - tier_prefix.size() - extension.size());
+            if (window.find_first_not_of("0123456789") == std::string_view::npos) {
+                return tier + 1;
+            }
+        }
+        return SIZE_MAX;
+    }
+
+    std::string RetentionManager::rollupPath(size_t tier, uint64_t key) const {
+        // A file per day below hourly resolution, per month from there on
+        const bool monthly = options_.rollups[tier].resolution >= std::chrono::hours(1);
+        const uint64_t window = monthly ? key / kKeysPerMonth : key / kKeysPerDay;
+
+        const std::filesystem::path output(output_file_);
+        const std::string name = output.stem().string() + "." + labels_[tier] + "." + std::to_string(window) +
+                                 std::string(SegmentNames::kArchiveExtension);
+        return output.has_parent_path() ? (output.parent_path() / name).string() : name;
+    }
+
+    size_t RetentionManager::runCycle() {
+        std::lock_guard<std::mutex> cycle_lock(cycle_mutex_);
+
+        const auto now = TimestampUtils::getCurrentTime();
+        const std::vector<std::string> files = SegmentNames::list(output_file_);
+        uint64_t io_bytes = 0;
+        size_t expired = 0;
+
+        // Forget failures of files that are gone
+        for (auto it = failed_files_.begin(); it != failed_files_.end();) {
+            if (std::find(files.begin(), files.end(), it->first) == files.end()) {
+                it = failed_files_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        // Finest level first: a rollup only moves on once everything older
+        // than it has been merged into it
+        for (size_t level = 0; level <= options_.rollups.size(); ++level) {
+            const auto keep = level == 0 ? options_.raw_keep : options_.rollups[level - 1].keep;
+            const uint64_t cutoff = keyOf(now - keep);
+
+            for (const auto& path : files) {
+                if (levelOf(path) != level) {
+                    continue;
+                }
+                auto failed = failed_files_.find(path);
+                if (failed != failed_files_.end() && std::chrono::steady_clock::now() < failed->second.at) {
+                    continue;
+                }
+                if (isStopping() || overBudget(io_bytes)) {
+                    cycles_.fetch_add(1, std::memory_order_relaxed);
+                    return expired;
+                }
+
+                // A segment's data starts about when the segment did: one
+                // started after the cutoff is kept without reading it
+                if (level == 0 && SegmentNames::startKey(output_file_, path) >= cutoff) {
+                    continue;
+                }
+
+                uint64_t first_key = 0;
+                uint64_t last_key = 0;
+                bool empty = false;
+                try {
+                    if (!fileRange(path, first_key, last_key, empty) || (!empty && last_key >= cutoff)) {
+                        continue;
+                    }
+                } catch (const std::exception&) {
+                    continue; // Removed since the listing, or not ours
+                }
+
+                // A file that does not fit what is left of the budget waits
+                // for the next cycle, unless nothing else ran in this one
+                std::error_code ec;
+                const uint64_t size = std::filesystem::file_size(path, ec);
+                if (!ec && io_bytes > 0 && overBudget(io_bytes + size)) {
+                    cycles_.fetch_add(1, std::memory_order_relaxed);
+                    return expired;
+                }
+
+                if (expire(path, level, io_bytes)) {
+                    failed_files_.erase(path);
+                    ++expired;
+                }
+            }
+        }
+
+        cycles_.fetch_add(1, std::memory_order_relaxed);
+        return expired;
+    }
+
+    bool RetentionManager::overBudget(uint64_t io_bytes) const {
+        return options_.bytes_per_cycle != 0 && io_bytes >= options_.bytes_per_cycle;
+    }
+
+    bool RetentionManager::expire(const std::string& path, size_t level, uint64_t& io_bytes) {
+        std::error_code ec;
+        try {
+            if (level == options_.rollups.size()) {
+                io_bytes += std::filesystem::file_size(path);
+                std::filesystem::remove(path);
+                deleted_files_.fetch_add(1, std::memory_order_relaxed);
+                std::cout << "Deleted expired " << path << std::endl;
+                return true;
+            }
+
+            // Cells of this file, bucketed for the next tier and grouped by
+            // the rollup file they go to
+            const uint64_t seconds = static_cast<uint64_t>(options_.rollups[level].resolution.count());
+            std::map<std::string, Rollup> targets;
+            uint64_t source_last_key = 0;
+            auto add = [&](const std::string& name, uint64_t key, const RollupCell& cell) {
+                const uint64_t bucket = bucketKey(key, seconds);
+                targets[rollupPath(level, bucket)].metrics[name][bucket].merge(cell);
+                source_last_key = std::max(source_last_key, key);
+            };
+
+            const std::string data = readFile(path);
+            io_bytes += data.size();
+            input_bytes_.fetch_add(data.size(), std::memory_order_relaxed);
+
+            if (level > 0) {
+                Rollup rollup;
+                decodeRollup(data, rollup);
+                for (const auto& [name, cells] : rollup.metrics) {
+                    for (const auto& [key, cell] : cells) {
+                        add(name, key, cell);
+                    }
+                }
+            } else if (ColumnarArchive::isArchive(data)) {
+                std::string value;
+                for (const auto& series : ColumnarArchive::decode(data)) {
+                    for (size_t i = 0; i < series.size(); ++i) {
+                        value.clear();
+                        series.appendValue(i, value);
+                        double number = 0.0;
+                        if (parseDouble(value, number)) {
+                            add(series.name, series.keys[i], RollupCell{ 1, number, number, number });
+                        }
+                    }
+                }
+            } else {
+                MappedFile file(path);
+                SegmentFooter footer;
+                const bool has_footer = SegmentFooter::read(file, footer, false);
+                MetricFileCursor cursor(file, has_footer ? footer.getDataSize() : file.size());
+                std::string name;
+                size_t samples = 0;
+                while (cursor.next()) {
+                    if (++samples % kStopCheckSamples == 0 && isStopping()) {
+                        return false;
+                    }
+                    const MetricSample& sample = cursor.current();
+                    double number = 0.0;
+                    if (parseDouble(sample.value, number)) {
+                        name.assign(sample.name);
+                        add(name, sample.time_key, RollupCell{ 1, number, number, number });
+                    }
+                }
+            }
+
+            const std::string source = sourceName(path, level == 0);
+            std::string encoded;
+            bool merged = false;    // A rollup was written by this call
+            for (auto& [target_path, cells] : targets) {
+                if (merged && (isStopping() || overBudget(io_bytes))) {
+                    // The rollups written so far list the file; the next
+                    // cycle merges it into the rest
+                    std::cout << "Paused rolling up " << path << " at the cycle budget" << std::endl;
+                    return false;
+                }
+
+                Rollup target;
+                if (std::filesystem::exists(target_path, ec)) {
+                    const std::string existing = readFile(target_path);
+                    io_bytes += existing.size();
+                    decodeRollup(existing, target);
+                }
+                if (target.sources.count(source) != 0) {
+                    // Merged before a stop or crash; only the removal is
+                    // left, once the rollup's rename is known to be on disk
+                    if (!DurableFile::syncDirectory(target_path)) {
+                        throw std::runtime_error("failed to sync the directory of " + target_path);
+                    }
+                    continue;
+                }
+
+                for (const auto& [name, buckets] : cells.metrics) {
+                    auto& target_cells = target.metrics[name];
+                    for (const auto& [key, cell] : buckets) {
+                        target_cells[key].merge(cell);
+                    }
+                }
+                target.sources[source] = source_last_key;
+
+                encoded.clear();
+                encodeRollup(target, encoded);
+                writeRollup(target_path, encoded);
+                merged = true;
+                io_bytes += encoded.size();
+                output_bytes_.fetch_add(encoded.size(), std::memory_order_relaxed);
+            }
+
+            std::filesystem::remove(path);
+            downsampled_files_.fetch_add(1, std::memory_order_relaxed);
+            std::cout << "Rolled up " << path << " into " << targets.size() << " " << labels_[level] << " rollup"
+                      << (targets.size() == 1 ? "" : "s") << std::endl;
+            return true;
+
+        } catch (const std::exception& e) {
+            failures_.fetch_add(1, std::memory_order_relaxed);
+            auto [it, first] = failed_files_.try_emplace(path, Retry{ {}, options_.retry_delay });
+            if (!first) {
+                it->second.delay = std::min(it->second.delay * 2, options_.max_retry_delay);
+            }
+            it->second.at = std::chrono::steady_clock::now() + it->second.delay;
+            std::cerr << "Failed to expire " << path << ": " << e.what() << " (retry in "
+                      << it->second.delay.count() << " s)" << std::endl;
+            return false;
+        }
+    }
+
+} // namespace MetricsSystem
\ No newline at end of file
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace MetricsSystem {
+
+    struct RollupTier {
+        std::chrono::seconds resolution;    // Bucket width; must divide a day
+        std::chrono::seconds keep;          // Age after which the rollup moves on (or is deleted)
+    };
+
+    // "Keep raw data for 2 days, 1 minute rollups for 30 days and 1 hour
+    // rollups for a year". Each tier must be coarser than the one before
+    // (and a multiple of it) and kept longer.
+    struct RetentionOptions {
+        std::chrono::seconds raw_keep = std::chrono::hours(48);
+        std::vector<RollupTier> rollups = {
+            { std::chrono::minutes(1), std::chrono::hours(24 * 30) },
+            { std::chrono::hours(1), std::chrono::hours(24 * 365) },
+        };
+        std::chrono::seconds cycle_interval{ 300 };
+        uint64_t bytes_per_cycle = 64 * 1024 * 1024;   // Read plus write budget of one cycle (0: unlimited)
+        std::chrono::seconds retry_delay{ 300 };        // Before a failed file is tried again; doubles per failure
+        std::chrono::seconds max_retry_delay{ 6 * 3600 };
+    };
+
+    struct RetentionStats {
+        uint64_t cycles = 0;
+        uint64_t downsampled_files = 0;     // Files merged into the next tier, then deleted
+        uint64_t deleted_files = 0;         // Files past the last tier, deleted
+        uint64_t failures = 0;              // Files that could not be read or merged (left for a retry)
+        uint64_t input_bytes = 0;
+        uint64_t output_bytes = 0;
+    };
+
+    // Applies a RetentionOptions policy to the files of an output file (see
+    // SegmentNames). Finished segments and their archives older than
+    // raw_keep are rolled up into the first tier, rollups older than their
+    // tier's keep into the next one, and files past the last tier are
+    // deleted. The file being written is never touched. Segments without
+    // a footer (footers off) are kept while their name's start time is
+    // within raw_keep and read through to find their time range after;
+    // files in other formats (CSV, JSON Lines) are left alone.
+    //
+    // A rollup is a columnar archive holding <name>:count, <name>:sum,
+    // <name>:min and <name>:max per metric and bucket (so tiers merge
+    // exactly), one file per day below hourly resolution and per month
+    // from there on: metrics.1m.20250601.mca, metrics.1h.202506.mca.
+    // Non-numeric samples are not rolled up. Each rollup also lists the
+    // files merged into it, so a cycle interrupted between writing a
+    // rollup and deleting its source only finishes the deletion later.
+    // A source is deleted only after its rollups (and their directory
+    // entries) have been synced to disk.
+    //
+    // Each cycle works finest tier first and stops at bytes_per_cycle;
+    // the rest waits for the next cycle. A file that would take the cycle
+    // past its budget waits too, unless it is the cycle's first, and one
+    // merging into several rollups stops between them once the budget is
+    // spent (the rollups already written list it, so the next cycle goes
+    // on from there). A file that fails is tried again after retry_delay,
+    // doubling up to max_retry_delay. Cycles run on their own thread at
+    // the lowest scheduling priority.
+    class RetentionManager {
+    private:
+        std::string output_file_;
+        RetentionOptions options_;
+        std::vector<std::string> labels_;                   // File name label per rollup tier ("1m")
+        std::thread thread_;
+        std::mutex cycle_mutex_;                            // One cycle at a time
+
+        struct Retry {
+            std::chrono::steady_clock::time_point at;
+            std::chrono::seconds delay;
+        };
+        std::unordered_map<std::string, Retry> failed_files_;  // Skipped until their retry time (cycle_mutex_)
+
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        bool stopping_;
+
+        std::atomic<uint64_t> cycles_;
+        std::atomic<uint64_t> downsampled_files_;
+        std::atomic<uint64_t> deleted_files_;
+        std::atomic<uint64_t> failures_;
+        std::atomic<uint64_t> input_bytes_;
+        std::atomic<uint64_t> output_bytes_;
+
+        void run();
+        bool isStopping();
+
+        // 0 for raw files, i + 1 for rollups of tier i, SIZE_MAX otherwise
+        size_t levelOf(const std::string& path) const;
+        std::string rollupPath(size_t tier, uint64_t key) const;
+
+        bool overBudget(uint64_t io_bytes) const;
+
+        // Roll the file up into the next tier (or delete it past the last
+        // one); adds the bytes read and written to `io_bytes`. False if it
+        // failed, or stopped at the budget or a stop before finishing.
+        bool expire(const std::string& path, size_t level, uint64_t& io_bytes);
+
+    public:
+        explicit RetentionManager(const std::string& output_file, RetentionOptions options = RetentionOptions());
+        ~RetentionManager();
+
+        RetentionManager(const RetentionManager&) = delete;
+        RetentionManager& operator=(const RetentionManager&) = delete;
+
+        void start();
+        void stop();
+
+        // Run one cycle on the calling thread; returns how many files were
+        // rolled up or deleted
+        size_t runCycle();
+
+        RetentionStats getStats() const;
+    };
+
+} // namespace MetricsSystem
\ No newline at end of file
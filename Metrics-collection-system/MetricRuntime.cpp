@@ -0,0 +1,159 @@
+#include "MetricRuntime.h"
+#include "MetricSystem.h"
+#include <algorithm>
+#include <iostream>
+
+namespace MetricsSystem {
+
+    // MetricRuntime Implementation
+    MetricRuntime::MetricRuntime(size_t pool_threads, std::chrono::milliseconds tick_interval,
+                                 std::shared_ptr<Clock> clock)
+        : pool_(pool_threads == 0 ? WorkerPool::defaultThreadCount() : pool_threads),
+          tick_interval_(tick_interval), clock_(std::move(clock)), ticking_(nullptr), stopping_(false),
+          io_stopping_(false) {
+        if (tick_interval_ <= std::chrono::milliseconds(0)) {
+            throw std::invalid_argument("Tick interval must be positive");
+        }
+
+        io_thread_ = std::thread(&MetricRuntime::ioLoop, this);
+        scheduler_thread_ = std::thread(&MetricRuntime::schedulerLoop, this);
+        std::cout << "MetricRuntime started with " << pool_.size() << " pool threads" << std::endl;
+    }
+
+    MetricRuntime::~MetricRuntime() {
+        {
+            std::lock_guard<std::mutex> lock(collectors_mutex_);
+            stopping_ = true;
+        }
+        scheduler_cv_.notify_all();
+        if (scheduler_thread_.joinable()) {
+            scheduler_thread_.join();
+        }
+
+        // Drain outstanding writes before the I/O thread exits
+        {
+            std::lock_guard<std::mutex> lock(io_mutex_);
+            io_stopping_ = true;
+        }
+        io_cv_.notify_all();
+        if (io_thread_.joinable()) {
+            io_thread_.join();
+        }
+
+        std::cout << "MetricRuntime stopped" << std::endl;
+    }
+
+    void MetricRuntime::attach(MetricCollector* collector) {
+        if (!collector) {
+            throw std::invalid_argument("Cannot attach null collector");
+        }
+
+        std::lock_guard<std::mutex> lock(collectors_mutex_);
+        if (std::find(collectors_.begin(), collectors_.end(), collector) == collectors_.end()) {
+            collectors_.push_back(collector);
+        }
+    }
+
+    void MetricRuntime::detach(MetricCollector* collector) {
+        std::unique_lock<std::mutex> lock(collectors_mutex_);
+        collectors_.erase(std::remove(collectors_.begin(), collectors_.end(), collector), collectors_.end());
+
+        // The scheduler thread itself cannot wait for the tick it is running
+        if (std::this_thread::get_id() != scheduler_thread_.get_id()) {
+            tick_done_cv_.wait(lock, [this, collector]() { return ticking_ != collector; });
+        }
+    }
+
+    void MetricRuntime::postIO(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(io_mutex_);
+            io_tasks_.push(std::move(task));
+        }
+        io_cv_.notify_one();
+    }
+
+    size_t MetricRuntime::getCollectorCount() {
+        std::lock_guard<std::mutex> lock(collectors_mutex_);
+        return collectors_.size();
+    }
+
+    void MetricRuntime::schedulerLoop() {
+        // Ticks are aligned to a fixed grid, so every collector is served by
+        // a single wakeup per interval
+        auto next_tick = clock().steadyNow() + tick_interval_;
+
+        std::vector<MetricCollector*> due;
+        std::unique_lock<std::mutex> lock(collectors_mutex_);
+        while (!stopping_) {
+            if (clock().waitUntil(lock, scheduler_cv_, next_tick, [this]() { return stopping_; })) {
+                break;
+            }
+
+            // Ticks run without the lock, so a slow collector or a gauge
+            // callback that attaches, detaches or stops a collector does
+            // not block the others. One detached meanwhile is skipped.
+            due = collectors_;
+            for (MetricCollector* collector : due) {
+                if (std::find(collectors_.begin(), collectors_.end(), collector) == collectors_.end()) {
+                    continue;
+                }
+
+                ticking_ = collector;
+                lock.unlock();
+                try {
+                    collector->runScheduledTick();
+                } catch (const std::exception& e) {
+                    std::cerr << "Scheduled metrics tick failed: " << e.what() << std::endl;
+                }
+                lock.lock();
+                ticking_ = nullptr;
+                tick_done_cv_.notify_all();
+            }
+
+            // Skip missed ticks instead of bursting to catch up
+            auto now = clock().steadyNow();
+            next_tick += tick_interval_;
+            if (next_tick <= now) {
+                auto behind = (now - next_tick) / tick_interval_ + 1;
+                next_tick += tick_interval_ * behind;
+            }
+        }
+    }
+
+    void MetricRuntime::ioLoop() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(io_mutex_);
+                io_cv_.wait(lock, [this]() { return io_stopping_ || !io_tasks_.empty(); });
+
+                if (io_tasks_.empty()) {
+                    return; // Stopping and fully drained
+                }
+
+                task = std::move(io_tasks_.front());
+                io_tasks_.pop();
+            }
+
+            try {
+                task();
+            } catch (const std::exception& e) {
+                std::cerr << "Metrics I/O task failed: " << e.what() << std::endl;
+            }
+        }
+    }
+
+    std::shared_ptr<MetricRuntime> MetricRuntime::shared() {
+        static std::mutex shared_mutex;
+        static std::weak_ptr<MetricRuntime> shared_runtime;
+
+        std::lock_guard<std::mutex> lock(shared_mutex);
+        auto runtime = shared_runtime.lock();
+        if (!runtime) {
+            runtime = std::make_shared<MetricRuntime>();
+            shared_runtime = runtime;
+        }
+        return runtime;
+    }
+
+} // namespace MetricsSystem
\ No newline at end of file
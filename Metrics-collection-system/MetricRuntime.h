@@ -0,0 +1,81 @@
+#pragma once
+
+#include "MetricWorkerPool.h"
+#include "MetricClock.h"
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace MetricsSystem {
+
+    class MetricCollector;
+
+    // Process-wide runtime shared by many collectors.
+    // One scheduler thread ticks every attached collector, a worker pool
+    // sweeps large registries and one I/O thread performs all file writes.
+    // Thread count and wakeups stay constant no matter how many
+    // MetricSystemManager instances are attached.
+    class MetricRuntime {
+    private:
+        WorkerPool pool_;
+        std::chrono::milliseconds tick_interval_;
+        std::shared_ptr<Clock> clock_;      // Null: Clock::getDefault()
+
+        // Attached collectors (protected by collectors_mutex_). The scheduler
+        // runs ticks without the lock; detach() waits for the running one.
+        std::vector<MetricCollector*> collectors_;
+        std::mutex collectors_mutex_;
+        std::condition_variable scheduler_cv_;
+        MetricCollector* ticking_;              // Collector whose tick is running, if any
+        std::condition_variable tick_done_cv_;
+        bool stopping_;
+        std::thread scheduler_thread_;
+
+        // Write tasks executed in submission order on the I/O thread
+        std::queue<std::function<void()>> io_tasks_;
+        std::mutex io_mutex_;
+        std::condition_variable io_cv_;
+        bool io_stopping_;
+        std::thread io_thread_;
+
+        void schedulerLoop();
+        void ioLoop();
+        Clock& clock() const { return clock_ ? *clock_ : Clock::getDefault(); }
+
+    public:
+        explicit MetricRuntime(size_t pool_threads = 0,
+                               std::chrono::milliseconds tick_interval = std::chrono::seconds(1),
+                               std::shared_ptr<Clock> clock = nullptr);
+        ~MetricRuntime();
+
+        // Non-copyable, non-movable (owns threads)
+        MetricRuntime(const MetricRuntime&) = delete;
+        MetricRuntime& operator=(const MetricRuntime&) = delete;
+        MetricRuntime(MetricRuntime&&) = delete;
+        MetricRuntime& operator=(MetricRuntime&&) = delete;
+
+        // Collector registration (called from MetricCollector::start/stop).
+        // detach() waits for a tick of the collector that is running, so the
+        // scheduler does not touch it afterwards; called from a tick (e.g. a
+        // gauge callback stopping another collector) it does not wait.
+        void attach(MetricCollector* collector);
+        void detach(MetricCollector* collector);
+
+        // Queue a write task for the I/O thread
+        void postIO(std::function<void()> task);
+
+        WorkerPool& pool() { return pool_; }
+        std::chrono::milliseconds getTickInterval() const { return tick_interval_; }
+        size_t getCollectorCount();
+
+        // Process-wide instance, created on first use and destroyed when the
+        // last collector using it goes away
+        static std::shared_ptr<MetricRuntime> shared();
+    };
+
+} // namespace MetricsSystem
\ No newline at end of file
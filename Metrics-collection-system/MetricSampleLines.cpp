@@ -0,0 +1,122 @@
+#include "MetricSampleLines.h"
+#include <charconv>
+#include <iostream>
+#include <system_error>
+
+namespace MetricsSystem {
+
+    namespace {
+
+        // Undo appendEscaped() into `out`
+        void unescape(std::string_view text, std::string& out) {
+            out.clear();
+            for (size_t i = 0; i < text.size(); ++i) {
+                char c = text[i];
+                if (c == '\\' && i + 1 < text.size()) {
+                    switch (text[++i]) {
+                        case 't': c = '\t'; break;
+                        case 'n': c = '\n'; break;
+                        case 'r': c = '\r'; break;
+                        default: c = text[i]; break;
+                    }
+                }
+                out.push_back(c);
+            }
+        }
+
+        // Whole of `text` parsed as a number, in range
+        template<typename T>
+        bool parseNumber(std::string_view text, T& value) {
+            auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+            return result.ec == std::errc() && result.ptr == text.data() + text.size();
+        }
+
+    } // namespace
+
+    void SampleLines::appendEscaped(std::string& out, std::string_view text) {
+        for (char c : text) {
+            switch (c) {
+                case '\\': out.append("\\\\"); break;
+                case '\t': out.append("\\t"); break;
+                case '\n': out.append("\\n"); break;
+                case '\r': out.append("\\r"); break;
+                default: out.push_back(c); break;
+            }
+        }
+    }
+
+    void SampleLines::format(const MetricEntry* first, const MetricEntry* last, std::string& out) {
+        const TimePoint* cached_tp = nullptr;
+        char ts[24];
+        size_t ts_length = 0;
+
+        for (const MetricEntry* entry = first; entry != last; ++entry) {
+            const size_t start = out.size();
+            try {
+                if (!cached_tp || *cached_tp != entry->timestamp) {
+                    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(entry->timestamp.time_since_epoch()).count();
+                    ts_length = static_cast<size_t>(std::to_chars(ts, ts + sizeof(ts), ms).ptr - ts);
+                    cached_tp = &entry->timestamp;
+                }
+
+                out.append(ts, ts_length);
+                out.push_back('\t');
+                appendEscaped(out, entry->name);
+                out.append("\tn");
+
+                if (!entry->value->appendNumber(out)) {
+                    if (entry->value->asDouble()) {
+                        out.back() = '-'; // NaN or infinity
+                    } else {
+                        out.back() = 's';
+                        appendEscaped(out, entry->value->toString());
+                    }
+                }
+                out.push_back('\n');
+
+            } catch (const std::exception& e) {
+                out.resize(start);
+                std::cerr << "Error formatting metric entry '" << entry->name << "': " << e.what() << std::endl;
+            }
+        }
+    }
+
+    bool SampleLines::next(std::string_view& batch, SampleLine& line) {
+        size_t end = batch.find('\n');
+        std::string_view text = batch.substr(0, end);
+        batch.remove_prefix(end == std::string_view::npos ? batch.size() : end + 1);
+
+        size_t name_start = text.find('\t');
+        size_t value_start = name_start == std::string_view::npos ? name_start : text.find('\t', name_start + 1);
+        if (value_start == std::string_view::npos || value_start + 1 >= text.size() ||
+            !parseNumber(text.substr(0, name_start), line.timestamp_ms)) {
+            return false;
+        }
+        unescape(text.substr(name_start + 1, value_start - name_start - 1), line.name);
+
+        std::string_view value = text.substr(value_start + 2);
+        switch (text[value_start + 1]) {
+            case 'n':
+                // Integers beyond int64 (large uint64 counters) are read as reals
+                if (parseNumber(value, line.integer)) {
+                    line.kind = SampleLine::Kind::Integer;
+                } else if (parseNumber(value, line.real)) {
+                    line.kind = SampleLine::Kind::Real;
+                } else {
+                    return false;
+                }
+                break;
+            case 's':
+                unescape(value, line.text);
+                line.kind = SampleLine::Kind::Text;
+                break;
+            case '-':
+                line.kind = SampleLine::Kind::Null;
+                break;
+            default:
+                return false;
+        }
+        return true;
+    }
+
+} // namespace MetricsSystem 
\ No newline at end of file
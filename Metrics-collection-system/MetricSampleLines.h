@@ -0,0 +1,48 @@
+#pragma once
+
+#include "MetricSystem.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace MetricsSystem {
+
+    // One parsed sample line, see SampleLines. Buffers are reused from line
+    // to line.
+    struct SampleLine {
+        enum class Kind {
+            Integer,
+            Real,
+            Text,
+            Null        // Non-finite number
+        };
+
+        int64_t timestamp_ms = 0;   // Since the Unix epoch
+        std::string name;
+        Kind kind = Kind::Null;
+        int64_t integer = 0;
+        double real = 0.0;
+        std::string text;
+    };
+
+    // Intermediate line form of metric entries for sinks that are not files
+    // (SQLite, remote write):
+    //   <epoch ms>\t<name>\t<kind><value>\n
+    // with kind n for numbers, s for text and - for non-finite numbers, and
+    // backslash, tab and line breaks in names and text escaped. Lines stand
+    // alone, so batches can be buffered, coalesced and spooled like text
+    // output and are parsed again by the sink when it writes them.
+    class SampleLines {
+    public:
+        static void format(const MetricEntry* first, const MetricEntry* last, std::string& out);
+
+        // Parse the first line of `batch` into `line` and drop it from the
+        // batch. Returns false for a malformed line (e.g. from a spool left
+        // behind by another output format), which is dropped as well.
+        static bool next(std::string_view& batch, SampleLine& line);
+
+        // Append `text` with backslash, tab and line breaks escaped
+        static void appendEscaped(std::string& out, std::string_view text);
+    };
+
+} // namespace MetricsSystem
\ No newline at end of file
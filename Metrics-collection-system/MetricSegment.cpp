@@ -0,0 +1,462 @@
+#include "MetricSegment.h"
+#include <algorithm>
+#include <charconv>
+#include <filesystem>
+#include <string>
+
+namespace MetricsSystem {
+
+    namespace {
+
+        const std::string_view kSummaryPrefix = "#segment ";
+        const std::string_view kBloomPrefix = "#bloom ";
+        const std::string_view kStatsPrefix = "#stat ";
+        const std::string_view kTrailerPrefix = "#end-segment ";
+
+        // About 1% false positives at 10 bits per metric
+        const uint32_t kBloomHashes = 7;
+        const size_t kBloomBitsPerMetric = 10;
+        const size_t kMinBloomBits = 64;
+
+        uint64_t hashName(std::string_view name) {
+            // FNV-1a
+            uint64_t hash = 14695981039346656037ull;
+            for (unsigned char c : name) {
+                hash ^= c;
+                hash *= 1099511628211ull;
+            }
+            return hash;
+        }
+
+        template<typename T>
+        void appendNumber(std::string& out, T value) {
+            char digits[32];
+            auto result = std::to_chars(digits, digits + sizeof(digits), value);
+            out.append(digits, result.ptr);
+        }
+
+        // Take the next space-separated token off the front of `rest`
+        std::string_view takeToken(std::string_view& rest) {
+            size_t end = rest.find(' ');
+            std::string_view token = rest.substr(0, end);
+            rest = end == std::string_view::npos ? std::string_view() : rest.substr(end + 1);
+            return token;
+        }
+
+        template<typename T>
+        bool parseNumber(std::string_view text, T& value) {
+            auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+            return result.ec == std::errc() && result.ptr == text.data() + text.size() && !text.empty();
+        }
+
+        // Timestamp text, or "-" for an empty segment (key 0)
+        bool takeTime(std::string_view& rest, uint64_t& key) {
+            if (!rest.empty() && rest[0] == '-') {
+                key = 0;
+                return takeToken(rest) == "-";
+            }
+            if (rest.size() < MetricTimeKey::kTimestampLength) {
+                return false;
+            }
+
+            key = MetricTimeKey::parse(rest.substr(0, MetricTimeKey::kTimestampLength));
+            rest.remove_prefix(MetricTimeKey::kTimestampLength);
+            if (!rest.empty()) {
+                if (rest[0] != ' ') {
+                    return false;
+                }
+                rest.remove_prefix(1);
+            }
+            return key != 0;
+        }
+
+        void appendTime(std::string& out, uint64_t key) {
+            if (key == 0) {
+                out.push_back('-');
+            } else {
+                MetricTimeKey::format(key, out);
+            }
+        }
+
+        int hexDigit(char c) {
+            if (c >= '0' && c <= '9') {
+                return c - '0';
+            }
+            if (c >= 'a' && c <= 'f') {
+                return c - 'a' + 10;
+            }
+            return -1;
+        }
+
+        // Next line of `rest` without its '\n'; false at the end
+        bool takeLine(std::string_view& rest, std::string_view& line) {
+            if (rest.empty()) {
+                return false;
+            }
+            size_t end = rest.find('\n');
+            line = rest.substr(0, end);
+            rest = end == std::string_view::npos ? std::string_view() : rest.substr(end + 1);
+            return true;
+        }
+
+    } // namespace
+
+    // SegmentFooter Implementation
+    SegmentFooter::SegmentFooter()
+        : first_key_(0), last_key_(0), samples_(0), metric_count_(0), data_size_(0), format_(SegmentFormat::Unknown),
+          bloom_hashes_(kBloomHashes) {}
+
+    SegmentFooter SegmentFooter::build(const MappedFile& file) {
+        SegmentFooter footer;
+        MetricFileCursor cursor(file);
+        while (cursor.next()) {
+            footer.addSample(cursor.current());
+            cursor.releaseConsumed();
+        }
+        footer.finish(file.size());
+        return footer;
+    }
+
+    void SegmentFooter::addSample(const MetricSample& sample) {
+        if (samples_ == 0 || sample.time_key < first_key_) {
+            first_key_ = sample.time_key;
+        }
+        if (sample.time_key > last_key_) {
+            last_key_ = sample.time_key;
+        }
+        ++samples_;
+
+        auto it = metrics_.find(sample.name);
+        if (it == metrics_.end()) {
+            it = metrics_.emplace(std::string(sample.name), SegmentMetricStats()).first;
+        }
+        SegmentMetricStats& metric = it->second;
+        ++metric.count;
+
+        double value = 0.0;
+        if (parseNumber(sample.value, value)) {
+            if (!metric.has_range) {
+                metric.has_range = true;
+                metric.min = value;
+                metric.max = value;
+            } else if (value < metric.min) {
+                metric.min = value;
+            } else if (value > metric.max) {
+                metric.max = value;
+            }
+        }
+    }
+
+    void SegmentFooter::finish(size_t data_size) {
+        data_size_ = data_size;
+        metric_count_ = metrics_.size();
+
+        size_t bits = kMinBloomBits;
+        while (bits < metrics_.size() * kBloomBitsPerMetric) {
+            bits *= 2;
+        }
+        bloom_.assign(bits / 8, 0);
+        for (const auto& entry : metrics_) {
+            addToBloom(entry.first);
+        }
+    }
+
+    void SegmentFooter::addToBloom(std::string_view name) {
+        // Double hashing: probe i is h1 + i * h2
+        const uint64_t hash = hashName(name);
+        const uint32_t h1 = static_cast<uint32_t>(hash);
+        const uint32_t h2 = static_cast<uint32_t>(hash >> 32) | 1;
+        const size_t mask = bloom_.size() * 8 - 1;
+
+        for (uint32_t i = 0; i < bloom_hashes_; ++i) {
+            size_t bit = static_cast<uint32_t>(h1 + i * h2) & mask;
+            bloom_[bit / 8] |= static_cast<uint8_t>(1u << (bit % 8));
+        }
+    }
+
+    bool SegmentFooter::mayContain(std::string_view name) const {
+        if (bloom_.empty()) {
+            return true; // No filter to ask
+        }
+
+        const uint64_t hash = hashName(name);
+        const uint32_t h1 = static_cast<uint32_t>(hash);
+        const uint32_t h2 = static_cast<uint32_t>(hash >> 32) | 1;
+        const size_t mask = bloom_.size() * 8 - 1;
+
+        for (uint32_t i = 0; i < bloom_hashes_; ++i) {
+            size_t bit = static_cast<uint32_t>(h1 + i * h2) & mask;
+            if (!(bloom_[bit / 8] & (1u << (bit % 8)))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool SegmentFooter::overlaps(uint64_t from_key, uint64_t to_key) const {
+        return samples_ > 0 && first_key_ <= to_key && last_key_ >= from_key;
+    }
+
+    void SegmentFooter::format(std::string& out) const {
+        out.append(kSummaryPrefix);
+        appendNumber(out, kVersion);
+        out.push_back(' ');
+        appendTime(out, samples_ > 0 ? first_key_ : 0);
+        out.push_back(' ');
+        appendTime(out, samples_ > 0 ? last_key_ : 0);
+        out.push_back(' ');
+        appendNumber(out, samples_);
+        out.push_back(' ');
+        appendNumber(out, metric_count_);
+        out.push_back(' ');
+        out.append(format_ == SegmentFormat::Text ? "text" : format_ == SegmentFormat::Compact ? "compact" : "-");
+        out.push_back('\n');
+
+        static const char kHex[] = "0123456789abcdef";
+        out.append(kBloomPrefix);
+        appendNumber(out, bloom_hashes_);
+        out.push_back(' ');
+        appendNumber(out, bloom_.size() * 8);
+        out.push_back(' ');
+        for (uint8_t byte : bloom_) {
+            out.push_back(kHex[byte >> 4]);
+            out.push_back(kHex[byte & 0xF]);
+        }
+        out.push_back('\n');
+
+        for (const auto& [name, metric] : metrics_) {
+            out.append(kStatsPrefix);
+            appendNumber(out, metric.count);
+            if (metric.has_range) {
+                out.push_back(' ');
+                appendNumber(out, metric.min);
+                out.push_back(' ');
+                appendNumber(out, metric.max);
+            } else {
+                out.append(" - -");
+            }
+            out.append(" \"");
+            out.append(name);
+            out.append("\"\n");
+        }
+
+        // Fixed width, so readers find the footer from the end of the file
+        const std::string offset = std::to_string(data_size_);
+        out.append(kTrailerPrefix);
+        out.append(kTrailerSize - kTrailerPrefix.size() - 1 - offset.size(), '0');
+        out.append(offset);
+        out.push_back('\n');
+    }
+
+    bool SegmentFooter::read(const MappedFile& file, SegmentFooter& footer, bool with_stats) {
+        const size_t size = file.size();
+        if (size < kTrailerSize) {
+            return false;
+        }
+
+        std::string_view data(file.data(), size);
+        std::string_view trailer = data.substr(size - kTrailerSize);
+        size_t offset = 0;
+        if (trailer.substr(0, kTrailerPrefix.size()) != kTrailerPrefix || trailer.back() != '\n' ||
+            !parseNumber(trailer.substr(kTrailerPrefix.size(), kTrailerSize - kTrailerPrefix.size() - 1), offset) ||
+            offset > size - kTrailerSize || (offset > 0 && data[offset - 1] != '\n')) {
+            return false;
+        }
+
+        SegmentFooter parsed;
+        parsed.data_size_ = offset;
+
+        std::string_view rest = data.substr(offset, size - kTrailerSize - offset);
+        std::string_view line;
+        if (!takeLine(rest, line) || !parsed.parseSummary(line) || !takeLine(rest, line) || !parsed.parseBloom(line)) {
+            return false;
+        }
+
+        if (with_stats) {
+            while (takeLine(rest, line)) {
+                if (!parsed.parseStats(line)) {
+                    return false;
+                }
+            }
+            if (parsed.metrics_.size() != parsed.metric_count_) {
+                return false;
+            }
+        }
+
+        footer = std::move(parsed);
+        return true;
+    }
+
+    bool SegmentFooter::parseSummary(std::string_view line) {
+        // #segment <version> <first> <last> <samples> <metrics> [<format>]
+        if (line.substr(0, kSummaryPrefix.size()) != kSummaryPrefix) {
+            return false;
+        }
+        std::string_view rest = line.substr(kSummaryPrefix.size());
+
+        uint32_t version = 0;
+        if (!parseNumber(takeToken(rest), version) || version < 1 || version > kVersion) {
+            return false;
+        }
+        if (!takeTime(rest, first_key_) || !takeTime(rest, last_key_)) {
+            return false;
+        }
+        if (!parseNumber(takeToken(rest), samples_) || !parseNumber(takeToken(rest), metric_count_)) {
+            return false;
+        }
+
+        format_ = SegmentFormat::Unknown;
+        if (version >= 2) {
+            std::string_view format = takeToken(rest);
+            if (format == "text") {
+                format_ = SegmentFormat::Text;
+            } else if (format == "compact") {
+                format_ = SegmentFormat::Compact;
+            } else if (format != "-") {
+                return false;
+            }
+        }
+        return rest.empty();
+    }
+
+    bool SegmentFooter::parseBloom(std::string_view line) {
+        // #bloom <hashes> <bits> <hex>
+        if (line.substr(0, kBloomPrefix.size()) != kBloomPrefix) {
+            return false;
+        }
+        std::string_view rest = line.substr(kBloomPrefix.size());
+
+        size_t bits = 0;
+        if (!parseNumber(takeToken(rest), bloom_hashes_) || !parseNumber(takeToken(rest), bits) || bloom_hashes_ == 0 ||
+            bits < 8 || (bits & (bits - 1)) != 0 || rest.size() != bits / 4) {
+            return false;
+        }
+
+        bloom_.resize(bits / 8);
+        for (size_t i = 0; i < bloom_.size(); ++i) {
+            int high = hexDigit(rest[2 * i]);
+            int low = hexDigit(rest[2 * i + 1]);
+            if (high < 0 || low < 0) {
+                return false;
+            }
+            bloom_[i] = static_cast<uint8_t>(high << 4 | low);
+        }
+        return true;
+    }
+
+    bool SegmentFooter::parseStats(std::string_view line) {
+        // #stat <count> <min|-> <max|-> "<name>"
+        if (line.substr(0, kStatsPrefix.size()) != kStatsPrefix) {
+            return false;
+        }
+        std::string_view rest = line.substr(kStatsPrefix.size());
+
+        SegmentMetricStats metric;
+        if (!parseNumber(takeToken(rest), metric.count)) {
+            return false;
+        }
+
+        std::string_view min = takeToken(rest);
+        std::string_view max = takeToken(rest);
+        if (min != "-" || max != "-") {
+            if (!parseNumber(min, metric.min) || !parseNumber(max, metric.max)) {
+                return false;
+            }
+            metric.has_range = true;
+        }
+
+        if (rest.size() < 2 || rest.front() != '"' || rest.back() != '"') {
+            return false;
+        }
+        metrics_.emplace(std::string(rest.substr(1, rest.size() - 2)), metric);
+        return true;
+    }
+
+    // SegmentFooterBuilder Implementation
+    SegmentFooterBuilder::SegmentFooterBuilder() : data_size_(0) {}
+
+    void SegmentFooterBuilder::add(std::string_view data) {
+        MetricFileCursor cursor(data, dictionary_);
+        while (cursor.next()) {
+            footer_.addSample(cursor.current());
+        }
+        data_size_ += data.size();
+
+        // Names defined by this batch point into it: keep copies for the
+        // batches that use them
+        const std::vector<std::string_view>& defined = cursor.getDictionary();
+        dictionary_.resize(defined.size());
+        for (size_t id = 0; id < defined.size(); ++id) {
+            if (defined[id].data() != dictionary_[id].data()) {
+                names_.emplace_back(defined[id]);
+                dictionary_[id] = names_.back();
+            }
+        }
+    }
+
+    void SegmentFooterBuilder::reset() {
+        footer_ = SegmentFooter();
+        data_size_ = 0;
+        names_.clear();
+        dictionary_.clear();
+    }
+
+    SegmentFooter SegmentFooterBuilder::build() const {
+        SegmentFooter footer = footer_;
+        footer.finish(data_size_);
+        return footer;
+    }
+
+    // SegmentNames Implementation
+    std::vector<std::string> SegmentNames::list(const std::string& output_file) {
+        const std::filesystem::path output(output_file);
+        const std::string prefix = output.stem().string() + ".";
+        const std::filesystem::path directory = output.has_parent_path() ? output.parent_path() : ".";
+
+        std::vector<std::string> paths;
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+            const std::string name = entry.path().filename().string();
+            if (entry.is_regular_file(ec) && name.size() > prefix.size() && name.compare(0, prefix.size(), prefix) == 0) {
+                paths.push_back(entry.path().string());
+            }
+        }
+
+        std::sort(paths.begin(), paths.end());
+        return paths;
+    }
+
+    bool SegmentNames::isSegment(const std::string& output_file, const std::string& path) {
+        // <stem>.<YYYYMMDD-hhmmss>[-n]<extension>, as MetricWriter names them
+        const std::filesystem::path output(output_file);
+        const std::string prefix = output.stem().string() + ".";
+        const std::string extension = output.extension().string();
+        const std::string name = std::filesystem::path(path).filename().string();
+
+        if (name.size() <= prefix.size() + extension.size() || name.compare(0, prefix.size(), prefix) != 0 ||
+            name.compare(name.size() - extension.size(), extension.size(), extension) != 0) {
+            return false;
+        }
+
+        const std::string_view stamp(name.data() + prefix.size(), name.size() - prefix.size() - extension.size());
+        return stamp.size() >= 15 && stamp.find_first_not_of("0123456789-") == std::string_view::npos;
+    }
+
+    uint64_t SegmentNames::startKey(const std::string& output_file, const std::string& path) {
+        if (!isSegment(output_file, path)) {
+            return 0;
+        }
+
+        // <stem>.YYYYMMDD-hhmmss... -> YYYYMMDDhhmmss000
+        const std::string prefix = std::filesystem::path(output_file).stem().string() + ".";
+        const std::string name = std::filesystem::path(path).filename().string();
+        uint64_t key = 0;
+        for (size_t i = prefix.size(); i < prefix.size() + 15; ++i) {
+            if (name[i] != '-') {
+                key = key * 10 + static_cast<uint64_t>(name[i] - '0');
+            }
+        }
+        return key * 1000;
+    }
+
+} // namespace MetricsSystem
\ No newline at end of file
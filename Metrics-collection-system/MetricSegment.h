@@ -0,0 +1,138 @@
+#pragma once
+
+#include "MetricFileReader.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace MetricsSystem {
+
+    // Samples of one metric within a segment. min/max cover the values
+    // that parse as numbers (has_range is false if none did).
+    struct SegmentMetricStats {
+        uint64_t count = 0;
+        bool has_range = false;
+        double min = 0.0;
+        double max = 0.0;
+    };
+
+    // Summary appended to a finished segment (a rotated output file, see
+    // SegmentOptions), so tools can tell from its last few kilobytes whether
+    // the segment can hold what they look for:
+    //   #segment 2 2025-06-01 15:00:01.653 2025-06-01 15:59:59.653 360000 3 text
+    //   #bloom 7 64 <bits as hex>
+    //   #stat 3600 0.01 0.99 "CPU"
+    //   #stat 3600 - - "State"
+    //   #end-segment 00000000000001234567
+    // The first line holds the time range, sample and metric counts and the
+    // line format (text, compact or -; version 1 footers have none); the
+    // bloom filter answers "may this metric be in here" without reading the
+    // #stat lines (about 1% false positives). The last line has a fixed
+    // length and gives the offset of the footer. All lines are comments to
+    // MetricFileCursor, so a segment stays a valid metrics file.
+    class SegmentFooter {
+    private:
+        uint64_t first_key_;
+        uint64_t last_key_;
+        uint64_t samples_;
+        size_t metric_count_;
+        size_t data_size_;              // Bytes before the footer
+        SegmentFormat format_;
+        uint32_t bloom_hashes_;
+        std::vector<uint8_t> bloom_;
+        std::map<std::string, SegmentMetricStats, std::less<>> metrics_;  // Empty unless built or read with stats
+
+        friend class SegmentFooterBuilder;
+
+        void addSample(const MetricSample& sample);
+        void finish(size_t data_size);      // Counts and bloom filter from metrics_
+        void addToBloom(std::string_view name);
+        bool parseSummary(std::string_view line);
+        bool parseBloom(std::string_view line);
+        bool parseStats(std::string_view line);
+
+    public:
+        static constexpr uint32_t kVersion = 2;
+        static constexpr size_t kTrailerSize = 34;  // "#end-segment " + 20 digits + '\n'
+
+        SegmentFooter();
+
+        // Summarize a metrics file by reading it once
+        static SegmentFooter build(const MappedFile& file);
+
+        // Footer of a segment; false if the file does not end with one.
+        // The #stat lines are only read when `with_stats` is set.
+        static bool read(const MappedFile& file, SegmentFooter& footer, bool with_stats = true);
+
+        // Append the footer lines, ending with the trailer that points back
+        // to getDataSize()
+        void format(std::string& out) const;
+
+        uint64_t getFirstKey() const { return first_key_; }
+        uint64_t getLastKey() const { return last_key_; }
+        uint64_t getSamples() const { return samples_; }
+        size_t getMetricCount() const { return metric_count_; }
+        size_t getDataSize() const { return data_size_; }
+        SegmentFormat getFormat() const { return format_; }
+        void setFormat(SegmentFormat format) { format_ = format; }
+        const std::map<std::string, SegmentMetricStats, std::less<>>& metrics() const { return metrics_; }
+
+        // False only if the segment has no sample of `name`
+        bool mayContain(std::string_view name) const;
+
+        // Whether the segment has samples in [from_key, to_key] (packed time keys)
+        bool overlaps(uint64_t from_key, uint64_t to_key) const;
+    };
+
+    // Footer of the segment being written, fed with each batch as it is
+    // appended, so finishing the segment does not read it back. Holds one
+    // entry per metric plus the compact format's names.
+    class SegmentFooterBuilder {
+    private:
+        SegmentFooter footer_;
+        size_t data_size_;                          // Bytes added since reset()
+        std::deque<std::string> names_;             // Compact-format definitions seen so far
+        std::vector<std::string_view> dictionary_;  // Views of names_ by number
+
+    public:
+        SegmentFooterBuilder();
+
+        // Bytes appended to the segment, in whole lines
+        void add(std::string_view data);
+
+        // Start over for a new segment
+        void reset();
+
+        // Bytes added since reset(); the footer only describes the segment
+        // if this is its size
+        size_t getDataSize() const { return data_size_; }
+
+        SegmentFooter build() const;
+    };
+
+    // Files that belong to an output file, e.g. for metrics.txt:
+    //   metrics.20250601-150001.txt         finished segment (see SegmentOptions)
+    //   metrics.20250601-150001.txt.mca     its columnar archive (see SegmentCompactor)
+    //   metrics.1m.20250601.mca             rollup (see RetentionManager)
+    class SegmentNames {
+    public:
+        static constexpr std::string_view kArchiveExtension = ".mca";
+
+        // Files in the output file's directory named <stem>.*, sorted by name
+        static std::vector<std::string> list(const std::string& output_file);
+
+        // Whether the name of `path` is that of a finished segment
+        static bool isSegment(const std::string& output_file, const std::string& path);
+
+        // Time key (see MetricTimeKey) of the second a segment was started,
+        // from its name; 0 if `path` is not a segment. A lower bound for its
+        // data when it has no footer to tell.
+        static uint64_t startKey(const std::string& output_file, const std::string& path);
+    };
+
+} // namespace MetricsSystem
\ No newline at end of file
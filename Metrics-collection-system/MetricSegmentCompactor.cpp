@@ -0,0 +1,327 @@
+#include "MetricSegmentCompactor.h"
+#include "MetricSegment.h"
+#include "MetricUtilities.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace MetricsSystem {
+
+    namespace {
+
+        const size_t kIoChunk = 1 << 20;        // Granularity of the I/O budget
+        const size_t kPiecesPerThread = 4;      // Parse pieces per thread, to even out line density
+        const size_t kPageSize = 4096;
+
+        // Fault in the pages of a mapped range, so parsing runs from memory
+        void touchPages(const char* data, size_t size) {
+            volatile char sink = 0;
+            for (size_t offset = 0; offset < size; offset += kPageSize) {
+                sink = static_cast<char>(sink + data[offset]);
+            }
+        }
+
+    } // namespace
+
+    // SegmentCompactor Implementation
+    SegmentCompactor::SegmentCompactor(const std::string& output_file, CompactionOptions options)
+        : output_file_(output_file), options_(options),
+          pool_(std::make_unique<WorkerPool>(std::max<size_t>(1, options.parse_threads))), stopping_(false),
+          io_ready_(std::chrono::steady_clock::now()), segments_(0), failures_(0), input_bytes_(0), output_bytes_(0) {
+        if (output_file.empty()) {
+            throw std::invalid_argument("Output filename cannot be empty");
+        }
+        if (options_.scan_interval.count() <= 0) {
+            throw std::invalid_argument("Compaction scan interval must be positive");
+        }
+        if (options_.retry_delay.count() <= 0 || options_.max_retry_delay < options_.retry_delay) {
+            throw std::invalid_argument("Compaction retry delays must be positive and increasing");
+        }
+    }
+
+    SegmentCompactor::~SegmentCompactor() {
+        stop();
+    }
+
+    void SegmentCompactor::start() {
+        if (thread_.joinable()) {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = false;
+        }
+        thread_ = std::thread(&SegmentCompactor::run, this);
+    }
+
+    void SegmentCompactor::stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    CompactionStats SegmentCompactor::getStats() const {
+        CompactionStats stats;
+        stats.segments = segments_.load(std::memory_order_relaxed);
+        stats.failures = failures_.load(std::memory_order_relaxed);
+        stats.input_bytes = input_bytes_.load(std::memory_order_relaxed);
+        stats.output_bytes = output_bytes_.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    std::string SegmentCompactor::archivePath(const std::string& segment) {
+        return segment + std::string(SegmentNames::kArchiveExtension);
+    }
+
+    void SegmentCompactor::run() {
+        WorkerPool::lowerThreadPriority();
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stopping_) {
+            lock.unlock();
+            try {
+                compactPending();
+            } catch (const std::exception& e) {
+                std::cerr << "Segment compaction pass failed: " << e.what() << std::endl;
+            }
+            lock.lock();
+
+            cv_.wait_for(lock, options_.scan_interval, [this]() { return stopping_; });
+        }
+    }
+
+    size_t SegmentCompactor::compactPending() {
+        std::lock_guard<std::mutex> pass_lock(pass_mutex_);
+
+        const std::vector<std::string> segments = findSegments();
+
+        // Forget failures of segments that are gone (compacted elsewhere,
+        // removed by retention)
+        for (auto it = failed_segments_.begin(); it != failed_segments_.end();) {
+            if (std::find(segments.begin(), segments.end(), it->first) == segments.end()) {
+                it = failed_segments_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        size_t compacted = 0;
+        for (const auto& segment : segments) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (stopping_) {
+                    break;
+                }
+            }
+
+            auto failed = failed_segments_.find(segment);
+            if (failed != failed_segments_.end() && std::chrono::steady_clock::now() < failed->second.at) {
+                continue;
+            }
+            if (compactSegment(segment)) {
+                failed_segments_.erase(segment);
+                ++compacted;
+            }
+        }
+        return compacted;
+    }
+
+    std::vector<std::string> SegmentCompactor::findSegments() const {
+        std::vector<std::string> segments;
+        for (auto& path : SegmentNames::list(output_file_)) {
+            if (SegmentNames::isSegment(output_file_, path)) {
+                segments.push_back(std::move(path));
+            }
+        }
+        return segments;
+    }
+
+    bool SegmentCompactor::throttle(uint64_t bytes) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (options_.io_bytes_per_second == 0 || stopping_) {
+            return !stopping_;
+        }
+
+        // Pay for the previous chunk before starting this one; idle time is
+        // not saved up for a burst
+        auto now = std::chrono::steady_clock::now();
+        if (io_ready_ < now) {
+            io_ready_ = now;
+        }
+        cv_.wait_until(lock, io_ready_, [this]() { return stopping_; });
+
+        io_ready_ += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(static_cast<double>(bytes) / static_cast<double>(options_.io_bytes_per_second)));
+        return !stopping_;
+    }
+
+    std::vector<ColumnarSeries> SegmentCompactor::parse(const MappedFile& file, const SegmentFooter& footer) {
+        const char* data = file.data();
+        const size_t data_size = footer.getDataSize();
+
+        // Text lines stand alone; compact ids only make sense after their
+        // #def lines, and a segment of unknown format may hold either
+        const size_t pieces = footer.getFormat() == SegmentFormat::Text ? pool_->size() * kPiecesPerThread : 1;
+
+        std::vector<size_t> bounds(1, 0);
+        for (size_t i = 1; i < pieces; ++i) {
+            size_t pos = std::max(bounds.back(), data_size / pieces * i);
+            const void* newline = pos < data_size ? std::memchr(data + pos, '\n', data_size - pos) : nullptr;
+            bounds.push_back(newline ? static_cast<size_t>(static_cast<const char*>(newline) - data) + 1 : data_size);
+        }
+        bounds.push_back(data_size);
+
+        std::vector<std::vector<ColumnarSeries>> parts(pieces);
+        pool_->parallelFor(pieces, [&](size_t piece) {
+            WorkerPool::lowerThreadPriority();
+
+            // Names point into the mapping
+            std::unordered_map<std::string_view, size_t> index;
+            std::vector<ColumnarSeries>& part = parts[piece];
+            MetricFileCursor cursor(file, bounds[piece], bounds[piece + 1]);
+            while (cursor.next()) {
+                const MetricSample& sample = cursor.current();
+                auto [it, inserted] = index.try_emplace(sample.name, part.size());
+                if (inserted) {
+                    part.emplace_back();
+                    part.back().name = std::string(sample.name);
+                }
+                part[it->second].add(sample.time_key, sample.value);
+            }
+        });
+
+        // Series in order of first appearance, samples in file order
+        std::vector<ColumnarSeries> series;
+        std::unordered_map<std::string, size_t> index;
+        for (auto& part : parts) {
+            for (auto& piece_series : part) {
+                auto [it, inserted] = index.try_emplace(piece_series.name, series.size());
+                if (inserted) {
+                    series.push_back(std::move(piece_series));
+                } else {
+                    series[it->second].append(piece_series);
+                }
+            }
+        }
+        return series;
+    }
+
+    bool SegmentCompactor::compactSegment(const std::string& segment) {
+        const std::string archive = archivePath(segment);
+        const std::string temp = archive + ".tmp";
+        std::error_code ec;
+
+        if (std::filesystem::exists(archive, ec)) {
+            // Swapped in before a stop or crash; only the removal is left
+            // (once the rename is known to be on disk)
+            if (!options_.keep_source && DurableFile::syncDirectory(archive)) {
+                std::filesystem::remove(segment, ec);
+            }
+            return false;
+        }
+
+        try {
+            std::vector<ColumnarSeries> series;
+            SegmentFooter footer;
+            uint64_t input_size = 0;
+            {
+                MappedFile file(segment);
+                if (!SegmentFooter::read(file, footer, true)) {
+                    return false; // Not a finished segment
+                }
+                input_size = file.size();
+
+                for (size_t offset = 0; offset < footer.getDataSize(); offset += kIoChunk) {
+                    const size_t length = std::min(kIoChunk, footer.getDataSize() - offset);
+                    if (!throttle(length)) {
+                        return false;
+                    }
+                    touchPages(file.data() + offset, length);
+                }
+                series = parse(file, footer);
+            }
+
+            // The footer was written from the same file: a different count
+            // means the parse lost or invented samples
+            uint64_t samples = 0;
+            for (const auto& s : series) {
+                auto it = footer.metrics().find(s.name);
+                if (it == footer.metrics().end() || it->second.count != s.size()) {
+                    throw std::runtime_error("sample count of '" + s.name + "' differs from the segment footer");
+                }
+                samples += s.size();
+            }
+            if (samples != footer.getSamples() || series.size() != footer.getMetricCount()) {
+                throw std::runtime_error("sample count differs from the segment footer");
+            }
+
+            std::string encoded;
+            ColumnarArchive::encode(series, encoded);
+            {
+                std::ofstream out(temp, std::ios::out | std::ios::trunc | std::ios::binary);
+                if (!out.is_open()) {
+                    throw std::runtime_error("failed to create " + temp);
+                }
+                for (size_t offset = 0; offset < encoded.size(); offset += kIoChunk) {
+                    const size_t length = std::min(kIoChunk, encoded.size() - offset);
+                    if (!throttle(length)) {
+                        out.close();
+                        std::filesystem::remove(temp, ec);
+                        return false;
+                    }
+                    out.write(encoded.data() + offset, static_cast<std::streamsize>(length));
+                }
+                out.close();
+                if (out.fail()) {
+                    throw std::runtime_error("failed to write " + temp);
+                }
+            }
+
+            // Check what is on disk, not what is in memory
+            {
+                MappedFile written(temp);
+                if (written.size() != encoded.size() ||
+                    ColumnarArchive::decode(std::string_view(written.data(), written.size())) != series) {
+                    throw std::runtime_error("archive does not read back as written");
+                }
+            }
+
+            // The segment goes only once the archive is safely in its place
+            DurableFile::replace(temp, archive);
+            if (!options_.keep_source) {
+                // Retried on the next pass if a reader still holds the segment open
+                std::filesystem::remove(segment, ec);
+            }
+
+            segments_.fetch_add(1, std::memory_order_relaxed);
+            input_bytes_.fetch_add(input_size, std::memory_order_relaxed);
+            output_bytes_.fetch_add(encoded.size(), std::memory_order_relaxed);
+            std::cout << "Compacted " << segment << ": " << input_size << " -> " << encoded.size() << " bytes" << std::endl;
+            return true;
+
+        } catch (const std::exception& e) {
+            failures_.fetch_add(1, std::memory_order_relaxed);
+            auto [it, first] = failed_segments_.try_emplace(segment, Retry{ {}, options_.retry_delay });
+            if (!first) {
+                it->second.delay = std::min(it->second.delay * 2, options_.max_retry_delay);
+            }
+            it->second.at = std::chrono::steady_clock::now() + it->second.delay;
+            std::cerr << "Failed to compact " << segment << ": " << e.what() << " (retry in "
+                      << it->second.delay.count() << " s)" << std::endl;
+            std::filesystem::remove(temp, ec);
+            return false;
+        }
+    }
+
+} // namespace MetricsSystem
\ No newline at end of file
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "MetricColumnar.h"
+#include "MetricWorkerPool.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace MetricsSystem {
+
+    class MappedFile;
+    class SegmentFooter;
+
+    struct CompactionOptions {
+        std::chrono::seconds scan_interval{ 60 };       // How often to look for finished segments
+        uint64_t io_bytes_per_second = 8 * 1024 * 1024; // Read plus write budget (0: unlimited)
+        size_t parse_threads = 2;
+        bool keep_source = false;                       // Leave the text segment next to its archive
+        std::chrono::seconds retry_delay{ 60 };         // Before a failed segment is tried again; doubles per failure
+        std::chrono::seconds max_retry_delay{ 3600 };
+    };
+
+    struct CompactionStats {
+        uint64_t segments = 0;          // Segments turned into archives
+        uint64_t failures = 0;          // Failed attempts to compact or verify a segment (left as it is, retried later)
+        uint64_t input_bytes = 0;
+        uint64_t output_bytes = 0;
+    };
+
+    // Turns the finished segments of an output file (see SegmentOptions)
+    // into columnar archives (see ColumnarArchive) in the background.
+    // Only segments with a footer are taken, never the file being written.
+    // metrics.20250601-150001.txt becomes metrics.20250601-150001.txt.mca:
+    //   1. the segment is read at the I/O budget and parsed in parallel
+    //      (segments whose footer says text are split at line boundaries;
+    //      compact ones need their dictionary and are parsed in one piece)
+    //   2. the parsed sample count is checked against the footer
+    //   3. the archive is written to <archive>.tmp at the I/O budget,
+    //      decoded again and compared sample by sample with the parse
+    //   4. <archive>.tmp is synced to disk and renamed to <archive>, the
+    //      directory synced, and only then the segment removed
+    // A segment whose archive already exists (e.g. after a crash between
+    // the last two steps) is only removed. A segment that fails is tried
+    // again after retry_delay, doubling up to max_retry_delay, since most
+    // failures (a full disk, a file held open) pass. The compactor runs on
+    // its own thread at the lowest scheduling priority.
+    class SegmentCompactor {
+    private:
+        std::string output_file_;
+        CompactionOptions options_;
+        std::unique_ptr<WorkerPool> pool_;
+        std::thread thread_;
+        std::mutex pass_mutex_;                            // One compaction pass at a time
+
+        struct Retry {
+            std::chrono::steady_clock::time_point at;
+            std::chrono::seconds delay;
+        };
+        std::unordered_map<std::string, Retry> failed_segments_;   // Skipped until their retry time (pass_mutex_)
+
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        bool stopping_;
+        std::chrono::steady_clock::time_point io_ready_;   // When the I/O budget allows the next byte
+
+        std::atomic<uint64_t> segments_;
+        std::atomic<uint64_t> failures_;
+        std::atomic<uint64_t> input_bytes_;
+        std::atomic<uint64_t> output_bytes_;
+
+        void run();
+        std::vector<std::string> findSegments() const;
+        bool compactSegment(const std::string& segment);
+        std::vector<ColumnarSeries> parse(const MappedFile& file, const SegmentFooter& footer);
+
+        // Wait until `bytes` more fit in the I/O budget; false if stopping
+        bool throttle(uint64_t bytes);
+
+    public:
+        explicit SegmentCompactor(const std::string& output_file, CompactionOptions options = CompactionOptions());
+        ~SegmentCompactor();
+
+        SegmentCompactor(const SegmentCompactor&) = delete;
+        SegmentCompactor& operator=(const SegmentCompactor&) = delete;
+
+        void start();
+        void stop();
+
+        // Compact the segments found now on the calling thread; returns
+        // how many were compacted
+        size_t compactPending();
+
+        CompactionStats getStats() const;
+
+        // metrics.20250601-150001.txt -> metrics.20250601-150001.txt.mca
+        static std::string archivePath(const std::string& segment);
+    };
+
+} // namespace MetricsSystem
\ No newline at end of file
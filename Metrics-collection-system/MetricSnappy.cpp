@@ -0,0 +1,218 @@
+#include "MetricSnappy.h"
+#include <cstdint>
+#include <cstring>
+
+namespace MetricsSystem {
+
+    namespace {
+
+        const size_t kBlockSize = 1 << 16;
+        const int kHashBits = 14;
+
+        uint32_t load32(const char* p) {
+            uint32_t value;
+            std::memcpy(&value, p, sizeof(value));
+            return value;
+        }
+
+        uint32_t hash(uint32_t bytes) {
+            return (bytes * 0x1e35a7bdu) >> (32 - kHashBits);
+        }
+
+        void appendVarint(std::string& out, uint64_t value) {
+            while (value >= 0x80) {
+                out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+                value >>= 7;
+            }
+            out.push_back(static_cast<char>(value));
+        }
+
+        void emitLiteral(std::string& out, const char* data, size_t length) {
+            size_t n = length - 1;
+            if (n < 60) {
+                out.push_back(static_cast<char>(n << 2));
+            } else {
+                // Tag 60..63: length - 1 follows in 1..4 little-endian bytes
+                int bytes = n < (1u << 8) ? 1 : n < (1u << 16) ? 2 : n < (1u << 24) ? 3 : 4;
+                out.push_back(static_cast<char>((59 + bytes) << 2));
+                for (int i = 0; i < bytes; ++i) {
+                    out.push_back(static_cast<char>(n >> (8 * i)));
+                }
+            }
+            out.append(data, length);
+        }
+
+        // One copy element of 4..64 bytes
+        void emitCopyUpTo64(std::string& out, size_t offset, size_t length) {
+            if (length < 12 && offset < 2048) {
+                out.push_back(static_cast<char>(1 | ((length - 4) << 2) | ((offset >> 8) << 5)));
+                out.push_back(static_cast<char>(offset & 0xff));
+            } else {
+                out.push_back(static_cast<char>(2 | ((length - 1) << 2)));
+                out.push_back(static_cast<char>(offset & 0xff));
+                out.push_back(static_cast<char>(offset >> 8));
+            }
+        }
+
+        void emitCopy(std::string& out, size_t offset, size_t length) {
+            // Leave at least 4 bytes for the last element
+            while (length >= 68) {
+                emitCopyUpTo64(out, offset, 64);
+                length -= 64;
+            }
+            if (length > 64) {
+                emitCopyUpTo64(out, offset, 60);
+                length -= 60;
+            }
+            emitCopyUpTo64(out, offset, length);
+        }
+
+        void compressBlock(const char* block, size_t size, std::string& out, uint16_t* table) {
+            std::memset(table, 0, sizeof(uint16_t) << kHashBits);
+
+            size_t literal_start = 0;
+            if (size >= 15) {
+                // Matches need 4 bytes to compare; stop early enough that
+                // load32() never reads past the block
+                const size_t limit = size - 4;
+                size_t skip = 32;
+                size_t pos = 1;
+                while (pos <= limit) {
+                    uint32_t bytes = load32(block + pos);
+                    uint32_t h = hash(bytes);
+                    size_t candidate = table[h];
+                    table[h] = static_cast<uint16_t>(pos);
+
+                    if (candidate >= pos || load32(block + candidate) != bytes) {
+                        // Step faster through data that does not compress
+                        pos += skip++ >> 5;
+                        continue;
+                    }
+                    skip = 32;
+
+                    if (pos > literal_start) {
+                        emitLiteral(out, block + literal_start, pos - literal_start);
+                    }
+
+                    size_t length = 4;
+                    while (pos + length < size && block[candidate + length] == block[pos + length]) {
+                        ++length;
+                    }
+                    emitCopy(out, pos - candidate, length);
+
+                    pos += length;
+                    literal_start = pos;
+                    if (pos - 1 <= limit) {
+                        table[hash(load32(block + pos - 1))] = static_cast<uint16_t>(pos - 1);
+                    }
+                }
+            }
+
+            if (literal_start < size) {
+                emitLiteral(out, block + literal_start, size - literal_start);
+            }
+        }
+
+    } // namespace
+
+    void SnappyCodec::compress(std::string_view input, std::string& out) {
+        out.clear();
+        out.reserve(32 + input.size() + input.size() / 6);
+        appendVarint(out, input.size());
+
+        uint16_t table[1 << kHashBits];
+        for (size_t start = 0; start < input.size(); start += kBlockSize) {
+            size_t size = input.size() - start < kBlockSize ? input.size() - start : kBlockSize;
+            compressBlock(input.data() + start, size, out, table);
+        }
+    }
+
+    bool SnappyCodec::uncompress(std::string_view input, std::string& out, size_t max_size) {
+        out.clear();
+
+        uint64_t length = 0;
+        size_t pos = 0;
+        for (int shift = 0;; shift += 7) {
+            if (pos >= input.size() || shift > 35) {
+                return false;
+            }
+            uint8_t byte = static_cast<uint8_t>(input[pos++]);
+            length |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                break;
+            }
+        }
+        if (length > max_size) {
+            return false;
+        }
+        out.reserve(static_cast<size_t>(length));
+
+        while (pos < input.size()) {
+            uint8_t tag = static_cast<uint8_t>(input[pos++]);
+            size_t element_length;
+            size_t offset;
+
+            switch (tag & 3) {
+                case 0: {   // Literal
+                    element_length = (tag >> 2) + 1;
+                    if (element_length > 60) {
+                        size_t bytes = element_length - 60;
+                        if (input.size() - pos < bytes) {
+                            return false;
+                        }
+                        element_length = 0;
+                        for (size_t i = 0; i < bytes; ++i) {
+                            element_length |= static_cast<size_t>(static_cast<uint8_t>(input[pos++])) << (8 * i);
+                        }
+                        ++element_length;
+                    }
+                    if (input.size() - pos < element_length || out.size() + element_length > length) {
+                        return false;
+                    }
+                    out.append(input.data() + pos, element_length);
+                    pos += element_length;
+                    continue;
+                }
+                case 1:     // Copy, 11-bit offset
+                    if (input.size() - pos < 1) {
+                        return false;
+                    }
+                    element_length = ((tag >> 2) & 7) + 4;
+                    offset = (static_cast<size_t>(tag >> 5) << 8) | static_cast<uint8_t>(input[pos]);
+                    pos += 1;
+                    break;
+                case 2:     // Copy, 16-bit offset
+                    if (input.size() - pos < 2) {
+                        return false;
+                    }
+                    element_length = (tag >> 2) + 1;
+                    offset = static_cast<uint8_t>(input[pos]) | static_cast<size_t>(static_cast<uint8_t>(input[pos + 1])) << 8;
+                    pos += 2;
+                    break;
+                default:    // Copy, 32-bit offset
+                    if (input.size() - pos < 4) {
+                        return false;
+                    }
+                    element_length = (tag >> 2) + 1;
+                    offset = 0;
+                    for (size_t i = 0; i < 4; ++i) {
+                        offset |= static_cast<size_t>(static_cast<uint8_t>(input[pos + i])) << (8 * i);
+                    }
+                    pos += 4;
+                    break;
+            }
+
+            if (offset == 0 || offset > out.size() || out.size() + element_length > length) {
+                return false;
+            }
+            // Overlapping copies repeat the last `offset` bytes, so go byte by byte
+            size_t from = out.size() - offset;
+            for (size_t i = 0; i < element_length; ++i) {
+                out.push_back(out[from + i]);
+            }
+        }
+
+        return out.size() == length;
+    }
+
+} // namespace MetricsSystem 
\ No newline at end of file
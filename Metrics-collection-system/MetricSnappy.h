@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace MetricsSystem {
+
+    // Snappy block format (not the framing format), as remote write uses
+    // it: a varint of the uncompressed length, then literal and copy
+    // elements. The compressor is the single-pass hash-table matcher of the
+    // reference implementation, working on 64 KiB blocks so copy offsets
+    // fit in two bytes; its output is readable by any Snappy decoder.
+    class SnappyCodec {
+    public:
+        // Replace `out` with the compressed form of `input`
+        static void compress(std::string_view input, std::string& out);
+
+        // Replace `out` with the uncompressed form of `input`. Returns false
+        // for corrupt input or a result larger than `max_size`.
+        static bool uncompress(std::string_view input, std::string& out, size_t max_size = 256 * 1024 * 1024);
+    };
+
+} // namespace MetricsSystem
\ No newline at end of file
@@ -0,0 +1,103 @@
+#include "MetricSpool.h"
+#include "MetricSystem.h"
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace MetricsSystem {
+
+    // MetricSpool Implementation
+    MetricSpool::MetricSpool(const std::string& path, size_t max_bytes)
+        : path_(path), max_bytes_(max_bytes), size_(0), replay_offset_(0) {
+        if (path.empty()) {
+            throw std::invalid_argument("Spool path cannot be empty");
+        }
+
+        std::error_code ec;
+        auto existing = std::filesystem::file_size(path_, ec);
+        if (!ec && existing > 0) {
+            size_ = static_cast<size_t>(existing);
+            std::cout << "MetricSpool found " << size_ << " bytes from a previous run: " << path_ << std::endl;
+        }
+    }
+
+    bool MetricSpool::openForAppend() {
+        if (!out_.is_open()) {
+            out_.clear();
+            out_.open(path_, std::ios::out | std::ios::app | std::ios::binary);
+        }
+        return out_.is_open();
+    }
+
+    bool MetricSpool::append(const std::string& data) {
+        if (data.empty()) {
+            return true;
+        }
+
+        if (max_bytes_ > 0 && size() + data.size() > max_bytes_) {
+            return false;
+        }
+
+        if (!openForAppend()) {
+            return false;
+        }
+
+        out_.write(data.data(), static_cast<std::streamsize>(data.size()));
+        out_.flush();
+        if (out_.fail()) {
+            // The spool's disk is in trouble too: cut back to the known size
+            out_.close();
+            std::error_code ec;
+            std::filesystem::resize_file(path_, size_, ec);
+            return false;
+        }
+
+        size_ += data.size();
+        return true;
+    }
+
+    void MetricSpool::replayInto(MetricWriter& writer, size_t batch_bytes) {
+        if (empty()) {
+            return;
+        }
+
+        out_.close();
+
+        std::ifstream in(path_, std::ios::in | std::ios::binary);
+        if (!in.is_open()) {
+            throw std::runtime_error("Failed to open spool file: " + path_);
+        }
+        in.seekg(static_cast<std::streamoff>(replay_offset_));
+
+        std::vector<std::string> batch(1);
+        while (replay_offset_ < size_) {
+            size_t length = std::min(batch_bytes, size_ - replay_offset_);
+            batch.front().resize(length);
+            in.read(&batch.front()[0], static_cast<std::streamsize>(length));
+            length = static_cast<size_t>(in.gcount());
+            if (length == 0) {
+                break; // Spool shorter than recorded (e.g. truncated externally)
+            }
+            batch.front().resize(length);
+
+            // Only whole lines go out, so a retry never splits a line
+            size_t last_newline = batch.front().rfind('\n');
+            if (last_newline != std::string::npos && last_newline + 1 < length) {
+                batch.front().resize(last_newline + 1);
+                in.seekg(static_cast<std::streamoff>(replay_offset_ + last_newline + 1));
+            }
+
+            writer.writeFormatted(batch);
+            replay_offset_ += batch.front().size();
+        }
+
+        // Fully replayed: start an empty spool
+        in.close();
+        std::ofstream truncate(path_, std::ios::out | std::ios::trunc | std::ios::binary);
+        size_ = 0;
+        replay_offset_ = 0;
+    }
+
+} // namespace MetricsSystem
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <fstream>
+#include <string>
+
+namespace MetricsSystem {
+
+    class MetricWriter;
+
+    // Bounded on-disk spool on an alternate path. While the main sink is
+    // failing, formatted ticks are appended here instead of piling up in
+    // memory; once the sink recovers they are copied back in large batches.
+    // Spooled data left by a previous run is picked up and replayed too.
+    class MetricSpool {
+    private:
+        std::string path_;
+        size_t max_bytes_;
+        size_t size_;           // Bytes currently in the spool file
+        size_t replay_offset_;  // Bytes already copied to the main sink
+        std::ofstream out_;
+
+        bool openForAppend();
+
+    public:
+        MetricSpool(const std::string& path, size_t max_bytes);
+
+        // Append formatted output. Returns false if the spool is full or
+        // its own disk fails; the caller keeps the data in memory then.
+        bool append(const std::string& data);
+
+        // Copy spooled data to the writer in batches of batch_bytes and empty
+        // the spool. Throws MetricWriteError if the writer fails part way;
+        // the next call resumes after the last batch that was written.
+        void replayInto(MetricWriter& writer, size_t batch_bytes = 1 << 20);
+
+        bool empty() const { return size_ == replay_offset_; }
+        size_t size() const { return size_ - replay_offset_; }
+        const std::string& getPath() const { return path_; }
+    };
+
+} // namespace MetricsSystem
\ No newline at end of file
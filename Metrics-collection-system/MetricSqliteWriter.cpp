@@ -0,0 +1,333 @@
+#include "MetricSqliteWriter.h"
+#include "MetricSampleLines.h"
+
+#ifdef METRICS_WITH_SQLITE
+
+#include <cerrno>
+#include <iostream>
+#include <stdexcept>
+#include <sqlite3.h>
+
+namespace MetricsSystem {
+
+    namespace {
+
+        const char* const kSchema =
+            "CREATE TABLE IF NOT EXISTS metrics ("
+            "  id INTEGER PRIMARY KEY,"
+            "  name TEXT NOT NULL UNIQUE);"
+            "CREATE TABLE IF NOT EXISTS samples ("
+            "  ts INTEGER NOT NULL,"
+            "  metric_id INTEGER NOT NULL REFERENCES metrics(id),"
+            "  value);"
+            "CREATE INDEX IF NOT EXISTS samples_metric_ts ON samples(metric_id, ts);"
+            "CREATE VIEW IF NOT EXISTS metric_samples AS"
+            "  SELECT s.ts AS ts, m.name AS name, s.value AS value"
+            "  FROM samples s JOIN metrics m ON m.id = s.metric_id;";
+
+        int errorCodeFor(int rc) {
+            switch (rc & 0xff) {
+                case SQLITE_FULL: return ENOSPC;
+                case SQLITE_BUSY:
+                case SQLITE_LOCKED: return EBUSY;
+                case SQLITE_READONLY:
+                case SQLITE_PERM: return EACCES;
+                default: return EIO;
+            }
+        }
+
+    } // namespace
+
+    SqliteWriter::SqliteWriter(const std::string& filename, SqliteOptions options)
+        : MetricWriter(filename, NoFile{}), options_(options), db_(nullptr), insert_sample_(nullptr),
+          insert_metric_(nullptr), select_metric_(nullptr), in_transaction_(false), failed_(false), stopping_(false) {
+        if (options_.batches_per_commit == 0) {
+            throw std::invalid_argument("SQLite commit cadence must be at least one batch");
+        }
+        if (options_.max_commit_delay.count() < 0) {
+            throw std::invalid_argument("SQLite commit delay cannot be negative");
+        }
+
+        try {
+            open();
+        } catch (const MetricWriteError& e) {
+            throw std::runtime_error(std::string("Failed to open output database: ") + e.what());
+        }
+
+        // With one batch per transaction every write commits at once
+        if (options_.max_commit_delay.count() > 0 && options_.batches_per_commit > 1) {
+            commit_thread_ = std::thread(&SqliteWriter::commitLoop, this);
+        }
+
+        std::cout << "SqliteWriter initialized with database: " << filename << std::endl;
+    }
+
+    SqliteWriter::~SqliteWriter() {
+        close();
+    }
+
+    void SqliteWriter::fail(const std::string& what, int rc) {
+        std::string message = what + " " + getOutputFile() + ": " + (db_ ? sqlite3_errmsg(db_) : sqlite3_errstr(rc));
+        throw MetricWriteError(message, errorCodeFor(rc));
+    }
+
+    void SqliteWriter::execute(const char* sql) {
+        int rc = sqlite3_exec(db_, sql, nullptr, nullptr, nullptr);
+        if (rc != SQLITE_OK) {
+            fail(std::string("Failed to run '") + sql + "' on", rc);
+        }
+    }
+
+    void SqliteWriter::begin() {
+        execute("BEGIN");
+        in_transaction_ = true;
+        commit_cv_.notify_one();
+    }
+
+    void SqliteWriter::commit() {
+        execute("COMMIT");
+        in_transaction_ = false;
+        pending_.clear();
+    }
+
+    void SqliteWriter::commitLoop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stopping_) {
+            if (!db_ || !in_transaction_) {
+                commit_cv_.wait(lock);
+                continue;
+            }
+
+            const SteadyTimePoint due = transaction_started_ + options_.max_commit_delay;
+            if (std::chrono::steady_clock::now() < due) {
+                commit_cv_.wait_until(lock, due);
+                continue;
+            }
+
+            try {
+                commit();
+            } catch (const MetricWriteError& e) {
+                // The next write reports the failure; recover() applies the
+                // batches again
+                std::cerr << "Error committing metrics: " << e.what() << std::endl;
+                failed_ = true;
+                closeDatabase();
+            }
+        }
+    }
+
+    void SqliteWriter::open() {
+        int rc = sqlite3_open_v2(getOutputFile().c_str(), &db_, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr);
+        try {
+            if (rc != SQLITE_OK) {
+                fail("Failed to open", rc);
+            }
+            sqlite3_busy_timeout(db_, static_cast<int>(options_.busy_timeout.count()));
+
+            // NORMAL is crash safe in WAL mode; only a power loss can drop
+            // the last commits
+            execute("PRAGMA journal_mode=WAL");
+            execute("PRAGMA synchronous=NORMAL");
+            execute(kSchema);
+
+            auto prepare = [this](const char* sql, sqlite3_stmt** stmt) {
+                int result = sqlite3_prepare_v2(db_, sql, -1, stmt, nullptr);
+                if (result != SQLITE_OK) {
+                    fail("Failed to prepare statement for", result);
+                }
+            };
+            prepare("INSERT INTO samples (ts, metric_id, value) VALUES (?, ?, ?)", &insert_sample_);
+            prepare("INSERT OR IGNORE INTO metrics (name) VALUES (?)", &insert_metric_);
+            prepare("SELECT id FROM metrics WHERE name = ?", &select_metric_);
+        } catch (...) {
+            closeDatabase();
+            throw;
+        }
+    }
+
+    void SqliteWriter::closeDatabase() {
+        sqlite3_finalize(insert_sample_);
+        sqlite3_finalize(insert_metric_);
+        sqlite3_finalize(select_metric_);
+        insert_sample_ = insert_metric_ = select_metric_ = nullptr;
+
+        // Closing rolls back a transaction that is still open
+        sqlite3_close_v2(db_);
+        db_ = nullptr;
+        in_transaction_ = false;
+        metric_ids_.clear();
+    }
+
+    int64_t SqliteWriter::metricId(const std::string& name) {
+        auto it = metric_ids_.find(name);
+        if (it != metric_ids_.end()) {
+            return it->second;
+        }
+
+        sqlite3_bind_text(insert_metric_, 1, name.data(), static_cast<int>(name.size()), SQLITE_STATIC);
+        int rc = sqlite3_step(insert_metric_);
+        sqlite3_reset(insert_metric_);
+        if (rc != SQLITE_DONE) {
+            fail("Failed to add metric '" + name + "' to", rc);
+        }
+
+        sqlite3_bind_text(select_metric_, 1, name.data(), static_cast<int>(name.size()), SQLITE_STATIC);
+        rc = sqlite3_step(select_metric_);
+        int64_t id = rc == SQLITE_ROW ? sqlite3_column_int64(select_metric_, 0) : 0;
+        sqlite3_reset(select_metric_);
+        if (rc != SQLITE_ROW) {
+            fail("Failed to look up metric '" + name + "' in", rc);
+        }
+
+        metric_ids_.emplace(name, id);
+        return id;
+    }
+
+    void SqliteWriter::apply(std::string_view batch) {
+        SampleLine line;
+        size_t malformed = 0;
+
+        while (!batch.empty()) {
+            if (!SampleLines::next(batch, line)) {
+                ++malformed;
+                continue;
+            }
+
+            sqlite3_bind_int64(insert_sample_, 1, line.timestamp_ms);
+            sqlite3_bind_int64(insert_sample_, 2, metricId(line.name));
+            switch (line.kind) {
+                case SampleLine::Kind::Integer:
+                    sqlite3_bind_int64(insert_sample_, 3, line.integer);
+                    break;
+                case SampleLine::Kind::Real:
+                    sqlite3_bind_double(insert_sample_, 3, line.real);
+                    break;
+                case SampleLine::Kind::Text:
+                    sqlite3_bind_text(insert_sample_, 3, line.text.data(), static_cast<int>(line.text.size()), SQLITE_STATIC);
+                    break;
+                case SampleLine::Kind::Null:
+                    sqlite3_bind_null(insert_sample_, 3);
+                    break;
+            }
+
+            int rc = sqlite3_step(insert_sample_);
+            sqlite3_reset(insert_sample_);
+            if (rc != SQLITE_DONE) {
+                fail("Failed to insert into", rc);
+            }
+        }
+
+        if (malformed > 0) {
+            std::cerr << "Skipped " << malformed << " malformed lines for " << getOutputFile() << std::endl;
+        }
+    }
+
+    void SqliteWriter::formatEntries(const MetricEntry* first, const MetricEntry* last, std::string& out) const {
+        SampleLines::format(first, last, out);
+    }
+
+    void SqliteWriter::writeFormatted(const std::vector<std::string>& chunks) {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (!db_) {
+            throw MetricWriteError("Output database is not open: " + getOutputFile(), failed_ ? EIO : EBADF);
+        }
+
+        std::string batch;
+        for (const auto& chunk : chunks) {
+            batch.append(chunk);
+        }
+
+        try {
+            if (!in_transaction_) {
+                transaction_started_ = std::chrono::steady_clock::now();
+                begin();
+            }
+            apply(batch);
+
+            // This batch only joins pending_ once nothing can fail any more:
+            // after a throw the collector writes it again itself
+            const bool overdue = options_.max_commit_delay.count() > 0 &&
+                                 std::chrono::steady_clock::now() - transaction_started_ >= options_.max_commit_delay;
+            if (pending_.size() + 1 >= options_.batches_per_commit || overdue) {
+                commit();
+            } else {
+                pending_.push_back(std::move(batch));
+            }
+        } catch (const MetricWriteError&) {
+            failed_ = true;
+            closeDatabase();
+            throw;
+        }
+    }
+
+    bool SqliteWriter::recover() {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (db_) {
+            return true;
+        }
+
+        if (!failed_) {
+            return false; // Closed on purpose
+        }
+
+        try {
+            open();
+
+            // Batches of the rolled back transaction were already accepted;
+            // they keep their deadline
+            if (!pending_.empty()) {
+                begin();
+                for (const auto& batch : pending_) {
+                    apply(batch);
+                }
+            }
+        } catch (const MetricWriteError&) {
+            closeDatabase();
+            return false;
+        }
+
+        failed_ = false;
+        return true;
+    }
+
+    bool SqliteWriter::hasFailed() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return failed_;
+    }
+
+    void SqliteWriter::close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+            commit_cv_.notify_all();
+        }
+        if (commit_thread_.joinable()) {
+            commit_thread_.join();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (db_ && in_transaction_) {
+            try {
+                commit();
+            } catch (const MetricWriteError& e) {
+                std::cerr << "Error committing metrics: " << e.what() << std::endl;
+            }
+        }
+        if (!pending_.empty()) {
+            std::cerr << "Dropped " << pending_.size() << " uncommitted batches for " << getOutputFile() << std::endl;
+            pending_.clear();
+        }
+
+        failed_ = false;
+        if (db_) {
+            closeDatabase();
+            std::cout << "SqliteWriter closed" << std::endl;
+        }
+    }
+
+} // namespace MetricsSystem
+
+#endif // METRICS_WITH_SQLITE
\ No newline at end of file
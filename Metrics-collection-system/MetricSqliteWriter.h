@@ -0,0 +1,91 @@
+#pragma once
+
+#include "MetricSystem.h"
+
+#ifdef METRICS_WITH_SQLITE
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+namespace MetricsSystem {
+
+    struct SqliteOptions {
+        size_t batches_per_commit = 10;                     // Output batches per transaction
+        std::chrono::milliseconds max_commit_delay{ 1000 }; // Commit sooner once a transaction is this old (0: never)
+        std::chrono::milliseconds busy_timeout{ 5000 };     // Wait for a lock held by another connection
+    };
+
+    // Output to an embedded SQLite database, for ad-hoc SQL over the
+    // collected metrics. The database runs in WAL mode, so readers do not
+    // block the writer:
+    //   metrics(id INTEGER PRIMARY KEY, name TEXT UNIQUE)
+    //   samples(ts INTEGER, metric_id INTEGER, value)    -- ts: ms since the Unix epoch
+    //   metric_samples: view of (ts, name, value)
+    // Values are stored as INTEGER or REAL where they have a numeric form,
+    // as TEXT otherwise and as NULL for non-finite numbers.
+    //
+    // Ticks are formatted as SampleLines, so the collector's batching and
+    // spooling work unchanged; writeFormatted() inserts them with prepared
+    // statements. One transaction spans
+    // batches_per_commit batches, or fewer if it has been open for
+    // max_commit_delay: a background thread commits it then, even when no
+    // further batch arrives. Readers see a batch once its transaction
+    // commits (or on close()). The batches of the open transaction are
+    // kept in memory: if it has to be rolled back, recover() applies them
+    // again.
+    class SqliteWriter : public MetricWriter {
+    private:
+        SqliteOptions options_;
+        std::mutex mutex_;
+        sqlite3* db_;
+        sqlite3_stmt* insert_sample_;
+        sqlite3_stmt* insert_metric_;
+        sqlite3_stmt* select_metric_;
+        std::unordered_map<std::string, int64_t> metric_ids_;     // Valid for the open connection only
+        std::vector<std::string> pending_;                          // Batches of the open transaction
+        bool in_transaction_;
+        bool failed_;
+        SteadyTimePoint transaction_started_;
+        std::condition_variable commit_cv_;
+        std::thread commit_thread_;                                 // Commits after max_commit_delay
+        bool stopping_;
+
+        void open();
+        void closeDatabase();
+        void execute(const char* sql);
+        void begin();
+        void commit();
+        void commitLoop();
+        void apply(std::string_view batch);
+        int64_t metricId(const std::string& name);
+        [[noreturn]] void fail(const std::string& what, int rc);
+
+    public:
+        explicit SqliteWriter(const std::string& filename, SqliteOptions options = {});
+        ~SqliteWriter() override;
+
+        void formatEntries(const MetricEntry* first, const MetricEntry* last, std::string& out) const override;
+
+        // Throws MetricWriteError if SQLite fails; the transaction is rolled
+        // back and the writer needs recover()
+        void writeFormatted(const std::vector<std::string>& chunks) override;
+        bool recover() override;
+        bool hasFailed() override;
+
+        // Commits the open transaction and closes the database
+        void close() override;
+    };
+
+} // namespace MetricsSystem
+
+#endif // METRICS_WITH_SQLITE
\ No newline at end of file
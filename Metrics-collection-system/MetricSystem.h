@@ -4,13 +4,30 @@
 
 #include <string>
 #include <memory>
+#include <cstdint>
 #include <vector>
 #include <chrono>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 #include <queue>
+#include <deque>
 #include <atomic>
 #include <fstream>
+#include <shared_mutex>
+#include <unordered_map>
+#include <stdexcept>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <typeinfo>
+#include "MetricClock.h"
+#include "MetricAccumulator.h"
+#include "MetricAggregation.h"
+#include "MetricCheckpoint.h"
+#include "MetricEventTime.h"
+#include "MetricGauges.h"
+#include "MetricValue.h"
 
 namespace MetricsSystem {
 
@@ -19,39 +36,15 @@ namespace MetricsSystem {
     class Metric;
     class MetricCollector;
     class MetricWriter;
+    class WorkerPool;
+    class MetricRuntime;
+    class MetricOutputBuffer;
+    class MetricSpool;
+    class SegmentFooterBuilder;
 
-    // Timestamp type for consistent time handling
+    // Timestamp type for consistent time handling (see MetricClock.h)
     using TimePoint = std::chrono::system_clock::time_point;
 
-    // Base class for metric values that can hold different data types
-    class MetricValue {
-    public:
-        virtual ~MetricValue() = default;
-        virtual std::string toString() const = 0;
-        virtual std::unique_ptr<MetricValue> clone() const = 0;
-        virtual void reset() = 0;
-        virtual void accumulate(const MetricValue& other) = 0;
-    };
-
-    // Template implementation for specific data types
-    template<typename T>
-    class TypedMetricValue : public MetricValue {
-    private:
-        T value_;
-        size_t count_;
-
-    public:
-        TypedMetricValue(T value = T{}) : value_(value), count_(value != T{} ? 1 : 0) {}
-
-        std::string toString() const override;
-        std::unique_ptr<MetricValue> clone() const override;
-        void reset() override;
-        void accumulate(const MetricValue& other) override;
-        
-        T getValue() const { return count_ > 0 ? value_ / static_cast<T>(count_) : T{}; }
-        void addValue(T val) { value_ += val; count_++; }
-    };
-
     // Metric entry that will be written to file
     struct MetricEntry {
         TimePoint timestamp;
@@ -62,92 +55,853 @@ namespace MetricsSystem {
             : timestamp(ts), name(n), value(std::move(v)) {}
     };
 
-    // Base interface for all metric types
-    class Metric {
+    // One collected interval on its way from the collector to the writer
+    struct MetricTick {
+        TimePoint timestamp;
+        std::vector<MetricEntry> entries;   // Registration order
+        std::vector<std::string> chunks;    // Formatted output, empty until formatted
+        bool formatted = false;
+
+        // Approximate memory held by this tick (for buffer limits)
+        size_t sizeBytes() const;
+    };
+
+    // What to do when collected ticks arrive faster than the writer drains them
+    enum class OverflowPolicy {
+        Block,       // Hold back the collector (values keep accumulating in the metrics)
+        DropOldest,  // Discard the oldest buffered tick
+        DropNewest,  // Discard the incoming tick
+        Coalesce     // Merge the two oldest buffered ticks into one
+    };
+
+    // Which collected values are written. The default writes every metric
+    // on every tick.
+    struct EmissionPolicy {
+        bool skip_idle = false;         // Metrics without records in the interval write nothing
+        double deadband = 0.0;          // Skip values within this distance of the last written one (0: off)
+        size_t heartbeat_ticks = 0;     // Write each metric at least every n ticks regardless (0: off)
+    };
+
+    // Counters describing the buffer between collection and output
+    struct OutputBufferStats {
+        uint64_t enqueued_ticks = 0;
+        uint64_t written_ticks = 0;
+        uint64_t dropped_ticks = 0;
+        uint64_t dropped_entries = 0;
+        uint64_t coalesced_ticks = 0;
+        uint64_t blocked_ticks = 0;     // Ticks held back by the Block policy
+        size_t queued_ticks = 0;
+        size_t queued_bytes = 0;
+        size_t peak_queued_ticks = 0;
+        uint64_t spilled_ticks = 0;     // Ticks moved to the disk spool while the sink was down
+        uint64_t write_failures = 0;
+        int last_error_code = 0;        // errno of the last failed write
+    };
+
+    // Rotation of the output file. The active file keeps its name; a
+    // finished segment is renamed to <stem>.<YYYYMMDD-hhmmss><extension>,
+    // after the local time it was started. Line formats (text, compact) end
+    // each finished segment with a footer (see SegmentFooter) that lets
+    // tools skip it without reading the data. The footer is gathered from
+    // each batch as it is written; a segment that held data before the
+    // writer opened it is read back once when it is finished.
+    struct SegmentOptions {
+        uint64_t max_bytes = 0;                 // Rotate once the file has grown this much (0: no limit)
+        std::chrono::seconds max_age{ 0 };      // Rotate after this much time on the collector's clock (0: no limit)
+        bool footers = true;
+    };
+
+    // Line format of a segment, recorded in its footer
+    enum class SegmentFormat {
+        Unknown,    // Older footer, or data of an earlier writer in the segment
+        Text,       // Every line reads alone
+        Compact     // Lines use numbers defined by earlier #def lines
+    };
+
+    // Metrics that accept samples of type T, whatever their aggregation.
+    // The collector and MetricHandle record through this interface.
+    template<Accumulable T>
+    class RecordableMetric : public Metric {
     public:
-        virtual ~Metric() = default;
-        virtual std::string getName() const = 0;
-        virtual void recordValue(std::unique_ptr<MetricValue> value) = 0;
-        virtual std::unique_ptr<MetricValue> getAccumulatedValue() const = 0;
-        virtual void reset() = 0;
+        using Metric::recordValue;
+
+        virtual void recordValue(T value) = 0;
+        virtual void recordValues(const T* values, size_t count) = 0;
     };
 
-    // Template implementation for specific metric types
-    template<typename T>
-    class TypedMetric : public Metric {
+    // Template implementation for specific metric types. Header-only: any
+    // Accumulable type works without library changes, and the record path
+    // inlines into the caller. Policy picks the aggregation at compile time
+    // (Sum, Mean, Max, Last, MinMaxMean - see MetricAggregation.h); the
+    // default averages floating-point metrics and totals everything else.
+    template<Accumulable T, AggregationPolicy<T> Policy = DefaultAggregation<T>>
+    class TypedMetric : public RecordableMetric<T> {
     private:
+        using Accumulator = typename Policy::template Accumulator<T>;
+
+        // One accumulator per shard, each on its own cache line. Recording
+        // threads are spread over the shards, so hot metrics shared by many
+        // threads do not serialize on one lock (or one atomic).
+        struct alignas(64) Shard {
+            std::mutex mutex;   // Not used by lock-free accumulators
+            Accumulator accumulator;
+        };
+
         std::string name_;
-        mutable std::mutex mutex_;
-        T accumulated_value_;
-        size_t count_;
+        CounterOverflow overflow_;
+        size_t shard_count_;
+        std::unique_ptr<Shard[]> shards_;
+
+        Shard& localShard() const;
+
+        // Interval state over all shards; each shard is read (and
+        // optionally reset) atomically. Shard partials are reduced pairwise,
+        // so floating-point error grows with log2(shards), not shards.
+        void readShards(Accumulator& total, bool reset) const;
 
     public:
-        explicit TypedMetric(const std::string& name) 
-            : name_(name), accumulated_value_(T{}), count_(0) {}
+        using Metric::recordValue;
+
+        // shards: number of independent accumulators (1 for metrics that are
+        // not recorded from many threads at once; Last always uses one)
+        // overflow: what integer interval sums do past the 64-bit range
+        explicit TypedMetric(const std::string& name, size_t shards = 1,
+                             CounterOverflow overflow = CounterOverflow::Saturate);
 
         std::string getName() const override { return name_; }
         void recordValue(std::unique_ptr<MetricValue> value) override;
         std::unique_ptr<MetricValue> getAccumulatedValue() const override;
         void reset() override;
+        std::unique_ptr<MetricValue> collectAndReset() override;
+        void saveState(CheckpointWriter& out) const override;
+        void loadState(CheckpointReader& in) override;
+        bool tracksDirty() const override { return true; }
+        std::unique_ptr<MetricValue> idleValue() const override { return Accumulator().result(); }
+        // Plain TypedMetrics only: the tracking of a subclass (e.g. the
+        // HTTPRequestMetric total) would miss values recorded into a plain
+        // copy, so a subclass takes event-time values only by overriding this
+        std::unique_ptr<Metric> createInterval() const override {
+            if (typeid(*this) != typeid(TypedMetric<T, Policy>)) {
+                return nullptr;
+            }
+            return std::make_unique<TypedMetric<T, Policy>>(name_, 1, overflow_);
+        }
+        void mergeInterval(Metric& other) override;
 
         // Convenience method for recording typed values
-        void recordValue(T value);
+        // (virtual so specialized metrics keep their tracking when fed by the collector)
+        void recordValue(T value) override;
+
+        // Record many values with one update (pairwise SIMD sum outside the lock)
+        void recordValues(const T* values, size_t count) override;
+
+        size_t getShardCount() const { return shard_count_; }
+        CounterOverflow getOverflow() const { return overflow_; }
+    };
+
+    // A registered metric of value type T resolved once by
+    // MetricCollector::getHandle(). Recording through a handle skips the name
+    // lookup; when the metric is a plain TypedMetric<T> (default aggregation,
+    // not a specialized subclass) the call is also non-virtual and inlines.
+    // Valid as long as its collector exists.
+    template<Accumulable T>
+    class MetricHandle {
+    private:
+        RecordableMetric<T>* metric_ = nullptr;
+        const std::atomic<bool>* running_ = nullptr;
+        bool exact_ = false;  // metric_ is exactly a TypedMetric<T>
+
+    public:
+        MetricHandle() = default;
+        MetricHandle(RecordableMetric<T>* metric, const std::atomic<bool>* running)
+            : metric_(metric), running_(running), exact_(typeid(*metric) == typeid(TypedMetric<T>)) {}
+
+        // Same semantics as MetricCollector::recordMetric (ignored while stopped)
+        void record(T value) const;
+        void recordBatch(const T* values, size_t count) const;
+
+        RecordableMetric<T>* get() const { return metric_; }
+        explicit operator bool() const { return metric_ != nullptr; }
     };
 
     // Thread-safe metric collector - main interface for recording metrics
     class MetricCollector {
     private:
-        std::vector<std::unique_ptr<Metric>> metrics_;
-        std::queue<MetricEntry> pending_entries_;
-        std::mutex metrics_mutex_;
-        std::mutex queue_mutex_;
+        std::vector<std::unique_ptr<Metric>> metrics_;          // Registration order = output order
+        std::unordered_map<std::string, Metric*> metric_index_; // Name lookup for the record path
+        std::shared_mutex metrics_mutex_;  // Shared: record/snapshot, exclusive: registration
         std::atomic<bool> running_;
         std::thread worker_thread_;
         std::unique_ptr<MetricWriter> writer_;
 
+        // Time source (null: Clock::getDefault()). worker_cv_ interrupts the
+        // interval waits of the worker and writer threads on stop().
+        std::shared_ptr<Clock> clock_;
+        std::vector<CachedClock*> cached_clocks_;   // Refreshed by the worker thread
+        std::chrono::milliseconds cached_refresh_period_{ 1 };
+        std::mutex worker_mutex_;
+        std::condition_variable worker_cv_;
+
+        // Bounded buffer between collection and output, drained by
+        // writer_thread_ (or by the runtime I/O thread)
+        std::unique_ptr<MetricOutputBuffer> output_buffer_;
+        std::thread writer_thread_;
+        std::mutex drain_mutex_;           // One drain at a time
+        bool drain_scheduled_;             // A drain task is queued on the runtime I/O thread
+
+        // Sink failure handling (protected by drain_mutex_): retries back off
+        // exponentially, buffered ticks spill to the optional disk spool
+        bool sink_failed_;
+        std::chrono::milliseconds initial_retry_delay_;
+        std::chrono::milliseconds max_retry_delay_;
+        std::chrono::milliseconds retry_delay_;
+        SteadyTimePoint next_retry_;
+        std::unique_ptr<MetricSpool> spool_;
+
+        // Parallel snapshot of large registries
+        size_t snapshot_threads_;
+        std::unique_ptr<WorkerPool> snapshot_pool_;   // Created on first large sweep
+        std::once_flag snapshot_pool_once_;
+
+        // Shared runtime (scheduler, I/O thread and pool) - null when the
+        // collector runs its own worker thread
+        std::shared_ptr<MetricRuntime> runtime_;
+
+        // At most one snapshot per collector is in progress at any time
+        std::mutex tick_mutex_;
+        std::condition_variable tick_cv_;
+        bool tick_in_progress_;
+        uint64_t tick_generation_;          // Bumped as a tick starts and ends (odd: in progress)
+
+        // Checkpointing (restore records wait here until their metric is registered)
+        std::string checkpoint_path_;
+        size_t checkpoint_every_ticks_;
+        size_t ticks_since_checkpoint_;     // Ticks written since the last save (drain_mutex_)
+        bool checkpoint_has_intervals_;     // The saved checkpoint holds unwritten interval state (drain_mutex_)
+        std::unordered_map<std::string, std::string> pending_restore_;
+        std::mutex checkpoint_mutex_;
+
+        // Pull gauges, read at the start of each tick
+        std::unique_ptr<GaugeSampler> gauges_;
+
+        // Open intervals of values recorded with an event time (null until
+        // configureEventTime()), and the live ticks held back until the
+        // watermark has passed them (owned by the thread holding the tick)
+        std::unique_ptr<EventTimeWindows> event_time_;
+        std::deque<MetricTick> held_ticks_;
+        TimePoint released_until_;          // Second of the last tick written
+
+        // Incremental snapshot and emission filtering. Each metric owns a bit
+        // in dirty_ that its first record of an interval sets; only those
+        // metrics (plus due heartbeats and untracked metrics) are read.
+        struct EmissionState {
+            double last_written = 0.0;
+            double deadband = 0.0;
+            bool has_deadband = false;  // Overrides the policy deadband
+            bool written = false;
+        };
+        EmissionPolicy emission_;
+        DirtySet dirty_;
+        std::vector<EmissionState> emission_state_;     // Parallel to metrics_
+        std::vector<size_t> untracked_metrics_;         // Read on every tick
+        uint64_t emission_tick_;                        // Ticks prepared so far
+
+        // Registries smaller than this are swept on the collector thread alone
+        static constexpr size_t kMinPartitionSize = 8192;
+
+        // Default output buffer: about a minute of ticks at the 1 s interval
+        static constexpr size_t kDefaultOutputBufferTicks = 64;
+
+        // Sink retry backoff: 100 ms doubling up to 30 s
+        static constexpr std::chrono::milliseconds kDefaultRetryDelay{ 100 };
+        static constexpr std::chrono::milliseconds kDefaultMaxRetryDelay{ 30000 };
+
         // Internal processing methods
+        Clock& clock() const { return clock_ ? *clock_ : Clock::getDefault(); }
         void processMetrics();
-        void collectCurrentMetrics();
+        void refreshCachedClocks();
+        void writerLoop();
+        void collectCurrentMetrics(bool closing = false);
+        Metric* findMetric(const std::string& name);
+        template<Accumulable T>
+        RecordableMetric<T>* resolveMetric(const std::string& name, size_t shards = 1);  // Find or auto-register
+        void addMetric(std::unique_ptr<Metric> metric);  // Requires exclusive metrics_mutex_
+        void maybeCheckpoint(size_t written_ticks);     // Requires drain_mutex_
+        bool saveCheckpointLocked(bool intervals);      // Requires drain_mutex_
+        uint64_t tickGeneration();
+        WorkerPool* snapshotPool();
+        size_t partitionCount(size_t metric_count, WorkerPool* pool) const;
+        void takeDirtyMetrics(uint64_t tick, std::vector<uint64_t>& words);   // Requires shared metrics_mutex_
+        bool shouldEmit(size_t index, const MetricValue& value, uint64_t tick);
+
+        // Tick pipeline: snapshot (collector or scheduler thread) -> output
+        // buffer -> drain (writer or runtime I/O thread)
+        MetricTick prepareTick();
+        void pushTick(MetricTick tick, bool may_wait, bool closing);
+        void foldInterval(MetricTick& tick, EventTimeInterval& interval);
+        bool ticksHeld();
+        bool drainOutput();
+        void scheduleDrain();
+        std::string formatBatch(std::vector<MetricTick>& ticks);
+        bool retrySink();                  // Requires drain_mutex_
+        void handleSinkFailure(const std::string& message, int error_code);
+        void spillOutput();
+        void acquireTick();
+        bool tryAcquireTick();
+        void releaseTick();
+
+        friend class MetricRuntime;
+        void runScheduledTick();  // Called by the runtime scheduler thread
 
     public:
-        explicit MetricCollector(std::unique_ptr<MetricWriter> writer);
+        // snapshot_threads: size of the pool used to sweep large registries
+        // (0 = WorkerPool::defaultThreadCount())
+        explicit MetricCollector(std::unique_ptr<MetricWriter> writer, size_t snapshot_threads = 0);
+
+        // Collector driven by a shared runtime instead of its own thread.
+        // The collector keeps its own registry and writer.
+        MetricCollector(std::unique_ptr<MetricWriter> writer, std::shared_ptr<MetricRuntime> runtime);
         ~MetricCollector();
 
-        // Register new metrics
-        template<typename T>
-        void registerMetric(const std::string& name);
+        // Register new metrics (auto-registered metrics use the default
+        // aggregation, saturate and have one shard). shards: accumulators
+        // for a metric recorded from many threads at once (see TypedMetric)
+        template<Accumulable T, AggregationPolicy<T> Policy = DefaultAggregation<T>>
+        void registerMetric(const std::string& name, CounterOverflow overflow = CounterOverflow::Saturate,
+                            size_t shards = 1);
+
+        // Register a prebuilt metric (e.g. HTTPRequestMetric) under its own name
+        void registerMetric(std::unique_ptr<Metric> metric);
+
+        // Register a gauge whose value is read from `read` at the start of a
+        // tick rather than recorded. With options.affinity the callback runs
+        // on the affinity's thread instead of the collector thread.
+        template<Accumulable T>
+        void registerGauge(const std::string& name, std::function<T()> read, GaugeOptions options = {});
+
+        // Time per tick for reading gauges (default 10 ms). Inline gauges left
+        // over are read first on the next tick; affinity batches still running
+        // at the deadline are emitted with the next tick.
+        void setGaugeBudget(std::chrono::microseconds budget);
+        GaugeStats getGaugeStats() const;
+
+        // Drop idle or barely changed values from the output (see
+        // EmissionPolicy). setDeadband overrides the policy deadband for one
+        // registered metric. Call before start().
+        void setEmissionPolicy(const EmissionPolicy& policy);
+        void setDeadband(const std::string& name, double deadband);
 
         // Record metric values (non-blocking)
-        template<typename T>
+        template<Accumulable T>
         void recordMetric(const std::string& name, T value);
 
+        // Record many values of one metric at once
+        template<Accumulable T>
+        void recordMetricBatch(const std::string& name, const T* values, size_t count);
+
+        // Record a value into the interval holding event_time rather than the
+        // current one, for sources that report with a delay (see
+        // EventTimeWindows). Values for an interval the watermark has closed
+        // are dropped and counted in getEventTimeStats(). Requires
+        // configureEventTime(); specialized metrics (e.g. HTTPRequestMetric)
+        // take no event-time values (see TypedMetric::createInterval).
+        //
+        // Live ticks are then held back until the watermark has passed their
+        // second, and each closed interval is folded into the first tick of
+        // its second (values combine as in MetricValue::coalesce, the live
+        // value counting as the newer), or written as a tick of its own
+        // where there is none. Output stays in timestamp order, about
+        // allowed_lateness plus a second behind the clock. Should the
+        // watermark lag the clock by more than max_open_intervals seconds
+        // (WatermarkSource::EventTime with a stalled or replayed source),
+        // ticks are written anyway and intervals closing behind them go out
+        // late, counted in EventTimeStats::late_intervals. flush() writes
+        // only what the watermark has passed; stop() writes everything.
+        template<Accumulable T>
+        void record(const MetricHandle<T>& handle, T value, TimePoint event_time);
+
+        // Enable event-time recording with this lateness and watermark.
+        // Call before start().
+        void configureEventTime(const EventTimeOptions& options);
+        EventTimeStats getEventTimeStats() const;
+
+        // Resolve (or auto-register with `shards` shards) a metric once for
+        // repeated recording. Throws std::invalid_argument if `name` holds
+        // another value type.
+        template<Accumulable T>
+        MetricHandle<T> getHandle(const std::string& name, size_t shards = 1);
+
         // Control methods
         void start();
         void stop();
         void flush(); // Force write current metrics
+
+        // Bound the ticks waiting for output (max_bytes = 0: no byte limit).
+        // Call before start().
+        void configureOutputBuffer(size_t max_ticks, OverflowPolicy policy, size_t max_bytes = 0);
+        OutputBufferStats getOutputStats() const;
+
+        // While the output sink fails, spill buffered ticks to `path` (up to
+        // max_bytes) and write them back once it recovers. Spooled data left
+        // by an earlier run is written on the first drain. Call before start().
+        void configureSpool(const std::string& path, size_t max_bytes = 64 * 1024 * 1024);
+
+        // Rotate the output file into segments (see SegmentOptions). Call
+        // before start().
+        void configureSegments(const SegmentOptions& options);
+
+        // Time source for tick timestamps, intervals and retries, e.g. a
+        // VirtualClock for simulation (default: Clock::getDefault()).
+        // Call before start().
+        void setClock(std::shared_ptr<Clock> clock);
+        void setTimeSource(TimeSource source);  // setClock(Clock::create(source))
+
+        // Delay between attempts to reopen a failed sink (doubles up to max_delay)
+        void setRetryBackoff(std::chrono::milliseconds initial_delay, std::chrono::milliseconds max_delay);
+
+        // Persistent checkpoint: restores state saved at <path> (applied to
+        // metrics as they get registered) and saves it every `every_ticks`
+        // ticks written and on stop(). A checkpoint that fails to load is
+        // logged and ignored (cold start). Call before start().
+        //
+        // Cumulative state (lifetime totals) is always saved. The partial
+        // interval is saved only when every collected tick has been written,
+        // and the checkpoint is saved again without it before the next
+        // write, so a restart never emits an interval the output already
+        // has. Ticks still buffered when the process dies are lost unless
+        // a spool holds them (see configureSpool).
+        void enableCheckpoint(const std::string& path, size_t every_ticks = 10);
+        bool saveCheckpoint();
+    };
+
+    // Raised when the output sink rejects a write (disk full, I/O error, ...)
+    class MetricWriteError : public std::runtime_error {
+    private:
+        int error_code_;  // errno value, 0 if unknown
+
+    public:
+        MetricWriteError(const std::string& message, int error_code)
+            : std::runtime_error(message), error_code_(error_code) {}
+
+        int getErrorCode() const { return error_code_; }
+        bool isDiskFull() const;
+    };
+
+    // Output formats understood by MetricSystemFactory
+    enum class OutputFormat {
+        Text,       // 2025-06-01 15:00:01.653 "CPU" 0.97 (one line per metric)
+        Compact,    // #def 3 "CPU" once, then 2025-06-01 15:00:01.653 3=0.97 (one line per tick)
+        JsonLines,  // {"ts":1748782801653,"metrics":{"CPU":0.97}} (one line per tick)
+        Csv,        // timestamp,CPU + 2025-06-01 15:00:01.653,0.97 (one column per metric)
+        Sqlite,     // SQLite database, see SqliteWriter (needs METRICS_WITH_SQLITE)
+        RemoteWrite // Prometheus remote write; the output file is an http:// URL
     };
 
-    // Handles writing metrics to file with proper formatting
+    // Handles writing metrics to file with proper formatting. The base class
+    // writes the text format; other formats override the format hooks and
+    // keep the file handling (batching, failure recovery, spooling).
     class MetricWriter {
     private:
         std::string output_file_;
         std::ofstream file_stream_;
         std::mutex write_mutex_;
 
+        // After a failed write the stream is closed and the file is cut back
+        // to the last complete batch on recovery, so no torn lines remain
+        bool failed_;
+        std::streamoff good_size_;          // File size through the last complete batch (-1: unknown)
+
+        SegmentOptions segment_options_;
+        std::shared_ptr<Clock> clock_;      // Segment age; null for Clock::getDefault()
+        TimePoint segment_started_;
+        std::uintmax_t segment_base_size_;  // File size the current segment started at
+        bool preamble_pending_;             // startSegment() output still to be written
+        mutable std::atomic<bool> new_segment_requested_;
+        std::unique_ptr<SegmentFooterBuilder> footer_;     // Footer of the current segment so far
+
         std::string formatTimestamp(const TimePoint& tp) const;
+        TimePoint now() const { return clock_ ? clock_->now() : Clock::getDefault().now(); }
+        void rotateSegment();
+        std::string segmentPath() const;
+
+    protected:
+        // For sinks that are not an appended file: keeps the name but opens
+        // nothing. Such writers override writeFormatted(), recover(),
+        // hasFailed() and close().
+        struct NoFile {};
+        MetricWriter(const std::string& filename, NoFile);
+
+        const std::string& getOutputFile() const { return output_file_; }
+
+        // Lines that open every new segment, so it can be read on its own
+        // (e.g. a header row or name dictionary). Called under the write
+        // lock, again if the first write into the segment fails.
+        virtual void startSegment(std::string& /*preamble*/) {}
+
+        // Whether the output is a line format MetricFileCursor reads, and
+        // so can carry segment footers
+        virtual bool hasSegmentFooters() const { return true; }
+
+        // Line format written to segment footers
+        virtual SegmentFormat segmentFormat() const { return SegmentFormat::Text; }
+
+        // Start a new segment with the next write, rotating the file if it
+        // holds data, whatever the segment options. For formats whose
+        // preamble changes (a CSV header gaining a column). Thread-safe.
+        void startNewSegment() const { new_segment_requested_.store(true); }
 
     public:
         explicit MetricWriter(const std::string& filename);
-        ~MetricWriter();
+        virtual ~MetricWriter();
 
         void writeMetrics(const std::vector<MetricEntry>& entries);
-        void close();
+        virtual void close();
+
+        // Format a contiguous range of entries of one tick (appended to out).
+        // Thread-safe and lock-free, so partitions can be formatted in parallel.
+        virtual void formatEntries(const MetricEntry* first, const MetricEntry* last, std::string& out) const;
+
+        // Called once per tick, in tick order, with all entries of the tick
+        // and its formatted partitions in output order, for formats that
+        // work on a whole tick. Default: nothing to add.
+        virtual void finishTick(TimePoint /*timestamp*/, const std::vector<MetricEntry>& /*entries*/,
+                                std::vector<std::string>& /*chunks*/) const {}
+
+        // Write preformatted chunks in order as a single batch.
+        // Throws MetricWriteError if the sink fails; the writer then needs recover().
+        virtual void writeFormatted(const std::vector<std::string>& chunks);
+
+        // Reopen the output after a failed write. Returns false while the
+        // sink is still unusable.
+        virtual bool recover();
+        virtual bool hasFailed();
+
+        // Rotate the output into segments. Ignored by writers that do not
+        // append to a file (SQLite, remote write).
+        void setSegmentOptions(const SegmentOptions& options);
+
+        // Clock that segment ages and names follow (set by the collector
+        // on start; default: Clock::getDefault())
+        void setClock(std::shared_ptr<Clock> clock);
     };
 
     // Factory class for easy system setup
     class MetricSystemFactory {
     public:
+        static std::unique_ptr<MetricWriter> createWriter(const std::string& output_file,
+                                                          OutputFormat format = OutputFormat::Text);
+
         static std::unique_ptr<MetricCollector> createSystem(const std::string& output_file);
+        static std::unique_ptr<MetricCollector> createSystem(const std::string& output_file, OutputFormat format);
+
+        // Collector attached to a shared runtime (see MetricRuntime::shared())
+        static std::unique_ptr<MetricCollector> createSystem(const std::string& output_file,
+                                                             std::shared_ptr<MetricRuntime> runtime);
     };
 
+    // TypedMetric template implementations
+    template<Accumulable T, AggregationPolicy<T> Policy>
+    TypedMetric<T, Policy>::TypedMetric(const std::string& name, size_t shards, CounterOverflow overflow)
+        : name_(name), overflow_(overflow), shard_count_(Accumulator::kShardable && shards > 1 ? shards : 1),
+          shards_(new Shard[shard_count_]) {}
+
+    template<Accumulable T, AggregationPolicy<T> Policy>
+    typename TypedMetric<T, Policy>::Shard& TypedMetric<T, Policy>::localShard() const {
+        if (shard_count_ == 1) {
+            return shards_[0];
+        }
+
+        // Threads are numbered in order of first use and keep their shard for
+        // their lifetime, so N threads on N shards never share one
+        static std::atomic<size_t> next_slot(0);
+        static thread_local const size_t thread_slot = next_slot.fetch_add(1, std::memory_order_relaxed);
+        return shards_[thread_slot % shard_count_];
+    }
+
+    template<Accumulable T, AggregationPolicy<T> Policy>
+    void TypedMetric<T, Policy>::readShards(Accumulator& total, bool reset) const {
+        auto drainShard = [this, reset](size_t i, Accumulator& into) {
+            Shard& shard = shards_[i];
+            if constexpr (Accumulator::kLockFree) {
+                shard.accumulator.drainInto(into, reset, overflow_);
+            } else {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                shard.accumulator.drainInto(into, reset, overflow_);
+            }
+        };
+
+        if (shard_count_ == 1) {
+            drainShard(0, total);
+            return;
+        }
+
+        // Take each shard's partial, then fold neighbours: 0+1, 2+3, ...,
+        // then 0+2, 4+6, ... until partial 0 holds the interval
+        std::unique_ptr<Accumulator[]> partials(new Accumulator[shard_count_]);
+        for (size_t i = 0; i < shard_count_; ++i) {
+            drainShard(i, partials[i]);
+        }
+        for (size_t stride = 1; stride < shard_count_; stride *= 2) {
+            for (size_t i = 0; i + stride < shard_count_; i += 2 * stride) {
+                partials[i + stride].drainInto(partials[i], false, overflow_);
+            }
+        }
+        partials[0].drainInto(total, false, overflow_);
+    }
+
+    template<Accumulable T, AggregationPolicy<T> Policy>
+    void TypedMetric<T, Policy>::recordValue(std::unique_ptr<MetricValue> value) {
+        auto* typed_value = dynamic_cast<TypedMetricValue<T>*>(value.get());
+        if (!typed_value) {
+            throw std::invalid_argument("Invalid metric value type for metric: " + name_);
+        }
+
+        recordValue(static_cast<T>(typed_value->getValue()));
+    }
+
+    template<Accumulable T, AggregationPolicy<T> Policy>
+    void TypedMetric<T, Policy>::recordValue(T value) {
+        Shard& shard = localShard();
+        if constexpr (Accumulator::kLockFree) {
+            shard.accumulator.add(value, overflow_);
+        } else {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.accumulator.add(value, overflow_);
+        }
+        this->markDirty();
+    }
+
+    template<Accumulable T, AggregationPolicy<T> Policy>
+    void TypedMetric<T, Policy>::recordValues(const T* values, size_t count) {
+        if (count == 0) {
+            return;
+        }
+
+        Shard& shard = localShard();
+        if constexpr (Accumulator::kLockFree) {
+            shard.accumulator.addBatch(values, count, overflow_);
+        } else {
+            // Aggregate outside the lock
+            Accumulator batch;
+            batch.addBatch(values, count, overflow_);
+
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.accumulator.merge(batch, overflow_);
+        }
+        this->markDirty();
+    }
+
+    template<Accumulable T, AggregationPolicy<T> Policy>
+    std::unique_ptr<MetricValue> TypedMetric<T, Policy>::getAccumulatedValue() const {
+        Accumulator total;
+        readShards(total, false);
+        return total.result();
+    }
+
+    template<Accumulable T, AggregationPolicy<T> Policy>
+    std::unique_ptr<MetricValue> TypedMetric<T, Policy>::collectAndReset() {
+        Accumulator total;
+        readShards(total, true);
+        return total.result();
+    }
+
+    template<Accumulable T, AggregationPolicy<T> Policy>
+    void TypedMetric<T, Policy>::reset() {
+        for (size_t i = 0; i < shard_count_; ++i) {
+            std::lock_guard<std::mutex> lock(shards_[i].mutex);
+            shards_[i].accumulator.reset();
+        }
+    }
+
+    template<Accumulable T, AggregationPolicy<T> Policy>
+    void TypedMetric<T, Policy>::saveState(CheckpointWriter& out) const {
+        Accumulator total;
+        if (out.intervals()) {
+            readShards(total, false);
+        }
+
+        out.put(checkpointTypeCode<T>());
+        out.put(Policy::kCheckpointCode);
+        total.save(out);
+    }
+
+    template<Accumulable T, AggregationPolicy<T> Policy>
+    void TypedMetric<T, Policy>::mergeInterval(Metric& other) {
+        auto* interval = dynamic_cast<TypedMetric<T, Policy>*>(&other);
+        if (!interval) {
+            throw std::invalid_argument("Cannot merge interval of a different metric into: " + name_);
+        }
+
+        // Interval copies have one shard, which drains straight into ours
+        std::lock_guard<std::mutex> lock(shards_[0].mutex);
+        interval->readShards(shards_[0].accumulator, true);
+        this->markDirty();
+    }
+
+    template<Accumulable T, AggregationPolicy<T> Policy>
+    void TypedMetric<T, Policy>::loadState(CheckpointReader& in) {
+        if (in.get<uint8_t>() != checkpointTypeCode<T>()) {
+            throw std::invalid_argument("Checkpoint value type does not match metric: " + name_);
+        }
+        if (in.get<uint8_t>() != Policy::kCheckpointCode) {
+            throw std::invalid_argument("Checkpoint aggregation does not match metric: " + name_);
+        }
+
+        std::lock_guard<std::mutex> lock(shards_[0].mutex);
+        shards_[0].accumulator.load(in, overflow_);
+        this->markDirty();
+    }
+
+    // MetricCollector template implementations
+    template<Accumulable T, AggregationPolicy<T> Policy>
+    void MetricCollector::registerMetric(const std::string& name, CounterOverflow overflow, size_t shards) {
+        std::unique_lock<std::shared_mutex> lock(metrics_mutex_);
+        
+        // Check if metric already exists
+        if (metric_index_.find(name) != metric_index_.end()) {
+            throw std::invalid_argument("Metric already registered: " + name);
+        }
+        
+        // Create and add new metric
+        addMetric(std::make_unique<TypedMetric<T, Policy>>(name, shards, overflow));
+    }
+
+    template<Accumulable T>
+    void MetricCollector::registerGauge(const std::string& name, std::function<T()> read, GaugeOptions options) {
+        auto gauge = std::make_unique<PullGauge<T>>(name, std::move(read), std::move(options));
+        GaugeBase* sampled = gauge.get();
+
+        {
+            std::unique_lock<std::shared_mutex> lock(metrics_mutex_);
+            if (metric_index_.find(name) != metric_index_.end()) {
+                throw std::invalid_argument("Metric already registered: " + name);
+            }
+            addMetric(std::move(gauge));
+        }
+
+        gauges_->add(sampled);
+    }
+
+    template<Accumulable T>
+    RecordableMetric<T>* MetricCollector::resolveMetric(const std::string& name, size_t shards) {
+        // Find the metric (read lock)
+        Metric* target_metric = findMetric(name);
+
+        if (!target_metric) {
+            // Auto-register metric if it doesn't exist
+            try {
+                registerMetric<T>(name, CounterOverflow::Saturate, shards);
+            } catch (const std::exception& e) {
+                // Another thread may have registered it in the meantime
+                target_metric = findMetric(name);
+                if (!target_metric) {
+                    std::cerr << "Failed to auto-register metric '" << name << "': " << e.what() << std::endl;
+                    return nullptr;
+                }
+            }
+
+            // Try again after registration
+            if (!target_metric) {
+                target_metric = findMetric(name);
+            }
+        }
+
+        return dynamic_cast<RecordableMetric<T>*>(target_metric);
+    }
+
+    template<Accumulable T>
+    void MetricCollector::recordMetric(const std::string& name, T value) {
+        if (!running_) {
+            return; // Silently ignore if not running
+        }
+
+        RecordableMetric<T>* typed_metric = resolveMetric<T>(name);
+        if (typed_metric) {
+            // Record the value (this is the hot path - must be fast)
+            try {
+                typed_metric->recordValue(value);
+            } catch (const std::exception& e) {
+                std::cerr << "Failed to record metric '" << name << "': " << e.what() << std::endl;
+            }
+        }
+    }
+
+    template<Accumulable T>
+    void MetricCollector::recordMetricBatch(const std::string& name, const T* values, size_t count) {
+        if (!running_ || count == 0) {
+            return;
+        }
+
+        RecordableMetric<T>* typed_metric = resolveMetric<T>(name);
+        if (typed_metric) {
+            try {
+                typed_metric->recordValues(values, count);
+            } catch (const std::exception& e) {
+                std::cerr << "Failed to record metric '" << name << "': " << e.what() << std::endl;
+            }
+        }
+    }
+
+    template<Accumulable T>
+    void MetricCollector::record(const MetricHandle<T>& handle, T value, TimePoint event_time) {
+        if (!handle || !running_) {
+            return;
+        }
+
+        try {
+            if (!event_time_) {
+                throw std::logic_error("event-time recording is not configured");
+            }
+
+            // Interval copies have the metric's own type (see createInterval)
+            std::unique_lock<std::mutex> lock;
+            if (Metric* interval = event_time_->acquire(*handle.get(), event_time, lock)) {
+                static_cast<RecordableMetric<T>*>(interval)->recordValue(value);
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Failed to record metric '" << handle.get()->getName() << "': " << e.what() << std::endl;
+        }
+    }
+
+    template<Accumulable T>
+    MetricHandle<T> MetricCollector::getHandle(const std::string& name, size_t shards) {
+        RecordableMetric<T>* typed_metric = resolveMetric<T>(name, shards);
+        if (!typed_metric) {
+            throw std::invalid_argument("Metric '" + name + "' does not hold values of the requested type");
+        }
+        return MetricHandle<T>(typed_metric, &running_);
+    }
+
+    // MetricHandle template implementations
+    template<Accumulable T>
+    void MetricHandle<T>::record(T value) const {
+        if (!metric_ || !running_->load(std::memory_order_relaxed)) {
+            return;
+        }
+
+        if (exact_) {
+            static_cast<TypedMetric<T>*>(metric_)->TypedMetric<T>::recordValue(value);
+            return;
+        }
+
+        try {
+            metric_->recordValue(value);
+        } catch (const std::exception& e) {
+            std::cerr << "Failed to record metric '" << metric_->getName() << "': " << e.what() << std::endl;
+        }
+    }
+
+    template<Accumulable T>
+    void MetricHandle<T>::recordBatch(const T* values, size_t count) const {
+        if (!metric_ || count == 0 || !running_->load(std::memory_order_relaxed)) {
+            return;
+        }
+
+        try {
+            metric_->recordValues(values, count);
+        } catch (const std::exception& e) {
+            std::cerr << "Failed to record metric '" << metric_->getName() << "': " << e.what() << std::endl;
+        }
+    }
+
 } // namespace MetricsSystem 
\ No newline at end of file
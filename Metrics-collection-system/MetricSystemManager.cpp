@@ -6,17 +6,28 @@
 namespace MetricsSystem {
 
     // MetricSystemManager Implementation
-    MetricSystemManager::MetricSystemManager(const std::string& output_file) 
-        : output_file_(output_file), is_running_(false) {
+    MetricSystemManager::MetricSystemManager(const std::string& output_file, OutputFormat format) 
+        : output_file_(output_file), format_(format), is_running_(false) {
         
         // Create the metric collection system
-        collector_ = MetricSystemFactory::createSystem(output_file);
+        collector_ = MetricSystemFactory::createSystem(output_file, format);
         
         if (!collector_) {
             throw std::runtime_error("Failed to create metric collector");
         }
     }
 
+    MetricSystemManager::MetricSystemManager(const std::string& output_file, std::shared_ptr<MetricRuntime> runtime)
+        : output_file_(output_file), format_(OutputFormat::Text), is_running_(false) {
+
+        // Create a collector driven by the shared runtime
+        collector_ = MetricSystemFactory::createSystem(output_file, std::move(runtime));
+
+        if (!collector_) {
+            throw std::runtime_error("Failed to create metric collector");
+        }
+    }
+
     MetricSystemManager::~MetricSystemManager() {
         stop();
     }
@@ -28,6 +39,12 @@ namespace MetricsSystem {
 
         try {
             collector_->start();
+            if (compactor_) {
+                compactor_->start();
+            }
+            if (retention_) {
+                retention_->start();
+            }
             is_running_ = true;
             std::cout << "Metrics collection system started" << std::endl;
         } catch (const std::exception& e) {
@@ -42,6 +59,12 @@ namespace MetricsSystem {
         }
 
         try {
+            if (retention_) {
+                retention_->stop();
+            }
+            if (compactor_) {
+                compactor_->stop();
+            }
             collector_->stop();
             is_running_ = false;
             std::cout << "Metrics collection system stopped" << std::endl;
@@ -50,21 +73,6 @@ namespace MetricsSystem {
         }
     }
 
-    template<typename T>
-    void MetricSystemManager::registerMetric(const std::string& name) {
-        if (!collector_) {
-            throw std::runtime_error("Metric collector not initialized");
-        }
-
-        try {
-            collector_->registerMetric<T>(name);
-            std::cout << "Registered metric: " << name << std::endl;
-        } catch (const std::exception& e) {
-            std::cerr << "Failed to register metric '" << name << "': " << e.what() << std::endl;
-            throw;
-        }
-    }
-
     void MetricSystemManager::registerCPUMetric(const std::string& name) {
         registerMetric<double>(name);
     }
@@ -81,20 +89,18 @@ namespace MetricsSystem {
         registerMetric<long>(name);
     }
 
-    template<typename T>
-    void MetricSystemManager::recordMetric(const std::string& name, T value) {
+    void MetricSystemManager::registerMetric(std::unique_ptr<Metric> metric) {
         if (!collector_) {
-            return; // Silently ignore if not initialized
-        }
-
-        if (!is_running_) {
-            return; // Silently ignore if not running
+            throw std::runtime_error("Metric collector not initialized");
         }
 
+        const std::string name = metric ? metric->getName() : std::string();
         try {
-            collector_->recordMetric<T>(name, value);
+            collector_->registerMetric(std::move(metric));
+            std::cout << "Registered metric: " << name << std::endl;
         } catch (const std::exception& e) {
-            std::cerr << "Failed to record metric '" << name << "': " << e.what() << std::endl;
+            std::cerr << "Failed to register metric '" << name << "': " << e.what() << std::endl;
+            throw;
         }
     }
 
@@ -120,8 +126,132 @@ namespace MetricsSystem {
         }
     }
 
-    std::unique_ptr<MetricSystemManager> MetricSystemManager::create(const std::string& output_file) {
-        return std::make_unique<MetricSystemManager>(output_file);
+    void MetricSystemManager::setEmissionPolicy(const EmissionPolicy& policy) {
+        if (!collector_) {
+            throw std::runtime_error("Metric collector not initialized");
+        }
+
+        collector_->setEmissionPolicy(policy);
+    }
+
+    void MetricSystemManager::setDeadband(const std::string& name, double deadband) {
+        if (!collector_) {
+            throw std::runtime_error("Metric collector not initialized");
+        }
+
+        collector_->setDeadband(name, deadband);
+    }
+
+    void MetricSystemManager::configureOutputBuffer(size_t max_ticks, OverflowPolicy policy, size_t max_bytes) {
+        if (!collector_) {
+            throw std::runtime_error("Metric collector not initialized");
+        }
+
+        collector_->configureOutputBuffer(max_ticks, policy, max_bytes);
+    }
+
+    OutputBufferStats MetricSystemManager::getOutputStats() const {
+        return collector_ ? collector_->getOutputStats() : OutputBufferStats{};
+    }
+
+    void MetricSystemManager::configureEventTime(const EventTimeOptions& options) {
+        if (!collector_) {
+            throw std::runtime_error("Metric collector not initialized");
+        }
+
+        collector_->configureEventTime(options);
+    }
+
+    EventTimeStats MetricSystemManager::getEventTimeStats() const {
+        return collector_ ? collector_->getEventTimeStats() : EventTimeStats{};
+    }
+
+    void MetricSystemManager::setGaugeBudget(std::chrono::microseconds budget) {
+        if (!collector_) {
+            throw std::runtime_error("Metric collector not initialized");
+        }
+
+        collector_->setGaugeBudget(budget);
+    }
+
+    GaugeStats MetricSystemManager::getGaugeStats() const {
+        return collector_ ? collector_->getGaugeStats() : GaugeStats{};
+    }
+
+    void MetricSystemManager::setClock(std::shared_ptr<Clock> clock) {
+        if (!collector_) {
+            throw std::runtime_error("Metric collector not initialized");
+        }
+
+        collector_->setClock(std::move(clock));
+    }
+
+    void MetricSystemManager::setTimeSource(TimeSource source) {
+        if (!collector_) {
+            throw std::runtime_error("Metric collector not initialized");
+        }
+
+        collector_->setTimeSource(source);
+    }
+
+    void MetricSystemManager::enableSpool(const std::string& path, size_t max_bytes) {
+        if (!collector_) {
+            throw std::runtime_error("Metric collector not initialized");
+        }
+
+        collector_->configureSpool(path, max_bytes);
+    }
+
+    void MetricSystemManager::enableSegments(const SegmentOptions& options) {
+        if (!collector_) {
+            throw std::runtime_error("Metric collector not initialized");
+        }
+
+        collector_->configureSegments(options);
+    }
+
+    void MetricSystemManager::enableCompaction(const CompactionOptions& options) {
+        if (is_running_) {
+            throw std::logic_error("Compaction must be enabled before start()");
+        }
+
+        compactor_ = std::make_unique<SegmentCompactor>(output_file_, options);
+    }
+
+    CompactionStats MetricSystemManager::getCompactionStats() const {
+        return compactor_ ? compactor_->getStats() : CompactionStats();
+    }
+
+    void MetricSystemManager::enableRetention(const RetentionOptions& options) {
+        if (is_running_) {
+            throw std::logic_error("Retention must be enabled before start()");
+        }
+        if (format_ != OutputFormat::Text && format_ != OutputFormat::Compact) {
+            // Rollups read the samples back, which only the line formats allow
+            throw std::invalid_argument("Retention needs text or compact output: " + output_file_);
+        }
+
+        retention_ = std::make_unique<RetentionManager>(output_file_, options);
+    }
+
+    RetentionStats MetricSystemManager::getRetentionStats() const {
+        return retention_ ? retention_->getStats() : RetentionStats();
+    }
+
+    void MetricSystemManager::enableCheckpoint(const std::string& path, size_t every_ticks) {
+        if (!collector_) {
+            throw std::runtime_error("Metric collector not initialized");
+        }
+
+        collector_->enableCheckpoint(path, every_ticks);
+    }
+
+    std::unique_ptr<MetricSystemManager> MetricSystemManager::create(const std::string& output_file, OutputFormat format) {
+        return std::make_unique<MetricSystemManager>(output_file, format);
+    }
+
+    std::unique_ptr<MetricSystemManager> MetricSystemManager::createShared(const std::string& output_file) {
+        return std::make_unique<MetricSystemManager>(output_file, MetricRuntime::shared());
     }
 
     // ScopedMetricSystem Implementation
@@ -136,15 +266,4 @@ namespace MetricsSystem {
         }
     }
 
-    // Explicit template instantiations for common types
-    template void MetricSystemManager::registerMetric<int>(const std::string& name);
-    template void MetricSystemManager::registerMetric<double>(const std::string& name);
-    template void MetricSystemManager::registerMetric<float>(const std::string& name);
-    template void MetricSystemManager::registerMetric<long>(const std::string& name);
-
-    template void MetricSystemManager::recordMetric<int>(const std::string& name, int value);
-    template void MetricSystemManager::recordMetric<double>(const std::string& name, double value);
-    template void MetricSystemManager::recordMetric<float>(const std::string& name, float value);
-    template void MetricSystemManager::recordMetric<long>(const std::string& name, long value);
-
 } // namespace MetricsSystem 
\ No newline at end of file
@@ -2,6 +2,10 @@
 
 #include "MetricSystem.h"
 #include "SpecificMetrics.h"
+#include "MetricRuntime.h"
+#include "MetricSegmentCompactor.h"
+#include "MetricRetention.h"
+#include <iostream>
 #include <memory>
 #include <string>
 
@@ -12,11 +16,19 @@ namespace MetricsSystem {
     class MetricSystemManager {
     private:
         std::unique_ptr<MetricCollector> collector_;
+        std::unique_ptr<SegmentCompactor> compactor_;
+        std::unique_ptr<RetentionManager> retention_;
         std::string output_file_;
+        OutputFormat format_;
         bool is_running_;
 
     public:
-        explicit MetricSystemManager(const std::string& output_file = "metrics.txt");
+        explicit MetricSystemManager(const std::string& output_file = "metrics.txt",
+                                     OutputFormat format = OutputFormat::Text);
+
+        // Manager served by a shared runtime instead of a private collector thread.
+        // Registry and output file remain per manager.
+        MetricSystemManager(const std::string& output_file, std::shared_ptr<MetricRuntime> runtime);
         ~MetricSystemManager();
 
         // Non-copyable, non-movable for safety
@@ -31,8 +43,12 @@ namespace MetricsSystem {
         bool isRunning() const { return is_running_; }
 
         // Metric registration (call before start())
-        template<typename T>
-        void registerMetric(const std::string& name);
+        // Policy: aggregation (see MetricAggregation.h)
+        // overflow: what integer interval sums do past the 64-bit range
+        // shards: accumulators for a metric recorded from many threads at once
+        template<Accumulable T, AggregationPolicy<T> Policy = DefaultAggregation<T>>
+        void registerMetric(const std::string& name, CounterOverflow overflow = CounterOverflow::Saturate,
+                            size_t shards = 1);
         
         // Convenient metric registration methods
         void registerCPUMetric(const std::string& name = "CPU");
@@ -40,10 +56,34 @@ namespace MetricsSystem {
         void registerMemoryMetric(const std::string& name = "Memory Usage MB");
         void registerNetworkMetric(const std::string& name = "Network Bytes/sec");
 
+        // Register a prebuilt metric, e.g. MetricFactory::createHTTPMetric()
+        void registerMetric(std::unique_ptr<Metric> metric);
+
+        // Gauge read from a callback once per tick (see MetricCollector::registerGauge)
+        template<Accumulable T>
+        void registerGauge(const std::string& name, std::function<T()> read, GaugeOptions options = {});
+        void setGaugeBudget(std::chrono::microseconds budget);
+        GaugeStats getGaugeStats() const;
+
         // Metric recording (non-blocking, thread-safe)
-        template<typename T>
+        template<Accumulable T>
         void recordMetric(const std::string& name, T value);
 
+        template<Accumulable T>
+        void recordMetricBatch(const std::string& name, const std::vector<T>& values);
+
+        // Handle for repeated recording without the name lookup (see MetricHandle);
+        // shards as in registerMetric when the handle registers the metric
+        template<Accumulable T>
+        MetricHandle<T> getHandle(const std::string& name, size_t shards = 1);
+
+        // Record against the interval holding event_time (see
+        // MetricCollector::record); lateness and watermark set before start()
+        template<Accumulable T>
+        void record(const MetricHandle<T>& handle, T value, TimePoint event_time);
+        void configureEventTime(const EventTimeOptions& options);
+        EventTimeStats getEventTimeStats() const;
+
         // Convenient recording methods
         void recordCPU(double utilization, const std::string& name = "CPU");
         void recordHTTPRequests(int requests, const std::string& name = "HTTP requests RPS");
@@ -52,10 +92,47 @@ namespace MetricsSystem {
 
         // System operations
         void flush(); // Force immediate write
+
+        // Skip idle or barely changed values in the output (call before start())
+        void setEmissionPolicy(const EmissionPolicy& policy);
+        void setDeadband(const std::string& name, double deadband);
+
+        // Bounded buffering between collection and output (call before start())
+        void configureOutputBuffer(size_t max_ticks, OverflowPolicy policy, size_t max_bytes = 0);
+        OutputBufferStats getOutputStats() const;
+
+        // Time source for the collector (e.g. VirtualClock; call before start())
+        void setClock(std::shared_ptr<Clock> clock);
+        void setTimeSource(TimeSource source);
+
+        // Disk spool used while the output file cannot be written (call before start())
+        void enableSpool(const std::string& path, size_t max_bytes = 64 * 1024 * 1024);
+
+        // Rotate the output file into segments (call before start())
+        void enableSegments(const SegmentOptions& options);
+
+        // Compact finished text segments into columnar archives in the
+        // background while the system runs (see SegmentCompactor)
+        void enableCompaction(const CompactionOptions& options = CompactionOptions());
+        CompactionStats getCompactionStats() const;
+
+        // Roll up and delete old segments, archives and rollups in the
+        // background while the system runs (see RetentionManager). Text
+        // and compact output only; throws std::invalid_argument otherwise.
+        void enableRetention(const RetentionOptions& options = RetentionOptions());
+        RetentionStats getRetentionStats() const;
+
+        // Warm restart: reload accumulator state from `path` and keep it
+        // updated every `every_ticks` ticks and on stop (call before start())
+        void enableCheckpoint(const std::string& path, size_t every_ticks = 10);
         const std::string& getOutputFile() const { return output_file_; }
 
         // Factory method for easy setup
-        static std::unique_ptr<MetricSystemManager> create(const std::string& output_file = "metrics.txt");
+        static std::unique_ptr<MetricSystemManager> create(const std::string& output_file = "metrics.txt",
+                                                           OutputFormat format = OutputFormat::Text);
+
+        // Factory method for managers sharing the process-wide runtime
+        static std::unique_ptr<MetricSystemManager> createShared(const std::string& output_file = "metrics.txt");
     };
 
     // RAII helper for automatic system management
@@ -73,4 +150,80 @@ namespace MetricsSystem {
         MetricSystemManager* get() { return manager_.get(); }
     };
 
+    // MetricSystemManager template implementations
+    template<Accumulable T, AggregationPolicy<T> Policy>
+    void MetricSystemManager::registerMetric(const std::string& name, CounterOverflow overflow, size_t shards) {
+        if (!collector_) {
+            throw std::runtime_error("Metric collector not initialized");
+        }
+
+        try {
+            collector_->registerMetric<T, Policy>(name, overflow, shards);
+            std::cout << "Registered metric: " << name << std::endl;
+        } catch (const std::exception& e) {
+            std::cerr << "Failed to register metric '" << name << "': " << e.what() << std::endl;
+            throw;
+        }
+    }
+
+    template<Accumulable T>
+    void MetricSystemManager::registerGauge(const std::string& name, std::function<T()> read, GaugeOptions options) {
+        if (!collector_) {
+            throw std::runtime_error("Metric collector not initialized");
+        }
+
+        try {
+            collector_->registerGauge<T>(name, std::move(read), std::move(options));
+            std::cout << "Registered gauge: " << name << std::endl;
+        } catch (const std::exception& e) {
+            std::cerr << "Failed to register gauge '" << name << "': " << e.what() << std::endl;
+            throw;
+        }
+    }
+
+    template<Accumulable T>
+    void MetricSystemManager::recordMetric(const std::string& name, T value) {
+        if (!collector_) {
+            return; // Silently ignore if not initialized
+        }
+
+        if (!is_running_) {
+            return; // Silently ignore if not running
+        }
+
+        try {
+            collector_->recordMetric<T>(name, value);
+        } catch (const std::exception& e) {
+            std::cerr << "Failed to record metric '" << name << "': " << e.what() << std::endl;
+        }
+    }
+
+    template<Accumulable T>
+    void MetricSystemManager::recordMetricBatch(const std::string& name, const std::vector<T>& values) {
+        if (!collector_ || !is_running_) {
+            return; // Silently ignore if not initialized or not running
+        }
+
+        try {
+            collector_->recordMetricBatch<T>(name, values.data(), values.size());
+        } catch (const std::exception& e) {
+            std::cerr << "Failed to record metric '" << name << "': " << e.what() << std::endl;
+        }
+    }
+
+    template<Accumulable T>
+    MetricHandle<T> MetricSystemManager::getHandle(const std::string& name, size_t shards) {
+        if (!collector_) {
+            throw std::runtime_error("Metric collector not initialized");
+        }
+        return collector_->getHandle<T>(name, shards);
+    }
+
+    template<Accumulable T>
+    void MetricSystemManager::record(const MetricHandle<T>& handle, T value, TimePoint event_time) {
+        if (collector_) {
+            collector_->record(handle, value, event_time);
+        }
+    }
+
 } // namespace MetricsSystem 
\ No newline at end of file
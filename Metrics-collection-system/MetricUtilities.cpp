@@ -3,12 +3,22 @@
 #include <sstream>
 #include <iomanip>
 #include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 namespace MetricsSystem {
 
     // TimestampUtils implementations
     std::chrono::system_clock::time_point TimestampUtils::getCurrentTime() {
-        return std::chrono::system_clock::now();
+        return Clock::getDefault().now();
     }
 
     std::string TimestampUtils::formatTimestamp(const std::chrono::system_clock::time_point& timePoint) {
@@ -16,8 +26,16 @@ namespace MetricsSystem {
         auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
             timePoint.time_since_epoch()) % 1000;
 
+        // Reentrant conversion: timestamps are formatted from several threads
+        std::tm local_tm = {};
+#ifdef _WIN32
+        localtime_s(&local_tm, &time_t);
+#else
+        localtime_r(&time_t, &local_tm);
+#endif
+
         std::stringstream ss;
-        ss << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
+        ss << std::put_time(&local_tm, "%Y-%m-%d %H:%M:%S");
         ss << '.' << std::setfill('0') << std::setw(3) << ms.count();
         
         return ss.str();
@@ -138,19 +156,6 @@ namespace MetricsSystem {
     }
 
     // ValueFormatter implementations
-    template<typename T>
-    std::string ValueFormatter::formatValue(const T& value) {
-        if constexpr (std::is_floating_point_v<T>) {
-            return formatDouble(static_cast<double>(value));
-        } else if constexpr (std::is_integral_v<T>) {
-            return formatInteger(static_cast<long>(value));
-        } else {
-            std::ostringstream oss;
-            oss << value;
-            return oss.str();
-        }
-    }
-
     std::string ValueFormatter::formatDouble(double value, int precision) {
         std::ostringstream oss;
         oss << std::fixed << std::setprecision(precision) << value;
@@ -161,10 +166,54 @@ namespace MetricsSystem {
         return std::to_string(value);
     }
 
-    // Explicit template instantiations for common types
-    template std::string ValueFormatter::formatValue<int>(const int& value);
-    template std::string ValueFormatter::formatValue<double>(const double& value);
-    template std::string ValueFormatter::formatValue<float>(const float& value);
-    template std::string ValueFormatter::formatValue<long>(const long& value);
+    // DurableFile implementations
+    bool DurableFile::sync(const std::string& path) {
+#ifdef _WIN32
+        int fd = _open(path.c_str(), _O_RDWR | _O_BINARY);
+        if (fd < 0) {
+            return false;
+        }
+        bool ok = _commit(fd) == 0;
+        return (_close(fd) == 0) && ok;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        bool ok = fsync(fd) == 0;
+        return (::close(fd) == 0) && ok;
+#endif
+    }
+
+    bool DurableFile::syncDirectory(const std::string& path) {
+#ifdef _WIN32
+        (void)path;
+        return true;
+#else
+        std::string directory = std::filesystem::path(path).parent_path().string();
+        int fd = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY);
+        if (fd < 0) {
+            return false;
+        }
+        bool ok = fsync(fd) == 0;
+        return (::close(fd) == 0) && ok;
+#endif
+    }
+
+    void DurableFile::replace(const std::string& temp, const std::string& path) {
+        if (!sync(temp)) {
+            throw std::runtime_error("Failed to sync " + temp);
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(temp, path, ec);
+        if (ec) {
+            throw std::runtime_error("Failed to rename " + temp + " to " + path + ": " + ec.message());
+        }
+
+        if (!syncDirectory(path)) {
+            throw std::runtime_error("Failed to sync the directory of " + path);
+        }
+    }
 
 } // namespace MetricsSystem 
\ No newline at end of file
@@ -3,10 +3,13 @@
 #define _CRT_SECURE_NO_WARNINGS  // Disable Windows security warnings
 
 #include <string>
+#include <vector>
 #include <chrono>
 #include <unordered_map>
 #include <memory>
 #include <mutex>
+#include <sstream>
+#include <type_traits>
 
 // Use shared_mutex if available (C++17), otherwise fall back to mutex
 #if __cplusplus >= 201703L
@@ -28,7 +31,7 @@ namespace MetricsSystem {
     // Utility class for timestamp operations
     class TimestampUtils {
     public:
-        // Get current timestamp
+        // Get current timestamp (from Clock::getDefault())
         static std::chrono::system_clock::time_point getCurrentTime();
         
         // Format timestamp to required string format: "2025-06-01 15:00:01.653"
@@ -94,7 +97,17 @@ namespace MetricsSystem {
     public:
         // Format different value types for output
         template<typename T>
-        static std::string formatValue(const T& value);
+        static std::string formatValue(const T& value) {
+            if constexpr (std::is_floating_point_v<T>) {
+                return formatDouble(static_cast<double>(value));
+            } else if constexpr (std::is_integral_v<T>) {
+                return std::to_string(value);  // Full 64-bit range (long is 32-bit on Windows)
+            } else {
+                std::ostringstream oss;
+                oss << value;
+                return oss.str();
+            }
+        }
         
         // Format floating point with specific precision
         static std::string formatDouble(double value, int precision = 2);
@@ -103,4 +116,21 @@ namespace MetricsSystem {
         static std::string formatInteger(long value);
     };
 
+    // Files written through a temporary and renamed into place: the data
+    // reaches the disk before the rename, and the rename before anything
+    // that relies on it (e.g. removing the file's source)
+    class DurableFile {
+    public:
+        // Flush a written file's data to disk
+        static bool sync(const std::string& path);
+
+        // Flush the directory holding `path`, so a rename or removal in it
+        // survives a crash (nothing to do on Windows)
+        static bool syncDirectory(const std::string& path);
+
+        // sync(temp), rename it over `path`, syncDirectory(path). Throws
+        // std::runtime_error; `temp` is left for the caller to remove.
+        static void replace(const std::string& temp, const std::string& path);
+    };
+
 } // namespace MetricsSystem 
\ No newline at end of file
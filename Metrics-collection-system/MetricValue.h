@@ -0,0 +1,358 @@
+#pragma once
+
+#include "MetricAccumulator.h"
+#include "MetricCheckpoint.h"
+#include "MetricDirtySet.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+namespace MetricsSystem {
+
+    // How the values of consecutive ticks combine when the output buffer
+    // coalesces them (see MetricValue::coalesce)
+    enum class TickMerge : uint8_t {
+        Sum,    // Interval totals add up
+        Mean,   // Averages weighted by their sample counts
+        Max,    // The larger maximum
+        Last    // The newer value
+    };
+
+    // Base class for metric values that can hold different data types
+    class MetricValue {
+    public:
+        virtual ~MetricValue() = default;
+        virtual std::string toString() const = 0;
+        virtual std::unique_ptr<MetricValue> clone() const = 0;
+        virtual void reset() = 0;
+        virtual void accumulate(const MetricValue& other) = 0;
+
+        // Fold in the value of the following tick of the same metric, as
+        // its aggregation would have over both intervals. The default is
+        // accumulate().
+        virtual void coalesce(const MetricValue& newer) { accumulate(newer); }
+
+        // Numeric reading for deadband filtering (none for composite values)
+        virtual std::optional<double> asDouble() const { return std::nullopt; }
+
+        // Append the value as a bare number (std::to_chars, shortest form).
+        // False for values that are not a finite number.
+        virtual bool appendNumber(std::string& /*out*/) const { return false; }
+
+        // Append toString(). Typed values write it in place, without the
+        // temporary string.
+        virtual void appendText(std::string& out) const { out.append(toString()); }
+    };
+
+    // Template implementation for specific data types. Values are held in
+    // the accumulator type of T (64-bit for integers), so interval totals of
+    // narrow metrics fit and averages are divided in 64 bits. The value is
+    // value_ / count_: a mean keeps its sum and sample count, anything else
+    // a count of 1. A default-constructed value is empty (count 0).
+    template<Accumulable T>
+    class TypedMetricValue : public MetricValue {
+    public:
+        using accumulator_type = AccumulatorType<T>;
+
+    private:
+        accumulator_type value_;
+        uint64_t count_;
+        TickMerge merge_;
+
+    public:
+        TypedMetricValue() : value_(), count_(0), merge_(TickMerge::Sum) {}
+        TypedMetricValue(accumulator_type value, TickMerge merge = TickMerge::Sum, uint64_t count = 1)
+            : value_(value), count_(count), merge_(merge) {}
+
+        std::string toString() const override;
+        std::unique_ptr<MetricValue> clone() const override;
+        void reset() override;
+        void accumulate(const MetricValue& other) override;
+        void coalesce(const MetricValue& newer) override;
+        TickMerge getMerge() const { return merge_; }
+        
+        accumulator_type getValue() const {
+            if (count_ == 0) {
+                return accumulator_type{};
+            }
+            if constexpr (std::is_arithmetic_v<T>) {
+                return value_ / static_cast<accumulator_type>(count_);
+            } else {
+                return value_ / count_;
+            }
+        }
+        void addValue(T val) { value_ += val; count_++; }
+
+        std::optional<double> asDouble() const override {
+            if constexpr (std::is_arithmetic_v<T>) {
+                return static_cast<double>(getValue());
+            } else {
+                return std::nullopt;
+            }
+        }
+
+        bool appendNumber(std::string& out) const override {
+            if constexpr (std::is_arithmetic_v<T>) {
+                const accumulator_type value = getValue();
+                if constexpr (std::is_floating_point_v<accumulator_type>) {
+                    if (!std::isfinite(value)) {
+                        return false;
+                    }
+                }
+
+                char buffer[32];
+                auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+                out.append(buffer, result.ptr);
+                return true;
+            } else {
+                return false;
+            }
+        }
+
+        void appendText(std::string& out) const override {
+            if constexpr (std::is_arithmetic_v<T>) {
+                if (count_ == 0) {
+                    out.push_back('0');
+                    return;
+                }
+
+                // Same digits as toString(); values too long for the buffer
+                // (huge doubles in fixed notation) take the slow path
+                char buffer[64];
+                std::to_chars_result result;
+                if constexpr (std::is_floating_point_v<T>) {
+                    result = std::to_chars(buffer, buffer + sizeof(buffer), getValue(), std::chars_format::fixed, 2);
+                } else {
+                    result = std::to_chars(buffer, buffer + sizeof(buffer), getValue());
+                }
+                if (result.ec == std::errc()) {
+                    out.append(buffer, result.ptr);
+                    return;
+                }
+            }
+            out.append(toString());
+        }
+    };
+
+    // TypedMetricValue template implementations
+    template<Accumulable T>
+    std::string TypedMetricValue<T>::toString() const {
+        if (count_ == 0) {
+            return "0";
+        }
+        
+        std::ostringstream oss;
+        if constexpr (std::is_floating_point_v<T>) {
+            oss << std::fixed << std::setprecision(2) << getValue();
+        } else {
+            oss << getValue();
+        }
+        return oss.str();
+    }
+
+    template<Accumulable T>
+    std::unique_ptr<MetricValue> TypedMetricValue<T>::clone() const {
+        return std::make_unique<TypedMetricValue<T>>(*this);
+    }
+
+    template<Accumulable T>
+    void TypedMetricValue<T>::reset() {
+        value_ = accumulator_type{};
+        count_ = 0;
+    }
+
+    template<Accumulable T>
+    void TypedMetricValue<T>::accumulate(const MetricValue& other) {
+        const auto* typed_other = dynamic_cast<const TypedMetricValue<T>*>(&other);
+        if (!typed_other) {
+            throw std::invalid_argument("Cannot accumulate different metric value types");
+        }
+        
+        if constexpr (std::is_integral_v<T>) {
+            value_ = addCounter(value_, typed_other->value_, CounterOverflow::Saturate);
+        } else {
+            value_ += typed_other->value_;
+        }
+        count_ += typed_other->count_;
+    }
+
+    template<Accumulable T>
+    void TypedMetricValue<T>::coalesce(const MetricValue& newer) {
+        const auto* typed_newer = dynamic_cast<const TypedMetricValue<T>*>(&newer);
+        if (!typed_newer) {
+            throw std::invalid_argument("Cannot coalesce different metric value types");
+        }
+
+        switch (merge_) {
+        case TickMerge::Sum: {
+            accumulator_type total = getValue();
+            if constexpr (std::is_integral_v<T>) {
+                total = addCounter(total, typed_newer->getValue(), CounterOverflow::Saturate);
+            } else {
+                total += typed_newer->getValue();
+            }
+            value_ = total;
+            count_ = 1;
+            break;
+        }
+
+        case TickMerge::Mean:
+            accumulate(newer);
+            break;
+
+        case TickMerge::Max:
+            if constexpr (std::is_arithmetic_v<T>) {
+                if (typed_newer->count_ > 0 && (count_ == 0 || typed_newer->getValue() > getValue())) {
+                    *this = *typed_newer;
+                }
+            }
+            break;
+
+        case TickMerge::Last:
+            if (typed_newer->count_ > 0) {
+                *this = *typed_newer;
+            }
+            break;
+        }
+    }
+
+    // Interval minimum, maximum and mean of one metric (MinMaxMean
+    // aggregation), written as a single "min/max/mean" token
+    template<Accumulable T>
+        requires std::is_arithmetic_v<T>
+    class MinMaxMeanValue : public MetricValue {
+    public:
+        using accumulator_type = AccumulatorType<T>;
+
+    private:
+        T min_;
+        T max_;
+        accumulator_type sum_;
+        uint64_t count_;
+
+        static void format(std::ostringstream& oss, accumulator_type value) {
+            if constexpr (std::is_floating_point_v<T>) {
+                oss << std::fixed << std::setprecision(2) << value;
+            } else {
+                oss << value;
+            }
+        }
+
+    public:
+        MinMaxMeanValue() : min_(), max_(), sum_(), count_(0) {}
+        MinMaxMeanValue(T min, T max, accumulator_type sum, uint64_t count)
+            : min_(min), max_(max), sum_(sum), count_(count) {}
+
+        std::string toString() const override {
+            if (count_ == 0) {
+                return "0";
+            }
+
+            std::ostringstream oss;
+            format(oss, min_);
+            oss << '/';
+            format(oss, max_);
+            oss << '/';
+            format(oss, getMean());
+            return oss.str();
+        }
+
+        std::unique_ptr<MetricValue> clone() const override {
+            return std::make_unique<MinMaxMeanValue<T>>(*this);
+        }
+
+        void reset() override {
+            *this = MinMaxMeanValue<T>();
+        }
+
+        void accumulate(const MetricValue& other) override {
+            const auto* typed_other = dynamic_cast<const MinMaxMeanValue<T>*>(&other);
+            if (!typed_other) {
+                throw std::invalid_argument("Cannot accumulate different metric value types");
+            }
+            if (typed_other->count_ == 0) {
+                return;
+            }
+            if (count_ == 0) {
+                *this = *typed_other;
+                return;
+            }
+
+            min_ = std::min(min_, typed_other->min_);
+            max_ = std::max(max_, typed_other->max_);
+            if constexpr (std::is_integral_v<T>) {
+                sum_ = addCounter(sum_, typed_other->sum_, CounterOverflow::Saturate);
+            } else {
+                sum_ += typed_other->sum_;
+            }
+            count_ += typed_other->count_;
+        }
+
+        T getMin() const { return min_; }
+        T getMax() const { return max_; }
+        uint64_t getCount() const { return count_; }
+        accumulator_type getMean() const {
+            return count_ > 0 ? sum_ / static_cast<accumulator_type>(count_) : accumulator_type{};
+        }
+    };
+
+    // Base interface for all metric types
+    class Metric {
+    public:
+        virtual ~Metric() = default;
+        virtual std::string getName() const = 0;
+        virtual void recordValue(std::unique_ptr<MetricValue> value) = 0;
+        virtual std::unique_ptr<MetricValue> getAccumulatedValue() const = 0;
+        virtual void reset() = 0;
+
+        // Read the interval value and start a new interval. The default is
+        // getAccumulatedValue() followed by reset(); TypedMetric does both
+        // under one lock so no record falls between them.
+        virtual std::unique_ptr<MetricValue> collectAndReset() {
+            auto value = getAccumulatedValue();
+            reset();
+            return value;
+        }
+
+        // Checkpoint support: metrics append their accumulator state and can
+        // restore it after a restart. State of the current interval is saved
+        // empty unless out.intervals(). Metrics without such state write nothing.
+        virtual void saveState(CheckpointWriter& /*out*/) const {}
+        virtual void loadState(CheckpointReader& /*in*/) {}
+
+        // Dirty tracking: metrics that call markDirty() on every record can
+        // be skipped by the collector while idle. Others are read every tick.
+        virtual bool tracksDirty() const { return false; }
+
+        // Interval value of a metric with no records since the last
+        // collection, written without reading the metric (null: read it)
+        virtual std::unique_ptr<MetricValue> idleValue() const { return nullptr; }
+
+        // Fresh, unregistered metric with the same value type and
+        // aggregation, accumulating one event-time interval (see
+        // EventTimeWindows). Null: the metric takes live values only.
+        virtual std::unique_ptr<Metric> createInterval() const { return nullptr; }
+
+        // Fold `other`, another interval copy of the same metric, into this
+        // interval copy and leave `other` empty
+        virtual void mergeInterval(Metric& /*other*/) {
+            throw std::logic_error("Metric '" + getName() + "' has no interval copies to merge");
+        }
+        void attachDirtySlot(DirtySlot slot) { dirty_ = slot; }
+
+    protected:
+        void markDirty() const { dirty_.mark(); }
+
+    private:
+        DirtySlot dirty_;   // Assigned by the collector on registration
+    };
+
+} // namespace MetricsSystem
\ No newline at end of file
@@ -0,0 +1,160 @@
+#include "MetricWorkerPool.h"
+#include <algorithm>
+#include <iostream>
+#include <memory>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace MetricsSystem {
+
+    namespace {
+
+        // State shared between the caller of parallelFor and its helpers.
+        // Held by shared_ptr so helpers that start after the work is done
+        // never touch the caller's stack.
+        struct ParallelForState {
+            const std::function<void(size_t)>* task = nullptr;
+            size_t count = 0;
+            std::atomic<size_t> next_index{0};
+            std::atomic<size_t> completed{0};
+            std::mutex done_mutex;
+            std::condition_variable done_cv;
+            std::exception_ptr error;
+
+            // Execute items until none are left
+            void drain() {
+                size_t finished = 0;
+                for (size_t i = next_index.fetch_add(1); i < count; i = next_index.fetch_add(1)) {
+                    try {
+                        (*task)(i);
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock(done_mutex);
+                        if (!error) {
+                            error = std::current_exception();
+                        }
+                    }
+                    ++finished;
+                }
+
+                if (finished > 0 && completed.fetch_add(finished) + finished == count) {
+                    std::lock_guard<std::mutex> lock(done_mutex);
+                    done_cv.notify_all();
+                }
+            }
+        };
+
+    } // namespace
+
+    // WorkerPool Implementation
+    WorkerPool::WorkerPool(size_t thread_count) : stopping_(false) {
+        if (thread_count == 0) {
+            thread_count = 1;
+        }
+
+        workers_.reserve(thread_count);
+        for (size_t i = 0; i < thread_count; ++i) {
+            workers_.emplace_back(&WorkerPool::workerLoop, this);
+        }
+    }
+
+    WorkerPool::~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            stopping_ = true;
+        }
+        queue_cv_.notify_all();
+
+        for (auto& worker : workers_) {
+            if (worker.joinable()) {
+                worker.join();
+            }
+        }
+    }
+
+    void WorkerPool::submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            tasks_.push(std::move(task));
+        }
+        queue_cv_.notify_one();
+    }
+
+    void WorkerPool::parallelFor(size_t count, const std::function<void(size_t)>& task) {
+        if (count == 0) {
+            return;
+        }
+
+        auto state = std::make_shared<ParallelForState>();
+        state->task = &task;
+        state->count = count;
+
+        // The caller handles one share of the work itself
+        size_t helpers = std::min(workers_.size(), count - 1);
+        for (size_t i = 0; i < helpers; ++i) {
+            submit([state]() { state->drain(); });
+        }
+
+        state->drain();
+
+        {
+            std::unique_lock<std::mutex> lock(state->done_mutex);
+            state->done_cv.wait(lock, [&state]() { return state->completed.load() == state->count; });
+        }
+
+        if (state->error) {
+            std::rethrow_exception(state->error);
+        }
+    }
+
+    size_t WorkerPool::defaultThreadCount() {
+        size_t cores = std::thread::hardware_concurrency();
+        return std::max<size_t>(1, std::min<size_t>(4, cores / 2));
+    }
+
+    void WorkerPool::lowerThreadPriority() {
+        thread_local bool lowered = false;
+        if (lowered) {
+            return;
+        }
+        lowered = true;
+#ifdef _WIN32
+        // Background mode lowers the I/O priority as well
+        SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+#elif defined(__linux__)
+        // Nice values apply per thread on Linux
+        setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+#endif
+    }
+
+    void WorkerPool::workerLoop() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(queue_mutex_);
+                queue_cv_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+
+                if (stopping_ && tasks_.empty()) {
+                    return;
+                }
+
+                task = std::move(tasks_.front());
+                tasks_.pop();
+            }
+
+            try {
+                task();
+            } catch (const std::exception& e) {
+                std::cerr << "WorkerPool task failed: " << e.what() << std::endl;
+            }
+        }
+    }
+
+} // namespace MetricsSystem
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace MetricsSystem {
+
+    // Small fixed-size thread pool used for background metric processing
+    // (snapshot sweeps, formatting). Application threads never touch it.
+    class WorkerPool {
+    private:
+        std::vector<std::thread> workers_;
+        std::queue<std::function<void()>> tasks_;
+        std::mutex queue_mutex_;
+        std::condition_variable queue_cv_;
+        bool stopping_;
+
+        void workerLoop();
+
+    public:
+        explicit WorkerPool(size_t thread_count);
+        ~WorkerPool();
+
+        // Non-copyable, non-movable (owns threads)
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+        WorkerPool(WorkerPool&&) = delete;
+        WorkerPool& operator=(WorkerPool&&) = delete;
+
+        // Queue a task for asynchronous execution
+        void submit(std::function<void()> task);
+
+        // Run task(i) for every i in [0, count) and wait for completion.
+        // The calling thread takes part in the work, so nested calls from
+        // inside a pool task cannot deadlock. The first exception thrown by
+        // a task is rethrown to the caller.
+        void parallelFor(size_t count, const std::function<void(size_t)>& task);
+
+        size_t size() const { return workers_.size(); }
+
+        // Reasonable default size for background work: half the cores, capped at 4
+        static size_t defaultThreadCount();
+
+        // Drop the calling thread to the lowest scheduling priority (and
+        // background I/O priority where the platform has one). Only the
+        // first call on a thread does anything.
+        static void lowerThreadPriority();
+    };
+
+} // namespace MetricsSystem
\ No newline at end of file
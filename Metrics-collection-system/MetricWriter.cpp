@@ -1,12 +1,33 @@
 #include "MetricSystem.h"
 #include "MetricUtilities.h"
+#include "MetricCompactWriter.h"
+#include "MetricJsonWriter.h"
+#include "MetricCsvWriter.h"
+#include "MetricSqliteWriter.h"
+#include "MetricRemoteWrite.h"
+#include "MetricSegment.h"
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
 #include <iostream>
 #include <stdexcept>
 
 namespace MetricsSystem {
 
+    bool MetricWriteError::isDiskFull() const {
+#ifdef EDQUOT
+        if (error_code_ == EDQUOT) {
+            return true;
+        }
+#endif
+        return error_code_ == ENOSPC;
+    }
+
     // MetricWriter Implementation
-    MetricWriter::MetricWriter(const std::string& filename) : output_file_(filename) {
+    MetricWriter::MetricWriter(const std::string& filename)
+        : output_file_(filename), failed_(false), good_size_(0), segment_started_(Clock::getDefault().now()),
+          segment_base_size_(0), preamble_pending_(false), new_segment_requested_(false) {
         if (filename.empty()) {
             throw std::invalid_argument("Output filename cannot be empty");
         }
@@ -18,9 +39,21 @@ namespace MetricsSystem {
             throw std::runtime_error("Failed to open output file: " + filename);
         }
 
+        std::error_code ec;
+        auto size = std::filesystem::file_size(filename, ec);
+        good_size_ = ec ? -1 : static_cast<std::streamoff>(size);
+
         std::cout << "MetricWriter initialized with file: " << filename << std::endl;
     }
 
+    MetricWriter::MetricWriter(const std::string& filename, NoFile)
+        : output_file_(filename), failed_(false), good_size_(0), segment_started_(Clock::getDefault().now()),
+          segment_base_size_(0), preamble_pending_(false), new_segment_requested_(false) {
+        if (filename.empty()) {
+            throw std::invalid_argument("Output filename cannot be empty");
+        }
+    }
+
     MetricWriter::~MetricWriter() {
         close();
     }
@@ -30,41 +63,269 @@ namespace MetricsSystem {
             return;
         }
 
-        std::lock_guard<std::mutex> lock(write_mutex_);
+        // Format outside of the write lock, then hand over as one batch
+        std::vector<std::string> chunks(1);
+        formatEntries(entries.data(), entries.data() + entries.size(), chunks.front());
+        finishTick(entries.front().timestamp, entries, chunks);
+        writeFormatted(chunks);
+    }
 
-        if (!file_stream_.is_open()) {
-            throw std::runtime_error("Output file is not open");
-        }
+    void MetricWriter::formatEntries(const MetricEntry* first, const MetricEntry* last, std::string& out) const {
+        // Entries of one tick share a timestamp, so format it once per run
+        // instead of once per entry
+        const TimePoint* cached_tp = nullptr;
+        std::string timestamp_str;
 
-        // Group entries by timestamp to write them together
-        // Format: timestamp "metric1" value1 "metric2" value2 ...
-        
-        // For now, write each metric on its own line as specified in the requirements
-        for (const auto& entry : entries) {
+        for (const MetricEntry* entry = first; entry != last; ++entry) {
             try {
-                // Format: 2025-06-01 15:00:01.653 "CPU" 0.97 "HTTP requests RPS" 42
-                std::string timestamp_str = formatTimestamp(entry.timestamp);
-                std::string metric_name = MetricNameValidator::formatNameForOutput(entry.name);
-                std::string value_str = entry.value->toString();
+                if (!cached_tp || *cached_tp != entry->timestamp) {
+                    timestamp_str = formatTimestamp(entry->timestamp);
+                    cached_tp = &entry->timestamp;
+                }
 
-                file_stream_ << timestamp_str << " " << metric_name << " " << value_str;
+                // Format: 2025-06-01 15:00:01.653 "CPU" 0.97
+                std::string metric_name = MetricNameValidator::formatNameForOutput(entry->name);
+                std::string value_str = entry->value->toString();
 
-                // Add newline after each metric entry
-                file_stream_ << std::endl;
+                out.append(timestamp_str);
+                out.push_back(' ');
+                out.append(metric_name);
+                out.push_back(' ');
+                out.append(value_str);
+                out.push_back('\n');
 
             } catch (const std::exception& e) {
-                std::cerr << "Error formatting metric entry '" << entry.name << "': " << e.what() << std::endl;
+                std::cerr << "Error formatting metric entry '" << entry->name << "': " << e.what() << std::endl;
                 continue; // Skip this entry but continue with others
             }
         }
+    }
+
+    void MetricWriter::writeFormatted(const std::vector<std::string>& chunks) {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+
+        if (!file_stream_.is_open()) {
+            throw MetricWriteError("Output file is not open: " + output_file_, failed_ ? EIO : EBADF);
+        }
+
+        // good_size_ follows the bytes written (every batch is flushed); the
+        // file is only asked when it is unknown
+        if (good_size_ < 0) {
+            std::error_code ec;
+            auto size = std::filesystem::file_size(output_file_, ec);
+            good_size_ = ec ? -1 : static_cast<std::streamoff>(size);
+        }
+
+        if (good_size_ >= 0) {
+            const auto size = static_cast<std::uintmax_t>(good_size_);
+            if (new_segment_requested_.exchange(false)) {
+                if (size > segment_base_size_) {
+                    rotateSegment();
+                } else {
+                    segment_started_ = now();
+                }
+                // The new preamble goes out even if the rename failed
+                preamble_pending_ = true;
+            } else if (segment_options_.max_bytes > 0 || segment_options_.max_age.count() > 0) {
+                if (size <= segment_base_size_) {
+                    // Nothing in this segment yet - its age starts with the first batch
+                    segment_started_ = now();
+                } else if ((segment_options_.max_bytes > 0 && size - segment_base_size_ >= segment_options_.max_bytes) ||
+                           (segment_options_.max_age.count() > 0 && now() - segment_started_ >= segment_options_.max_age)) {
+                    rotateSegment();
+                }
+            }
+        }
+
+        errno = 0;
+
+        std::streamoff written = 0;
+        std::string preamble;
+        if (preamble_pending_) {
+            startSegment(preamble);
+            file_stream_.write(preamble.data(), static_cast<std::streamsize>(preamble.size()));
+            written += static_cast<std::streamoff>(preamble.size());
+        }
+
+        for (const auto& chunk : chunks) {
+            file_stream_.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+            written += static_cast<std::streamoff>(chunk.size());
+        }
 
         // Ensure data is written to disk immediately
         file_stream_.flush();
+
+        if (file_stream_.fail()) {
+            // The stream does not report why; errno from the failed write does
+            int error_code = errno != 0 ? errno : EIO;
+            failed_ = true;
+            file_stream_.clear();
+            file_stream_.close();
+            throw MetricWriteError("Failed to write " + output_file_ + ": " + std::strerror(error_code), error_code);
+        }
+
+        preamble_pending_ = false;
+        if (good_size_ >= 0) {
+            good_size_ += written;
+        }
+
+        // Only what reached the file counts towards the footer
+        if (segment_options_.footers && hasSegmentFooters() &&
+            (segment_options_.max_bytes > 0 || segment_options_.max_age.count() > 0)) {
+            if (!footer_) {
+                footer_ = std::make_unique<SegmentFooterBuilder>();
+            }
+            footer_->add(preamble);
+            for (const auto& chunk : chunks) {
+                footer_->add(chunk);
+            }
+        }
+    }
+
+    void MetricWriter::rotateSegment() {
+        // Called under the write lock, with the stream open and holding at
+        // least one complete batch
+        file_stream_.close();
+
+        std::error_code ec;
+        if (segment_options_.footers && hasSegmentFooters()) {
+            const auto data_size = std::filesystem::file_size(output_file_, ec);
+            try {
+                std::string footer;
+                if (!ec && footer_ && footer_->getDataSize() == data_size) {
+                    SegmentFooter built = footer_->build();
+                    built.setFormat(segmentFormat());
+                    built.format(footer);
+                } else {
+                    // Data from before this writer, or written while footers
+                    // were off: read the segment once. The earlier data may
+                    // be of another format, so none is recorded.
+                    MappedFile file(output_file_);
+                    SegmentFooter::build(file).format(footer);
+                }
+
+                std::ofstream out(output_file_, std::ios::out | std::ios::app | std::ios::binary);
+                out.write(footer.data(), static_cast<std::streamsize>(footer.size()));
+                out.flush();
+                if (!out) {
+                    throw std::runtime_error(std::strerror(errno != 0 ? errno : EIO));
+                }
+            } catch (const std::exception& e) {
+                // The segment stays readable without a footer; a torn one
+                // must not run into the next batch
+                std::cerr << "Failed to write segment footer to " << output_file_ << ": " << e.what() << std::endl;
+                if (!ec) {
+                    std::filesystem::resize_file(output_file_, data_size, ec);
+                }
+            }
+        }
+
+        const std::string segment = segmentPath();
+        std::filesystem::rename(output_file_, segment, ec);
+        if (ec) {
+            // Keep appending to the same file and try again one segment later
+            std::cerr << "Failed to rotate " << output_file_ << " to " << segment << ": " << ec.message() << std::endl;
+            segment_base_size_ = std::filesystem::file_size(output_file_, ec);
+            if (ec) {
+                segment_base_size_ = 0;
+            }
+            good_size_ = ec ? -1 : static_cast<std::streamoff>(segment_base_size_);
+        } else {
+            std::cout << "MetricWriter finished segment: " << segment << std::endl;
+            if (footer_) {
+                footer_->reset();
+            }
+            segment_base_size_ = 0;
+            good_size_ = 0;
+            preamble_pending_ = true;
+        }
+        segment_started_ = now();
+
+        file_stream_.open(output_file_, std::ios::out | std::ios::app);
+        if (!file_stream_.is_open()) {
+            int error_code = errno != 0 ? errno : EIO;
+            failed_ = true;
+            throw MetricWriteError("Failed to reopen " + output_file_ + ": " + std::strerror(error_code), error_code);
+        }
+    }
+
+    std::string MetricWriter::segmentPath() const {
+        // metrics.txt -> metrics.20250601-150001.txt (-1, -2, ... if taken)
+        const std::time_t started = std::chrono::system_clock::to_time_t(segment_started_);
+        std::tm local_tm = {};
+#ifdef _WIN32
+        localtime_s(&local_tm, &started);
+#else
+        localtime_r(&started, &local_tm);
+#endif
+        char stamp[32];
+        std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &local_tm);
+
+        const std::filesystem::path path(output_file_);
+        const std::string base = (path.parent_path() / path.stem()).string() + "." + stamp;
+        const std::string extension = path.extension().string();
+
+        std::string candidate = base + extension;
+        std::error_code ec;
+        for (int n = 1; std::filesystem::exists(candidate, ec); ++n) {
+            candidate = base + "-" + std::to_string(n) + extension;
+        }
+        return candidate;
+    }
+
+    void MetricWriter::setSegmentOptions(const SegmentOptions& options) {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        segment_options_ = options;
+        segment_started_ = now();
+    }
+
+    void MetricWriter::setClock(std::shared_ptr<Clock> clock) {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        clock_ = std::move(clock);
+        segment_started_ = now();
+    }
+
+    bool MetricWriter::recover() {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+
+        if (file_stream_.is_open()) {
+            return true;
+        }
+
+        if (!failed_) {
+            return false; // Closed on purpose
+        }
+
+        // Drop a partially written batch - it is written again in full
+        std::error_code ec;
+        auto size = std::filesystem::file_size(output_file_, ec);
+        if (!ec && good_size_ >= 0 && static_cast<std::streamoff>(size) > good_size_) {
+            std::filesystem::resize_file(output_file_, static_cast<std::uintmax_t>(good_size_), ec);
+            if (ec) {
+                return false;
+            }
+        } else {
+            good_size_ = ec ? -1 : static_cast<std::streamoff>(size);
+        }
+
+        file_stream_.open(output_file_, std::ios::out | std::ios::app);
+        if (!file_stream_.is_open()) {
+            return false;
+        }
+
+        failed_ = false;
+        return true;
+    }
+
+    bool MetricWriter::hasFailed() {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        return failed_;
     }
 
     void MetricWriter::close() {
         std::lock_guard<std::mutex> lock(write_mutex_);
         
+        failed_ = false;
         if (file_stream_.is_open()) {
             file_stream_.close();
             std::cout << "MetricWriter closed" << std::endl;
@@ -76,9 +337,44 @@ namespace MetricsSystem {
     }
 
     // MetricSystemFactory Implementation
+    std::unique_ptr<MetricWriter> MetricSystemFactory::createWriter(const std::string& output_file, OutputFormat format) {
+        switch (format) {
+            case OutputFormat::Compact:
+                return std::make_unique<CompactTextWriter>(output_file);
+            case OutputFormat::JsonLines:
+                return std::make_unique<JsonLinesWriter>(output_file);
+            case OutputFormat::Csv:
+                return std::make_unique<CsvWriter>(output_file);
+            case OutputFormat::Sqlite:
+#ifdef METRICS_WITH_SQLITE
+                return std::make_unique<SqliteWriter>(output_file);
+#else
+                throw std::invalid_argument("SQLite output needs a build with METRICS_WITH_SQLITE");
+#endif
+            case OutputFormat::RemoteWrite:
+                return std::make_unique<RemoteWriteWriter>(output_file);
+            case OutputFormat::Text:
+                break;
+        }
+        return std::make_unique<MetricWriter>(output_file);
+    }
+
     std::unique_ptr<MetricCollector> MetricSystemFactory::createSystem(const std::string& output_file) {
         auto writer = std::make_unique<MetricWriter>(output_file);
         return std::make_unique<MetricCollector>(std::move(writer));
     }
 
+    std::unique_ptr<MetricCollector> MetricSystemFactory::createSystem(const std::string& output_file, OutputFormat format) {
+        return std::make_unique<MetricCollector>(createWriter(output_file, format));
+    }
+
+    std::unique_ptr<MetricCollector> MetricSystemFactory::createSystem(const std::string& output_file,
+                                                                       std::shared_ptr<MetricRuntime> runtime) {
+        auto writer = std::make_unique<MetricWriter>(output_file);
+        if (!runtime) {
+            return std::make_unique<MetricCollector>(std::move(writer));
+        }
+        return std::make_unique<MetricCollector>(std::move(writer), std::move(runtime));
+    }
+
 } // namespace MetricsSystem 
\ No newline at end of file
@@ -2,15 +2,22 @@
 //
 
 #include "MetricSystemManager.h"
+#include "tests/MetricTests.h"
 #include <iostream>
+#include <string>
 #include <thread>
 #include <chrono>
 
 using namespace MetricsSystem;
 
 // Main demo showing the complete metrics collection system
-int main()
+int main(int argc, char* argv[])
 {
+    // Metrics-collection-system --test [name filter] runs the tests instead
+    if (argc > 1 && std::string(argv[1]) == "--test") {
+        return runMetricTests(argc > 2 ? argv[2] : "") == 0 ? 0 : 1;
+    }
+
     std::cout << "=== Metrics Collection System - Complete Demo ===" << std::endl;
     std::cout << "This demo shows CPU and HTTP request metrics as specified." << std::endl << std::endl;
 
@@ -1,5 +1,7 @@
 #include "SpecificMetrics.h"
 #include "MetricUtilities.h"
+#include "MetricCheckpoint.h"
+#include <algorithm>
 #include <thread>
 #include <stdexcept>
 #include <sstream>
@@ -32,6 +34,17 @@ namespace MetricsSystem {
         TypedMetric<double>::recordValue(value);
     }
 
+    void CPUMetric::recordValues(const double* values, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            if (!isValidUtilization(values[i])) {
+                throw std::invalid_argument("Invalid CPU utilization value: " + std::to_string(values[i]) +
+                                          ". Must be between 0 and " + std::to_string(max_utilization_));
+            }
+        }
+
+        TypedMetric<double>::recordValues(values, count);
+    }
+
     double CPUMetric::getUtilizationPercentage() const {
         auto current_value = getAccumulatedValue();
         auto typed_value = dynamic_cast<TypedMetricValue<double>*>(current_value.get());
@@ -68,12 +81,25 @@ namespace MetricsSystem {
             throw std::invalid_argument("HTTP request count cannot be negative: " + std::to_string(requests));
         }
         
-        total_requests_ += requests;
+        total_requests_.fetch_add(requests, std::memory_order_relaxed);
         
         // Call parent implementation
         TypedMetric<int>::recordValue(requests);
     }
 
+    void HTTPRequestMetric::recordValues(const int* values, size_t count) {
+        int64_t batch_total = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (values[i] < 0) {
+                throw std::invalid_argument("HTTP request count cannot be negative: " + std::to_string(values[i]));
+            }
+            batch_total += values[i];
+        }
+
+        total_requests_.fetch_add(batch_total, std::memory_order_relaxed);
+        TypedMetric<int>::recordValues(values, count);
+    }
+
     void HTTPRequestMetric::reset() {
         last_reset_ = TimestampUtils::getCurrentTime();
         
@@ -81,6 +107,22 @@ namespace MetricsSystem {
         TypedMetric<int>::reset();
     }
 
+    std::unique_ptr<MetricValue> HTTPRequestMetric::collectAndReset() {
+        auto value = TypedMetric<int>::collectAndReset();
+        last_reset_ = TimestampUtils::getCurrentTime();
+        return value;
+    }
+
+    void HTTPRequestMetric::saveState(CheckpointWriter& out) const {
+        TypedMetric<int>::saveState(out);
+        out.put(total_requests_.load(std::memory_order_relaxed));
+    }
+
+    void HTTPRequestMetric::loadState(CheckpointReader& in) {
+        TypedMetric<int>::loadState(in);
+        total_requests_.fetch_add(in.get<int64_t>(), std::memory_order_relaxed);
+    }
+
     double HTTPRequestMetric::getCurrentRPS() const {
         auto now = TimestampUtils::getCurrentTime();
         auto duration = std::chrono::duration_cast<std::chrono::seconds>(now - last_reset_);
@@ -121,21 +163,61 @@ namespace MetricsSystem {
             throw std::invalid_argument("Memory usage cannot be negative: " + std::to_string(memoryMB));
         }
         
-        if (track_peak_ && memoryMB > peak_usage_) {
-            peak_usage_ = memoryMB;
+        if (track_peak_) {
+            raisePeak(memoryMB);
         }
         
         // Call parent implementation
         TypedMetric<double>::recordValue(memoryMB);
     }
 
+    void MemoryMetric::recordValues(const double* values, size_t count) {
+        double batch_peak = 0.0;
+        for (size_t i = 0; i < count; ++i) {
+            if (values[i] < 0.0) {
+                throw std::invalid_argument("Memory usage cannot be negative: " + std::to_string(values[i]));
+            }
+            batch_peak = std::max(batch_peak, values[i]);
+        }
+
+        if (track_peak_) {
+            raisePeak(batch_peak);
+        }
+        TypedMetric<double>::recordValues(values, count);
+    }
+
+    void MemoryMetric::raisePeak(double value) {
+        double peak = peak_usage_.load(std::memory_order_relaxed);
+        while (value > peak && !peak_usage_.compare_exchange_weak(peak, value, std::memory_order_relaxed)) {
+        }
+    }
+
     void MemoryMetric::reset() {
-        peak_usage_ = 0.0;
+        peak_usage_.store(0.0, std::memory_order_relaxed);
         
         // Call parent reset
         TypedMetric<double>::reset();
     }
 
+    std::unique_ptr<MetricValue> MemoryMetric::collectAndReset() {
+        auto value = TypedMetric<double>::collectAndReset();
+        peak_usage_.store(0.0, std::memory_order_relaxed);
+        return value;
+    }
+
+    void MemoryMetric::saveState(CheckpointWriter& out) const {
+        TypedMetric<double>::saveState(out);
+        out.put(out.intervals() ? peak_usage_.load(std::memory_order_relaxed) : 0.0);
+    }
+
+    void MemoryMetric::loadState(CheckpointReader& in) {
+        TypedMetric<double>::loadState(in);
+        double peak = in.get<double>();
+        if (track_peak_) {
+            raisePeak(peak);
+        }
+    }
+
     double MemoryMetric::getCurrentUsage() const {
         auto current_value = getAccumulatedValue();
         auto typed_value = dynamic_cast<TypedMetricValue<double>*>(current_value.get());
@@ -166,18 +248,41 @@ namespace MetricsSystem {
             throw std::invalid_argument("Network bytes cannot be negative: " + std::to_string(bytes));
         }
         
-        total_bytes_ += bytes;
+        total_bytes_.fetch_add(bytes, std::memory_order_relaxed);
         
         // Call parent implementation
         TypedMetric<long>::recordValue(bytes);
     }
 
+    void NetworkMetric::recordValues(const long* values, size_t count) {
+        int64_t batch_total = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (values[i] < 0) {
+                throw std::invalid_argument("Network bytes cannot be negative: " + std::to_string(values[i]));
+            }
+            batch_total += values[i];
+        }
+
+        total_bytes_.fetch_add(batch_total, std::memory_order_relaxed);
+        TypedMetric<long>::recordValues(values, count);
+    }
+
     void NetworkMetric::reset() {
         // Note: We keep total_bytes_ for lifetime statistics
         // Only reset the accumulated values for current period
         TypedMetric<long>::reset();
     }
 
+    void NetworkMetric::saveState(CheckpointWriter& out) const {
+        TypedMetric<long>::saveState(out);
+        out.put(total_bytes_.load(std::memory_order_relaxed));
+    }
+
+    void NetworkMetric::loadState(CheckpointReader& in) {
+        TypedMetric<long>::loadState(in);
+        total_bytes_.fetch_add(in.get<int64_t>(), std::memory_order_relaxed);
+    }
+
     std::string NetworkMetric::formatThroughput(long bytesPerSecond) const {
         std::ostringstream oss;
         
@@ -230,15 +335,4 @@ namespace MetricsSystem {
         return std::make_unique<NetworkMetric>(name);
     }
 
-    template<typename T>
-    std::unique_ptr<TypedMetric<T>> MetricFactory::createGenericMetric(const std::string& name) {
-        return std::make_unique<TypedMetric<T>>(name);
-    }
-
-    // Explicit template instantiations for common types
-    template std::unique_ptr<TypedMetric<int>> MetricFactory::createGenericMetric<int>(const std::string& name);
-    template std::unique_ptr<TypedMetric<double>> MetricFactory::createGenericMetric<double>(const std::string& name);
-    template std::unique_ptr<TypedMetric<float>> MetricFactory::createGenericMetric<float>(const std::string& name);
-    template std::unique_ptr<TypedMetric<long>> MetricFactory::createGenericMetric<long>(const std::string& name);
-
 } // namespace MetricsSystem 
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "MetricSystem.h"
+#include <atomic>
 #include <memory>
 #include <string>
 
@@ -19,7 +20,8 @@ namespace MetricsSystem {
         explicit CPUMetric(const std::string& name = "CPU", int cores = -1);
 
         // Add CPU-specific validation (convenience method)
-        void recordValue(double value);
+        void recordValue(double value) override;
+        void recordValues(const double* values, size_t count) override;
 
         // Get CPU utilization as percentage (0-100% per core)
         double getUtilizationPercentage() const;
@@ -39,7 +41,7 @@ namespace MetricsSystem {
     // Values are integer numbers from 0 to INT_MAX representing requests per second
     class HTTPRequestMetric : public TypedMetric<int> {
     private:
-        long total_requests_;
+        std::atomic<int64_t> total_requests_;    // Updated by any recording thread
         std::chrono::system_clock::time_point start_time_;
         std::chrono::system_clock::time_point last_reset_;
 
@@ -47,13 +49,22 @@ namespace MetricsSystem {
         explicit HTTPRequestMetric(const std::string& name = "HTTP requests RPS");
 
         // Add HTTP-specific tracking (convenience method)
-        void recordValue(int requests);
+        void recordValue(int requests) override;
+        void recordValues(const int* values, size_t count) override;
 
         // Reset with timestamp tracking
         void reset() override;
+        std::unique_ptr<MetricValue> collectAndReset() override;
+
+        // Collected on every tick, idle or not, so the RPS window restarts
+        std::unique_ptr<MetricValue> idleValue() const override { return nullptr; }
+
+        // Checkpoint the lifetime request total along with the interval state
+        void saveState(CheckpointWriter& out) const override;
+        void loadState(CheckpointReader& in) override;
 
         // Get total requests since creation
-        long getTotalRequests() const { return total_requests_; }
+        int64_t getTotalRequests() const { return total_requests_.load(std::memory_order_relaxed); }
 
         // Get requests per second since last reset
         double getCurrentRPS() const;
@@ -70,20 +81,28 @@ namespace MetricsSystem {
     // Values represent memory usage in MB
     class MemoryMetric : public TypedMetric<double> {
     private:
-        double peak_usage_;
+        std::atomic<double> peak_usage_;         // Raised by any recording thread (see raisePeak)
         bool track_peak_;
 
+        void raisePeak(double value);
+
     public:
         explicit MemoryMetric(const std::string& name = "Memory Usage MB", bool trackPeak = true);
 
         // Track peak memory usage (convenience method)
-        void recordValue(double memoryMB);
+        void recordValue(double memoryMB) override;
+        void recordValues(const double* values, size_t count) override;
 
         // Reset peak tracking
         void reset() override;
+        std::unique_ptr<MetricValue> collectAndReset() override;
+
+        // Checkpoint the peak along with the interval state
+        void saveState(CheckpointWriter& out) const override;
+        void loadState(CheckpointReader& in) override;
 
         // Get peak memory usage since last reset
-        double getPeakUsage() const { return peak_usage_; }
+        double getPeakUsage() const { return peak_usage_.load(std::memory_order_relaxed); }
 
         // Get current memory usage (last recorded value)
         double getCurrentUsage() const;
@@ -97,7 +116,7 @@ namespace MetricsSystem {
     // Values represent bytes per second
     class NetworkMetric : public TypedMetric<long> {
     private:
-        long total_bytes_;
+        std::atomic<int64_t> total_bytes_;       // Updated by any recording thread
         std::string direction_; // "in", "out", or "both"
 
     public:
@@ -105,13 +124,18 @@ namespace MetricsSystem {
                              const std::string& direction = "both");
 
         // Track total bytes (convenience method)
-        void recordValue(long bytes);
+        void recordValue(long bytes) override;
+        void recordValues(const long* values, size_t count) override;
 
         // Reset total byte counter
         void reset() override;
 
+        // Checkpoint the lifetime byte total along with the interval state
+        void saveState(CheckpointWriter& out) const override;
+        void loadState(CheckpointReader& in) override;
+
         // Get total bytes transferred
-        long getTotalBytes() const { return total_bytes_; }
+        int64_t getTotalBytes() const { return total_bytes_.load(std::memory_order_relaxed); }
 
         // Get direction of metric
         const std::string& getDirection() const { return direction_; }
@@ -142,8 +166,11 @@ namespace MetricsSystem {
         static std::unique_ptr<NetworkMetric> createNetworkMetric(const std::string& name = "Network Bytes/sec");
 
         // Generic typed metrics
-        template<typename T>
-        static std::unique_ptr<TypedMetric<T>> createGenericMetric(const std::string& name);
+        template<Accumulable T, AggregationPolicy<T> Policy = DefaultAggregation<T>>
+        static std::unique_ptr<TypedMetric<T, Policy>> createGenericMetric(const std::string& name,
+                                                                           CounterOverflow overflow = CounterOverflow::Saturate) {
+            return std::make_unique<TypedMetric<T, Policy>>(name, 1, overflow);
+        }
     };
 
 } // namespace MetricsSystem 
\ No newline at end of file
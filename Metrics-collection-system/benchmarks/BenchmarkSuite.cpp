@@ -0,0 +1,498 @@
+#include "../MetricSystemManager.h"
+#include "../MetricClock.h"
+#include "../MetricCompactWriter.h"
+#include "../MetricJsonWriter.h"
+#include "../MetricCsvWriter.h"
+#include "../MetricSqliteWriter.h"
+#include "../MetricUtilities.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace MetricsSystem;
+
+// Micro-benchmarks for hot paths
+//   BenchmarkSuite [name filter]
+namespace {
+
+    // Runs `iterations` operations and returns a value derived from them,
+    // so the work cannot be optimized away
+    using BenchmarkFunction = std::function<uint64_t(uint64_t iterations)>;
+
+    struct Benchmark {
+        std::string group;
+        std::string name;
+        BenchmarkFunction function;
+    };
+
+    std::vector<Benchmark>& benchmarks() {
+        static std::vector<Benchmark> registry;
+        return registry;
+    }
+
+    void addBenchmark(const std::string& group, const std::string& name, BenchmarkFunction function) {
+        benchmarks().push_back({ group, name, std::move(function) });
+    }
+
+    volatile uint64_t g_sink = 0;
+
+    // Grow the iteration count until a run takes at least min_time, then
+    // report the best of three runs
+    double measureNsPerOp(const BenchmarkFunction& function,
+                          std::chrono::milliseconds min_time = std::chrono::milliseconds(200)) {
+        uint64_t iterations = 1000;
+        while (true) {
+            auto start = std::chrono::steady_clock::now();
+            g_sink = g_sink + function(iterations);
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            if (elapsed >= min_time || iterations >= (1ull << 40)) {
+                break;
+            }
+            iterations *= elapsed < min_time / 10 ? 10 : 2;
+        }
+
+        double best = 0.0;
+        for (int run = 0; run < 3; ++run) {
+            auto start = std::chrono::steady_clock::now();
+            g_sink = g_sink + function(iterations);
+            double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            double per_op = ns / static_cast<double>(iterations);
+            best = (run == 0) ? per_op : std::min(best, per_op);
+        }
+        return best;
+    }
+
+    // Clock reads: cost of a timestamp per source
+    void registerClockBenchmarks() {
+        struct Source {
+            const char* name;
+            TimeSource source;
+        };
+        const Source sources[] = {
+            { "precise", TimeSource::Precise },
+            { "coarse", TimeSource::Coarse },
+            { "tsc", TimeSource::Tsc },
+            { "cached", TimeSource::Cached },
+        };
+
+        for (const Source& source : sources) {
+            std::shared_ptr<Clock> clock = Clock::create(source.source);
+
+            addBenchmark("clock", std::string(source.name) + ".now", [clock](uint64_t iterations) {
+                uint64_t sum = 0;
+                for (uint64_t i = 0; i < iterations; ++i) {
+                    sum += static_cast<uint64_t>(clock->now().time_since_epoch().count());
+                }
+                return sum;
+            });
+
+            addBenchmark("clock", std::string(source.name) + ".steadyNow", [clock](uint64_t iterations) {
+                uint64_t sum = 0;
+                for (uint64_t i = 0; i < iterations; ++i) {
+                    sum += static_cast<uint64_t>(clock->steadyNow().time_since_epoch().count());
+                }
+                return sum;
+            });
+        }
+
+        addBenchmark("clock", "TimestampUtils::getCurrentTime", [](uint64_t iterations) {
+            uint64_t sum = 0;
+            for (uint64_t i = 0; i < iterations; ++i) {
+                sum += static_cast<uint64_t>(TimestampUtils::getCurrentTime().time_since_epoch().count());
+            }
+            return sum;
+        });
+
+        // Accuracy of the cheap sources against the precise one
+        auto precise = Clock::create(TimeSource::Precise);
+        for (const Source& source : sources) {
+            auto clock = Clock::create(source.source);
+            if (auto cached = std::dynamic_pointer_cast<CachedClock>(clock)) {
+                cached->refresh();
+            }
+            auto skew = std::chrono::duration_cast<std::chrono::microseconds>(clock->now() - precise->now()).count();
+            std::printf("  %-8s skew vs precise: %lld us\n", source.name, static_cast<long long>(skew));
+        }
+    }
+
+    // The accumulator TypedMetric used before compensated sharding:
+    // one mutex and a naive running sum
+    template<typename T>
+    class LegacyAccumulator {
+    private:
+        std::mutex mutex_;
+        T sum_{};
+        size_t count_ = 0;
+
+    public:
+        void record(T value) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            sum_ += value;
+            count_++;
+        }
+
+        T average() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return count_ ? sum_ / static_cast<T>(count_) : T{};
+        }
+    };
+
+    // Run `threads` threads each doing iterations / threads operations
+    template<typename F>
+    void runThreads(size_t threads, uint64_t iterations, F body) {
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < threads; ++t) {
+            workers.emplace_back([&body, iterations, threads]() {
+                for (uint64_t i = 0; i < iterations / threads; ++i) {
+                    body(i);
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    // Floating-point accumulation: throughput against the legacy path,
+    // then precision on a skewed interval
+    void registerAccumulationBenchmarks() {
+        addBenchmark("accumulate", "legacy.record", [](uint64_t iterations) {
+            LegacyAccumulator<double> legacy;
+            for (uint64_t i = 0; i < iterations; ++i) {
+                legacy.record(static_cast<double>(i & 1023) * 0.001);
+            }
+            return static_cast<uint64_t>(legacy.average());
+        });
+
+        addBenchmark("accumulate", "compensated.record", [](uint64_t iterations) {
+            TypedMetric<double> metric("bench");
+            for (uint64_t i = 0; i < iterations; ++i) {
+                metric.recordValue(static_cast<double>(i & 1023) * 0.001);
+            }
+            return static_cast<uint64_t>(metric.getAccumulatedValue()->toString().size());
+        });
+
+        std::vector<double> batch(1024);
+        for (size_t i = 0; i < batch.size(); ++i) {
+            batch[i] = static_cast<double>(i) * 0.001;
+        }
+        addBenchmark("accumulate", "compensated.recordValues(1024)/value", [batch](uint64_t iterations) {
+            TypedMetric<double> metric("bench");
+            for (uint64_t i = 0; i < iterations; i += batch.size()) {
+                metric.recordValues(batch.data(), batch.size());
+            }
+            return static_cast<uint64_t>(metric.getAccumulatedValue()->toString().size());
+        });
+
+        const size_t threads = std::max(2u, std::min(8u, std::thread::hardware_concurrency()));
+        addBenchmark("accumulate", "legacy.record x" + std::to_string(threads) + " threads", [threads](uint64_t iterations) {
+            LegacyAccumulator<double> legacy;
+            runThreads(threads, iterations, [&legacy](uint64_t i) { legacy.record(static_cast<double>(i & 1023)); });
+            return static_cast<uint64_t>(legacy.average());
+        });
+
+        addBenchmark("accumulate", "compensated.record x" + std::to_string(threads) + " threads, 1 shard",
+                     [threads](uint64_t iterations) {
+            TypedMetric<double> metric("bench");
+            runThreads(threads, iterations, [&metric](uint64_t i) { metric.recordValue(static_cast<double>(i & 1023)); });
+            return static_cast<uint64_t>(metric.getAccumulatedValue()->toString().size());
+        });
+
+        addBenchmark("accumulate", "compensated.record x" + std::to_string(threads) + " threads, " +
+                     std::to_string(threads) + " shards", [threads](uint64_t iterations) {
+            TypedMetric<double> metric("bench", threads);
+            runThreads(threads, iterations, [&metric](uint64_t i) { metric.recordValue(static_cast<double>(i & 1023)); });
+            return static_cast<uint64_t>(metric.getAccumulatedValue()->toString().size());
+        });
+
+        // One large sample among ten million small ones: exact mean is
+        // (1e9 + 1e7 * 0.1) / (1e7 + 1)
+        const double large = 1e9;
+        const double small = 0.1;
+        const size_t small_count = 10000000;
+        const double exact = (large + small * static_cast<double>(small_count)) / static_cast<double>(small_count + 1);
+
+        LegacyAccumulator<float> legacy;
+        TypedMetric<float> compensated("precision");
+        legacy.record(static_cast<float>(large));
+        compensated.recordValue(static_cast<float>(large));
+        for (size_t i = 0; i < small_count; ++i) {
+            legacy.record(static_cast<float>(small));
+            compensated.recordValue(static_cast<float>(small));
+        }
+        auto compensated_result = compensated.getAccumulatedValue();
+        auto compensated_value = dynamic_cast<TypedMetricValue<float>*>(compensated_result.get());
+        double compensated_mean = compensated_value ? compensated_value->getValue() : 0.0;
+
+        std::printf("  float mean of 1e9 + 1e7 x 0.1: exact %.6f, legacy %.6f, compensated %.6f\n",
+                    exact, static_cast<double>(legacy.average()), compensated_mean);
+    }
+
+    // Integer counters: 64-bit accumulation with an overflow policy against
+    // the legacy accumulator of the recorded type, then the limit behavior
+    void registerCounterBenchmarks() {
+        addBenchmark("counter", "legacy<int>.record", [](uint64_t iterations) {
+            LegacyAccumulator<int> legacy;
+            for (uint64_t i = 0; i < iterations; ++i) {
+                legacy.record(static_cast<int>(i & 1023));
+            }
+            return static_cast<uint64_t>(legacy.average());
+        });
+
+        const struct {
+            const char* name;
+            CounterOverflow overflow;
+        } policies[] = {
+            { "saturate", CounterOverflow::Saturate },
+            { "wrap", CounterOverflow::Wrap },
+        };
+
+        for (const auto& policy : policies) {
+            const CounterOverflow overflow = policy.overflow;
+            addBenchmark("counter", std::string("TypedMetric<int>.record, ") + policy.name, [overflow](uint64_t iterations) {
+                TypedMetric<int> metric("bench", 1, overflow);
+                for (uint64_t i = 0; i < iterations; ++i) {
+                    metric.recordValue(static_cast<int>(i & 1023));
+                }
+                return static_cast<uint64_t>(metric.getAccumulatedValue()->toString().size());
+            });
+
+            addBenchmark("counter", std::string("TypedMetric<int64_t>.record, ") + policy.name, [overflow](uint64_t iterations) {
+                TypedMetric<int64_t> metric("bench", 1, overflow);
+                for (uint64_t i = 0; i < iterations; ++i) {
+                    metric.recordValue(static_cast<int64_t>(i & 1023));
+                }
+                return static_cast<uint64_t>(metric.getAccumulatedValue()->toString().size());
+            });
+        }
+
+        TypedMetric<int> busy("busy");
+        for (int i = 0; i < 3; ++i) {
+            busy.recordValue(std::numeric_limits<int>::max());
+        }
+
+        TypedMetric<int64_t> saturating("saturating", 1, CounterOverflow::Saturate);
+        TypedMetric<uint64_t> wrapping("wrapping", 1, CounterOverflow::Wrap);
+        for (int i = 0; i < 2; ++i) {
+            saturating.recordValue(std::numeric_limits<int64_t>::max());
+            wrapping.recordValue(std::numeric_limits<uint64_t>::max());
+        }
+
+        std::printf("  int interval of 3 x INT_MAX: %s\n", busy.getAccumulatedValue()->toString().c_str());
+        std::printf("  int64 2 x max, saturate: %s; uint64 2 x max, wrap: %s\n",
+                    saturating.getAccumulatedValue()->toString().c_str(),
+                    wrapping.getAccumulatedValue()->toString().c_str());
+    }
+
+    // One record per aggregation policy: lock-free policies (integer Sum,
+    // Max, Last) against the locked ones (Mean, MinMaxMean)
+    template<typename Policy, typename T>
+    void addPolicyBenchmark(const std::string& name) {
+        addBenchmark("policy", name, [](uint64_t iterations) {
+            TypedMetric<T, Policy> metric("bench");
+            for (uint64_t i = 0; i < iterations; ++i) {
+                metric.recordValue(static_cast<T>(i & 1023));
+            }
+            return static_cast<uint64_t>(metric.getAccumulatedValue()->toString().size());
+        });
+    }
+
+    void registerPolicyBenchmarks() {
+        addPolicyBenchmark<Sum, int64_t>("Sum<int64_t>.record");
+        addPolicyBenchmark<Sum, double>("Sum<double>.record");
+        addPolicyBenchmark<Mean, double>("Mean<double>.record");
+        addPolicyBenchmark<Max, double>("Max<double>.record");
+        addPolicyBenchmark<Last, double>("Last<double>.record");
+        addPolicyBenchmark<MinMaxMean, double>("MinMaxMean<double>.record");
+    }
+
+    // Record path from application code: by name (lookup + virtual call)
+    // against a resolved MetricHandle (inlined for plain TypedMetric<T>)
+    void registerRecordPathBenchmarks() {
+        static std::shared_ptr<MetricCollector> collector;
+        static std::once_flag started;
+        auto running = []() -> MetricCollector& {
+            std::call_once(started, []() {
+                auto path = std::filesystem::temp_directory_path() / "benchmark_metrics.txt";
+                collector = MetricSystemFactory::createSystem(path.string());
+                collector->registerMetric(std::make_unique<CPUMetric>("bench.cpu", 4));
+                collector->start();
+            });
+            return *collector;
+        };
+
+        addBenchmark("record", "recordMetric<double> by name", [running](uint64_t iterations) {
+            MetricCollector& target = running();
+            for (uint64_t i = 0; i < iterations; ++i) {
+                target.recordMetric<double>("bench.plain", static_cast<double>(i & 3));
+            }
+            return iterations;
+        });
+
+        addBenchmark("record", "MetricHandle<double>.record", [running](uint64_t iterations) {
+            auto handle = running().getHandle<double>("bench.plain");
+            for (uint64_t i = 0; i < iterations; ++i) {
+                handle.record(static_cast<double>(i & 3));
+            }
+            return iterations;
+        });
+
+        addBenchmark("record", "MetricHandle<double>.record, CPUMetric", [running](uint64_t iterations) {
+            auto handle = running().getHandle<double>("bench.cpu");
+            for (uint64_t i = 0; i < iterations; ++i) {
+                handle.record(static_cast<double>(i & 3));
+            }
+            return iterations;
+        });
+    }
+
+    // Collection tick over a large, mostly idle registry: 5000 metrics with
+    // 1% recorded per tick. Reported per registered metric and tick.
+    void addSnapshotBenchmark(const std::string& name, bool skip_idle) {
+        constexpr size_t kMetrics = 5000;
+        constexpr size_t kActive = kMetrics / 100;
+
+        struct Registry {
+            std::unique_ptr<MetricCollector> collector;
+            std::vector<MetricHandle<double>> handles;
+            uint64_t tick = 0;
+        };
+        auto registry = std::make_shared<Registry>();
+
+        addBenchmark("snapshot", name, [registry, skip_idle](uint64_t iterations) {
+            if (!registry->collector) {
+                auto path = std::filesystem::temp_directory_path() / "benchmark_snapshot.txt";
+                registry->collector = MetricSystemFactory::createSystem(path.string());
+
+                EmissionPolicy policy;
+                policy.skip_idle = skip_idle;
+                registry->collector->setEmissionPolicy(policy);
+
+                for (size_t i = 0; i < kMetrics; ++i) {
+                    std::string metric = "bench.series." + std::to_string(i);
+                    registry->collector->registerMetric<double>(metric);
+                    registry->handles.push_back(registry->collector->getHandle<double>(metric));
+                }
+                registry->collector->start();
+            }
+
+            const uint64_t ticks = (iterations + kMetrics - 1) / kMetrics;
+            for (uint64_t t = 0; t < ticks; ++t, ++registry->tick) {
+                for (size_t i = 0; i < kActive; ++i) {
+                    registry->handles[(registry->tick * 7919 + i * 101) % kMetrics].record(static_cast<double>(i));
+                }
+                registry->collector->flush();
+            }
+            return ticks * kMetrics;
+        });
+    }
+
+    void registerSnapshotBenchmarks() {
+        addSnapshotBenchmark("flush, 1% active, write all", false);
+        addSnapshotBenchmark("flush, 1% active, skip idle", true);
+    }
+
+    // Formatting one tick of 1000 double metrics, per entry
+    template<typename Writer>
+    void addWriterBenchmark(const std::string& name) {
+        constexpr size_t kEntries = 1000;
+
+        auto entries = std::make_shared<std::vector<MetricEntry>>();
+        auto now = std::chrono::system_clock::now();
+        for (size_t i = 0; i < kEntries; ++i) {
+            entries->emplace_back(now, "service.requests.latency." + std::to_string(i),
+                                  std::make_unique<TypedMetricValue<double>>(0.25 * static_cast<double>(i) + 0.97));
+        }
+
+        addBenchmark("writer", name, [entries](uint64_t iterations) {
+            static auto path = std::filesystem::temp_directory_path() / "benchmark_writer.out";
+            static Writer writer(path.string());
+            // One real write first, so stateful formats (the compact
+            // dictionary) are timed in their steady state
+            static bool primed = (writer.writeMetrics(*entries), true);
+            (void)primed;
+
+            const uint64_t ticks = (iterations + kEntries - 1) / kEntries;
+            size_t bytes = 0;
+            for (uint64_t t = 0; t < ticks; ++t) {
+                std::vector<std::string> chunks(1);
+                writer.formatEntries(entries->data(), entries->data() + entries->size(), chunks.front());
+                writer.finishTick(entries->front().timestamp, *entries, chunks);
+                bytes += chunks.back().size();
+            }
+            g_sink = g_sink + bytes;
+            return ticks * kEntries;
+        });
+    }
+
+#ifdef METRICS_WITH_SQLITE
+    // Formatting and inserting one tick of 1000 double metrics into SQLite,
+    // per entry (default commit cadence)
+    void addSqliteBenchmark() {
+        constexpr size_t kEntries = 1000;
+
+        auto entries = std::make_shared<std::vector<MetricEntry>>();
+        auto now = std::chrono::system_clock::now();
+        for (size_t i = 0; i < kEntries; ++i) {
+            entries->emplace_back(now, "service.requests.latency." + std::to_string(i),
+                                  std::make_unique<TypedMetricValue<double>>(0.25 * static_cast<double>(i) + 0.97));
+        }
+
+        addBenchmark("writer", "sqlite.writeTick", [entries](uint64_t iterations) {
+            static auto path = std::filesystem::temp_directory_path() / "benchmark_writer.db";
+            static SqliteWriter writer(path.string());
+
+            const uint64_t ticks = (iterations + kEntries - 1) / kEntries;
+            for (uint64_t t = 0; t < ticks; ++t) {
+                writer.writeMetrics(*entries);
+            }
+            return ticks * kEntries;
+        });
+    }
+#endif
+
+    void registerWriterBenchmarks() {
+        addWriterBenchmark<MetricWriter>("text.formatTick");
+        addWriterBenchmark<CompactTextWriter>("compact.formatTick");
+        addWriterBenchmark<JsonLinesWriter>("jsonl.formatTick");
+        addWriterBenchmark<CsvWriter>("csv.formatTick");
+#ifdef METRICS_WITH_SQLITE
+        addSqliteBenchmark();
+#endif
+    }
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    const char* filter = argc > 1 ? argv[1] : "";
+
+    std::cout << "=== Metrics System Benchmark Suite ===" << std::endl;
+    registerClockBenchmarks();
+    registerAccumulationBenchmarks();
+    registerCounterBenchmarks();
+    registerPolicyBenchmarks();
+    registerRecordPathBenchmarks();
+    registerSnapshotBenchmarks();
+    registerWriterBenchmarks();
+
+    std::printf("\n%-10s %-40s %12s\n", "group", "benchmark", "ns/op");
+    for (const Benchmark& benchmark : benchmarks()) {
+        std::string full_name = benchmark.group + "/" + benchmark.name;
+        if (full_name.find(filter) == std::string::npos) {
+            continue;
+        }
+        double ns = measureNsPerOp(benchmark.function);
+        std::printf("%-10s %-40s %12.2f\n", benchmark.group.c_str(), benchmark.name.c_str(), ns);
+    }
+
+    return 0;
+}
\ No newline at end of file
@@ -134,6 +134,13 @@ public:
     void start() {
         std::cout << "Starting web server simulation..." << std::endl;
         running_ = true;
+
+        // Queue depth is read by the collector once per tick instead of
+        // being recorded on every change
+        metrics_system_->registerGauge<int>("Request queue depth", [this]() {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            return static_cast<int>(request_queue_.size());
+        });
         
         // Start simulation threads
         std::thread cpu_thread(&WebServerSimulator::cpuLoadSimulation, this);
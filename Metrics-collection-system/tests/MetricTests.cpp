@@ -0,0 +1,547 @@
+#include "MetricTests.h"
+#include "../MetricSystemManager.h"
+#include "../MetricClock.h"
+#include "../MetricColumnar.h"
+#include "../MetricEventTime.h"
+#include "../MetricFileReader.h"
+#include "../MetricMerge.h"
+#include "../MetricOutputBuffer.h"
+#include "../MetricSnappy.h"
+#include "../MetricUtilities.h"
+#include "../SpecificMetrics.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <set>
+#include <source_location>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Unit and round-trip tests of the core components
+//   Metrics-collection-system --test [name filter]
+namespace MetricsSystem {
+
+    namespace {
+
+        struct TestCase {
+            std::string group;
+            std::string name;
+            std::function<void()> function;
+        };
+
+        std::vector<TestCase>& tests() {
+            static std::vector<TestCase> registry;
+            return registry;
+        }
+
+        void addTest(const std::string& group, const std::string& name, std::function<void()> function) {
+            tests().push_back({ group, name, std::move(function) });
+        }
+
+        void expect(bool condition, const std::string& what,
+                    std::source_location where = std::source_location::current()) {
+            if (!condition) {
+                throw std::runtime_error(std::string(where.file_name()) + ":" + std::to_string(where.line()) +
+                                         ": expected " + what);
+            }
+        }
+
+        template<typename Exception, typename Function>
+        void expectThrow(Function function, const std::string& what,
+                         std::source_location where = std::source_location::current()) {
+            try {
+                function();
+            } catch (const Exception&) {
+                return;
+            }
+            expect(false, what + " to throw", where);
+        }
+
+        // Empty scratch directory of one test
+        std::filesystem::path scratchDirectory(const std::string& name) {
+            auto dir = std::filesystem::temp_directory_path() / "metric_tests" / name;
+            std::filesystem::remove_all(dir);
+            std::filesystem::create_directories(dir);
+            return dir;
+        }
+
+        std::string readAll(const std::filesystem::path& path) {
+            std::ifstream in(path, std::ios::binary);
+            std::ostringstream out;
+            out << in.rdbuf();
+            return out.str();
+        }
+
+        void writeAll(const std::filesystem::path& path, const std::string& data) {
+            std::ofstream out(path, std::ios::binary);
+            out << data;
+        }
+
+        struct Sample {
+            uint64_t key;
+            std::string name;
+            std::string value;
+        };
+
+        // Samples of a file in the writer's text format, in file order
+        std::vector<Sample> readSamples(const std::filesystem::path& path) {
+            const std::string data = readAll(path);
+            MetricFileCursor cursor{ std::string_view(data) };
+            std::vector<Sample> samples;
+            while (cursor.next()) {
+                const MetricSample& sample = cursor.current();
+                samples.push_back({ sample.time_key, std::string(sample.name), std::string(sample.value) });
+            }
+            return samples;
+        }
+
+        TimePoint at(const char* timestamp) {
+            return TimestampUtils::parseTimestamp(timestamp);
+        }
+
+        MetricTick makeTick(int value, TickMerge merge = TickMerge::Sum) {
+            MetricTick tick;
+            tick.timestamp = std::chrono::system_clock::now();
+            tick.entries.emplace_back(tick.timestamp, "requests", std::make_unique<TypedMetricValue<int>>(value, merge));
+            tick.chunks.push_back("formatted\n");
+            tick.formatted = true;
+            return tick;
+        }
+
+        std::string valueOf(const MetricTick& tick) {
+            return tick.entries.front().value->toString();
+        }
+
+        // VirtualClock: time moves only on advance(), and sleepers wake at
+        // their deadline with the clock stopped there
+        void registerClockTests() {
+            addTest("clock", "virtual.advance", []() {
+                const TimePoint start = at("2026-01-01 12:00:00.000");
+                VirtualClock clock(start);
+                const SteadyTimePoint steady = clock.steadyNow();
+                expect(clock.now() == start, "the start time");
+
+                clock.advance(std::chrono::milliseconds(1500));
+                expect(clock.now() == start + std::chrono::milliseconds(1500), "wall time to move by the advance");
+                expect(clock.steadyNow() - steady == std::chrono::milliseconds(1500), "steady time to move alike");
+            });
+
+            addTest("clock", "virtual.waiters", []() {
+                const TimePoint start = at("2026-01-01 12:00:00.000");
+                VirtualClock clock(start);
+                std::mutex mutex;
+                std::condition_variable cv;
+                bool done = false;
+                TimePoint woke;
+
+                std::thread sleeper([&]() {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    clock.waitUntil(lock, cv, clock.steadyNow() + std::chrono::seconds(1), [&]() { return done; });
+                    woke = clock.now();
+                    clock.waitUntil(lock, cv, clock.steadyNow() + std::chrono::hours(1), [&]() { return done; });
+                });
+
+                expect(clock.waitForWaiters(1), "the sleeper to wait on the clock");
+                clock.advance(std::chrono::seconds(3));
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    expect(woke == start + std::chrono::seconds(1), "the sleeper to wake at its deadline");
+                    done = true;
+                }
+                cv.notify_all();
+                sleeper.join();
+                expect(clock.now() == start + std::chrono::seconds(3), "the clock to finish the advance");
+            });
+        }
+
+        void registerEventTimeTests() {
+            addTest("eventtime", "windows.watermark", []() {
+                EventTimeOptions options;
+                options.allowed_lateness = std::chrono::seconds(2);
+                options.max_open_intervals = 8;
+                EventTimeWindows windows(options);
+                TypedMetric<int> jobs("jobs");
+
+                const TimePoint now = at("2026-01-01 12:00:10.000");
+                windows.advance(now);
+
+                auto record = [&](TimePoint event_time, int value) {
+                    std::unique_lock<std::mutex> lock;
+                    Metric* interval = windows.acquire(jobs, event_time, lock);
+                    if (interval) {
+                        static_cast<RecordableMetric<int>*>(interval)->recordValue(value);
+                    }
+                    return interval != nullptr;
+                };
+                expect(record(now - std::chrono::milliseconds(1500), 5), "a record within the lateness");
+                expect(record(now - std::chrono::milliseconds(1200), 7), "a second record for the same interval");
+                expect(!record(now - std::chrono::seconds(5), 1), "a record behind the watermark to be dropped");
+                expect(!record(now + std::chrono::seconds(100), 1), "a record past the open intervals to be dropped");
+
+                TimePoint start;
+                expect(!windows.oldestClosed(start), "no interval closed before the watermark passes");
+                windows.advance(now + std::chrono::seconds(2));
+                expect(windows.oldestClosed(start), "the interval closed once the watermark passed it");
+
+                EventTimeInterval interval;
+                expect(windows.popClosed(interval), "the closed interval");
+                expect(interval.start == at("2026-01-01 12:00:08.000"), "the interval stamped with its start");
+                expect(interval.metrics.size() == 1, "one interval copy per metric");
+                expect(interval.metrics.front()->collectAndReset()->toString() == "12", "both records in the interval");
+
+                const EventTimeStats stats = windows.getStats();
+                expect(stats.accepted == 2 && stats.late_dropped == 1 && stats.early_dropped == 1,
+                       "accepted and dropped records to be counted");
+            });
+
+            addTest("eventtime", "windows.specialized", []() {
+                EventTimeWindows windows;
+                HTTPRequestMetric http("http");
+                const TimePoint now = at("2026-01-01 12:00:10.000");
+                windows.advance(now);
+
+                std::unique_lock<std::mutex> lock;
+                expectThrow<std::invalid_argument>([&]() { windows.acquire(http, now, lock); },
+                    "event-time records into a specialized metric");
+            });
+
+            // Live ticks wait for the watermark and take the closed intervals
+            // of their second, so output is in order with one row per metric
+            // and second
+            addTest("eventtime", "collector.order", []() {
+                const auto dir = scratchDirectory("eventtime");
+                const auto path = dir / "events.txt";
+                auto clock = std::make_shared<VirtualClock>(at("2026-01-01 12:00:00.500"));
+
+                auto collector = MetricSystemFactory::createSystem(path.string());
+                collector->setClock(clock);
+                EmissionPolicy emission;
+                emission.skip_idle = true;
+                collector->setEmissionPolicy(emission);
+                EventTimeOptions options;
+                options.allowed_lateness = std::chrono::seconds(2);
+                options.max_open_intervals = 8;
+                collector->configureEventTime(options);
+
+                auto jobs = collector->getHandle<int>("jobs");
+                collector->start();
+                clock->waitForWaiters(1);
+
+                long recorded = 0;
+                for (int second = 0; second < 20; ++second) {
+                    jobs.record(1);
+                    collector->record(jobs, 10, clock->now() - std::chrono::seconds(1));
+                    recorded += 11;
+                    clock->advance(std::chrono::seconds(1));
+                }
+                collector->stop();
+
+                long written = 0;
+                uint64_t previous = 0;
+                std::set<uint64_t> seconds;
+                for (const auto& sample : readSamples(path)) {
+                    expect(sample.key >= previous, "samples in timestamp order");
+                    expect(seconds.insert(sample.key / 1000).second, "one row per second");
+                    previous = sample.key;
+                    written += std::stol(sample.value);
+                }
+                expect(written == recorded, "every value written once");
+
+                const EventTimeStats stats = collector->getEventTimeStats();
+                expect(stats.accepted == 20 && stats.late_intervals == 0, "all records taken, none written late");
+            });
+        }
+
+        // The loser tree picks samples across inputs in time order; equal
+        // timestamps keep input order
+        void registerMergeTests() {
+            addTest("merge", "loser-tree.order", []() {
+                const auto dir = scratchDirectory("merge");
+                writeAll(dir / "a.txt", "2026-01-01 12:00:00.100 \"x\" 1\n"
+                                        "2026-01-01 12:00:02.100 \"x\" 1\n"
+                                        "2026-01-01 12:00:04.100 \"x\" 1\n");
+                writeAll(dir / "b.txt", "2026-01-01 12:00:01.200 \"y\" 2\n"
+                                        "2026-01-01 12:00:03.200 \"y\" 2\n"
+                                        "2026-01-01 12:00:05.200 \"y\" 2\n");
+                writeAll(dir / "c.txt", "2026-01-01 12:00:00.100 \"z\" 3\n"
+                                        "2026-01-01 12:00:03.200 \"z\" 3\n");
+
+                MetricMerger merger;
+                for (const char* input : { "a.txt", "b.txt", "c.txt" }) {
+                    merger.addInput((dir / input).string());
+                }
+                const MergeStats stats = merger.merge((dir / "merged.txt").string());
+                expect(stats.inputs == 3 && stats.input_samples == 8 && stats.output_samples == 8,
+                       "every sample merged");
+
+                std::string names;
+                uint64_t previous = 0;
+                for (const auto& sample : readSamples(dir / "merged.txt")) {
+                    expect(sample.key >= previous, "samples in timestamp order");
+                    previous = sample.key;
+                    names += sample.name;
+                }
+                expect(names == "xzyxyzxy", "equal timestamps in input order");
+            });
+
+            addTest("merge", "loser-tree.aggregate", []() {
+                const auto dir = scratchDirectory("merge_aggregate");
+                writeAll(dir / "a.txt", "2026-01-01 12:00:00.100 \"n\" 1\n2026-01-01 12:00:01.100 \"n\" 5\n");
+                writeAll(dir / "b.txt", "2026-01-01 12:00:00.900 \"n\" 2\n");
+
+                MergeOptions options;
+                options.aggregate = true;
+                MetricMerger merger(options);
+                merger.addInput((dir / "a.txt").string());
+                merger.addInput((dir / "b.txt").string());
+                merger.merge((dir / "merged.txt").string());
+
+                const auto samples = readSamples(dir / "merged.txt");
+                expect(samples.size() == 2, "one sample per bucket");
+                expect(samples[0].key == MetricTimeKey::parse("2026-01-01 12:00:00.000") && samples[0].value == "3",
+                       "the bucket's sum stamped with its start");
+                expect(samples[1].value == "5", "the next bucket alone");
+            });
+        }
+
+        void registerSnappyTests() {
+            addTest("snappy", "round-trip", []() {
+                std::string repetitive;
+                while (repetitive.size() < 200000) {
+                    repetitive += "2026-01-01 12:00:00.000 \"HTTP requests RPS\" " + std::to_string(repetitive.size() % 97) + "\n";
+                }
+                std::string random(100000, '\0');
+                std::mt19937 gen(42);
+                for (char& c : random) {
+                    c = static_cast<char>(gen() & 0xFF);
+                }
+
+                std::string compressed;
+                std::string restored;
+                for (const std::string& input : { std::string(), std::string("a"), std::string(70000, 'x'), repetitive, random }) {
+                    SnappyCodec::compress(input, compressed);
+                    expect(SnappyCodec::uncompress(compressed, restored), "the compressed form to decode");
+                    expect(restored == input, "the input back");
+                }
+
+                SnappyCodec::compress(repetitive, compressed);
+                expect(compressed.size() < repetitive.size() / 4, "repetitive text to compress well");
+            });
+
+            addTest("snappy", "corrupt", []() {
+                std::string compressed;
+                std::string restored;
+                SnappyCodec::compress(std::string(10000, 'y') + "tail", compressed);
+                expect(!SnappyCodec::uncompress(compressed.substr(0, compressed.size() / 2), restored),
+                       "truncated input to be rejected");
+                expect(!SnappyCodec::uncompress(compressed, restored, 100), "output past max_size to be rejected");
+            });
+        }
+
+        void registerColumnarTests() {
+            addTest("columnar", "round-trip", []() {
+                const uint64_t keys[] = {
+                    MetricTimeKey::parse("2026-01-01 12:00:00.500"), MetricTimeKey::parse("2026-01-01 12:00:01.500"),
+                    MetricTimeKey::parse("2026-01-01 12:00:02.501"), MetricTimeKey::parse("2026-01-01 12:00:03.499"),
+                };
+
+                ColumnarSeries cpu;
+                cpu.name = "CPU";
+                const char* values[] = { "0.97", "1.125", "-3", "42" };
+                for (size_t i = 0; i < 4; ++i) {
+                    cpu.add(keys[i], values[i]);
+                }
+                ColumnarSeries state;
+                state.name = "state";
+                state.add(keys[0], "up");
+                state.add(keys[2], "degraded mode");
+
+                std::string data;
+                ColumnarArchive::encode({ cpu, state }, data);
+                expect(ColumnarArchive::isArchive(data), "an archive");
+                expect(ColumnarArchive::decode(data) == std::vector<ColumnarSeries>{ cpu, state }, "every series back");
+
+                const auto only = ColumnarArchive::decode(data, "state");
+                expect(only.size() == 1 && only.front() == state, "one series read alone");
+
+                uint64_t min_key = 0;
+                uint64_t max_key = 0;
+                expect(ColumnarArchive::timeRange(data, min_key, max_key), "a time range");
+                expect(min_key == keys[0] && max_key == keys[3], "the range of all series");
+            });
+
+            addTest("columnar", "corrupt", []() {
+                ColumnarSeries series;
+                series.name = "n";
+                series.add(MetricTimeKey::parse("2026-01-01 12:00:00.000"), "1");
+                std::string data;
+                ColumnarArchive::encode({ series }, data);
+
+                expect(!ColumnarArchive::isArchive("2026-01-01 12:00:00.000 \"n\" 1\n"), "text not to be an archive");
+                expectThrow<std::runtime_error>([&]() { ColumnarArchive::decode(data.substr(0, data.size() - 4)); },
+                                                "a truncated archive");
+            });
+        }
+
+        void registerOutputBufferTests() {
+            addTest("output-buffer", "drop", []() {
+                MetricOutputBuffer oldest(2, OverflowPolicy::DropOldest);
+                MetricOutputBuffer newest(2, OverflowPolicy::DropNewest);
+                for (int value : { 10, 20, 30 }) {
+                    oldest.push(makeTick(value));
+                    newest.push(makeTick(value));
+                }
+
+                auto kept = oldest.takeAll();
+                expect(kept.size() == 2 && valueOf(kept[0]) == "20" && valueOf(kept[1]) == "30", "the newest ticks kept");
+                expect(oldest.getStats().dropped_ticks == 1, "the dropped tick counted");
+                kept = newest.takeAll();
+                expect(kept.size() == 2 && valueOf(kept[0]) == "10" && valueOf(kept[1]) == "20", "the oldest ticks kept");
+                expect(newest.getStats().dropped_ticks == 1, "the dropped tick counted");
+            });
+
+            addTest("output-buffer", "coalesce", []() {
+                MetricOutputBuffer sums(2, OverflowPolicy::Coalesce);
+                MetricOutputBuffer lasts(2, OverflowPolicy::Coalesce);
+                for (int value : { 10, 20, 30 }) {
+                    sums.push(makeTick(value));
+                    lasts.push(makeTick(value, TickMerge::Last));
+                }
+
+                auto kept = sums.takeAll();
+                expect(kept.size() == 2 && valueOf(kept[0]) == "30" && valueOf(kept[1]) == "30", "totals to add up");
+                expect(!kept[0].formatted, "a coalesced tick to be formatted again");
+                expect(sums.getStats().coalesced_ticks == 1, "the coalesced tick counted");
+                kept = lasts.takeAll();
+                expect(valueOf(kept[0]) == "20", "last values to keep the newer one");
+            });
+
+            addTest("output-buffer", "block", []() {
+                MetricOutputBuffer buffer(2, OverflowPolicy::Block);
+                buffer.push(makeTick(1));
+                expect(!buffer.deferIfFull(), "room for a tick");
+                buffer.push(makeTick(2));
+                expect(buffer.deferIfFull(), "a full buffer to defer");
+                expect(buffer.getStats().blocked_ticks == 1, "the deferred tick counted");
+
+                // A failing sink must not stall collection
+                buffer.setDegraded(true);
+                expect(!buffer.deferIfFull(), "a degraded buffer not to defer");
+                buffer.push(makeTick(3));
+                expect(buffer.getStats().queued_ticks == 2 && buffer.getStats().coalesced_ticks == 1,
+                       "a degraded buffer to coalesce");
+            });
+        }
+
+        void registerCheckpointTests() {
+            addTest("checkpoint", "records", []() {
+                const auto path = scratchDirectory("checkpoint_records") / "state.ckpt";
+                expect(MetricCheckpoint::load(path.string()).empty(), "no records without a file");
+
+                const std::vector<MetricCheckpoint::Record> records = {
+                    { "CPU", std::string("\x01\x00\x02", 3) }, { "HTTP requests RPS", "" },
+                };
+                MetricCheckpoint::save(path.string(), records);
+                const auto loaded = MetricCheckpoint::load(path.string());
+                expect(loaded.size() == 2, "every record back");
+                for (size_t i = 0; i < loaded.size(); ++i) {
+                    expect(loaded[i].name == records[i].name && loaded[i].state == records[i].state, "names and states back");
+                }
+
+                writeAll(path, readAll(path).substr(0, 10));
+                expectThrow<std::exception>([&]() { MetricCheckpoint::load(path.string()); }, "a truncated checkpoint");
+            });
+
+            addTest("checkpoint", "metric-state", []() {
+                TypedMetric<long> requests("requests");
+                requests.recordValue(3L);
+                requests.recordValue(4L);
+
+                std::string full;
+                std::string cumulative;
+                CheckpointWriter full_writer(full);
+                CheckpointWriter cumulative_writer(cumulative, false);
+                requests.saveState(full_writer);
+                requests.saveState(cumulative_writer);
+
+                TypedMetric<long> restored("requests");
+                CheckpointReader reader(full);
+                restored.loadState(reader);
+                expect(restored.collectAndReset()->toString() == "7", "the interval state back");
+
+                TypedMetric<long> without_interval("requests");
+                CheckpointReader cumulative_reader(cumulative);
+                without_interval.loadState(cumulative_reader);
+                expect(without_interval.collectAndReset()->toString() == "0", "no interval state when left out");
+
+                TypedMetric<double> other_type("requests");
+                CheckpointReader other_reader(full);
+                expectThrow<std::invalid_argument>([&]() { other_type.loadState(other_reader); },
+                                                   "state of another value type");
+            });
+
+            // The lifetime total of an HTTP metric survives a restart
+            addTest("checkpoint", "restart", []() {
+                const auto dir = scratchDirectory("checkpoint_restart");
+                int64_t totals[2] = {};
+                for (int run = 0; run < 2; ++run) {
+                    auto manager = MetricSystemManager::create((dir / "out.txt").string());
+                    auto http = MetricFactory::createHTTPMetric();
+                    HTTPRequestMetric* metric = http.get();
+                    manager->registerMetric(std::move(http));
+                    manager->enableCheckpoint((dir / "state.ckpt").string(), 1);
+                    manager->start();
+                    manager->recordHTTPRequests(100);
+                    manager->stop();
+                    totals[run] = metric->getTotalRequests();
+                }
+                expect(totals[0] == 100 && totals[1] == 200, "the total restored and added to");
+            });
+        }
+
+    } // namespace
+
+    int runMetricTests(const std::string& filter) {
+        tests().clear();
+        registerClockTests();
+        registerEventTimeTests();
+        registerMergeTests();
+        registerSnappyTests();
+        registerColumnarTests();
+        registerOutputBufferTests();
+        registerCheckpointTests();
+
+        std::cout << "=== Metrics System Tests ===" << std::endl;
+        int run = 0;
+        int failed = 0;
+        for (const TestCase& test : tests()) {
+            const std::string full_name = test.group + "/" + test.name;
+            if (full_name.find(filter) == std::string::npos) {
+                continue;
+            }
+
+            ++run;
+            try {
+                test.function();
+                std::printf("%-40s ok\n", full_name.c_str());
+            } catch (const std::exception& e) {
+                ++failed;
+                std::printf("%-40s FAILED\n    %s\n", full_name.c_str(), e.what());
+            }
+        }
+
+        std::printf("%d of %d tests passed\n", run - failed, run);
+        return failed;
+    }
+
+} // namespace MetricsSystem
\ No newline at end of file
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <string>
+
+namespace MetricsSystem {
+
+    // Runs the unit and round-trip tests whose group/name contains `filter`
+    // (all for an empty filter); returns the number that failed
+    int runMetricTests(const std::string& filter);
+
+} // namespace MetricsSystem
\ No newline at end of file
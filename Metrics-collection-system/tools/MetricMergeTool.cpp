@@ -0,0 +1,107 @@
+#include "../MetricMerge.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+using namespace MetricsSystem;
+
+static bool parseKind(const std::string& text, MergeKind& kind) {
+    if (text == "sum") {
+        kind = MergeKind::Sum;
+    } else if (text == "mean") {
+        kind = MergeKind::Mean;
+    } else if (text == "max") {
+        kind = MergeKind::Max;
+    } else if (text == "last") {
+        kind = MergeKind::Last;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Merge per-host or per-process metric files into one time-ordered file
+//   MetricMergeTool [--aggregate] [--kind "CPU Usage=mean"] [--bucket 1] [--binary] [--reorder 10]
+//                   -o merged.txt host1.txt host2.txt ...
+int main(int argc, char* argv[]) {
+    MergeOptions options;
+    std::string output_path;
+    std::vector<std::string> inputs;
+    bool usage_error = false;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--aggregate") == 0) {
+            options.aggregate = true;
+        } else if (std::strcmp(argv[i], "--kind") == 0 && i + 1 < argc) {
+            // name=kind, split at the last '=' since names may contain one
+            std::string spec = argv[++i];
+            size_t equals = spec.rfind('=');
+            MergeKind kind;
+            if (equals == std::string::npos || equals == 0 || !parseKind(spec.substr(equals + 1), kind)) {
+                std::cerr << "Invalid --kind: " << spec << std::endl;
+                usage_error = true;
+            } else {
+                options.kinds[spec.substr(0, equals)] = kind;
+            }
+        } else if (std::strcmp(argv[i], "--default-kind") == 0 && i + 1 < argc) {
+            if (!parseKind(argv[++i], options.default_kind)) {
+                std::cerr << "Invalid --default-kind: " << argv[i] << std::endl;
+                usage_error = true;
+            }
+        } else if (std::strcmp(argv[i], "--bucket") == 0 && i + 1 < argc) {
+            options.bucket = std::chrono::milliseconds(static_cast<long long>(std::atof(argv[++i]) * 1000));
+        } else if (std::strcmp(argv[i], "--binary") == 0) {
+            options.format = MergeOutputFormat::Binary;
+        } else if (std::strcmp(argv[i], "--reorder") == 0 && i + 1 < argc) {
+            options.reorder_window = std::chrono::milliseconds(static_cast<long long>(std::atof(argv[++i]) * 1000));
+        } else if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output_path = argv[++i];
+        } else {
+            inputs.push_back(argv[i]);
+        }
+    }
+
+    if (usage_error || output_path.empty() || inputs.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [--aggregate] [--kind <name>=<kind>]... [--default-kind <kind>]" << std::endl;
+        std::cerr << "       [--bucket <seconds>] [--binary] [--reorder <seconds>] -o <output> <input>..." << std::endl;
+        std::cerr << "  --aggregate     combine same-name samples per bucket" << std::endl;
+        std::cerr << "  --kind          how to combine one metric: sum, mean, max or last" << std::endl;
+        std::cerr << "  --default-kind  how to combine metrics without --kind (default sum)" << std::endl;
+        std::cerr << "  --bucket        bucket width (default 1, one tick; 0 = exact timestamp only)" << std::endl;
+        std::cerr << "  --binary        write compact binary records instead of text" << std::endl;
+        std::cerr << "  --reorder       put samples up to this late back in time order (default 10;" << std::endl;
+        std::cerr << "                  late event-time intervals follow newer ticks)" << std::endl;
+        return 2;
+    }
+
+    try {
+        MetricMerger merger(options);
+        for (const auto& input : inputs) {
+            merger.addInput(input);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        MergeStats stats = merger.merge(output_path);
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "Merged " << stats.inputs << " files: " << stats.input_samples << " samples in, "
+                  << stats.output_samples << " out";
+        if (stats.malformed_lines > 0) {
+            std::cout << ", " << stats.malformed_lines << " malformed lines skipped";
+        }
+        if (stats.late_samples > 0) {
+            std::cout << ", " << stats.late_samples << " samples beyond the reorder window";
+        }
+        if (stats.mismatched_values > 0) {
+            std::cout << ", " << stats.mismatched_values << " values of the wrong type skipped";
+        }
+        std::cout << " (" << elapsed << " s)" << std::endl;
+
+    } catch (const std::exception& e) {
+        std::cerr << "Merge failed: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,242 @@
+#include "../MetricSegment.h"
+#include "../MetricColumnar.h"
+#include "../MetricSegmentCompactor.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+
+using namespace MetricsSystem;
+
+namespace {
+
+    struct Query {
+        std::string name;
+        uint64_t from_key = 0;
+        uint64_t to_key = std::numeric_limits<uint64_t>::max();
+        double above = -std::numeric_limits<double>::infinity();
+        double below = std::numeric_limits<double>::infinity();
+        bool value_filter = false;
+        bool stats_only = false;
+    };
+
+    bool parseDouble(std::string_view text, double& value) {
+        auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+        return result.ec == std::errc() && result.ptr == text.data() + text.size() && !text.empty();
+    }
+
+    // Apply the value filter and count the sample into `stats`
+    bool matchSample(const Query& query, std::string_view text, SegmentMetricStats& stats) {
+        double value = 0.0;
+        const bool numeric = parseDouble(text, value);
+        if (query.value_filter && (!numeric || value < query.above || value > query.below)) {
+            return false;
+        }
+
+        ++stats.count;
+        if (numeric) {
+            stats.min = stats.has_range ? std::min(stats.min, value) : value;
+            stats.max = stats.has_range ? std::max(stats.max, value) : value;
+            stats.has_range = true;
+        }
+        return true;
+    }
+
+    void printStats(const std::string& path, const SegmentMetricStats& stats, const char* source) {
+        std::cout << path << ": " << stats.count << " samples";
+        if (stats.has_range) {
+            std::cout << ", min " << stats.min << ", max " << stats.max;
+        }
+        std::cout << " (" << source << ")\n";
+    }
+
+} // namespace
+
+// Print the samples of one metric from metric files. Finished segments
+// (see SegmentOptions) are skipped by their footer when it shows that the
+// metric, time range or value range cannot match, so only the segments
+// that may hold matches are read.
+//   MetricQueryTool [--from <ts>] [--to <ts>] [--above X] [--below Y] [--stats] <name> <file|directory>...
+int main(int argc, char* argv[]) {
+    Query query;
+    std::vector<std::string> inputs;
+    bool usage_error = false;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--from") == 0 && i + 1 < argc) {
+            query.from_key = MetricTimeKey::parse(argv[++i]);
+            usage_error |= query.from_key == 0;
+        } else if (std::strcmp(argv[i], "--to") == 0 && i + 1 < argc) {
+            query.to_key = MetricTimeKey::parse(argv[++i]);
+            usage_error |= query.to_key == 0;
+        } else if (std::strcmp(argv[i], "--above") == 0 && i + 1 < argc) {
+            usage_error |= !parseDouble(argv[++i], query.above);
+            query.value_filter = true;
+        } else if (std::strcmp(argv[i], "--below") == 0 && i + 1 < argc) {
+            usage_error |= !parseDouble(argv[++i], query.below);
+            query.value_filter = true;
+        } else if (std::strcmp(argv[i], "--stats") == 0) {
+            query.stats_only = true;
+        } else if (query.name.empty()) {
+            query.name = argv[i];
+        } else {
+            inputs.push_back(argv[i]);
+        }
+    }
+
+    if (usage_error || query.name.empty() || inputs.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [options] <metric name> <file or directory>..." << std::endl;
+        std::cerr << "  --from <ts>, --to <ts>  time range, e.g. \"2025-06-01 15:00:00.000\"" << std::endl;
+        std::cerr << "  --above X, --below Y    only values in [X, Y]" << std::endl;
+        std::cerr << "  --stats                 print count/min/max per file instead of samples" << std::endl;
+        return 2;
+    }
+
+    // Directories stand for the files in them, in name order (segments
+    // are named by start time)
+    std::vector<std::string> files;
+    try {
+        for (const auto& input : inputs) {
+            if (!std::filesystem::is_directory(input)) {
+                files.push_back(input);
+                continue;
+            }
+
+            std::vector<std::string> found;
+            for (const auto& entry : std::filesystem::directory_iterator(input)) {
+                // Archives being written by the compactor are left out
+                if (entry.is_regular_file() && entry.path().extension() != ".tmp") {
+                    found.push_back(entry.path().string());
+                }
+            }
+            std::sort(found.begin(), found.end());
+            files.insert(files.end(), found.begin(), found.end());
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Query failed: " << e.what() << std::endl;
+        return 1;
+    }
+
+    uint64_t total_bytes = 0;
+    uint64_t read_bytes = 0;
+    size_t read_files = 0;
+    size_t skipped_files = 0;
+    uint64_t matches = 0;
+
+    for (const auto& path : files) {
+        try {
+            MappedFile file(path);
+            total_bytes += file.size();
+
+            // Archives (see SegmentCompactor) hold each metric apart, so
+            // only the queried one is decoded
+            const std::string_view data(file.data(), file.size());
+            if (ColumnarArchive::isArchive(data)) {
+                ++read_files;
+                read_bytes += file.size();
+
+                SegmentMetricStats stats;
+                std::string value;
+                for (const auto& series : ColumnarArchive::decode(data, query.name)) {
+                    for (size_t i = 0; i < series.size(); ++i) {
+                        if (series.keys[i] < query.from_key || series.keys[i] > query.to_key) {
+                            continue;
+                        }
+                        value.clear();
+                        series.appendValue(i, value);
+                        if (!matchSample(query, value, stats)) {
+                            continue;
+                        }
+                        ++matches;
+                        if (!query.stats_only) {
+                            std::string timestamp;
+                            MetricTimeKey::format(series.keys[i], timestamp);
+                            std::cout << timestamp << " \"" << series.name << "\" " << value << '\n';
+                        }
+                    }
+                }
+                if (query.stats_only && stats.count > 0) {
+                    printStats(path, stats, "archive");
+                }
+                continue;
+            }
+
+            // The summary and bloom filter first; the #stat lines only when
+            // they can still rule the segment out
+            SegmentFooter footer;
+            const bool has_footer = SegmentFooter::read(file, footer, false);
+            if (has_footer) {
+                // Compacted, with only the removal of the segment left
+                std::error_code ec;
+                if (std::filesystem::exists(SegmentCompactor::archivePath(path), ec)) {
+                    ++skipped_files;
+                    continue;
+                }
+
+                if (!footer.mayContain(query.name) || !footer.overlaps(query.from_key, query.to_key)) {
+                    ++skipped_files;
+                    continue;
+                }
+
+                if (query.value_filter || query.stats_only) {
+                    SegmentFooter::read(file, footer, true);
+                    auto it = footer.metrics().find(query.name);
+                    if (it == footer.metrics().end() ||
+                        (query.value_filter && (!it->second.has_range || it->second.max < query.above ||
+                                                it->second.min > query.below))) {
+                        ++skipped_files;
+                        continue;
+                    }
+
+                    // Whole-segment stats answer --stats unless the time range cuts it
+                    if (query.stats_only && query.from_key <= footer.getFirstKey() &&
+                        footer.getLastKey() <= query.to_key && !query.value_filter) {
+                        printStats(path, it->second, "footer");
+                        ++skipped_files;
+                        continue;
+                    }
+                }
+            }
+
+            ++read_files;
+            read_bytes += has_footer ? footer.getDataSize() : file.size();
+
+            SegmentMetricStats stats;
+            MetricFileCursor cursor(file, has_footer ? footer.getDataSize() : file.size());
+            while (cursor.next()) {
+                const MetricSample& sample = cursor.current();
+                cursor.releaseConsumed();
+                if (sample.name != query.name || sample.time_key < query.from_key || sample.time_key > query.to_key) {
+                    continue;
+                }
+
+                if (!matchSample(query, sample.value, stats)) {
+                    continue;
+                }
+
+                ++matches;
+                if (!query.stats_only) {
+                    std::cout << sample.timestamp << " \"" << sample.name << "\" " << sample.value << '\n';
+                }
+            }
+
+            if (query.stats_only && stats.count > 0) {
+                printStats(path, stats, "scanned");
+            }
+
+        } catch (const std::exception& e) {
+            std::cerr << "Skipping " << path << ": " << e.what() << std::endl;
+        }
+    }
+
+    std::cout.flush();
+    std::cerr << "Read " << read_files << " of " << files.size() << " files (" << read_bytes << " of " << total_bytes
+              << " bytes), " << skipped_files << " answered or skipped by their footer";
+    if (!query.stats_only) {
+        std::cerr << ", " << matches << " samples";
+    }
+    std::cerr << std::endl;
+    return 0;
+}
\ No newline at end of file
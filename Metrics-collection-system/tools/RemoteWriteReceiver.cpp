@@ -0,0 +1,119 @@
+#include "../MetricRemoteWrite.h"
+#include "../MetricSnappy.h"
+#include "../MetricUtilities.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+using namespace MetricsSystem;
+
+namespace {
+
+    void respond(TcpSocket& connection, const std::string& status, const std::string& body = std::string()) {
+        std::string response = "HTTP/1.1 " + status + "\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+        connection.sendAll(response);
+    }
+
+} // namespace
+
+// Local stand-in for a Prometheus remote-write endpoint, to try the
+// RemoteWrite output on loopback
+//   RemoteWriteReceiver [--port 9201] [--print] [--fail N] [--requests N]
+// Requests are decoded and counted; --print lists their samples in the text
+// output format, --fail answers the first N requests with 503 to exercise
+// retries, and --requests exits after N accepted requests. Connections are
+// served one at a time, each for as long as the client keeps it alive.
+int main(int argc, char* argv[]) {
+    uint16_t port = 9201;
+    bool print = false;
+    long fail = 0;
+    long max_requests = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            port = static_cast<uint16_t>(std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--print") == 0) {
+            print = true;
+        } else if (std::strcmp(argv[i], "--fail") == 0 && i + 1 < argc) {
+            fail = std::atol(argv[++i]);
+        } else if (std::strcmp(argv[i], "--requests") == 0 && i + 1 < argc) {
+            max_requests = std::atol(argv[++i]);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--port 9201] [--print] [--fail N] [--requests N]" << std::endl;
+            return 2;
+        }
+    }
+
+    try {
+        TcpSocket listener = TcpSocket::listen(port);
+        std::cout << "Listening on http://127.0.0.1:" << listener.localPort() << "/api/v1/write" << std::endl;
+
+        long accepted = 0;
+        long received = 0;
+        uint64_t total_samples = 0;
+        std::string body;
+        std::vector<RemoteSeries> series;
+
+        while (max_requests == 0 || accepted < max_requests) {
+            TcpSocket connection = listener.accept();
+            std::string buffer;
+            HttpMessage request;
+
+            try {
+                while ((max_requests == 0 || accepted < max_requests) && readHttpMessage(connection, buffer, request)) {
+                    ++received;
+                    if (request.start_line.compare(0, 5, "POST ") != 0) {
+                        respond(connection, "405 Method Not Allowed");
+                        continue;
+                    }
+                    if (received <= fail) {
+                        respond(connection, "503 Service Unavailable", "failing on purpose (--fail)");
+                        continue;
+                    }
+                    if (request.header("Content-Encoding") != "snappy" || !SnappyCodec::uncompress(request.body, body) ||
+                        !RemoteWriteWriter::decodeWriteRequest(body, series)) {
+                        respond(connection, "400 Bad Request", "expected a snappy-compressed WriteRequest");
+                        continue;
+                    }
+
+                    size_t samples = 0;
+                    for (const auto& s : series) {
+                        samples += s.samples.size();
+                        if (!print) {
+                            continue;
+                        }
+
+                        std::string name;
+                        for (const auto& [label, value] : s.labels) {
+                            if (label == "__name__") {
+                                name = value;
+                            }
+                        }
+                        for (const auto& [timestamp, value] : s.samples) {
+                            TimePoint tp{ std::chrono::milliseconds(timestamp) };
+                            std::cout << TimestampUtils::formatTimestamp(tp) << " "
+                                      << MetricNameValidator::formatNameForOutput(name) << " " << value << "\n";
+                        }
+                    }
+                    total_samples += samples;
+                    ++accepted;
+                    respond(connection, "204 No Content");
+
+                    std::cout << "Request " << received << ": " << series.size() << " series, " << samples
+                              << " samples (" << request.body.size() << " bytes snappy, " << body.size()
+                              << " bytes protobuf)" << std::endl;
+                }
+            } catch (const std::exception& e) {
+                std::cerr << "Connection error: " << e.what() << std::endl;
+            }
+        }
+
+        std::cout << "Received " << accepted << " requests with " << total_samples << " samples" << std::endl;
+
+    } catch (const std::exception& e) {
+        std::cerr << "Receiver failed: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
\ No newline at end of file